@@ -30,7 +30,7 @@
 #ifndef _GZIP_ENCODING_H_
 #define _GZIP_ENCODING_H_
 #include "net/http_client_base.h"
-#include "zlib/zlib.h"
+#include <zlib.h>
 //#include "http.h"
 
 
@@ -41,6 +41,30 @@ namespace net_utils
 
 
 
+	/*! \brief
+	*  Function gzip_encode : Compresses whole buffer into gzip format (or zlib format in deflate mode)
+	*
+	*/
+	inline
+	bool gzip_encode(const std::string& in, std::string& out, bool is_deflate_mode = false)
+	{
+		z_stream zstream_out;
+		memset(&zstream_out, 0, sizeof(zstream_out));
+		int ret = deflateInit2(&zstream_out, Z_DEFAULT_COMPRESSION, Z_DEFLATED, is_deflate_mode ? MAX_WBITS : 0x1F, 8, Z_DEFAULT_STRATEGY);
+		CHECK_AND_ASSERT_MES(ret == Z_OK, false, "gzip_encode() Failed to init deflate. err = " << ret);
+
+		out.resize(deflateBound(&zstream_out, (uLong)in.size()));
+		zstream_out.next_in = (Bytef*)in.data();
+		zstream_out.avail_in = (uInt)in.size();
+		zstream_out.next_out = (Bytef*)out.data();
+		zstream_out.avail_out = (uInt)out.size();
+		ret = deflate(&zstream_out, Z_FINISH);
+		out.resize(out.size() - zstream_out.avail_out);
+		deflateEnd(&zstream_out);
+		CHECK_AND_ASSERT_MES(ret == Z_STREAM_END, false, "gzip_encode() Failed to deflate. err = " << ret);
+		return true;
+	}
+
 	class content_encoding_gzip: public i_sub_handler
 	{
 	public:
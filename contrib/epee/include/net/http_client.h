@@ -240,6 +240,7 @@ using namespace std;
 			reciev_machine_state m_state;
 			chunked_state m_chunked_state;
 			std::string m_chunked_cache;
+			bool m_got_response_data;
 			critical_section m_lock;
 
 		public:
@@ -300,7 +301,8 @@ using namespace std;
 			inline bool invoke(const std::string& uri, const std::string& method, const std::string& body, const http_response_info** ppresponse_info = NULL, const fields_list& additional_params = fields_list())
 			{
 				CRITICAL_REGION_LOCAL(m_lock);
-				if(!is_connected())
+				bool reused_connection = is_connected();
+				if(!reused_connection)
 				{
 					LOG_PRINT("Reconnecting...", LOG_LEVEL_3);
 					if(!connect(m_host_buff, m_port, m_timeout))
@@ -309,10 +311,40 @@ using namespace std;
 						return false;
 					}
 				}
+				if(invoke_on_connection(uri, method, body, ppresponse_info, additional_params))
+					return true;
+				if(!reused_connection || m_got_response_data)
+					return false;
+
+				//server could close kept-alive connection while it was idle, try once more with a new one
+				LOG_PRINT("Kept-alive connection was lost, reconnecting...", LOG_LEVEL_3);
+				disconnect();
+				if(!connect(m_host_buff, m_port, m_timeout))
+				{
+					LOG_PRINT("Failed to connect to " << m_host_buff << ":" << m_port, LOG_LEVEL_3);
+					return false;
+				}
+				return invoke_on_connection(uri, method, body, ppresponse_info, additional_params);
+			}
+			//---------------------------------------------------------------------------
+			inline bool invoke_post(const std::string& uri, const std::string& body,  const http_response_info** ppresponse_info = NULL, const fields_list& additional_params = fields_list())
+			{
+				CRITICAL_REGION_LOCAL(m_lock);
+				return invoke(uri, "POST", body, ppresponse_info, additional_params);
+			}
+		private: 
+			//---------------------------------------------------------------------------
+			inline bool invoke_on_connection(const std::string& uri, const std::string& method, const std::string& body, const http_response_info** ppresponse_info, const fields_list& additional_params)
+			{
+				CRITICAL_REGION_LOCAL(m_lock);
 				m_response_info.clear();
+				m_got_response_data = false;
 				std::string req_buff = 	method + " ";
 				req_buff += uri + " HTTP/1.1\r\n" + 
 					"Host: "+ m_host_buff +"\r\n" +	"Content-Length: " + boost::lexical_cast<std::string>(body.size()) + "\r\n";
+#ifdef HTTP_ENABLE_GZIP
+				req_buff += "Accept-Encoding: gzip\r\n";
+#endif
 
 
 				//handle "additional_params"
@@ -321,11 +353,10 @@ using namespace std;
 				req_buff += "\r\n";
 				//--
 
+				//header and body in one send, so they go in one packet
+				req_buff += body;
 				bool res = m_net_client.send(req_buff);
 				CHECK_AND_ASSERT_MES(res, false, "HTTP_CLIENT: Failed to SEND");
-				if(body.size())
-					res = m_net_client.send(body);
-				CHECK_AND_ASSERT_MES(res, false, "HTTP_CLIENT: Failed to SEND");
 
 				if(ppresponse_info)
 					*ppresponse_info = &m_response_info;
@@ -333,13 +364,6 @@ using namespace std;
 				m_state = reciev_machine_state_header;
 				return handle_reciev();
 			}
-			//---------------------------------------------------------------------------
-			inline bool invoke_post(const std::string& uri, const std::string& body,  const http_response_info** ppresponse_info = NULL, const fields_list& additional_params = fields_list())
-			{
-				CRITICAL_REGION_LOCAL(m_lock);
-				return invoke(uri, "POST", body, ppresponse_info, additional_params);
-			}
-		private: 
 			//---------------------------------------------------------------------------
 			inline bool handle_reciev()
 			{
@@ -356,6 +380,8 @@ using namespace std;
 							LOG_PRINT("Unexpected reciec fail", LOG_LEVEL_3);
 							m_state = reciev_machine_state_error;
             }
+            if(recv_buffer.size())
+              m_got_response_data = true;
             if(!recv_buffer.size())
             {
               //connection is going to be closed
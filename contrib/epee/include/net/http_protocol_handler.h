@@ -109,6 +109,13 @@ namespace net_utils
 				http_body_transfer_undefined
 			};
 
+			enum chunked_state{
+				http_chunked_state_size,
+				http_chunked_state_body,
+				http_chunked_state_body_end,
+				http_chunked_state_trailer
+			};
+
 			bool handle_buff_in(std::string& buf);
 
 			bool analize_cached_request_header_and_invoke_state(size_t pos);
@@ -119,10 +126,12 @@ namespace net_utils
 			bool get_len_from_content_lenght(const std::string& str, size_t& len);
 			bool handle_retriving_query_body();
 			bool handle_query_measure();
+			bool handle_query_chunked();
 			bool set_ready_state();
 			bool slash_to_back_slash(std::string& str);
 			std::string get_file_mime_tipe(const std::string& path);
 			std::string get_response_header(const http_response_info& response);
+			bool is_gzip_accepted(const http::http_request_info& query_info);
 
 			//major function 
 			inline bool handle_request_and_send_response(const http::http_request_info& query_info);
@@ -137,6 +146,7 @@ namespace net_utils
 			bool m_is_stop_handling;
 			http::http_request_info m_query_info;
 			size_t m_len_summary, m_len_remain;
+			chunked_state m_chunked_state;
 			config_type& m_config;
 			bool m_want_close;
 		protected:
@@ -32,9 +32,16 @@
 #include "string_tools.h"
 #include "file_io_utils.h"
 #include "net_parse_helpers.h"
+#ifdef HTTP_ENABLE_GZIP
+#include "gzip_encoding.h"
+#endif
 
 #define HTTP_MAX_URI_LEN		 9000 
 #define HTTP_MAX_HEADER_LEN		 100000
+#define HTTP_MAX_CHUNK_LINE_LEN		 1024
+#define HTTP_MAX_BODY_SIZE		 (50 * 1024 * 1024)
+#define HTTP_MAX_COALESCED_BODY_SIZE	 65536 //smaller bodies are sent together with the header
+#define HTTP_MIN_GZIP_BODY_SIZE		 1024
 
 namespace epee
 {
@@ -198,6 +205,7 @@ namespace net_utils
         m_is_stop_handling(false),
 		m_len_summary(0),
 		m_len_remain(0),
+		m_chunked_state(http_chunked_state_size),
 		m_config(config), 
 		m_want_close(false),
         m_psnd_hndlr(psnd_hndlr)
@@ -213,6 +221,8 @@ namespace net_utils
 		m_body_transfer_type = http_body_transfer_undefined;
 		m_query_info.clear();
 		m_len_summary = 0;
+		m_len_remain = 0;
+		m_chunked_state = http_chunked_state_size;
 		return true;
 	}
 	//--------------------------------------------------------------------------------------------
@@ -289,7 +299,10 @@ namespace net_utils
 					break;
 				}
 			case http_state_retriving_body:
-				return handle_retriving_query_body();
+				//keep going: pipelined requests may follow the body in the cache
+				if(!handle_retriving_query_body())
+					return false;
+				break;
 			case http_state_connection_close:
 				return false;
 			default:
@@ -300,7 +313,7 @@ namespace net_utils
 				return false;
 			}
 
-			if(!m_cache.size())
+			if(!m_cache.size() || m_want_close)
 				m_is_stop_handling = true;
 		}
 
@@ -338,7 +351,7 @@ namespace net_utils
 		boost::smatch result;	
 		if(boost::regex_search(m_cache, result, rexp_match_command_line, boost::match_default) && result[0].matched)
 		{
-			analize_http_method(result, m_query_info.m_http_method, m_query_info.m_http_ver_hi, m_query_info.m_http_ver_hi);
+			analize_http_method(result, m_query_info.m_http_method, m_query_info.m_http_ver_hi, m_query_info.m_http_ver_lo);
 			m_query_info.m_URI = result[10];
       parse_uri(m_query_info.m_URI, m_query_info.m_uri_content);
 			m_query_info.m_http_method_str = result[2];
@@ -364,6 +377,11 @@ namespace net_utils
 	{
 
     //Here we returning head size, including terminating sequence (\r\n\r\n or \n\n)
+		//request without header fields: only the empty line follows the command line
+		if(!buf.compare(0, 2, "\r\n"))
+			return 2;
+		if(!buf.compare(0, 1, "\n"))
+			return 1;
 		std::string::size_type res = buf.find("\r\n\r\n");
 		if(std::string::npos != res)
 			return res+4;
@@ -393,8 +411,13 @@ namespace net_utils
 
 		std::string req_command_str = m_query_info.m_full_request_str;
     //if we have POST or PUT command, it is very possible tha we will get body
-    //but now, we suppose than we have body only in case of we have "ContentLength" 
-		if(m_query_info.m_header_info.m_content_length.size())
+    //but now, we suppose than we have body only in case of we have "ContentLength" or chunked "Transfer-Encoding"
+		if(std::string::npos != boost::algorithm::to_lower_copy(m_query_info.m_header_info.m_transfer_encoding).find("chunked"))
+		{
+			m_state = http_state_retriving_body;
+			m_body_transfer_type = http_body_transfer_chunked;
+			m_chunked_state = http_chunked_state_size;
+		}else if(m_query_info.m_header_info.m_content_length.size())
 		{
 			m_state = http_state_retriving_body;
 			m_body_transfer_type = http_body_transfer_measure;
@@ -404,6 +427,12 @@ namespace net_utils
 				m_state = http_state_error;
 				return false;
 			}
+			if(m_len_summary > HTTP_MAX_BODY_SIZE)
+			{
+				LOG_ERROR("simple_http_connection_handler<t_connection_context>::analize_cached_request_header_and_invoke_state(): Too big body, m_query_info.m_content_length=" << m_query_info.m_header_info.m_content_length);
+				m_state = http_state_error;
+				return false;
+			}
 			if(0 == m_len_summary)
 			{	//current query finished, next will be next query
 				if(handle_request_and_send_response(m_query_info))
@@ -429,6 +458,7 @@ namespace net_utils
 		case http_body_transfer_measure:
 			return handle_query_measure();
 		case http_body_transfer_chunked:
+			return handle_query_chunked();
 		case http_body_transfer_connection_close:
 		case http_body_transfer_multipart:
 		case http_body_transfer_undefined:
@@ -466,6 +496,93 @@ namespace net_utils
 		}
 		return true;
 	}
+	//-----------------------------------------------------------------------------------
+  template<class t_connection_context>
+	bool simple_http_connection_handler<t_connection_context>::handle_query_chunked()
+	{
+		while(true)
+		{
+			if(m_chunked_state == http_chunked_state_body)
+			{
+				if(m_len_remain > m_cache.size())
+				{
+					m_len_remain -= m_cache.size();
+					m_query_info.m_body += m_cache;
+					m_cache.clear();
+					m_is_stop_handling = true;
+					return true;
+				}
+				m_query_info.m_body.append(m_cache.begin(), m_cache.begin() + m_len_remain);
+				m_cache.erase(0, m_len_remain);
+				m_len_remain = 0;
+				m_chunked_state = http_chunked_state_body_end;
+				continue;
+			}
+
+			//all other states read one line
+			std::string::size_type pos = m_cache.find('\n');
+			if(std::string::npos == pos)
+			{
+				m_is_stop_handling = true;
+				if(m_cache.size() > HTTP_MAX_CHUNK_LINE_LEN)
+				{
+					LOG_ERROR("simple_http_connection_handler::handle_query_chunked(): Too long chunk line");
+					m_state = http_state_error;
+					return false;
+				}
+				return true;
+			}
+			std::string line = m_cache.substr(0, pos);
+			m_cache.erase(0, pos + 1);
+			string_tools::trim(line);
+
+			switch(m_chunked_state)
+			{
+			case http_chunked_state_size:
+				{
+					//chunk extensions after ';' are ignored
+					std::string size_str = line.substr(0, line.find(';'));
+					string_tools::trim(size_str);
+					if(size_str.empty() || size_str.size() > sizeof(size_t) * 2 || std::string::npos != size_str.find_first_not_of("0123456789abcdefABCDEF"))
+					{
+						LOG_ERROR("simple_http_connection_handler::handle_query_chunked(): Wrong chunk size line: " << line);
+						m_state = http_state_error;
+						return false;
+					}
+					m_len_remain = std::stoull(size_str, nullptr, 16);
+					if(m_len_remain > HTTP_MAX_BODY_SIZE - m_query_info.m_body.size())
+					{
+						LOG_ERROR("simple_http_connection_handler::handle_query_chunked(): Too big body, chunk size line: " << line);
+						m_state = http_state_error;
+						return false;
+					}
+					m_chunked_state = m_len_remain ? http_chunked_state_body : http_chunked_state_trailer;
+					break;
+				}
+			case http_chunked_state_body_end:
+				if(line.size())
+				{
+					LOG_ERROR("simple_http_connection_handler::handle_query_chunked(): Chunk data is not followed by line break");
+					m_state = http_state_error;
+					return false;
+				}
+				m_chunked_state = http_chunked_state_size;
+				break;
+			case http_chunked_state_trailer:
+				if(line.size())
+					break; //trailer fields are not used
+				//current query finished, next will be next query
+				if(handle_request_and_send_response(m_query_info))
+					set_ready_state();
+				else
+					m_state = http_state_error;
+				return true;
+			default:
+				m_state = http_state_error;
+				return false;
+			}
+		}
+	}
 	//--------------------------------------------------------------------------------------------
   template<class t_connection_context>
 	bool simple_http_connection_handler<t_connection_context>::parse_cached_header(http_header_info& body_info, const std::string& m_cache_to_process, size_t pos)
@@ -540,14 +657,34 @@ namespace net_utils
 		bool res = handle_request(query_info, response);
 		//CHECK_AND_ASSERT_MES(res, res, "handle_request(query_info, response) returned false" );
 
+#ifdef HTTP_ENABLE_GZIP
+		if(response.m_body.size() >= HTTP_MIN_GZIP_BODY_SIZE && is_gzip_accepted(query_info))
+		{
+			std::string gzipped_body;
+			if(gzip_encode(response.m_body, gzipped_body) && gzipped_body.size() < response.m_body.size())
+			{
+				response.m_body.swap(gzipped_body);
+				response.m_additional_fields.push_back(std::make_pair("Content-Encoding", " gzip"));
+				response.m_additional_fields.push_back(std::make_pair("Vary", " Accept-Encoding"));
+			}
+		}
+#endif
+
 		std::string response_data = get_response_header(response);
 		
 		//LOG_PRINT_L0("HTTP_SEND: << \r\n" << response_data + response.m_body);
     LOG_PRINT_L3("HTTP_RESPONSE_HEAD: << \r\n" << response_data);
 		
-		m_psnd_hndlr->do_send((void*)response_data.data(), response_data.size());
-		if(response.m_body.size())
+		//one send for header and small body, so they go in one packet
+		if(response.m_body.size() <= HTTP_MAX_COALESCED_BODY_SIZE)
+		{
+			response_data += response.m_body;
+			m_psnd_hndlr->do_send((void*)response_data.data(), response_data.size());
+		}else
+		{
+			m_psnd_hndlr->do_send((void*)response_data.data(), response_data.size());
 			m_psnd_hndlr->do_send((void*)response.m_body.data(), response.m_body.size());
+		}
 		return res;
 	}
 	//-----------------------------------------------------------------------------------
@@ -600,16 +737,25 @@ namespace net_utils
 		buf += "Accept-Ranges: bytes\r\n";
 		//Wed, 01 Dec 2010 03:27:41 GMT"
 
+		//HTTP/1.1 connections are persistent by default, HTTP/1.0 ones only on "Connection: keep-alive"
+		bool keep_alive = m_query_info.m_http_ver_hi > 1 || (m_query_info.m_http_ver_hi == 1 && m_query_info.m_http_ver_lo >= 1);
 		string_tools::trim(m_query_info.m_header_info.m_connection);
 		if(m_query_info.m_header_info.m_connection.size())
 		{
 			if(!string_tools::compare_no_case("close", m_query_info.m_header_info.m_connection))
-			{
-        //closing connection after sending
-				buf += "Connection: close\r\n";
-				m_state = http_state_connection_close;
-				m_want_close = true;
-			}
+				keep_alive = false;
+			else if(!string_tools::compare_no_case("keep-alive", m_query_info.m_header_info.m_connection))
+				keep_alive = true;
+		}
+		if(!keep_alive)
+		{
+      //closing connection after sending
+			buf += "Connection: close\r\n";
+			m_state = http_state_connection_close;
+			m_want_close = true;
+		}else if(m_query_info.m_http_ver_hi == 1 && m_query_info.m_http_ver_lo == 0)
+		{
+			buf += "Connection: keep-alive\r\n";
 		}
 		//add additional fields, if it is
 		for(fields_list::const_iterator it = response.m_additional_fields.begin(); it!=response.m_additional_fields.end(); it++)
@@ -621,6 +767,17 @@ namespace net_utils
 	}
 	//-----------------------------------------------------------------------------------
 	template<class t_connection_context>
+  bool simple_http_connection_handler<t_connection_context>::is_gzip_accepted(const http::http_request_info& query_info)
+	{
+		for(fields_list::const_iterator it = query_info.m_header_info.m_etc_fields.begin(); it != query_info.m_header_info.m_etc_fields.end(); it++)
+		{
+			if(!string_tools::compare_no_case(it->first, "Accept-Encoding"))
+				return std::string::npos != boost::algorithm::to_lower_copy(it->second).find("gzip");
+		}
+		return false;
+	}
+	//-----------------------------------------------------------------------------------
+	template<class t_connection_context>
   std::string simple_http_connection_handler<t_connection_context>::get_file_mime_tipe(const std::string& path)
 	{
 		std::string result;
@@ -34,10 +34,9 @@ namespace misc_utils
 {
   namespace parse
   {
-    inline std::string transform_to_escape_sequence(const std::string& src)
+    //appends escaped src to res, json writers use it to avoid temporary strings
+    inline void transform_to_escape_sequence(const std::string& src, std::string& res)
     {
-      //std::stringstream res;
-      std::string res;
       for(std::string::const_iterator it = src.begin(); it!=src.end(); ++it)
       {
         switch(*it)
@@ -66,6 +65,11 @@ namespace misc_utils
           res.push_back(*it);
         }
       }
+    }
+    inline std::string transform_to_escape_sequence(const std::string& src)
+    {
+      std::string res;
+      transform_to_escape_sequence(src, res);
       return res;
     }
     /*
@@ -0,0 +1,413 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+
+
+
+#pragma once 
+
+#include <cstring>
+#include <deque>
+#include <vector>
+#include "misc_language.h"
+#include "misc_log_ex.h"
+#include "portable_storage_base.h"
+#include "portable_storage_from_bin.h"
+#include "portable_storage_val_converters.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Storage for KV_SERIALIZE maps' load() which reads values straight    */
+    /* from the binary buffer. load_from_binary() only indexes entries of   */
+    /* the buffer, portable_storage tree is not built and values are not    */
+    /* copied until the struct asks for them.                               */
+    /* The buffer should stay alive while the storage is used.              */
+    /************************************************************************/
+    class binary_view_storage
+    {
+      struct view_reader
+      {
+        const uint8_t* m_ptr;
+        const uint8_t* m_end;
+
+        size_t remaining() const { return m_end - m_ptr; }
+
+        const uint8_t* skip(size_t count)
+        {
+          CHECK_AND_ASSERT_THROW_MES(count <= remaining(), "attempt to read " << count << " bytes from buffer with " << remaining() << " bytes remained");
+          const uint8_t* p = m_ptr;
+          m_ptr += count;
+          return p;
+        }
+
+        template<class t_pod_type>
+        t_pod_type read()
+        {
+          t_pod_type v;
+          memcpy(&v, skip(sizeof(v)), sizeof(v));
+          return v;
+        }
+
+        size_t read_varint()
+        {
+          CHECK_AND_ASSERT_THROW_MES(remaining() >= 1, "empty buff, expected place for varint");
+          size_t v = 0;
+          switch (*m_ptr & PORTABLE_RAW_SIZE_MARK_MASK)
+          {
+          case PORTABLE_RAW_SIZE_MARK_BYTE: v = read<uint8_t>(); break;
+          case PORTABLE_RAW_SIZE_MARK_WORD: v = read<uint16_t>(); break;
+          case PORTABLE_RAW_SIZE_MARK_DWORD: v = read<uint32_t>(); break;
+          case PORTABLE_RAW_SIZE_MARK_INT64: v = static_cast<size_t>(read<uint64_t>()); break;
+          }
+          return v >> 2;
+        }
+
+        size_t read_string_len()
+        {
+          size_t len = read_varint();
+          CHECK_AND_ASSERT_THROW_MES(len < MAX_STRING_LEN_POSSIBLE, "to big string len value in storage: " << len);
+          return len;
+        }
+      };
+
+      struct entry_view
+      {
+        const char* name;
+        uint8_t name_len;
+        uint8_t type;           //type of the value, or item type with SERIALIZE_FLAG_ARRAY for arrays
+        const uint8_t* praw;    //[praw, pend) is the whole entry after the name, as it is in the buffer
+        const uint8_t* pend;
+        const uint8_t* pvalue;  //the value or the first item of array
+        size_t count;           //items in array
+        size_t index;           //object: index in m_sections, array of objects: first index in m_array_sections
+      };
+
+      struct section_view
+      {
+        size_t first_entry;
+        size_t entries_count;
+      };
+
+      struct array_cursor
+      {
+        const entry_view* pentry;
+        size_t pos;
+        view_reader reader;
+      };
+
+#pragma pack(push)
+#pragma pack(1)
+      struct storage_block_header
+      {
+        uint32_t m_signature_a;
+        uint32_t m_signature_b;
+        uint8_t  m_ver;
+      };
+#pragma pack(pop)
+
+    public:
+      typedef const section_view* hsection;
+      typedef array_cursor* harray;
+      typedef storage_entry meta_entry;
+
+      binary_view_storage() :m_empty_section(section_view{ 0, 0 })
+      {}
+
+      bool load_from_binary(const std::string& source)
+      {
+        m_entries.clear();
+        m_sections.clear();
+        m_array_sections.clear();
+        m_cursors.clear();
+        storage_block_header hdr = AUTO_VAL_INIT(hdr);
+        if (source.size() < sizeof(hdr))
+        {
+          LOG_ERROR("binary_view_storage: wrong binary format, packet size = " << source.size() << " less than expected sizeof(storage_block_header)=" << sizeof(hdr));
+          return false;
+        }
+        memcpy(&hdr, source.data(), sizeof(hdr));
+        if (hdr.m_signature_a != PORTABLE_STORAGE_SIGNATUREA || hdr.m_signature_b != PORTABLE_STORAGE_SIGNATUREB)
+        {
+          LOG_ERROR("binary_view_storage: wrong binary format - signature missmatch");
+          return false;
+        }
+        if (hdr.m_ver != PORTABLE_STORAGE_FORMAT_VER)
+        {
+          LOG_ERROR("binary_view_storage: wrong binary format - unknown format ver = " << hdr.m_ver);
+          return false;
+        }
+        TRY_ENTRY();
+        view_reader r = { reinterpret_cast<const uint8_t*>(source.data()) + sizeof(hdr), reinterpret_cast<const uint8_t*>(source.data()) + source.size() };
+        m_sections.push_back(section_view{ 0, 0 });
+        read_section(r, 0, 0);
+        return true;
+        CATCH_ENTRY("binary_view_storage::load_from_binary", false);
+      }
+
+      hsection open_section(const std::string& section_name, hsection hparent_section, bool create_if_notexist = false)
+      {
+        const entry_view* pentry = find_entry(section_name, hparent_section);
+        if (pentry && pentry->type == SERIALIZE_TYPE_OBJECT)
+          return &m_sections[pentry->index];
+        //portable_storage adds an empty section here, nothing can be read from it anyway
+        return create_if_notexist ? &m_empty_section : nullptr;
+      }
+
+      template<class t_value>
+      bool get_value(const std::string& value_name, t_value& val, hsection hparent_section)
+      {
+        const entry_view* pentry = find_entry(value_name, hparent_section);
+        if (!pentry)
+          return false;
+        view_reader r = { pentry->pvalue, pentry->pend };
+        read_item(pentry->type, r, val);
+        return true;
+      }
+
+      bool get_value(const std::string& value_name, storage_entry& val, hsection hparent_section)
+      {
+        const entry_view* pentry = find_entry(value_name, hparent_section);
+        if (!pentry)
+          return false;
+        throwable_buffer_reader r(pentry->praw, pentry->pend - pentry->praw);
+        val = r.load_storage_entry();
+        return true;
+      }
+
+      template<class t_value>
+      harray get_first_value(const std::string& value_name, t_value& target, hsection hparent_section)
+      {
+        const entry_view* pentry = find_entry(value_name, hparent_section);
+        if (!pentry || !(pentry->type & SERIALIZE_FLAG_ARRAY) || !pentry->count)
+          return nullptr;
+        m_cursors.push_back(array_cursor{ pentry, 0, view_reader{ pentry->pvalue, pentry->pend } });
+        harray harr = &m_cursors.back();
+        get_next_value(harr, target);
+        return harr;
+      }
+
+      template<class t_value>
+      bool get_next_value(harray hval_array, t_value& target)
+      {
+        if (hval_array->pos == hval_array->pentry->count)
+          return false;
+        read_item(hval_array->pentry->type & ~SERIALIZE_FLAG_ARRAY, hval_array->reader, target);
+        ++hval_array->pos;
+        return true;
+      }
+
+      harray get_first_section(const std::string& section_name, hsection& h_child_section, hsection hparent_section)
+      {
+        const entry_view* pentry = find_entry(section_name, hparent_section);
+        if (!pentry || pentry->type != (SERIALIZE_TYPE_OBJECT | SERIALIZE_FLAG_ARRAY) || !pentry->count)
+          return nullptr;
+        m_cursors.push_back(array_cursor{ pentry, 0, view_reader{ nullptr, nullptr } });
+        harray harr = &m_cursors.back();
+        get_next_section(harr, h_child_section);
+        return harr;
+      }
+
+      bool get_next_section(harray hsec_array, hsection& h_child_section)
+      {
+        if (hsec_array->pos == hsec_array->pentry->count)
+          return false;
+        h_child_section = &m_sections[m_array_sections[hsec_array->pentry->index + hsec_array->pos]];
+        ++hsec_array->pos;
+        return true;
+      }
+
+    private:
+      //---------------------------------------------------------------------------------------------------------------
+      static size_t get_pod_size(uint8_t type)
+      {
+        switch (type)
+        {
+        case SERIALIZE_TYPE_INT64:  return sizeof(int64_t);
+        case SERIALIZE_TYPE_INT32:  return sizeof(int32_t);
+        case SERIALIZE_TYPE_INT16:  return sizeof(int16_t);
+        case SERIALIZE_TYPE_INT8:   return sizeof(int8_t);
+        case SERIALIZE_TYPE_UINT64: return sizeof(uint64_t);
+        case SERIALIZE_TYPE_UINT32: return sizeof(uint32_t);
+        case SERIALIZE_TYPE_UINT16: return sizeof(uint16_t);
+        case SERIALIZE_TYPE_UINT8:  return sizeof(uint8_t);
+        case SERIALIZE_TYPE_DUOBLE: return sizeof(double);
+        case SERIALIZE_TYPE_BOOL:   return sizeof(bool);
+        default:
+          ASSERT_MES_AND_THROW("unknown entry_type code = " << static_cast<uint32_t>(type));
+        }
+      }
+      //---------------------------------------------------------------------------------------------------------------
+      void read_section(view_reader& r, size_t section_index, size_t depth)
+      {
+        CHECK_AND_ASSERT_THROW_MES(depth < EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL, "Wrong blob data in portable storage: recursion limitation (" << EPEE_PORTABLE_STORAGE_RECURSION_LIMIT_INTERNAL << ") exceeded");
+        size_t count = r.read_varint();
+        //every entry takes at least 3 bytes: name length, type and value
+        CHECK_AND_ASSERT_THROW_MES(count <= r.remaining() / 3, "entries count " << count << " goes out of remain storage len " << r.remaining());
+        size_t first = m_entries.size();
+        m_entries.resize(first + count);
+        m_sections[section_index].first_entry = first;
+        m_sections[section_index].entries_count = count;
+        for (size_t i = 0; i != count; ++i)
+        {
+          //nested sections add entries, so the entry is written to m_entries when it is complete
+          entry_view e = AUTO_VAL_INIT(e);
+          e.name_len = r.read<uint8_t>();
+          e.name = reinterpret_cast<const char*>(r.skip(e.name_len));
+          e.praw = r.m_ptr;
+          e.type = r.read<uint8_t>();
+          read_entry_value(r, e, depth);
+          e.pend = r.m_ptr;
+          m_entries[first + i] = e;
+        }
+      }
+      //---------------------------------------------------------------------------------------------------------------
+      void read_entry_value(view_reader& r, entry_view& e, size_t depth)
+      {
+        if (e.type & SERIALIZE_FLAG_ARRAY)
+          return read_array(r, e, depth);
+
+        e.pvalue = r.m_ptr;
+        switch (e.type)
+        {
+        case SERIALIZE_TYPE_OBJECT:
+          e.index = add_section();
+          read_section(r, e.index, depth + 1);
+          break;
+        case SERIALIZE_TYPE_ARRAY:
+          e.type = r.read<uint8_t>();
+          CHECK_AND_ASSERT_THROW_MES(e.type & SERIALIZE_FLAG_ARRAY, "wrong type sequenses");
+          read_array(r, e, depth);
+          break;
+        case SERIALIZE_TYPE_STRING:
+          r.skip(r.read_string_len());
+          break;
+        default:
+          r.skip(get_pod_size(e.type));
+        }
+      }
+      //---------------------------------------------------------------------------------------------------------------
+      void read_array(view_reader& r, entry_view& e, size_t depth)
+      {
+        uint8_t item_type = e.type & ~SERIALIZE_FLAG_ARRAY;
+        e.count = r.read_varint();
+        //every item takes at least one byte
+        CHECK_AND_ASSERT_THROW_MES(e.count <= r.remaining(), "array size " << e.count << " goes out of remain storage len " << r.remaining());
+        e.pvalue = r.m_ptr;
+        switch (item_type)
+        {
+        case SERIALIZE_TYPE_OBJECT:
+          e.index = m_array_sections.size();
+          m_array_sections.resize(e.index + e.count);
+          for (size_t i = 0; i != e.count; ++i)
+          {
+            size_t section_index = add_section();
+            m_array_sections[e.index + i] = section_index;
+            read_section(r, section_index, depth + 1);
+          }
+          break;
+        case SERIALIZE_TYPE_STRING:
+          for (size_t i = 0; i != e.count; ++i)
+            r.skip(r.read_string_len());
+          break;
+        case SERIALIZE_TYPE_ARRAY:
+          ASSERT_MES_AND_THROW("arrays of arrays are not supported");
+        default:
+          r.skip(e.count * get_pod_size(item_type));
+        }
+      }
+      //---------------------------------------------------------------------------------------------------------------
+      size_t add_section()
+      {
+        m_sections.push_back(section_view{ 0, 0 });
+        return m_sections.size() - 1;
+      }
+      //---------------------------------------------------------------------------------------------------------------
+      const entry_view* find_entry(const std::string& name, hsection hparent_section) const
+      {
+        if (!hparent_section)
+        {
+          if (m_sections.empty())
+            return nullptr;
+          hparent_section = &m_sections.front();
+        }
+        //sections have a few entries, a linear search is faster than building a map; the first one of duplicates wins as in portable_storage
+        const entry_view* it = m_entries.data() + hparent_section->first_entry;
+        const entry_view* end = it + hparent_section->entries_count;
+        for (; it != end; ++it)
+        {
+          if (it->name_len == name.size() && !memcmp(it->name, name.data(), name.size()))
+            return it;
+        }
+        return nullptr;
+      }
+      //---------------------------------------------------------------------------------------------------------------
+      template<class t_value>
+      static void read_item(uint8_t type, view_reader& r, t_value& val)
+      {
+        switch (type)
+        {
+        case SERIALIZE_TYPE_INT64:  convert_t(r.read<int64_t>(), val); break;
+        case SERIALIZE_TYPE_INT32:  convert_t(r.read<int32_t>(), val); break;
+        case SERIALIZE_TYPE_INT16:  convert_t(r.read<int16_t>(), val); break;
+        case SERIALIZE_TYPE_INT8:   convert_t(r.read<int8_t>(), val); break;
+        case SERIALIZE_TYPE_UINT64: convert_t(r.read<uint64_t>(), val); break;
+        case SERIALIZE_TYPE_UINT32: convert_t(r.read<uint32_t>(), val); break;
+        case SERIALIZE_TYPE_UINT16: convert_t(r.read<uint16_t>(), val); break;
+        case SERIALIZE_TYPE_UINT8:  convert_t(r.read<uint8_t>(), val); break;
+        case SERIALIZE_TYPE_DUOBLE: convert_t(r.read<double>(), val); break;
+        case SERIALIZE_TYPE_BOOL:   convert_t(r.read<bool>(), val); break;
+        case SERIALIZE_TYPE_STRING: read_string(r, val); break;
+        default:
+          ASSERT_MES_AND_THROW("wrong conversion from entry_type code = " << static_cast<uint32_t>(type));
+        }
+      }
+      //---------------------------------------------------------------------------------------------------------------
+      static void read_string(view_reader& r, std::string& val)
+      {
+        //the only copy of the string, right from the buffer
+        size_t len = r.read_string_len();
+        val.assign(reinterpret_cast<const char*>(r.skip(len)), len);
+      }
+      //---------------------------------------------------------------------------------------------------------------
+      template<class t_value>
+      static void read_string(view_reader& r, t_value& val)
+      {
+        std::string s;
+        read_string(r, s);
+        convert_t(s, val);
+      }
+
+      std::vector<entry_view> m_entries;        //entries of all sections, every section takes a continuous range
+      std::vector<section_view> m_sections;     //root section goes first
+      std::vector<size_t> m_array_sections;     //sections of arrays of objects, every array takes a continuous range
+      std::deque<array_cursor> m_cursors;       //references stay valid on push_back
+      section_view m_empty_section;
+    };
+  }
+}
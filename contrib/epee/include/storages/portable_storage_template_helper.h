@@ -27,6 +27,8 @@
 #pragma once
 #include "parserse_base_utils.h"
 #include "portable_storage.h"
+#include "portable_storage_from_bin_view.h"
+#include "portable_storage_to_json_stream.h"
 #include "file_io_utils.h"
 
 namespace epee
@@ -58,9 +60,11 @@ namespace epee
     template<class t_struct>
     bool store_t_to_json(t_struct& str_in, std::string& json_buff, size_t indent = 0)
     {
-      portable_storage ps;
-      str_in.store(ps);
-      ps.dump_as_json(json_buff, indent);
+      //json is written while the struct is walked, portable_storage tree is not built
+      json_buff.clear();
+      json_stream_storage jss(json_buff, indent);
+      str_in.store(jss);
+      jss.finish();
       return true;
     }
     //-----------------------------------------------------------------------------------------------------------
@@ -83,12 +87,13 @@ namespace epee
     template<class t_struct>
     bool load_t_from_binary(t_struct& out, const std::string& binary_buff)
     {
-      portable_storage ps;
-      bool rs = ps.load_from_binary(binary_buff);
+      //values are read right from binary_buff, portable_storage tree is not built
+      binary_view_storage bvs;
+      bool rs = bvs.load_from_binary(binary_buff);
       if(!rs)
         return false;
 
-      return out.load(ps);
+      return out.load(bvs);
     }
     //-----------------------------------------------------------------------------------------------------------
     template<class t_struct>
@@ -0,0 +1,224 @@
+// Copyright (c) 2006-2013, Andrey N. Sabelnikov, www.sabelnikov.net
+// All rights reserved.
+// 
+// Redistribution and use in source and binary forms, with or without
+// modification, are permitted provided that the following conditions are met:
+// * Redistributions of source code must retain the above copyright
+// notice, this list of conditions and the following disclaimer.
+// * Redistributions in binary form must reproduce the above copyright
+// notice, this list of conditions and the following disclaimer in the
+// documentation and/or other materials provided with the distribution.
+// * Neither the name of the Andrey N. Sabelnikov nor the
+// names of its contributors may be used to endorse or promote products
+// derived from this software without specific prior written permission.
+// 
+// THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+// ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+// WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+// DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER  BE LIABLE FOR ANY
+// DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+// (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+// LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+// ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+// (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+// SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+// 
+
+
+
+#pragma once 
+
+#include <deque>
+#include <sstream>
+#include "misc_language.h"
+#include "misc_log_ex.h"
+#include "parserse_base_utils.h"
+#include "portable_storage_base.h"
+#include "portable_storage_to_json.h"
+
+namespace epee
+{
+  namespace serialization
+  {
+    /************************************************************************/
+    /* Storage for KV_SERIALIZE maps' store() which writes json right away, */
+    /* without building portable_storage tree. Output is the same as        */
+    /* portable_storage::dump_as_json() gives, except that entries go in    */
+    /* the order of the map instead of being sorted by name.                */
+    /************************************************************************/
+    class json_stream_storage
+    {
+      struct frame
+      {
+        bool is_array;
+        size_t indent;
+        size_t entries_count;
+      };
+    public:
+      typedef frame* hsection;
+      typedef frame* harray;
+      typedef storage_entry meta_entry;
+
+      //json is appended to buff
+      json_stream_storage(std::string& buff, size_t indent = 0) :m_buff(buff)
+      {
+        push_frame(false, indent);
+      }
+
+      //closes all opened sections and arrays, nothing can be added after
+      void finish()
+      {
+        while (!m_frames.empty())
+          pop_frame();
+      }
+
+      hsection open_section(const std::string& section_name, hsection hparent_section, bool /*create_if_notexist*/ = false)
+      {
+        frame* pparent = get_section(hparent_section);
+        if (!pparent)
+          return nullptr;
+        write_entry_name(*pparent, section_name);
+        return push_frame(false, pparent->indent + 1);
+      }
+
+      template<class t_value>
+      bool set_value(const std::string& value_name, const t_value& v, hsection hparent_section)
+      {
+        frame* pparent = get_section(hparent_section);
+        if (!pparent)
+          return false;
+        write_entry_name(*pparent, value_name);
+        write_value(v, pparent->indent + 1);
+        return true;
+      }
+
+      template<class t_value>
+      harray insert_first_value(const std::string& value_name, const t_value& v, hsection hparent_section)
+      {
+        frame* pparent = get_section(hparent_section);
+        if (!pparent)
+          return nullptr;
+        write_entry_name(*pparent, value_name);
+        frame* parray = push_frame(true, pparent->indent + 1);
+        write_value(v, parray->indent);
+        ++parray->entries_count;
+        return parray;
+      }
+
+      template<class t_value>
+      bool insert_next_value(harray hval_array, const t_value& v)
+      {
+        frame* parray = get_array(hval_array);
+        if (!parray)
+          return false;
+        m_buff += ',';
+        write_value(v, parray->indent);
+        ++parray->entries_count;
+        return true;
+      }
+
+      harray insert_first_section(const std::string& section_name, hsection& hinserted_childsection, hsection hparent_section)
+      {
+        frame* pparent = get_section(hparent_section);
+        if (!pparent)
+          return nullptr;
+        write_entry_name(*pparent, section_name);
+        frame* parray = push_frame(true, pparent->indent + 1);
+        ++parray->entries_count;
+        hinserted_childsection = push_frame(false, parray->indent);
+        return parray;
+      }
+
+      bool insert_next_section(harray hsec_array, hsection& hinserted_childsection)
+      {
+        frame* parray = get_array(hsec_array);
+        if (!parray)
+          return false;
+        m_buff += ',';
+        ++parray->entries_count;
+        hinserted_childsection = push_frame(false, parray->indent);
+        return true;
+      }
+
+    private:
+      frame* push_frame(bool is_array, size_t indent)
+      {
+        m_frames.push_back(frame{ is_array, indent, 0 });
+        m_buff += is_array ? "[" : "{\r\n";
+        return &m_frames.back();
+      }
+
+      void pop_frame()
+      {
+        const frame& f = m_frames.back();
+        if (f.is_array)
+        {
+          m_buff += ']';
+        }
+        else
+        {
+          if (f.entries_count)
+            m_buff += "\r\n";
+          m_buff.append(f.indent * 2, ' ');
+          m_buff += '}';
+        }
+        m_frames.pop_back();
+      }
+
+      //everything opened after the given frame is complete once something is added to it
+      frame* get_frame(frame* pf, bool is_array)
+      {
+        if (!pf && !is_array && !m_frames.empty())
+          pf = &m_frames.front();
+        auto it = m_frames.rbegin();
+        while (it != m_frames.rend() && &*it != pf)
+          ++it;
+        CHECK_AND_ASSERT_MES(it != m_frames.rend() && it->is_array == is_array, nullptr, "json_stream_storage: section or array is already closed");
+        while (&m_frames.back() != pf)
+          pop_frame();
+        return pf;
+      }
+
+      frame* get_section(hsection hsec) { return get_frame(hsec, false); }
+      frame* get_array(harray harr) { return get_frame(harr, true); }
+
+      void write_entry_name(frame& section, const std::string& name)
+      {
+        if (section.entries_count++)
+          m_buff += ",\r\n";
+        m_buff.append((section.indent + 1) * 2, ' ');
+        m_buff += '"';
+        misc_utils::parse::transform_to_escape_sequence(name, m_buff);
+        m_buff += "\": ";
+      }
+
+      void write_value(const std::string& v, size_t /*indent*/)
+      {
+        m_buff += '"';
+        misc_utils::parse::transform_to_escape_sequence(v, m_buff);
+        m_buff += '"';
+      }
+      void write_value(const bool& v, size_t /*indent*/) { m_buff += v ? "true" : "false"; }
+      void write_value(const int8_t& v, size_t /*indent*/) { m_buff += std::to_string(static_cast<int32_t>(v)); }
+      void write_value(const uint8_t& v, size_t /*indent*/) { m_buff += std::to_string(static_cast<int32_t>(v)); }
+      void write_value(const int16_t& v, size_t /*indent*/) { m_buff += std::to_string(v); }
+      void write_value(const uint16_t& v, size_t /*indent*/) { m_buff += std::to_string(v); }
+      void write_value(const int32_t& v, size_t /*indent*/) { m_buff += std::to_string(v); }
+      void write_value(const uint32_t& v, size_t /*indent*/) { m_buff += std::to_string(v); }
+      void write_value(const int64_t& v, size_t /*indent*/) { m_buff += std::to_string(v); }
+      void write_value(const uint64_t& v, size_t /*indent*/) { m_buff += std::to_string(v); }
+
+      //double, storage_entry: the same way portable_storage does it
+      template<class t_value>
+      void write_value(const t_value& v, size_t indent)
+      {
+        std::stringstream ss;
+        dump_as_json(ss, v, indent);
+        m_buff += ss.str();
+      }
+
+      std::string& m_buff;
+      std::deque<frame> m_frames; //opened sections and arrays, references stay valid on push_back/pop_back
+    };
+  }
+}
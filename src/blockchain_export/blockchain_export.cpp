@@ -0,0 +1,138 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// blockchain_export.cpp : exports blocks with transactions from the local blockchain to a file for offline import
+
+
+#include "include_base_utils.h"
+#include "version.h"
+
+using namespace epee;
+
+#include <boost/program_options.hpp>
+
+#include "common/command_line.h"
+#include "currency_core/currency_core.h"
+#include "currency_core/blockchain_export_file.h"
+#include "currency_protocol/currency_protocol_handler_common.h"
+
+namespace po = boost::program_options;
+using namespace currency;
+
+namespace
+{
+  const command_line::arg_descriptor<std::string> arg_output_file  = {"output-file", "Export file path, default: <data-dir>/" BLOCKCHAIN_EXPORT_FILE_DEFAULT_NAME, ""};
+  const command_line::arg_descriptor<uint64_t>    arg_start_height = {"start-height", "Height of the first exported block", 0};
+  const command_line::arg_descriptor<uint64_t>    arg_stop_height  = {"stop-height", "Height of the last exported block (0 - the top block)", 0};
+}
+
+//---------------------------------------------------------------------------------
+bool export_blockchain(core& ccore, const std::string& path, uint64_t start_height, uint64_t stop_height)
+{
+  blockchain_storage& bcs = ccore.get_blockchain_storage();
+  uint64_t height = bcs.get_current_blockchain_height();
+  CHECK_AND_ASSERT_MES(height, false, "Blockchain is empty");
+  if (!stop_height || stop_height >= height)
+    stop_height = height - 1;
+  CHECK_AND_ASSERT_MES(start_height <= stop_height, false, "Wrong heights range: " << start_height << " - " << stop_height);
+
+  blockchain_export_file_writer writer;
+  bool r = writer.open(path, start_height);
+  CHECK_AND_ASSERT_MES(r, false, "Failed to open export file");
+
+  LOG_PRINT_L0("Exporting blocks " << start_height << " - " << stop_height << " to " << path);
+  uint64_t start_time = misc_utils::get_tick_count();
+  for (uint64_t h = start_height; h <= stop_height; ++h)
+  {
+    block b = AUTO_VAL_INIT(b);
+    r = bcs.get_block_by_height(h, b);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to get block at height " << h);
+
+    std::list<transaction> txs;
+    std::list<crypto::hash> missed_txs;
+    bcs.get_transactions(b.tx_hashes, txs, missed_txs);
+    CHECK_AND_ASSERT_MES(missed_txs.empty() && txs.size() == b.tx_hashes.size(), false, "Failed to get " << missed_txs.size() << " transactions of block at height " << h);
+
+    blockchain_export_entry entry;
+    entry.block = block_to_blob(b);
+    entry.txs.reserve(txs.size());
+    for (const auto& tx : txs)
+      entry.txs.push_back(tx_to_blob(tx));
+    r = writer.write(entry);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to write block at height " << h);
+
+    if (h % 10000 == 0)
+      LOG_PRINT_L0("Exported height " << h << " of " << stop_height);
+  }
+  r = writer.close();
+  CHECK_AND_ASSERT_MES(r, false, "Failed to write export file");
+
+  uint64_t seconds = (misc_utils::get_tick_count() - start_time) / 1000;
+  LOG_PRINT_GREEN("Exported " << stop_height - start_height + 1 << " blocks in " << seconds << " seconds", LOG_LEVEL_0);
+  return true;
+}
+//---------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  string_tools::set_module_name_and_folder(argv[0]);
+  log_space::get_set_log_detalisation_level(true, LOG_LEVEL_0);
+  log_space::log_singletone::add_logger(LOGGER_CONSOLE, NULL, NULL);
+
+  TRY_ENTRY();
+
+  po::options_description desc_cmd_only("Command line options");
+  po::options_description desc_cmd_sett("Command line options and settings options");
+
+  command_line::add_arg(desc_cmd_only, command_line::arg_help);
+  command_line::add_arg(desc_cmd_only, command_line::arg_version);
+  command_line::add_arg(desc_cmd_only, command_line::arg_data_dir, tools::get_default_data_dir());
+  command_line::add_arg(desc_cmd_sett, command_line::arg_log_level);
+  command_line::add_arg(desc_cmd_sett, arg_output_file);
+  command_line::add_arg(desc_cmd_sett, arg_start_height);
+  command_line::add_arg(desc_cmd_sett, arg_stop_height);
+  core::init_options(desc_cmd_sett);
+
+  po::options_description desc_options("Allowed options");
+  desc_options.add(desc_cmd_only).add(desc_cmd_sett);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    if (command_line::get_arg(vm, command_line::arg_help))
+    {
+      std::cout << CURRENCY_NAME << " v" << PROJECT_VERSION_LONG << ENDL << ENDL;
+      std::cout << desc_options << std::endl;
+      return false;
+    }
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_version))
+  {
+    std::cout << CURRENCY_NAME << " v" << PROJECT_VERSION_LONG << ENDL;
+    return 0;
+  }
+  log_space::get_set_log_detalisation_level(true, command_line::get_arg(vm, command_line::arg_log_level));
+
+  std::string output_file = command_line::get_arg(vm, arg_output_file);
+  if (output_file.empty())
+    output_file = command_line::get_arg(vm, command_line::arg_data_dir) + "/" BLOCKCHAIN_EXPORT_FILE_DEFAULT_NAME;
+
+  currency_protocol_stub pr;
+  core ccore(&pr);
+  LOG_PRINT_L0("Initializing core...");
+  r = ccore.init(vm);
+  CHECK_AND_ASSERT_MES(r, 1, "Failed to initialize core");
+
+  r = export_blockchain(ccore, output_file, command_line::get_arg(vm, arg_start_height), command_line::get_arg(vm, arg_stop_height));
+
+  ccore.deinit();
+  return r ? 0 : 1;
+
+  CATCH_ENTRY_L0("main", 1);
+}
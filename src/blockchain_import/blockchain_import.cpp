@@ -0,0 +1,351 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+// blockchain_import.cpp : imports blocks from a file made by blockchain_export into the local blockchain
+
+
+#include "include_base_utils.h"
+#include "version.h"
+
+using namespace epee;
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <boost/program_options.hpp>
+
+#include "common/command_line.h"
+#include "common/parallel_for.h"
+#include "common/util.h"
+#include "currency_core/currency_core.h"
+#include "currency_core/checkpoints_create.h"
+#include "currency_core/blockchain_export_file.h"
+#include "currency_protocol/currency_protocol_handler_common.h"
+
+namespace po = boost::program_options;
+using namespace currency;
+
+#define BLOCKCHAIN_IMPORT_PARSED_BATCHES_QUEUE_SIZE   2
+
+namespace
+{
+  const command_line::arg_descriptor<std::string> arg_input_file = {"input-file", "Import file path, default: <data-dir>/" BLOCKCHAIN_EXPORT_FILE_DEFAULT_NAME, ""};
+  const command_line::arg_descriptor<uint32_t>    arg_batch_size = {"batch-size", "Blocks parsed and verified together", BLOCKS_SYNCHRONIZING_DEFAULT_COUNT};
+}
+
+struct parsed_tx_entry
+{
+  transaction tx;
+  crypto::hash id;
+  crypto::hash prefix_hash;
+  size_t blob_size;
+};
+
+struct parsed_block_entry
+{
+  block b;
+  crypto::hash id;
+  size_t blob_size;
+  std::vector<parsed_tx_entry> txs;
+  bool parsed;
+};
+
+/************************************************************************/
+/* reads batches of entries and parses them on worker threads,          */
+/* while previous batch is being imported                                */
+/************************************************************************/
+class parsed_batches_producer
+{
+public:
+  parsed_batches_producer(blockchain_export_file_reader& reader, size_t batch_size, size_t threads_count)
+    : m_reader(reader)
+    , m_batch_size(batch_size)
+    , m_threads_count(threads_count)
+    , m_stop(false)
+    , m_finished(false)
+    , m_failed(false)
+  {}
+
+  ~parsed_batches_producer()
+  {
+    stop();
+  }
+
+  void start()
+  {
+    m_thread = std::thread([this]() { worker(); });
+  }
+
+  void stop()
+  {
+    {
+      std::unique_lock<std::mutex> lock(m_lock);
+      m_stop = true;
+    }
+    m_cv.notify_all();
+    if (m_thread.joinable())
+      m_thread.join();
+  }
+
+  // returns false when there are no more batches (see is_failed())
+  bool get_next_batch(std::vector<parsed_block_entry>& batch)
+  {
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_cv.wait(lock, [this]() { return !m_queue.empty() || m_finished; });
+    if (m_queue.empty())
+      return false;
+    batch.swap(m_queue.front());
+    m_queue.pop_front();
+    m_cv.notify_all();
+    return true;
+  }
+
+  bool is_failed() const { return m_failed; }
+
+private:
+  void worker()
+  {
+    std::vector<blobdata> raw_entries;
+    while (!m_stop)
+    {
+      raw_entries.clear();
+      blobdata raw_entry;
+      while (raw_entries.size() < m_batch_size && m_reader.read(raw_entry))
+        raw_entries.push_back(std::move(raw_entry));
+      if (raw_entries.size() < m_batch_size && !m_reader.is_eof())
+      {
+        LOG_ERROR("Failed to read import file");
+        m_failed = true;
+      }
+      if (raw_entries.empty())
+        break;
+
+      std::vector<parsed_block_entry> batch(raw_entries.size());
+      try
+      {
+        tools::parallel_for(raw_entries.size(), m_threads_count, [&](size_t i)
+        {
+          batch[i].parsed = parse_entry(raw_entries[i], batch[i]);
+        });
+      }
+      catch (const std::exception& ex)
+      {
+        LOG_ERROR("Failed to parse import file entries: " << ex.what());
+        m_failed = true;
+        break;
+      }
+
+      std::unique_lock<std::mutex> lock(m_lock);
+      m_cv.wait(lock, [this]() { return m_queue.size() < BLOCKCHAIN_IMPORT_PARSED_BATCHES_QUEUE_SIZE || m_stop; });
+      m_queue.push_back(std::move(batch));
+      m_cv.notify_all();
+      if (m_failed)
+        break;
+    }
+
+    std::unique_lock<std::mutex> lock(m_lock);
+    m_finished = true;
+    m_cv.notify_all();
+  }
+
+  static bool parse_entry(const blobdata& raw_entry, parsed_block_entry& pbe)
+  {
+    blockchain_export_entry entry;
+    if (!t_unserializable_object_from_blob(entry, raw_entry))
+      return false;
+    if (!parse_and_validate_block_from_blob(entry.block, pbe.b))
+      return false;
+    pbe.id = get_block_hash(pbe.b);
+    pbe.blob_size = entry.block.size();
+    pbe.txs.resize(entry.txs.size());
+    for (size_t i = 0; i != entry.txs.size(); ++i)
+    {
+      parsed_tx_entry& pte = pbe.txs[i];
+      if (!parse_and_validate_tx_from_blob(entry.txs[i], pte.tx, pte.id, pte.prefix_hash))
+        return false;
+      pte.blob_size = entry.txs[i].size();
+    }
+    return true;
+  }
+
+  blockchain_export_file_reader& m_reader;
+  size_t m_batch_size;
+  size_t m_threads_count;
+  std::thread m_thread;
+  std::mutex m_lock;
+  std::condition_variable m_cv;
+  std::deque<std::vector<parsed_block_entry> > m_queue;
+  std::atomic<bool> m_stop;
+  bool m_finished;
+  std::atomic<bool> m_failed;
+};
+
+//---------------------------------------------------------------------------------
+bool import_batch(core& ccore, const std::vector<parsed_block_entry>& batch, uint64_t& entry_height, uint64_t& imported_count)
+{
+  std::vector<block> new_blocks;
+  for (const auto& pbe : batch)
+  {
+    if (pbe.parsed && !ccore.have_block(pbe.id))
+      new_blocks.push_back(pbe.b);
+  }
+
+  bool batch_started = ccore.begin_batch_import();
+  misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler([&](){
+    if (batch_started)
+      ccore.end_batch_import();
+  });
+
+  //verified in parallel, the result is used when the block is added
+  ccore.precalculate_blocks_pow(new_blocks);
+
+  for (const auto& pbe : batch)
+  {
+    CHECK_AND_ASSERT_MES(pbe.parsed, false, "Failed to parse entry at height " << entry_height);
+    if (ccore.have_block(pbe.id))
+    {
+      ++entry_height;
+      continue;
+    }
+
+    for (const auto& pte : pbe.txs)
+    {
+      tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      ccore.handle_incoming_tx(pte.tx, pte.id, pte.prefix_hash, pte.blob_size, tvc, true);
+      CHECK_AND_ASSERT_MES(!tvc.m_verifivation_failed, false, "Transaction " << pte.id << " verification failed, block " << pbe.id << " at height " << entry_height);
+    }
+
+    block_verification_context bvc = AUTO_VAL_INIT(bvc);
+    ccore.handle_incoming_block(pbe.b, pbe.blob_size, bvc, false);
+    CHECK_AND_ASSERT_MES(!bvc.m_verifivation_failed, false, "Block " << pbe.id << " verification failed at height " << entry_height);
+    CHECK_AND_ASSERT_MES(bvc.m_added_to_main_chain, false, "Block " << pbe.id << " at height " << entry_height << " was not added to the main chain");
+    ++entry_height;
+    ++imported_count;
+  }
+  return true;
+}
+//---------------------------------------------------------------------------------
+bool import_blockchain(core& ccore, const std::string& path, size_t batch_size, size_t threads_count, std::atomic<bool>& stop)
+{
+  blockchain_export_file_reader reader;
+  bool r = reader.open(path);
+  CHECK_AND_ASSERT_MES(r, false, "Failed to open import file");
+
+  uint64_t entry_height = reader.get_start_height();
+  CHECK_AND_ASSERT_MES(entry_height <= ccore.get_current_blockchain_height(), false, "Import file starts at height " << entry_height
+    << ", but local blockchain height is " << ccore.get_current_blockchain_height());
+
+  LOG_PRINT_L0("Importing blocks from " << path << ", starting at height " << entry_height << ", " << threads_count << " verification threads");
+  parsed_batches_producer producer(reader, batch_size, threads_count);
+  producer.start();
+
+  uint64_t start_time = misc_utils::get_tick_count();
+  uint64_t imported_count = 0;
+  std::vector<parsed_block_entry> batch;
+  r = true;
+  while (!stop && producer.get_next_batch(batch))
+  {
+    r = import_batch(ccore, batch, entry_height, imported_count);
+    if (!r)
+      break;
+    uint64_t seconds = (misc_utils::get_tick_count() - start_time) / 1000;
+    LOG_PRINT_L0("Imported height " << ccore.get_current_blockchain_height() - 1 << ", " << imported_count << " blocks, "
+      << (seconds ? imported_count / seconds : imported_count) << " blocks/s");
+  }
+  producer.stop();
+  if (producer.is_failed())
+    r = false;
+
+  uint64_t seconds = (misc_utils::get_tick_count() - start_time) / 1000;
+  if (r && !stop)
+  {
+    LOG_PRINT_GREEN("Imported " << imported_count << " blocks in " << seconds << " seconds, blockchain height " << ccore.get_current_blockchain_height(), LOG_LEVEL_0);
+  }
+  else
+  {
+    LOG_PRINT_RED_L0("Import " << (stop ? "interrupted" : "failed") << " after " << imported_count << " blocks, blockchain height " << ccore.get_current_blockchain_height());
+  }
+  return r;
+}
+//---------------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  string_tools::set_module_name_and_folder(argv[0]);
+  log_space::get_set_log_detalisation_level(true, LOG_LEVEL_0);
+  log_space::log_singletone::add_logger(LOGGER_CONSOLE, NULL, NULL);
+
+  TRY_ENTRY();
+
+  po::options_description desc_cmd_only("Command line options");
+  po::options_description desc_cmd_sett("Command line options and settings options");
+
+  command_line::add_arg(desc_cmd_only, command_line::arg_help);
+  command_line::add_arg(desc_cmd_only, command_line::arg_version);
+  command_line::add_arg(desc_cmd_only, command_line::arg_data_dir, tools::get_default_data_dir());
+  command_line::add_arg(desc_cmd_sett, command_line::arg_log_level);
+  command_line::add_arg(desc_cmd_sett, arg_input_file);
+  command_line::add_arg(desc_cmd_sett, arg_batch_size);
+  core::init_options(desc_cmd_sett);
+
+  po::options_description desc_options("Allowed options");
+  desc_options.add(desc_cmd_only).add(desc_cmd_sett);
+
+  po::variables_map vm;
+  bool r = command_line::handle_error_helper(desc_options, [&]()
+  {
+    po::store(po::parse_command_line(argc, argv, desc_options), vm);
+    if (command_line::get_arg(vm, command_line::arg_help))
+    {
+      std::cout << CURRENCY_NAME << " v" << PROJECT_VERSION_LONG << ENDL << ENDL;
+      std::cout << desc_options << std::endl;
+      return false;
+    }
+    po::notify(vm);
+    return true;
+  });
+  if (!r)
+    return 1;
+
+  if (command_line::get_arg(vm, command_line::arg_version))
+  {
+    std::cout << CURRENCY_NAME << " v" << PROJECT_VERSION_LONG << ENDL;
+    return 0;
+  }
+  log_space::get_set_log_detalisation_level(true, command_line::get_arg(vm, command_line::arg_log_level));
+
+  std::string input_file = command_line::get_arg(vm, arg_input_file);
+  if (input_file.empty())
+    input_file = command_line::get_arg(vm, command_line::arg_data_dir) + "/" BLOCKCHAIN_EXPORT_FILE_DEFAULT_NAME;
+  size_t batch_size = command_line::get_arg(vm, arg_batch_size);
+  CHECK_AND_ASSERT_MES(batch_size, 1, "Wrong batch size");
+
+  currency::checkpoints checkpoints;
+  r = currency::create_checkpoints(checkpoints);
+  CHECK_AND_ASSERT_MES(r, 1, "Failed to initialize checkpoints");
+
+  currency_protocol_stub pr;
+  core ccore(&pr);
+  LOG_PRINT_L0("Initializing core...");
+  r = ccore.init(vm);
+  CHECK_AND_ASSERT_MES(r, 1, "Failed to initialize core");
+  ccore.set_checkpoints(std::move(checkpoints));
+  //parsing uses the same number of threads as verification (see --verify-threads)
+  size_t threads_count = ccore.get_blockchain_storage().get_verification_threads();
+
+  std::atomic<bool> stop(false);
+  tools::signal_handler::install([&stop] {
+    stop = true;
+  });
+
+  r = import_blockchain(ccore, input_file, batch_size, threads_count, stop);
+
+  if (ccore.get_blockchain_storage().is_fast_sync_mode())
+    ccore.get_blockchain_storage().set_fast_sync_mode(false); // flushes everything to disk
+  ccore.deinit();
+  return r ? 0 : 1;
+
+  CATCH_ENTRY_L0("main", 1);
+}
@@ -220,6 +220,15 @@ namespace db
       return true;
     }
 
+    // value bytes as they are stored, copied straight into blob
+    template<class tkey_pod_t>
+    bool get_blob(const table_id tid, const tkey_pod_t& tkey, std::string& blob) const
+    {
+      size_t key_size = 0;
+      const char* key_data = tkey_to_pointer(tkey, key_size);
+      return m_db_adapter_ptr->get(tid, key_data, key_size, blob);
+    }
+
     void attach_container_receiver(i_db_write_tx_notification_receiver *receiver)
     {
       CRITICAL_REGION_LOCAL(m_attached_container_receivers_lock);
@@ -282,8 +291,7 @@ namespace db
     template<class value_t>
     static bool tvalue_from_pointer(const void* p, size_t s, value_t& v)
     {
-      std::string buffer(static_cast<const char*>(p), s);
-      return t_unserializable_object_from_blob(v, buffer);
+      return t_unserializable_object_from_blob(v, static_cast<const char*>(p), s);
     }
 
     template<class key_t, class value_t>
@@ -457,6 +465,12 @@ namespace db
       return get(key);
     }
 
+    // value as it is stored, without deserialization
+    bool get_raw(const key_t& key, std::string& blob) const
+    {
+      return m_dbb.get_blob(m_tid, key, blob);
+    }
+
     std::shared_ptr<const value_t> end() const
     {
       return std::shared_ptr<const value_t>(nullptr);
@@ -675,6 +689,14 @@ namespace db
       return super::get(ck);
     }
 
+    void set_subitem(const array_key_t& array_key, size_t i, const value_t& v)
+    {
+      size_t count = get_item_size(array_key);
+      CHECK_AND_ASSERT_THROW_MES(i < count, "array key " << array_key << ": item index " << i << " exceeds elements count == " << count);
+      complex_key<array_key_t, size_t> ck{ array_key, i };
+      super::set(ck, v);
+    }
+
     void push_back_item(const array_key_t& array_key, const value_t& v)
     {
       auto counter = get_counter_accessor(array_key);
@@ -4,14 +4,17 @@
 #include "db_lmdb_adapter.h"
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <algorithm>
 #include "misc_language.h"
 #include "db/liblmdb/lmdb.h"
 #include "common/util.h"
 #include "boost/thread/recursive_mutex.hpp"
 #include "epee/include/misc_language.h"
 
-// TODO: estimate correct size
-#define LMDB_MEMORY_MAP_SIZE (128ull * 1024 * 1024 * 1024)
+#define LMDB_MAP_RESIZE_WAIT_MS 10000  // how long map resizing waits for other threads' transactions to finish, new ones are held back meanwhile
 
 #define CHECK_DB_CALL_RESULT(result, return_value, msg) \
   CHECK_AND_ASSERT_MES(result == MDB_SUCCESS,  \
@@ -30,6 +33,9 @@ namespace db
   {
     lmdb_adapter_impl()
       : p_mdb_env(nullptr)
+      , map_grow_required(false)
+      , m_top_level_transactions(0)
+      , m_resize_in_progress(false)
     {}
 
     MDB_txn* get_current_transaction() const
@@ -48,14 +54,69 @@ namespace db
       return it != m_transaction_stack.end() && !it->second.empty();
     }
 
+    size_t get_transactions_depth() const
+    {
+      std::lock_guard<boost::recursive_mutex> guard(m_transaction_stack_mutex);
+      auto it = m_transaction_stack.find(std::this_thread::get_id());
+      return it != m_transaction_stack.end() ? it->second.size() : 0;
+    }
+
+    // should be called when the thread opens its outermost transaction, waits while the map is being resized
+    void enter_top_level_transaction()
+    {
+      std::unique_lock<std::mutex> lk(m_resize_mutex);
+      m_resize_cond.wait(lk, [this]() { return !m_resize_in_progress; });
+      ++m_top_level_transactions;
+    }
+
+    // should be called when the thread's outermost transaction is committed or aborted
+    void leave_top_level_transaction()
+    {
+      {
+        std::lock_guard<std::mutex> lk(m_resize_mutex);
+        --m_top_level_transactions;
+      }
+      m_resize_cond.notify_all();
+    }
+
+    // holds back new transactions and waits for running ones to finish, returns false if they didn't finish in time;
+    // the calling thread should not be inside a transaction
+    bool begin_map_resize()
+    {
+      std::unique_lock<std::mutex> lk(m_resize_mutex);
+      m_resize_cond.wait(lk, [this]() { return !m_resize_in_progress; });
+      m_resize_in_progress = true;
+      if (m_resize_cond.wait_for(lk, std::chrono::milliseconds(LMDB_MAP_RESIZE_WAIT_MS), [this]() { return m_top_level_transactions == 0; }))
+        return true;
+      m_resize_in_progress = false;
+      lk.unlock();
+      m_resize_cond.notify_all();
+      return false;
+    }
+
+    void end_map_resize()
+    {
+      {
+        std::lock_guard<std::mutex> lk(m_resize_mutex);
+        m_resize_in_progress = false;
+      }
+      m_resize_cond.notify_all();
+    }
+
     MDB_env* p_mdb_env;
+    std::atomic<bool> map_grow_required; // set when MDB_MAP_FULL occurred, map will be grown before next top-level write transaction
     std::map<std::thread::id, std::list<stack_entry_t>> m_transaction_stack; // thread_id -> (tx_entry, tx_entry, ...)
     mutable boost::recursive_mutex m_transaction_stack_mutex; // protects m_transaction_stack
     mutable boost::recursive_mutex m_begin_commit_abort_mutex; // protects db transaction sequence
+    std::mutex m_resize_mutex;                 // protects two fields below
+    std::condition_variable m_resize_cond;     // signaled when a top-level transaction ends or map resizing is over
+    size_t m_top_level_transactions;           // count of threads inside a transaction
+    bool m_resize_in_progress;                 // mdb_env_set_mapsize() is waiting for transactions to finish or being called
   };
 
 
   lmdb_adapter::lmdb_adapter()
+    : m_fast_sync_mode(false)
   {
     m_p_impl = new lmdb_adapter_impl();
   }
@@ -74,10 +135,10 @@ namespace db
     int r = mdb_env_create(&m_p_impl->p_mdb_env);
     CHECK_DB_CALL_RESULT(r, false, "mdb_env_create failed");
       
-    r = mdb_env_set_maxdbs(m_p_impl->p_mdb_env, 15);
+    r = mdb_env_set_maxdbs(m_p_impl->p_mdb_env, m_options.max_dbs);
     CHECK_DB_CALL_RESULT(r, false, "mdb_env_set_maxdbs failed");
 
-    r = mdb_env_set_mapsize(m_p_impl->p_mdb_env, LMDB_MEMORY_MAP_SIZE);
+    r = mdb_env_set_mapsize(m_p_impl->p_mdb_env, m_options.map_size);
     CHECK_DB_CALL_RESULT(r, false, "mdb_env_set_mapsize failed");
       
     m_db_folder = db_name;
@@ -85,9 +146,22 @@ namespace db
     bool br = tools::create_directories_if_necessary(m_db_folder);
     CHECK_AND_ASSERT_MES(br, false, "create_directories_if_necessary failed");
 
-    r = mdb_env_open(m_p_impl->p_mdb_env, m_db_folder.c_str(), MDB_NORDAHEAD, 0644);
+    unsigned int flags = 0;
+    flags |= m_options.no_readahead ? MDB_NORDAHEAD : 0;
+    flags |= m_options.no_sync ? MDB_NOSYNC : 0;
+    flags |= m_options.no_meta_sync ? MDB_NOMETASYNC : 0;
+    flags |= m_options.write_map ? MDB_WRITEMAP : 0;
+    flags |= m_options.map_async ? MDB_MAPASYNC : 0;
+    r = mdb_env_open(m_p_impl->p_mdb_env, m_db_folder.c_str(), flags, 0644);
     CHECK_DB_CALL_RESULT(r, false, "mdb_env_open failed, m_db_folder = " << m_db_folder);
 
+    if (m_fast_sync_mode)
+    {
+      m_fast_sync_mode = false;
+      set_fast_sync_mode(true);
+    }
+
+    LOG_PRINT_L1("LMDB environment opened: map size " << m_options.map_size / (1024 * 1024) << " MB, growth step " << m_options.map_growth_step / (1024 * 1024) << " MB, flags 0x" << std::hex << flags << std::dec);
     return true;
   }
   
@@ -113,6 +187,9 @@ namespace db
         }
         if (unlock_begin_commit_abort_mutex)
           m_p_impl->m_begin_commit_abort_mutex.lock();
+        m_p_impl->m_transaction_stack.clear();
+        std::lock_guard<std::mutex> lk(m_p_impl->m_resize_mutex);
+        m_p_impl->m_top_level_transactions = 0;
       } // lock_guard : m_p_impl->m_transaction_stack_mutex
 
       mdb_env_close(m_p_impl->p_mdb_env);
@@ -156,30 +233,54 @@ namespace db
     CHECK_DB_CALL_RESULT(r, false, "Unable to mdb_stat");
     return table_stat.ms_entries;
   }
+
   
   bool lmdb_adapter::begin_transaction(bool read_only_access)
   {
+    bool top_level = !m_p_impl->has_active_transaction();
     if (!read_only_access)
+    {
       m_p_impl->m_begin_commit_abort_mutex.lock(); // lock db tx sequence guard only for write-enabled transactions
-
-    std::lock_guard<boost::recursive_mutex> guard(m_p_impl->m_transaction_stack_mutex);
-    std::list<stack_entry_t>& tx_stack = m_p_impl->m_transaction_stack[std::this_thread::get_id()]; // get or create empty list
+      if (top_level)
+        grow_map_if_needed(); // top-level write transaction: the only moment when map could be safely resized
+    }
+    if (top_level)
+      m_p_impl->enter_top_level_transaction();
 
     MDB_txn* p_parent_tx = nullptr;
     MDB_txn* p_new_tx = nullptr;
-    if (!tx_stack.empty())
-      p_parent_tx = tx_stack.back().txn;
+    stack_entry_t* p_new_stack_entry = nullptr;
+    {
+      std::lock_guard<boost::recursive_mutex> guard(m_p_impl->m_transaction_stack_mutex);
+      std::list<stack_entry_t>& tx_stack = m_p_impl->m_transaction_stack[std::this_thread::get_id()]; // get or create empty list
+      if (!tx_stack.empty())
+        p_parent_tx = tx_stack.back().txn;
 
-    tx_stack.push_back(stack_entry_t(p_new_tx, read_only_access)); // new stack entry should be added in ANY case, don't return before this line
-    auto& new_stack_entry = tx_stack.back();
+      tx_stack.push_back(stack_entry_t(p_new_tx, read_only_access)); // new stack entry should be added in ANY case, don't return before this line
+      p_new_stack_entry = &tx_stack.back();
+    }
 
     unsigned int flags = read_only_access ? MDB_RDONLY : 0;
     // TODO: review the following check thorughly
     CHECK_AND_ASSERT_MES(m_p_impl != nullptr && m_p_impl->p_mdb_env != nullptr, false, "db env is null");
     int r = mdb_txn_begin(m_p_impl->p_mdb_env, p_parent_tx, flags, &p_new_tx);
+    if (r == MDB_MAP_RESIZED && top_level)
+    {
+      // the map was grown by another process, its size may be adopted only when there's no active transactions in this process
+      m_p_impl->leave_top_level_transaction();
+      if (m_p_impl->begin_map_resize())
+      {
+        r = mdb_env_set_mapsize(m_p_impl->p_mdb_env, 0);
+        m_p_impl->end_map_resize();
+        LOG_PRINT_L0("LMDB memory map was resized by another process, new size adopted, result: " << r);
+      }
+      m_p_impl->enter_top_level_transaction();
+      r = mdb_txn_begin(m_p_impl->p_mdb_env, p_parent_tx, flags, &p_new_tx);
+    }
     CHECK_DB_CALL_RESULT(r, false, "mdb_txn_begin");
 
-    new_stack_entry.txn = p_new_tx; // update stack entry with correct txn
+    std::lock_guard<boost::recursive_mutex> guard(m_p_impl->m_transaction_stack_mutex);
+    p_new_stack_entry->txn = p_new_tx; // update stack entry with correct txn
 
     return true;
   }
@@ -204,12 +305,17 @@ namespace db
     read_only_access = tx_stack.back().ro_access; // set actual value for unlocker
 
     tx_stack.pop_back();
-    if (tx_stack.empty())
+    bool top_level = tx_stack.empty();
+    if (top_level)
       m_p_impl->m_transaction_stack.erase(it);
     // tx_stack could be invalid after this point 
           
     int r = 0;
     r = mdb_txn_commit(txn);
+    if (top_level)
+      m_p_impl->leave_top_level_transaction();
+    if (r == MDB_MAP_FULL)
+      m_p_impl->map_grow_required = true;
     CHECK_DB_CALL_RESULT(r, false, "mdb_txn_commit failed");
 
     return true;
@@ -235,11 +341,14 @@ namespace db
     read_only_access = tx_stack.back().ro_access; // set actual value for unlocker
 
     tx_stack.pop_back();
-    if (tx_stack.empty())
+    bool top_level = tx_stack.empty();
+    if (top_level)
       m_p_impl->m_transaction_stack.erase(it);
     // tx_stack could be invalid after this point 
           
     mdb_txn_abort(txn);
+    if (top_level)
+      m_p_impl->leave_top_level_transaction();
   }
   
   bool lmdb_adapter::get(const table_id tid, const char* key_data, size_t key_size, std::string& out_buffer)
@@ -279,6 +388,8 @@ namespace db
     data.mv_size = value_size;
 
     r = mdb_put(m_p_impl->get_current_transaction(), static_cast<MDB_dbi>(tid), &key, &data, 0);
+    if (r == MDB_MAP_FULL)
+      m_p_impl->map_grow_required = true; // this transaction is failed, but the map will be grown before the next one
     CHECK_DB_CALL_RESULT(r, false, "mdb_put failed");
     return true;
   }
@@ -293,6 +404,8 @@ namespace db
     r = mdb_del(m_p_impl->get_current_transaction(), static_cast<MDB_dbi>(tid), &key, nullptr);
     if (r == MDB_NOTFOUND)
       return false;
+    if (r == MDB_MAP_FULL)
+      m_p_impl->map_grow_required = true;
 
     CHECK_DB_CALL_RESULT(r, false, "mdb_del failed");
     return true;
@@ -332,6 +445,118 @@ namespace db
     return true;
   }
 
+  void lmdb_adapter::set_options(const lmdb_adapter_options& options)
+  {
+    CHECK_AND_ASSERT_MES_NO_RET(m_p_impl->p_mdb_env == nullptr, "set_options should be called before open()");
+    m_options = options;
+  }
+
+  const lmdb_adapter_options& lmdb_adapter::get_options() const
+  {
+    return m_options;
+  }
+
+  bool lmdb_adapter::is_nested_transactions_supported() const
+  {
+    return !m_options.write_map;
+  }
+
+  bool lmdb_adapter::has_active_transaction() const
+  {
+    return m_p_impl->has_active_transaction();
+  }
+
+  size_t lmdb_adapter::get_transactions_depth() const
+  {
+    return m_p_impl->get_transactions_depth();
+  }
+
+  bool lmdb_adapter::is_map_grow_required() const
+  {
+    return m_p_impl->map_grow_required;
+  }
+
+  bool lmdb_adapter::set_fast_sync_mode(bool enabled)
+  {
+    if (m_p_impl->p_mdb_env == nullptr)
+    {
+      // will be applied in open()
+      m_fast_sync_mode = enabled;
+      return true;
+    }
+    if (m_fast_sync_mode == enabled)
+      return true;
+
+    unsigned int flags = MDB_NOSYNC;
+    if (m_options.write_map)
+      flags |= MDB_MAPASYNC;
+    if (!enabled)
+    {
+      // don't clear flags requested explicitly
+      flags &= m_options.no_sync ? ~MDB_NOSYNC : ~0u;
+      flags &= m_options.map_async ? ~MDB_MAPASYNC : ~0u;
+    }
+
+    if (flags)
+    {
+      int r = mdb_env_set_flags(m_p_impl->p_mdb_env, flags, enabled ? 1 : 0);
+      CHECK_DB_CALL_RESULT(r, false, "mdb_env_set_flags failed");
+    }
+    m_fast_sync_mode = enabled;
+    LOG_PRINT_L0("LMDB fast sync mode " << (enabled ? "enabled" : "disabled"));
+
+    if (!enabled)
+      return sync();
+    return true;
+  }
+
+  bool lmdb_adapter::is_fast_sync_mode() const
+  {
+    return m_fast_sync_mode;
+  }
 
+  bool lmdb_adapter::sync()
+  {
+    CHECK_AND_ASSERT_MES(m_p_impl->p_mdb_env != nullptr, false, "db env is null");
+    int r = mdb_env_sync(m_p_impl->p_mdb_env, 1);
+    CHECK_DB_CALL_RESULT(r, false, "mdb_env_sync failed");
+    return true;
+  }
+
+  bool lmdb_adapter::grow_map_if_needed()
+  {
+    // should be called with m_begin_commit_abort_mutex locked
+    CHECK_AND_ASSERT_MES(m_p_impl->p_mdb_env != nullptr, false, "db env is null");
+    if (!m_options.map_growth_step)
+      return true;
+
+    MDB_envinfo env_info = AUTO_VAL_INIT(env_info);
+    MDB_stat env_stat = AUTO_VAL_INIT(env_stat);
+    int r = mdb_env_info(m_p_impl->p_mdb_env, &env_info);
+    CHECK_DB_CALL_RESULT(r, false, "mdb_env_info failed");
+    r = mdb_env_stat(m_p_impl->p_mdb_env, &env_stat);
+    CHECK_DB_CALL_RESULT(r, false, "mdb_env_stat failed");
+
+    uint64_t used_size = (static_cast<uint64_t>(env_info.me_last_pgno) + 1) * env_stat.ms_psize;
+    uint64_t map_size = env_info.me_mapsize;
+    if (!m_p_impl->map_grow_required && used_size + m_options.map_growth_step <= map_size)
+      return true;
+
+    // mdb_env_set_mapsize() may be called only when there's no active transactions in this process,
+    // new ones wait meanwhile, so running readers can't postpone it forever
+    if (!m_p_impl->begin_map_resize())
+    {
+      LOG_PRINT_L0("LMDB memory map should be grown (used " << used_size / (1024 * 1024) << " MB of " << map_size / (1024 * 1024) << " MB), but there are still active transactions, postponed");
+      return false;
+    }
+    auto resize_end = epee::misc_utils::create_scope_leave_handler([this](){ m_p_impl->end_map_resize(); });
+
+    uint64_t new_map_size = std::max(map_size, used_size) + m_options.map_growth_step;
+    r = mdb_env_set_mapsize(m_p_impl->p_mdb_env, new_map_size);
+    CHECK_DB_CALL_RESULT(r, false, "mdb_env_set_mapsize failed, new size: " << new_map_size);
+    m_p_impl->map_grow_required = false;
+    LOG_PRINT_L0("LMDB memory map grown: " << map_size / (1024 * 1024) << " MB -> " << new_map_size / (1024 * 1024) << " MB (used " << used_size / (1024 * 1024) << " MB)");
+    return true;
+  }
 
 } // namespace db
@@ -4,10 +4,37 @@
 #pragma once
 #include "db_bridge.h"
 
+#define LMDB_DEFAULT_MEMORY_MAP_SIZE        (128ull * 1024 * 1024 * 1024)
+#define LMDB_DEFAULT_MEMORY_MAP_GROWTH_STEP (1ull * 1024 * 1024 * 1024)
+#define LMDB_DEFAULT_MAX_DBS                15
+
 namespace db
 {
   struct lmdb_adapter_impl;
 
+  struct lmdb_adapter_options
+  {
+    lmdb_adapter_options()
+      : map_size(LMDB_DEFAULT_MEMORY_MAP_SIZE)
+      , map_growth_step(LMDB_DEFAULT_MEMORY_MAP_GROWTH_STEP)
+      , max_dbs(LMDB_DEFAULT_MAX_DBS)
+      , no_sync(false)
+      , no_meta_sync(false)
+      , write_map(false)
+      , map_async(false)
+      , no_readahead(true)
+    {}
+
+    uint64_t map_size;          // initial memory map size, grows by map_growth_step when free space is lower than map_growth_step
+    uint64_t map_growth_step;
+    unsigned int max_dbs;
+    bool no_sync;               // MDB_NOSYNC
+    bool no_meta_sync;          // MDB_NOMETASYNC
+    bool write_map;             // MDB_WRITEMAP, note: nested transactions are not supported in this mode
+    bool map_async;             // MDB_MAPASYNC, makes sense only along with write_map
+    bool no_readahead;          // MDB_NORDAHEAD
+  };
+
   class lmdb_adapter : public i_db_adapter
   {
   public:
@@ -28,8 +55,28 @@ namespace db
     virtual bool erase(const table_id tid, const char* key_data, size_t key_size) override;
     virtual bool visit_table(const table_id tid, i_db_visitor* visitor) override;
 
+    // should be called before open()
+    void set_options(const lmdb_adapter_options& options);
+    const lmdb_adapter_options& get_options() const;
+    bool is_nested_transactions_supported() const;
+    // true if the calling thread is inside a transaction
+    bool has_active_transaction() const;
+    // count of transactions (the outermost one and nested ones) opened by the calling thread
+    size_t get_transactions_depth() const;
+    // true if a write failed with MDB_MAP_FULL, the map is grown when the next top-level write transaction begins
+    bool is_map_grow_required() const;
+    // fast sync: commits are not flushed to disk (MDB_NOSYNC), use sync() to make them durable;
+    // disabling fast sync restores configured flags and flushes everything to disk
+    bool set_fast_sync_mode(bool enabled);
+    bool is_fast_sync_mode() const;
+    bool sync();
+
   private:
+    bool grow_map_if_needed();
+
     lmdb_adapter_impl* m_p_impl;
+    lmdb_adapter_options m_options;
+    bool m_fast_sync_mode;
 
     std::string m_db_folder;
 
@@ -0,0 +1,66 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <algorithm>
+
+namespace tools
+{
+  //---------------------------------------------------------------
+  inline size_t get_default_worker_threads_count()
+  {
+    size_t n = std::thread::hardware_concurrency();
+    return n ? n : 1;
+  }
+  //---------------------------------------------------------------
+  // calls func(i) for every i in [0, count) using up to threads_count threads (calling thread is one of them)
+  // and returns when all calls are done; if func throws, calls not started yet are skipped
+  // and the first exception is rethrown in the calling thread once all threads are joined
+  template<class t_func>
+  void parallel_for(size_t count, size_t threads_count, t_func func)
+  {
+    threads_count = std::min(threads_count, count);
+    if (threads_count < 2)
+    {
+      for (size_t i = 0; i != count; ++i)
+        func(i);
+      return;
+    }
+
+    std::atomic<size_t> next_index(0);
+    std::exception_ptr first_exception;
+    std::mutex exception_lock;
+    auto worker = [&]()
+    {
+      try
+      {
+        for (size_t i = next_index++; i < count; i = next_index++)
+          func(i);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lk(exception_lock);
+        if (!first_exception)
+          first_exception = std::current_exception();
+        next_index = count;
+      }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(threads_count - 1);
+    for (size_t i = 1; i != threads_count; ++i)
+      threads.emplace_back(worker);
+    worker();
+    for (auto& th : threads)
+      th.join();
+    if (first_exception)
+      std::rethrow_exception(first_exception);
+  }
+}
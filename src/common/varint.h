@@ -9,6 +9,23 @@
 #include <utility>
 #include <sstream>
 #include <string>
+#include <cstring>
+#include <cstdint>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define VARINT_BULK_USE_SSE2
+#endif
+#if defined(__BMI2__)
+#include <immintrin.h>
+#define VARINT_BULK_USE_BMI2
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#if (defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__) || defined(_M_IX86) || defined(_M_X64)
+#define VARINT_BULK_LITTLE_ENDIAN
+#endif
 
 namespace tools {
 
@@ -83,4 +100,124 @@ namespace tools {
     int read_varint(InputIt &&first, InputIt &&last, T &i) {
         return read_varint<std::numeric_limits<T>::digits, InputIt, T>(std::move(first), std::move(last), i);
     }
+
+    /************************************************************************/
+    /* Bulk varint codec for arrays of uint64_t                             */
+    /************************************************************************/
+    namespace varint_detail
+    {
+      inline unsigned count_trailing_zeros(uint64_t v)
+      {
+#if defined(_MSC_VER)
+        unsigned long r = 0;
+        _BitScanForward64(&r, v);
+        return static_cast<unsigned>(r);
+#else
+        return static_cast<unsigned>(__builtin_ctzll(v));
+#endif
+      }
+
+      // gathers 7-bit groups of little-endian varint bytes (continuation bits already cleared)
+      inline uint64_t compact_7bit_groups(uint64_t x)
+      {
+#if defined(VARINT_BULK_USE_BMI2)
+        return _pext_u64(x, 0x7f7f7f7f7f7f7f7fULL);
+#else
+        x = (x & 0x007f007f007f007fULL) | ((x & 0x7f007f007f007f00ULL) >> 1);
+        x = (x & 0x00003fff00003fffULL) | ((x & 0x3fff00003fff0000ULL) >> 2);
+        x = (x & 0x000000000fffffffULL) | ((x & 0x0fffffff00000000ULL) >> 4);
+        return x;
+#endif
+      }
+    }
+
+    // Decodes up to count varints from [first, last) into out and advances first.
+    // Only values that fit into 8 bytes with at least 8 bytes of input available are decoded here, decoding stops
+    // at the first value that needs read_varint() (longer value, non-canonical encoding, end of data), so the result
+    // is always identical to calling read_varint() for each value. Returns the number of decoded values.
+    inline size_t read_varint_array_fast(const char*& first, const char* last, uint64_t* out, size_t count)
+    {
+      size_t i = 0;
+#if defined(VARINT_BULK_LITTLE_ENDIAN)
+      const char* p = first;
+      while (i != count)
+      {
+#if defined(VARINT_BULK_USE_SSE2)
+        // run of 16 one-byte values (small offsets, counts, indices)
+        if (count - i >= 16 && last - p >= 16)
+        {
+          __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+          if (!_mm_movemask_epi8(v))
+          {
+            __m128i zero = _mm_setzero_si128();
+            __m128i lo16 = _mm_unpacklo_epi8(v, zero);
+            __m128i hi16 = _mm_unpackhi_epi8(v, zero);
+            __m128i r[4] = { _mm_unpacklo_epi16(lo16, zero), _mm_unpackhi_epi16(lo16, zero), _mm_unpacklo_epi16(hi16, zero), _mm_unpackhi_epi16(hi16, zero) };
+            for (size_t j = 0; j != 4; ++j)
+            {
+              _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + j * 4), _mm_unpacklo_epi32(r[j], zero));
+              _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i + j * 4 + 2), _mm_unpackhi_epi32(r[j], zero));
+            }
+            i += 16;
+            p += 16;
+            continue;
+          }
+        }
+#endif
+        if (last - p < 8)
+          break;
+        uint64_t w = 0;
+        memcpy(&w, p, sizeof(w));
+        uint64_t stop_bits = ~w & 0x8080808080808080ULL;
+        if (!stop_bits)
+          break; // longer than 8 bytes
+        unsigned len = (varint_detail::count_trailing_zeros(stop_bits) >> 3) + 1;
+        if (len != 8)
+          w &= (1ULL << (len * 8)) - 1;
+        if (len > 1 && !(w >> ((len - 1) * 8)))
+          break; // non-canonical, let read_varint() handle it
+        out[i++] = varint_detail::compact_7bit_groups(w & 0x7f7f7f7f7f7f7f7fULL);
+        p += len;
+      }
+      first = p;
+#endif
+      return i;
+    }
+
+    // reads count varints, the same way as count subsequent read_varint() calls with ignored errors
+    inline void read_varint_array(const char*& first, const char* last, uint64_t* out, size_t count)
+    {
+      size_t i = 0;
+      while (true)
+      {
+        i += read_varint_array_fast(first, last, out + i, count - i);
+        if (i == count)
+          break;
+        read_varint<std::numeric_limits<uint64_t>::digits>(first, last, out[i]);
+        ++i;
+      }
+    }
+
+    // writes varint to the buffer that has at least 10 bytes available, returns the pointer past the last written byte
+    inline char* write_varint_fast(char* dest, uint64_t v)
+    {
+      while (v >= 0x80)
+      {
+        *dest++ = static_cast<char>((v & 0x7f) | 0x80);
+        v >>= 7;
+      }
+      *dest++ = static_cast<char>(v);
+      return dest;
+    }
+
+    // appends count varints to the string
+    inline void write_varint_array(std::string& buff, const uint64_t* in, size_t count)
+    {
+      size_t pos = buff.size();
+      buff.resize(pos + count * 10);
+      char* p = &buff[pos];
+      for (size_t i = 0; i != count; ++i)
+        p = write_varint_fast(p, in[i]);
+      buff.resize(p - buff.data());
+    }
 }
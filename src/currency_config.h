@@ -62,8 +62,18 @@
 
 #define BLOCKS_IDS_SYNCHRONIZING_DEFAULT_COUNT          10000  //by default, blocks ids count in synchronizing
 #define BLOCKS_SYNCHRONIZING_DEFAULT_COUNT              200    //by default, blocks count in blocks downloading
+#define BLOCKS_SYNCHRONIZING_MIN_COUNT                  10     //adaptive blocks downloading: blocks count limits for one request
+#define BLOCKS_SYNCHRONIZING_MAX_COUNT                  2000
+#define BLOCKS_SYNCHRONIZING_TARGET_SECONDS             5      //adaptive blocks downloading: expected response download time
+#define BLOCKS_SYNCHRONIZING_MAX_RESPONSE_SIZE          (20 * 1024 * 1024) //well below LEVIN_DEFAULT_MAX_PACKET_SIZE
+#define BLOCKS_SYNCHRONIZING_SLOW_PEER_RATIO            10     //peer that is N times slower than the fastest synchronizing one is dropped
+#define BLOCKS_SYNCHRONIZING_SLOW_PEER_MIN_RESPONSES    3      //...but not before N responses are measured
 #define CURRENCY_PROTOCOL_HOP_RELAX_COUNT               3      //value of hop, after which we use only announce of new block
 
+#define BLOCKCHAIN_BATCH_COMMIT_DEFAULT_BLOCKS          1000   //batched import: commit db write transaction at least every N blocks
+#define BLOCKCHAIN_BATCH_COMMIT_DEFAULT_SECONDS         60     //batched import: ...or at least every T seconds
+#define BLOCKCHAIN_BATCH_MAX_LOCK_MILLISECONDS          1000   //batched import from network: locks are released (batch committed) at least every T ms to let rpc in
+
 
 #define CURRENCY_ALT_BLOCK_LIVETIME_COUNT               (720*7)//one week
 #define CURRENCY_MEMPOOL_TX_LIVETIME                    86400 //seconds, one day
@@ -0,0 +1,143 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <fstream>
+#include <memory>
+
+#include "currency_basic.h"
+#include "currency_format_utils.h"
+#include "serialization/serialization.h"
+#include "serialization/string.h"
+
+/*
+  Blockchain export file: offline bootstrap of a node (see blockchain_export/blockchain_import tools)
+
+  header:  signature (8 bytes) | format version (uint32) | height of the first block (uint64)
+  records: entry blob size (uint32) | entry blob (blockchain_export_entry, binary serialization)
+  integers are stored in native (little-endian) byte order
+*/
+
+#define BLOCKCHAIN_EXPORT_FILE_SIGNATURE          "BBRCHAIN"
+#define BLOCKCHAIN_EXPORT_FILE_SIGNATURE_SIZE     8
+#define BLOCKCHAIN_EXPORT_FILE_FORMAT_VER         1
+#define BLOCKCHAIN_EXPORT_FILE_MAX_ENTRY_SIZE     (100 * 1024 * 1024)
+#define BLOCKCHAIN_EXPORT_FILE_DEFAULT_NAME       "blockchain.raw"
+#define BLOCKCHAIN_EXPORT_FILE_IO_BUFFER_SIZE     (4 * 1024 * 1024)
+
+namespace currency
+{
+  struct blockchain_export_entry
+  {
+    blobdata block;
+    std::vector<blobdata> txs;
+
+    BEGIN_SERIALIZE_OBJECT()
+      FIELD(block)
+      FIELD(txs)
+    END_SERIALIZE()
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  class blockchain_export_file_writer
+  {
+  public:
+    bool open(const std::string& path, uint64_t start_height)
+    {
+      m_buffer.reset(new char[BLOCKCHAIN_EXPORT_FILE_IO_BUFFER_SIZE]);
+      m_stream.rdbuf()->pubsetbuf(m_buffer.get(), BLOCKCHAIN_EXPORT_FILE_IO_BUFFER_SIZE);
+      m_stream.open(path, std::ios::binary | std::ios::out | std::ios::trunc);
+      CHECK_AND_ASSERT_MES(m_stream.is_open(), false, "Failed to open " << path << " for writing");
+
+      uint32_t ver = BLOCKCHAIN_EXPORT_FILE_FORMAT_VER;
+      m_stream.write(BLOCKCHAIN_EXPORT_FILE_SIGNATURE, BLOCKCHAIN_EXPORT_FILE_SIGNATURE_SIZE);
+      m_stream.write(reinterpret_cast<const char*>(&ver), sizeof(ver));
+      m_stream.write(reinterpret_cast<const char*>(&start_height), sizeof(start_height));
+      return m_stream.good();
+    }
+
+    bool write(const blockchain_export_entry& entry)
+    {
+      blobdata entry_blob;
+      bool r = t_serializable_object_to_blob(entry, entry_blob);
+      CHECK_AND_ASSERT_MES(r, false, "Failed to serialize export entry");
+      CHECK_AND_ASSERT_MES(entry_blob.size() <= BLOCKCHAIN_EXPORT_FILE_MAX_ENTRY_SIZE, false, "Export entry is too big: " << entry_blob.size());
+      uint32_t sz = static_cast<uint32_t>(entry_blob.size());
+      m_stream.write(reinterpret_cast<const char*>(&sz), sizeof(sz));
+      m_stream.write(entry_blob.data(), entry_blob.size());
+      return m_stream.good();
+    }
+
+    bool close()
+    {
+      m_stream.flush();
+      bool r = m_stream.good();
+      m_stream.close();
+      return r;
+    }
+
+  private:
+    std::ofstream m_stream;
+    std::unique_ptr<char[]> m_buffer;
+  };
+
+  /************************************************************************/
+  /*                                                                      */
+  /************************************************************************/
+  class blockchain_export_file_reader
+  {
+  public:
+    blockchain_export_file_reader() : m_start_height(0), m_eof(false)
+    {}
+
+    bool open(const std::string& path)
+    {
+      m_buffer.reset(new char[BLOCKCHAIN_EXPORT_FILE_IO_BUFFER_SIZE]);
+      m_stream.rdbuf()->pubsetbuf(m_buffer.get(), BLOCKCHAIN_EXPORT_FILE_IO_BUFFER_SIZE);
+      m_stream.open(path, std::ios::binary | std::ios::in);
+      CHECK_AND_ASSERT_MES(m_stream.is_open(), false, "Failed to open " << path);
+
+      char signature[BLOCKCHAIN_EXPORT_FILE_SIGNATURE_SIZE] = { 0 };
+      uint32_t ver = 0;
+      m_stream.read(signature, sizeof(signature));
+      m_stream.read(reinterpret_cast<char*>(&ver), sizeof(ver));
+      m_stream.read(reinterpret_cast<char*>(&m_start_height), sizeof(m_start_height));
+      CHECK_AND_ASSERT_MES(m_stream.good(), false, "Failed to read header of " << path);
+      CHECK_AND_ASSERT_MES(!memcmp(signature, BLOCKCHAIN_EXPORT_FILE_SIGNATURE, sizeof(signature)), false, "Wrong signature of " << path);
+      CHECK_AND_ASSERT_MES(ver == BLOCKCHAIN_EXPORT_FILE_FORMAT_VER, false, "Unsupported format version " << ver << " of " << path);
+      return true;
+    }
+
+    uint64_t get_start_height() const { return m_start_height; }
+
+    // reads raw entry blob, returns false at the end of file or on error (is_eof() tells them apart)
+    bool read(blobdata& entry_blob)
+    {
+      uint32_t sz = 0;
+      m_stream.read(reinterpret_cast<char*>(&sz), sizeof(sz));
+      if (m_stream.eof() && !m_stream.gcount())
+      {
+        m_eof = true;
+        return false;
+      }
+      CHECK_AND_ASSERT_MES(m_stream.good(), false, "Failed to read entry size");
+      CHECK_AND_ASSERT_MES(sz <= BLOCKCHAIN_EXPORT_FILE_MAX_ENTRY_SIZE, false, "Wrong entry size: " << sz);
+      entry_blob.resize(sz);
+      m_stream.read(&entry_blob[0], sz);
+      CHECK_AND_ASSERT_MES(m_stream.good(), false, "Failed to read entry, size: " << sz);
+      return true;
+    }
+
+    bool is_eof() const { return m_eof; }
+
+  private:
+    std::ifstream m_stream;
+    std::unique_ptr<char[]> m_buffer;
+    uint64_t m_start_height;
+    bool m_eof;
+  };
+}
@@ -10,6 +10,7 @@
 
 #include "include_base_utils.h"
 #include "common/db_lmdb_adapter.h"
+#include "common/parallel_for.h"
 #include "currency_basic_impl.h"
 #include "blockchain_storage.h"
 #include "currency_format_utils.h"
@@ -41,11 +42,15 @@ using namespace currency;
 #define BLOCKCHAIN_CONTAINER_ADDR_TO_ALIAS    "addr_to_alias"
 #define BLOCKCHAIN_CONTAINER_SCRATCHPAD       "scratchpad"
 #define BLOCKCHAIN_CONTAINER_BLOCKS_INDEX     "blocks_index"
+#define BLOCKCHAIN_CONTAINER_OUTPUTS_META     "outputs_meta"
 
 #define BLOCKCHAIN_OPTIONS_ID_CURRENT_BLOCK_CUMUL_SZ_LIMIT          0
 #define BLOCKCHAIN_OPTIONS_ID_CURRENT_PRUNED_RS_HEIGHT              1
 #define BLOCKCHAIN_OPTIONS_ID_LAST_WORKED_VERSION                   2
 #define BLOCKCHAIN_OPTIONS_ID_STORAGE_MAJOR_COMPABILITY_VERSION     3 //mismatch here means full resync
+#define BLOCKCHAIN_OPTIONS_ID_OUTPUTS_META_HEIGHT                   4 //blocks covered by outputs metadata while it is being filled
+
+#define BLOCKCHAIN_OUTPUTS_META_COMPLETE                            std::numeric_limits<uint64_t>::max()
 
 #define BLOCKCHAIN_STORAGE_MAJOR_COMPABILITY_VERSION                1
 
@@ -61,6 +66,7 @@ blockchain_storage::blockchain_storage(tx_memory_pool& tx_pool) :m_db(std::share
                                                                  m_db_transactions(m_db),
                                                                  m_db_spent_keys(m_db),
                                                                  m_db_outputs(m_db),
+                                                                 m_db_outputs_meta(m_db),
                                                                  m_db_solo_options(m_db),
                                                                  m_db_aliases(m_db),
                                                                  m_db_addr_to_alias(m_db), 
@@ -70,12 +76,30 @@ blockchain_storage::blockchain_storage(tx_memory_pool& tx_pool) :m_db(std::share
                                                                  m_db_current_pruned_rs_height(BLOCKCHAIN_OPTIONS_ID_CURRENT_PRUNED_RS_HEIGHT, m_db_solo_options),
                                                                  m_db_last_worked_version(BLOCKCHAIN_OPTIONS_ID_LAST_WORKED_VERSION, m_db_solo_options),
                                                                  m_db_storage_major_compability_version(BLOCKCHAIN_OPTIONS_ID_STORAGE_MAJOR_COMPABILITY_VERSION, m_db_solo_options),                                                               
+                                                                 m_db_outputs_meta_height(BLOCKCHAIN_OPTIONS_ID_OUTPUTS_META_HEIGHT, m_db_solo_options),
                                                                  m_tx_pool(tx_pool),
                                                                  m_is_in_checkpoint_zone(false), 
                                                                  m_donations_account(AUTO_VAL_INIT(m_donations_account)), 
                                                                  m_royalty_account(AUTO_VAL_INIT(m_royalty_account)),
                                                                  m_is_blockchain_storing(false), 
-                                                                 m_locker_file(0)
+                                                                 m_locker_file(0),
+                                                                 m_batch_import_active(false),
+                                                                 m_batch_tx_depth(0),
+                                                                 m_batch_locked_at(0),
+                                                                 m_batch_blocks_since_commit(0),
+                                                                 m_batch_last_commit_time(0),
+                                                                 m_batch_commit_every_blocks(BLOCKCHAIN_BATCH_COMMIT_DEFAULT_BLOCKS),
+                                                                 m_batch_commit_every_seconds(BLOCKCHAIN_BATCH_COMMIT_DEFAULT_SECONDS),
+                                                                 m_verification_threads(1),
+                                                                 m_daily_tx_count(0),
+                                                                 m_daily_tx_volume(0),
+                                                                 m_next_difficulty_height(0),
+                                                                 m_next_difficulty(0),
+                                                                 m_main_chain_rollbacks(0),
+                                                                 m_chain_stats(AUTO_VAL_INIT(m_chain_stats)),
+                                                                 m_pevent_journal(nullptr),
+                                                                 m_unlocked_outs_frontier_height(0),
+                                                                 m_unlocked_outs_frontier_rollbacks(0)
 {
   bool r = get_donation_accounts(m_donations_account, m_royalty_account);
   CHECK_AND_ASSERT_THROW_MES(r, "failed to load donation accounts");
@@ -144,6 +168,8 @@ bool blockchain_storage::init(const std::string& config_folder)
   CHECK_AND_ASSERT_MES(res, false, "Unable to init db container");
   res = m_db_outputs.init(BLOCKCHAIN_CONTAINER_OUTPUTS);
   CHECK_AND_ASSERT_MES(res, false, "Unable to init db container");
+  res = m_db_outputs_meta.init(BLOCKCHAIN_CONTAINER_OUTPUTS_META);
+  CHECK_AND_ASSERT_MES(res, false, "Unable to init db container");
   res = m_db_solo_options.init(BLOCKCHAIN_CONTAINER_SOLO_OPTIONS);
   CHECK_AND_ASSERT_MES(res, false, "Unable to init db container");
   res = m_db_aliases.init(BLOCKCHAIN_CONTAINER_ALIASES);
@@ -173,6 +199,10 @@ bool blockchain_storage::init(const std::string& config_folder)
     LOG_PRINT_MAGENTA("Storage initialized with genesis", LOG_LEVEL_0);
   }
   initialize_db_solo_options_values();
+  res = store_missing_outputs_meta();
+  CHECK_AND_ASSERT_MES(res, false, "Failed to store outputs metadata");
+  res = rebuild_chain_stats();
+  CHECK_AND_ASSERT_MES(res, false, "Failed to calculate chain statistics");
 
   //print information message
   uint64_t timestamp_diff = time(nullptr) - m_db_blocks.back()->bl.timestamp;
@@ -224,6 +254,11 @@ bool blockchain_storage::pop_block_from_blockchain()
 
   //pop block from core
   m_db_blocks.pop_back();
+  ++m_main_chain_rollbacks;
+  m_next_difficulty_height = 0;
+  add_pending_event(core_event_block_removed, get_block_hash(bei.bl), h);
+  r = pop_daily_tx_stat();
+  CHECK_AND_ASSERT_MES(r, false, "pop_block_from_blockchain: failed to update daily statistics on height " << h);
   m_tx_pool.on_blockchain_dec(m_db_blocks.size() - 1, get_top_block_id());
   return true;
 }
@@ -333,12 +368,16 @@ bool blockchain_storage::clear()
   m_db_spent_keys.clear();
   m_db_solo_options.clear();
   initialize_db_solo_options_values();
+  m_db_outputs_meta_height = BLOCKCHAIN_OUTPUTS_META_COMPLETE;
   m_db_outputs.clear();
+  m_db_outputs_meta.clear();
   m_invalid_blocks.clear(); 
   m_db_aliases.clear();
   m_db_addr_to_alias.clear();
   m_scratchpad_wr.clear();
   m_db.commit_transaction();
+  ++m_main_chain_rollbacks;
+  rebuild_chain_stats();
   return true;
 }
 //------------------------------------------------------------------
@@ -450,6 +489,7 @@ bool blockchain_storage::purge_transaction_from_blockchain(const crypto::hash& t
   if (!is_coinbase(tx))
   {
     currency::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+    track_pool_tx(tx_id, tx);
     bool r = m_tx_pool.add_tx(tx, tvc, true);
     CHECK_AND_ASSERT_MES(r, false, "purge_block_data_from_blockchain: failed to add transaction to transaction pool");
   }
@@ -610,6 +650,142 @@ bool blockchain_storage::get_block_by_height(uint64_t h, block &blk)
   return true;
 }
 //------------------------------------------------------------------
+bool blockchain_storage::get_block_complete_entry(uint64_t h, block& blk, block_complete_entry& e)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  if (h >= m_db_blocks.size())
+    return false;
+  bool r = get_block_blob(h, e.block);
+  CHECK_AND_ASSERT_MES(r, false, "Internal error: failed to get block blob on height " << h);
+  r = parse_and_validate_block_from_blob(e.block, blk);
+  CHECK_AND_ASSERT_MES(r, false, "Internal error: failed to parse block blob on height " << h);
+  e.txs.clear();
+  BOOST_FOREACH(const auto& tx_id, blk.tx_hashes)
+  {
+    e.txs.push_back(blobdata());
+    r = get_transaction_blob(tx_id, e.txs.back());
+    CHECK_AND_ASSERT_MES(r, false, "Internal error: failed to get blob for transaction " << tx_id << " from block on height " << h);
+  }
+  return true;
+}
+//------------------------------------------------------------------
+namespace
+{
+  //blob of a block (transaction) from raw block_extended_info (transaction_chain_entry) record, is taken without
+  //decoding the record, it's stored there since record version 2. version_fields is how many version fields precede it
+  bool get_blob_from_record(const std::string& record, size_t version_fields, blobdata& blob)
+  {
+    binary_buffer_istream bs(record.data(), record.size());
+    binary_buffer_archive<false> ba(bs);
+    uint32_t version = 0;
+    for (size_t i = 0; i != version_fields; ++i)
+      ba.serialize_int(version);
+    if (!bs.good() || version < 2)
+      return false;
+    size_t blob_size = 0;
+    ba.serialize_varint(blob_size);
+    if (!bs.good() || ba.remaining_bytes() < blob_size)
+      return false;
+    blob.assign(record, record.size() - ba.remaining_bytes(), blob_size);
+    return true;
+  }
+}
+//------------------------------------------------------------------
+bool blockchain_storage::get_block_blob(uint64_t h, blobdata& blob) const
+{
+  blobdata record;
+  if (!m_db_blocks.get_raw(h, record))
+    return false;
+  if (get_blob_from_record(record, 1, blob))
+    return true;
+
+  //stored before version 2
+  auto bei_ptr = m_db_blocks.get(h);
+  CHECK_AND_ASSERT_MES(bei_ptr, false, "Internal error: failed to decode block on height " << h);
+  return block_to_blob(bei_ptr->bl, blob);
+}
+//------------------------------------------------------------------
+bool blockchain_storage::get_transaction_blob(const crypto::hash& tx_id, blobdata& blob) const
+{
+  blobdata record;
+  if (!m_db_transactions.get_raw(tx_id, record))
+    return false;
+  if (get_blob_from_record(record, 2, blob))
+    return true;
+
+  auto tx_ptr = m_db_transactions.get(tx_id);
+  CHECK_AND_ASSERT_MES(tx_ptr, false, "Internal error: failed to decode transaction " << tx_id);
+  return tx_to_blob(tx_ptr->tx, blob);
+}
+//------------------------------------------------------------------
+bool blockchain_storage::store_missing_outputs_meta()
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  //storages created before outputs metadata was kept get it filled here once, in portions, resuming from the stored height
+  const size_t portion_size = 1000;
+  uint64_t meta_height = m_db_outputs_meta_height;
+  if (meta_height == BLOCKCHAIN_OUTPUTS_META_COMPLETE)
+    return true;
+  if (meta_height > m_db_blocks.size() || (!meta_height && m_db_outputs_meta.size()))
+  {
+    m_db.begin_transaction();
+    m_db_outputs_meta.clear();
+    m_db_outputs_meta_height = 0;
+    m_db.commit_transaction();
+    meta_height = 0;
+  }
+
+  LOG_PRINT_L0("Storing outputs metadata from height " << meta_height << "...");
+  for (size_t h = meta_height; h < m_db_blocks.size();)
+  {
+    m_db.begin_transaction();
+    bool r = true;
+    for (size_t portion_end = h + portion_size; r && h < m_db_blocks.size() && h != portion_end; ++h)
+    {
+      auto bei_ptr = m_db_blocks[h];
+      const block& bl = bei_ptr->bl;
+      std::vector<crypto::hash> tx_ids(1, get_transaction_hash(bl.miner_tx));
+      tx_ids.insert(tx_ids.end(), bl.tx_hashes.begin(), bl.tx_hashes.end());
+      for (size_t t = 0; r && t != tx_ids.size(); ++t)
+      {
+        auto tx_ptr = m_db_transactions.find(tx_ids[t]);
+        r = tx_ptr && tx_ptr->m_spent_flags.size() == tx_ptr->tx.vout.size();
+        if (!r)
+        {
+          LOG_ERROR("Transaction " << tx_ids[t] << " from block on height " << h << " not found or broken");
+          break;
+        }
+        for (size_t n = 0; r && n != tx_ptr->tx.vout.size(); ++n)
+        {
+          const tx_out& ot = tx_ptr->tx.vout[n];
+          if (ot.target.type() != typeid(txout_to_key))
+            continue;
+          size_t i = m_db_outputs_meta.get_item_size(ot.amount);
+          r = i < m_db_outputs.get_item_size(ot.amount) && *m_db_outputs.get_subitem(ot.amount, i) == std::pair<crypto::hash, uint64_t>(tx_ids[t], n);
+          if (!r)
+          {
+            LOG_ERROR("Output " << n << " of transaction " << tx_ids[t] << " doesn't match outputs index for amount " << ot.amount << " at " << i);
+            break;
+          }
+          push_output_meta(ot.amount, boost::get<txout_to_key>(ot.target), tx_ptr->tx.unlock_time, tx_ptr->m_keeper_block_height, tx_ptr->m_spent_flags[n]);
+        }
+      }
+    }
+    if (!r)
+    {
+      m_db.abort_transaction();
+      return false;
+    }
+    m_db_outputs_meta_height = h;
+    m_db.commit_transaction();
+    LOG_PRINT_L0("Outputs metadata stored up to height " << h);
+  }
+  m_db.begin_transaction();
+  m_db_outputs_meta_height = BLOCKCHAIN_OUTPUTS_META_COMPLETE;
+  m_db.commit_transaction();
+  return true;
+}
+//------------------------------------------------------------------
 // void blockchain_storage::get_all_known_block_ids(std::list<crypto::hash> &main, std::list<crypto::hash> &alt, std::list<crypto::hash> &invalid) {
 //   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 // 
@@ -676,13 +852,13 @@ bool blockchain_storage::switch_to_alternative_blockchain(std::list<blocks_ext_b
       rollback_blockchain_switching(disconnected_chain, split_height);
       add_block_as_invalid(ch_ent->second, get_block_hash(ch_ent->second.bl));
       LOG_PRINT_L0("The block was inserted as invalid while connecting new alternative chain,  block_id: " << get_block_hash(ch_ent->second.bl));
-      m_alternative_chains.erase(ch_ent);
+      erase_tracked_block(m_alternative_chains, ch_ent);
 
       for (auto alt_ch_to_orph_iter = ++alt_ch_iter; alt_ch_to_orph_iter != alt_chain.end(); alt_ch_to_orph_iter++)
       {
         //block_verification_context bvc = boost::value_initialized<block_verification_context>();
         add_block_as_invalid((*alt_ch_iter)->second, (*alt_ch_iter)->first);
-        m_alternative_chains.erase(*alt_ch_to_orph_iter);
+        erase_tracked_block(m_alternative_chains, *alt_ch_to_orph_iter);
       }
       return false;
     }
@@ -704,7 +880,7 @@ bool blockchain_storage::switch_to_alternative_blockchain(std::list<blocks_ext_b
   //removing all_chain entries from alternative chain
   BOOST_FOREACH(auto ch_ent, alt_chain)
   {
-    m_alternative_chains.erase(ch_ent);
+    erase_tracked_block(m_alternative_chains, ch_ent);
   }
 
   LOG_PRINT_GREEN("REORGANIZE SUCCESS! on height: " << split_height << ", new blockchain size: " << m_db_blocks.size(), LOG_LEVEL_0);
@@ -715,6 +891,9 @@ bool blockchain_storage::switch_to_alternative_blockchain(std::list<blocks_ext_b
 wide_difficulty_type blockchain_storage::get_difficulty_for_next_block()
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  if (m_next_difficulty_height && m_next_difficulty_height == m_db_blocks.size())
+    return m_next_difficulty;
+
   std::vector<uint64_t> timestamps;
   std::vector<wide_difficulty_type> commulative_difficulties;
   size_t offset = m_db_blocks.size() - std::min(m_db_blocks.size(), static_cast<size_t>(DIFFICULTY_BLOCKS_COUNT));
@@ -725,7 +904,9 @@ wide_difficulty_type blockchain_storage::get_difficulty_for_next_block()
     timestamps.push_back(m_db_blocks[offset]->bl.timestamp);
     commulative_difficulties.push_back(m_db_blocks[offset]->cumulative_difficulty);
   }
-  return next_difficulty(timestamps, commulative_difficulties);
+  m_next_difficulty = next_difficulty(timestamps, commulative_difficulties);
+  m_next_difficulty_height = m_db_blocks.size();
+  return m_next_difficulty;
 }
 //------------------------------------------------------------------
 
@@ -999,6 +1180,7 @@ bool blockchain_storage::create_block_template(block& b, const account_public_ad
   uint64_t donation_amount_for_this_block = 0;
 
   CRITICAL_REGION_BEGIN(m_blockchain_lock);
+  b.invalidate_hashes();
   b.major_version = CURRENT_BLOCK_MAJOR_VERSION;
   b.minor_version = CURRENT_BLOCK_MINOR_VERSION;
   b.prev_id = get_top_block_id();
@@ -1307,9 +1489,9 @@ bool blockchain_storage::handle_alternative_block(const block& b, const crypto::
     auto i_dres = m_alternative_chains.find(id);
     CHECK_AND_ASSERT_MES(i_dres == m_alternative_chains.end(), false, "insertion of new alternative block returned as it already exist");
 #endif
-    auto i_res = m_alternative_chains.insert(blocks_ext_by_hash::value_type(id, bei));
-    CHECK_AND_ASSERT_MES(i_res.second, false, "insertion of new alternative block returned as it already exist");
-    alt_chain.push_back(i_res.first);
+    blocks_ext_by_hash::iterator i_res;
+    CHECK_AND_ASSERT_MES(insert_tracked_block(m_alternative_chains, id, bei, &i_res), false, "insertion of new alternative block returned as it already exist");
+    alt_chain.push_back(i_res);
     //check if difficulty bigger then in main chain
     if (m_db_blocks.back()->cumulative_difficulty < bei.cumulative_difficulty)
     {
@@ -1369,31 +1551,31 @@ bool blockchain_storage::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request&
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   rsp.current_blockchain_height = get_current_blockchain_height();
-  std::list<block> blocks;
-  get_blocks(arg.blocks, blocks, rsp.missed_ids);
-
-  BOOST_FOREACH(const auto& bl, blocks)
+  //blocks and transactions are given as blobs they were stored with, without serializing them again
+  BOOST_FOREACH(const auto& bl_id, arg.blocks)
   {
-    std::list<crypto::hash> missed_tx_id;
-    std::list<transaction> txs;
-    get_transactions(bl.tx_hashes, txs, rsp.missed_ids);
-    CHECK_AND_ASSERT_MES(!missed_tx_id.size(), false, "Internal error: have missed missed_tx_id.size()=" << missed_tx_id.size()
-      << ENDL << "for block id = " << get_block_hash(bl));
+    auto block_ind_ptr = m_db_blocks_index.find(bl_id);
+    if (!block_ind_ptr)
+    {
+      rsp.missed_ids.push_back(bl_id);
+      continue;
+    }
+    block bl = AUTO_VAL_INIT(bl);
     rsp.blocks.push_back(block_complete_entry());
-    block_complete_entry& e = rsp.blocks.back();
-    //pack block
-    e.block = t_serializable_object_to_blob(bl);
-    //pack transactions
-    BOOST_FOREACH(transaction& tx, txs)
-      e.txs.push_back(t_serializable_object_to_blob(tx));
-
+    bool r = get_block_complete_entry(*block_ind_ptr, bl, rsp.blocks.back());
+    CHECK_AND_ASSERT_MES(r, false, "Internal error: failed to get blobs for block id = " << bl_id);
   }
   //get another transactions, if need
-  std::list<transaction> txs;
-  get_transactions(arg.txs, txs, rsp.missed_ids);
-  //pack aside transactions
-  BOOST_FOREACH(const auto& tx, txs)
-    rsp.txs.push_back(t_serializable_object_to_blob(tx));
+  BOOST_FOREACH(const auto& tx_id, arg.txs)
+  {
+    blobdata tx_blob;
+    if (get_transaction_blob(tx_id, tx_blob))
+    {
+      rsp.txs.push_back(std::move(tx_blob));
+      continue;
+    }
+    rsp.missed_ids.push_back(tx_id);
+  }
 
   return true;
 }
@@ -1401,22 +1583,118 @@ bool blockchain_storage::handle_get_objects(NOTIFY_REQUEST_GET_OBJECTS::request&
 bool blockchain_storage::get_transactions_daily_stat(uint64_t& daily_cnt, uint64_t& daily_volume)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  daily_cnt = daily_volume = 0;
+  daily_cnt = m_daily_tx_count;
+  daily_volume = m_daily_tx_volume;
+  return true;
+}
+//------------------------------------------------------------------
+void blockchain_storage::get_chain_stats(chain_stats& cs) const
+{
+  CRITICAL_REGION_LOCAL(m_chain_stats_lock);
+  cs = m_chain_stats;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::get_block_daily_tx_stat(const block& bl, uint64_t& tx_count, uint64_t& tx_volume)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  tx_count = tx_volume = 0;
+  for (auto& h : bl.tx_hashes)
+  {
+    ++tx_count;
+    auto tx_ptr = m_db_transactions.find(h);
+    CHECK_AND_ASSERT_MES(tx_ptr, false, "Wrong transaction hash " << h << " in block " << get_block_hash(bl));
+    uint64_t am = 0;
+    bool r = get_inputs_money_amount(tx_ptr->tx, am);
+    CHECK_AND_ASSERT_MES(r, false, "failed to get_inputs_money_amount");
+    tx_volume += am;
+  }
+  return true;
+}
+//------------------------------------------------------------------
+void blockchain_storage::push_daily_tx_stat(uint64_t tx_count, uint64_t tx_volume)
+{
+  m_daily_tx_stat.push_back(std::make_pair(tx_count, tx_volume));
+  m_daily_tx_count += tx_count;
+  m_daily_tx_volume += tx_volume;
+  if (m_daily_tx_stat.size() > CURRENCY_BLOCK_PER_DAY)
+  {
+    m_daily_tx_count -= m_daily_tx_stat.front().first;
+    m_daily_tx_volume -= m_daily_tx_stat.front().second;
+    m_daily_tx_stat.pop_front();
+  }
+}
+//------------------------------------------------------------------
+bool blockchain_storage::pop_daily_tx_stat()
+{
+  //should be called when the block is already popped from m_db_blocks
+  CHECK_AND_ASSERT_MES(m_daily_tx_stat.size(), false, "internal error: daily statistics is empty");
+  m_daily_tx_count -= m_daily_tx_stat.back().first;
+  m_daily_tx_volume -= m_daily_tx_stat.back().second;
+  m_daily_tx_stat.pop_back();
+  if (m_db_blocks.size() < CURRENCY_BLOCK_PER_DAY)
+    return true;
+
+  //the block before the window gets back into it
+  uint64_t tx_count = 0, tx_volume = 0;
+  bool r = get_block_daily_tx_stat(m_db_blocks[m_db_blocks.size() - CURRENCY_BLOCK_PER_DAY]->bl, tx_count, tx_volume);
+  CHECK_AND_ASSERT_MES(r, false, "failed to get_block_daily_tx_stat");
+  m_daily_tx_stat.push_front(std::make_pair(tx_count, tx_volume));
+  m_daily_tx_count += tx_count;
+  m_daily_tx_volume += tx_volume;
+  return true;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::rebuild_chain_stats()
+{
+  TRY_ENTRY();
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  m_daily_tx_stat.clear();
+  m_daily_tx_count = m_daily_tx_volume = 0;
+  m_next_difficulty_height = 0;
   for (size_t i = (m_db_blocks.size() > CURRENCY_BLOCK_PER_DAY ? m_db_blocks.size() - CURRENCY_BLOCK_PER_DAY : 0); i != m_db_blocks.size(); i++)
   {
-    auto ptr = m_db_blocks[i];
-    for (auto& h : ptr->bl.tx_hashes)
-    {
-      ++daily_cnt;
-      auto tx_ptr = m_db_transactions.find(h);
-      CHECK_AND_ASSERT_MES(tx_ptr, false, "Wrong transaction hash " << h << " in block on height " << i);
-      uint64_t am = 0;
-      bool r = get_inputs_money_amount(tx_ptr->tx, am);
-      CHECK_AND_ASSERT_MES(r, false, "failed to get_inputs_money_amount");
-      daily_volume += am;
-    }
+    uint64_t tx_count = 0, tx_volume = 0;
+    bool r = get_block_daily_tx_stat(m_db_blocks[i]->bl, tx_count, tx_volume);
+    CHECK_AND_ASSERT_MES(r, false, "failed to get_block_daily_tx_stat on height " << i);
+    push_daily_tx_stat(tx_count, tx_volume);
   }
+  update_chain_stats();
   return true;
+  CATCH_ENTRY_L0("rebuild_chain_stats", false);
+}
+//------------------------------------------------------------------
+void blockchain_storage::update_chain_stats()
+{
+  //called after blocks are committed, so it must not throw: a failure leaves the previous statistics
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  chain_stats cs = AUTO_VAL_INIT(cs);
+  try
+  {
+    cs.height = m_db_blocks.size();
+    cs.next_difficulty = get_difficulty_for_next_block();
+    cs.total_transactions = m_db_transactions.size();
+    cs.alt_blocks_count = m_alternative_chains.size();
+    cs.current_comulative_blocksize_limit = m_db_current_block_cumul_sz_limit;
+    cs.hashrate_50 = get_current_hashrate(50);
+    cs.hashrate_350 = get_current_hashrate(350);
+    cs.scratchpad_size = m_scratchpad_wr.get_scratchpad().size() * 32;
+    cs.aliases_count = m_db_aliases.size();
+    cs.daily_tx_count = m_daily_tx_count;
+    cs.daily_tx_volume = m_daily_tx_volume;
+  }
+  catch (const std::exception& ex)
+  {
+    LOG_ERROR("Failed to update chain statistics: " << ex.what());
+    return;
+  }
+  catch (...)
+  {
+    LOG_ERROR("Failed to update chain statistics");
+    return;
+  }
+
+  CRITICAL_REGION_LOCAL1(m_chain_stats_lock);
+  m_chain_stats = cs;
 }
 //------------------------------------------------------------------
 bool blockchain_storage::check_keyimages(const std::list<crypto::key_image>& images, std::list<bool>& images_stat)
@@ -1436,8 +1714,12 @@ uint64_t blockchain_storage::get_current_hashrate(size_t aprox_count)
   if (m_db_blocks.size() <= aprox_count)
     return 0;
 
-  wide_difficulty_type w_hr = (m_db_blocks.back()->cumulative_difficulty - m_db_blocks[m_db_blocks.size() - aprox_count]->cumulative_difficulty) /
-    (m_db_blocks.back()->bl.timestamp - m_db_blocks[m_db_blocks.size() - aprox_count]->bl.timestamp);
+  auto first_ptr = m_db_blocks[m_db_blocks.size() - aprox_count];
+  auto last_ptr = m_db_blocks.back();
+  //timestamps only follow the median rule, so they may be equal or even go back
+  if (last_ptr->bl.timestamp <= first_ptr->bl.timestamp)
+    return 0;
+  wide_difficulty_type w_hr = (last_ptr->cumulative_difficulty - first_ptr->cumulative_difficulty) / (last_ptr->bl.timestamp - first_ptr->bl.timestamp);
   return w_hr.convert_to<uint64_t>();
 }
 //------------------------------------------------------------------
@@ -1504,28 +1786,19 @@ size_t blockchain_storage::get_alternative_blocks_count()
 bool blockchain_storage::add_out_to_get_random_outs(COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, size_t i, uint64_t mix_count, bool use_only_forced_to_mix)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  auto out_ptr = m_db_outputs.get_subitem(amount, i);
-  auto tx_ptr = m_db_transactions.find(out_ptr->first);
-  CHECK_AND_ASSERT_MES(tx_ptr, false, "internal error: transaction with id " << out_ptr->first << ENDL <<
-    ", used in mounts global index for amount=" << amount << ": i=" << i << "not found in transactions index");
-  CHECK_AND_ASSERT_MES(tx_ptr->tx.vout.size() > out_ptr->second, false, "internal error: in global outs index, transaction out index="
-    << out_ptr->second << " more than transaction outputs = " << tx_ptr->tx.vout.size() << ", for tx id = " << out_ptr->first);
-
-  const transaction& tx = tx_ptr->tx;
-  CHECK_AND_ASSERT_MES(tx.vout[out_ptr->second].target.type() == typeid(txout_to_key), false, "unknown tx out type");
-
-  CHECK_AND_ASSERT_MES(tx_ptr->m_spent_flags.size() == tx.vout.size(), false, "internal error");
+  auto meta_ptr = m_db_outputs_meta.get_subitem(amount, i);
+  CHECK_AND_ASSERT_MES(meta_ptr, false, "internal error: no metadata for output of amount=" << amount << ": i=" << i);
 
   //do not use outputs that obviously spent for mixins
-  if (tx_ptr->m_spent_flags[out_ptr->second])
+  if (meta_ptr->spent)
     return false;
 
   //check if transaction is unlocked
-  if (!is_tx_spendtime_unlocked(tx.unlock_time))
+  if (!is_tx_spendtime_unlocked(meta_ptr->unlock_time))
     return false;
 
   //use appropriate mix_attr out 
-  uint8_t mix_attr = boost::get<txout_to_key>(tx.vout[out_ptr->second].target).mix_attr;
+  uint8_t mix_attr = meta_ptr->mix_attr;
 
   if (mix_attr == CURRENCY_TO_KEY_OUT_FORCED_NO_MIX)
     return false; //COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS call means that ring signature will have more than one entry.
@@ -1537,31 +1810,61 @@ bool blockchain_storage::add_out_to_get_random_outs(COMMAND_RPC_GET_RANDOM_OUTPU
 
   COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry& oen = *result_outs.outs.insert(result_outs.outs.end(), COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::out_entry());
   oen.global_amount_index = i;
-  oen.out_key = boost::get<txout_to_key>(tx.vout[out_ptr->second].target).key;
+  oen.out_key = meta_ptr->out_key;
   return true;
 }
 //------------------------------------------------------------------
 size_t blockchain_storage::find_end_of_allowed_index(uint64_t amount)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  uint64_t sz = m_db_outputs.get_item_size(amount);
+  uint64_t height = get_current_blockchain_height();
+  if (m_unlocked_outs_frontier_rollbacks != m_main_chain_rollbacks || m_unlocked_outs_frontier_height > height)
+    m_unlocked_outs_frontier.clear();
+  m_unlocked_outs_frontier_rollbacks = m_main_chain_rollbacks;
+  m_unlocked_outs_frontier_height = height;
 
-  if (!sz)
+  size_t hi = m_db_outputs_meta.get_item_size(amount);
+  if (!hi)
     return 0;
-  uint64_t i = sz;
-  do
-  {
-    --i;
-    auto out_ptr = m_db_outputs.get_subitem(amount, i);
-    auto tx_ptr = m_db_transactions.find(out_ptr->first);
-    CHECK_AND_ASSERT_MES(tx_ptr, 0, "internal error: failed to find transaction from outputs index with tx_id=" << out_ptr->first);
-    if (tx_ptr->m_keeper_block_height + CURRENCY_MINED_MONEY_UNLOCK_WINDOW <= get_current_blockchain_height())
-      return i + 1;
-  } while (i != 0);
-  return 0;
+  //outputs of an amount go in blocks order, so the frontier only moves up while blocks are added:
+  //look for it between the last known one and the end
+  size_t& frontier = m_unlocked_outs_frontier[amount];
+  if (frontier > hi)
+    frontier = 0;
+  while (frontier < hi)
+  {
+    size_t mid = frontier + (hi - frontier) / 2;
+    if (m_db_outputs_meta.get_subitem(amount, mid)->keeper_block_height + CURRENCY_MINED_MONEY_UNLOCK_WINDOW <= height)
+      frontier = mid + 1;
+    else
+      hi = mid;
+  }
+  return frontier;
 }
 //------------------------------------------------------------------
 bool blockchain_storage::get_random_outs_for_amounts(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  //all amounts are served within one read transaction instead of a transaction per lookup,
+  //read transaction can't be nested into a write one, so inside of it lookups just go on as they are
+  std::shared_ptr<db::lmdb_adapter> lmdb = get_lmdb_adapter();
+  if (!lmdb || lmdb->has_active_transaction())
+    return get_random_outs_for_amounts_in_transaction(req, res);
+  CHECK_AND_ASSERT_MES(m_db.begin_transaction(true), false, "Failed to begin read transaction");
+  bool r = false;
+  try
+  {
+    r = get_random_outs_for_amounts_in_transaction(req, res);
+  }
+  catch (const std::exception& ex)
+  {
+    LOG_ERROR("Exception in get_random_outs_for_amounts: " << ex.what());
+  }
+  m_db.commit_transaction();
+  return r;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::get_random_outs_for_amounts_in_transaction(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   BOOST_FOREACH(uint64_t amount, req.amounts)
@@ -1616,6 +1919,11 @@ bool blockchain_storage::update_spent_tx_flags_for_input(uint64_t amount, uint64
   CHECK_AND_ASSERT_MES(outs_count, false, "Amount " << amount << " have not found during update_spent_tx_flags_for_input()");
   CHECK_AND_ASSERT_MES(global_index < outs_count, false, "Global index" << global_index << " for amount " << amount << " bigger value than amount's vector size()=" << outs_count);
   auto out_ptr = m_db_outputs.get_subitem(amount, global_index);
+  auto meta_ptr = m_db_outputs_meta.get_subitem(amount, global_index);
+  CHECK_AND_ASSERT_MES(meta_ptr, false, "internal error: no metadata for output of amount=" << amount << ": global_index=" << global_index);
+  output_meta_entry ome = *meta_ptr;
+  ome.spent = spent;
+  m_db_outputs_meta.set_subitem(amount, global_index, ome);
   return update_spent_tx_flags_for_input(out_ptr->first, out_ptr->second, spent);
 }
 //------------------------------------------------------------------
@@ -1813,8 +2121,7 @@ bool blockchain_storage::add_block_as_invalid(const block& bl, const crypto::has
 bool blockchain_storage::add_block_as_invalid(const block_extended_info& bei, const crypto::hash& h)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
-  auto i_res = m_invalid_blocks.insert(std::map<crypto::hash, block_extended_info>::value_type(h, bei));
-  CHECK_AND_ASSERT_MES(i_res.second, false, "at insertion invalid by tx returned status existed");
+  CHECK_AND_ASSERT_MES(insert_tracked_block(m_invalid_blocks, h, bei), false, "at insertion invalid by tx returned status existed");
   LOG_PRINT_L0("BLOCK ADDED AS INVALID: " << h << ENDL << ", prev_id=" << bei.bl.prev_id << ", m_invalid_blocks count=" << m_invalid_blocks.size());
   return true;
 }
@@ -1843,7 +2150,7 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, block_verif
   return handle_block_to_main_chain(bl, id, bvc);
 }
 //------------------------------------------------------------------
-bool blockchain_storage::push_transaction_to_global_outs_index(const transaction& tx, const crypto::hash& tx_id, std::vector<uint64_t>& global_indexes)
+bool blockchain_storage::push_transaction_to_global_outs_index(const transaction& tx, const crypto::hash& tx_id, uint64_t keeper_block_height, std::vector<uint64_t>& global_indexes)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
   size_t i = 0;
@@ -1852,6 +2159,7 @@ bool blockchain_storage::push_transaction_to_global_outs_index(const transaction
     if (ot.target.type() == typeid(txout_to_key))
     {
       m_db_outputs.push_back_item(ot.amount, std::pair<crypto::hash, size_t>(tx_id, i));
+      push_output_meta(ot.amount, boost::get<txout_to_key>(ot.target), tx.unlock_time, keeper_block_height, false);
       global_indexes.push_back(m_db_outputs.get_item_size(ot.amount) - 1);
     }
     ++i;
@@ -1859,6 +2167,17 @@ bool blockchain_storage::push_transaction_to_global_outs_index(const transaction
   return true;
 }
 //------------------------------------------------------------------
+void blockchain_storage::push_output_meta(uint64_t amount, const txout_to_key& otk, uint64_t unlock_time, uint64_t keeper_block_height, bool spent)
+{
+  output_meta_entry ome = AUTO_VAL_INIT(ome);
+  ome.out_key = otk.key;
+  ome.keeper_block_height = keeper_block_height;
+  ome.unlock_time = unlock_time;
+  ome.mix_attr = otk.mix_attr;
+  ome.spent = spent ? 1 : 0;
+  m_db_outputs_meta.push_back_item(amount, ome);
+}
+//------------------------------------------------------------------
 size_t blockchain_storage::get_total_transactions()
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
@@ -1875,13 +2194,9 @@ bool blockchain_storage::get_outs(uint64_t amount, std::list<crypto::public_key>
 
   for (uint64_t i = 0; i != sz; i++)
   {
-    auto out_entry_ptr = m_db_outputs.get_subitem(amount, i);
-
-    auto tx_ptr = m_db_transactions.find(out_entry_ptr->first);
-    CHECK_AND_ASSERT_MES(tx_ptr, false, "transactions outs global index consistency broken: wrong tx id in index");
-    CHECK_AND_ASSERT_MES(tx_ptr->tx.vout.size() > out_entry_ptr->second, false, "transactions outs global index consistency broken: index in tx_outx more then size");
-    CHECK_AND_ASSERT_MES(tx_ptr->tx.vout[out_entry_ptr->second].target.type() == typeid(txout_to_key), false, "transactions outs global index consistency broken: index in tx_outx more then size");
-    pkeys.push_back(boost::get<txout_to_key>(tx_ptr->tx.vout[out_entry_ptr->second].target).key);
+    auto meta_ptr = m_db_outputs_meta.get_subitem(amount, i);
+    CHECK_AND_ASSERT_MES(meta_ptr, false, "internal error: no metadata for output of amount=" << amount << ": i=" << i);
+    pkeys.push_back(meta_ptr->out_key);
   }
 
   return true;
@@ -1901,6 +2216,7 @@ bool blockchain_storage::pop_transaction_from_global_index(const transaction& tx
       CHECK_AND_ASSERT_MES(back_item->first == tx_id, false, "transactions outs global index consistency broken: tx id missmatch");
       CHECK_AND_ASSERT_MES(back_item->second == i, false, "transactions outs global index consistency broken: in transaction index missmatch");
       m_db_outputs.pop_back_item(ot.amount);
+      m_db_outputs_meta.pop_back_item(ot.amount);
       //do not let to exist empty m_outputs entries - this will broke scratchpad selector
       //if (!it->second.size())
       //  m_db_outputs.erase(it);
@@ -2212,7 +2528,7 @@ bool blockchain_storage::add_transaction_from_block(const transaction& tx, const
     return false;
   }
 
-  r = push_transaction_to_global_outs_index(tx, tx_id, ch_e.m_global_output_indexes);
+  r = push_transaction_to_global_outs_index(tx, tx_id, bl_height, ch_e.m_global_output_indexes);
   CHECK_AND_ASSERT_MES(r, false, "failed to return push_transaction_to_global_outs_index tx id " << tx_id);
   TIME_MEASURE_FINISH(push_tx_to_global_index_time);
 
@@ -2276,7 +2592,7 @@ bool blockchain_storage::check_tx_inputs(const transaction& tx, uint64_t* pmax_u
   return check_tx_inputs(tx, tx_prefix_hash, pmax_used_block_height);
 }
 //------------------------------------------------------------------
-bool blockchain_storage::check_tx_inputs(const transaction& tx, const crypto::hash& tx_prefix_hash, uint64_t* pmax_used_block_height)
+bool blockchain_storage::check_tx_inputs(const transaction& tx, const crypto::hash& tx_prefix_hash, uint64_t* pmax_used_block_height, bool skip_ring_signatures)
 {
   size_t sig_index = 0;
   if (pmax_used_block_height)
@@ -2302,7 +2618,7 @@ bool blockchain_storage::check_tx_inputs(const transaction& tx, const crypto::ha
       CHECK_AND_ASSERT_MES(sig_index < tx.signatures.size(), false, "wrong transaction: not signature entry for input with index= " << sig_index);
       psig = &tx.signatures[sig_index];
     }
-    if (!check_tx_input(in_to_key, tx_prefix_hash, *psig, pmax_used_block_height))
+    if (!check_tx_input(in_to_key, tx_prefix_hash, *psig, pmax_used_block_height, skip_ring_signatures))
     {
       LOG_PRINT_L0("Failed to check ring signature for tx " << get_transaction_hash(tx));
       return false;
@@ -2340,7 +2656,7 @@ bool blockchain_storage::is_tx_spendtime_unlocked(uint64_t unlock_time)
   return false;
 }
 //------------------------------------------------------------------
-bool blockchain_storage::check_tx_input(const txin_to_key& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height)
+bool blockchain_storage::get_output_keys_for_input(const txin_to_key& txin, std::vector<crypto::public_key>& output_keys, uint64_t* pmax_related_block_height)
 {
   CRITICAL_REGION_LOCAL(m_blockchain_lock);
 
@@ -2370,8 +2686,6 @@ bool blockchain_storage::check_tx_input(const txin_to_key& txin, const crypto::h
     }
   };
 
-  //check ring signature
-  std::vector<crypto::public_key> output_keys;
   outputs_visitor vi(output_keys, *this);
   if (!scan_outputkeys_for_indexes(txin, vi, pmax_related_block_height))
   {
@@ -2384,7 +2698,19 @@ bool blockchain_storage::check_tx_input(const txin_to_key& txin, const crypto::h
     LOG_PRINT_L0("Output keys for tx with amount = " << txin.amount << " and count indexes " << txin.key_offsets.size() << " returned wrong keys count " << output_keys.size());
     return false;
   }
-  if (m_is_in_checkpoint_zone)
+  return true;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::check_tx_input(const txin_to_key& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height, bool skip_ring_signature)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+
+  //check ring signature
+  std::vector<crypto::public_key> output_keys;
+  if (!get_output_keys_for_input(txin, output_keys, pmax_related_block_height))
+    return false;
+
+  if (m_is_in_checkpoint_zone || skip_ring_signature)
     return true;
 
   CHECK_AND_ASSERT_MES(sig.size() == output_keys.size(), false, "internal error: tx signatures count=" << sig.size() << " mismatch with outputs keys count for inputs=" << output_keys.size());
@@ -2462,10 +2788,11 @@ bool blockchain_storage::prune_aged_alt_blocks()
   for (auto it = m_alternative_chains.begin(); it != m_alternative_chains.end();)
   {
     if (current_height > it->second.height && current_height - it->second.height > CURRENCY_ALT_BLOCK_LIVETIME_COUNT)
-      m_alternative_chains.erase(it++);
+      erase_tracked_block(m_alternative_chains, it++);
     else
       ++it;
   }
+  update_chain_stats();
 
   return true;
 }
@@ -2502,10 +2829,20 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
   TIME_MEASURE_START(longhash_calculating_time);
   crypto::hash proof_of_work = null_hash;
 
-  proof_of_work = get_block_longhash(bl, m_db_blocks.size(), [&](uint64_t index) -> crypto::hash
+  auto precalculated_pow_it = m_precalculated_pow.find(id);
+  if (precalculated_pow_it != m_precalculated_pow.end() && precalculated_pow_it->second.height == m_db_blocks.size())
   {
-    return m_scratchpad_wr.get_scratchpad()[index%m_scratchpad_wr.get_scratchpad().size()];
-  });
+    proof_of_work = precalculated_pow_it->second.pow;
+  }
+  else
+  {
+    proof_of_work = get_block_longhash(bl, m_db_blocks.size(), [&](uint64_t index) -> crypto::hash
+    {
+      return m_scratchpad_wr.get_scratchpad()[index%m_scratchpad_wr.get_scratchpad().size()];
+    });
+  }
+  if (precalculated_pow_it != m_precalculated_pow.end())
+    m_precalculated_pow.erase(precalculated_pow_it);
 
   if (!check_hash(proof_of_work, current_diffic))
   {
@@ -2554,8 +2891,13 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
 
 
   TIME_MEASURE_START(process_transactions_time);
+  std::unordered_set<crypto::hash> txs_with_checked_signatures;
+  if (!m_is_in_checkpoint_zone && m_verification_threads > 1)
+    precheck_ring_signatures(bl, txs_with_checked_signatures);
+
   size_t tx_processed_count = 0;
   uint64_t fee_summary = 0;
+  uint64_t daily_tx_volume = 0;
   BOOST_FOREACH(const crypto::hash& tx_id, bl.tx_hashes)
   {
     transaction tx;
@@ -2569,6 +2911,7 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
       bvc.m_verifivation_failed = true;
       return false;
     }
+    track_pool_tx(tx_id, tx);
 
     //If we under checkpoints, ring signatures should be pruned    
     if (m_is_in_checkpoint_zone)
@@ -2576,7 +2919,7 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
       tx.signatures.clear();
     }
 
-    if (!check_tx_inputs(tx))
+    if (!check_tx_inputs(tx, get_transaction_prefix_hash(tx), NULL, txs_with_checked_signatures.count(tx_id) != 0))
     {
       LOG_PRINT_L0("Block with id: " << id << "have at least one transaction (id: " << tx_id << ") with wrong inputs.");
       currency::tx_verification_context tvc = AUTO_VAL_INIT(tvc);
@@ -2599,6 +2942,9 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
       bvc.m_verifivation_failed = true;
       return false;
     }
+    uint64_t inputs_amount = 0;
+    get_inputs_money_amount(tx, inputs_amount);
+    daily_tx_volume += inputs_amount;
     fee_summary += fee;
     cumulative_block_size += blob_size;
     ++tx_processed_count;
@@ -2662,6 +3008,8 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
 
   TIME_MEASURE_START(update_blocks_table_time2);
   m_db_blocks.push_back(bei);
+  m_next_difficulty_height = 0;
+  push_daily_tx_stat(bl.tx_hashes.size(), daily_tx_volume);
   update_next_comulative_size_limit();
   TIME_MEASURE_FINISH(update_blocks_table_time2);
 
@@ -2688,6 +3036,7 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
     );
 
   bvc.m_added_to_main_chain = true;
+  add_pending_event(core_event_block_added, id, bei.height);
 
 
   m_tx_pool.on_blockchain_inc(bei.height, id);
@@ -2695,6 +3044,39 @@ bool blockchain_storage::handle_block_to_main_chain(const block& bl, const crypt
   return true;
 }
 //------------------------------------------------------------------
+void blockchain_storage::add_pending_event(core_event_type type, const crypto::hash& id, uint64_t height)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  if (!m_pevent_journal)
+    return;
+  core_event ev = { 0, type, id, height };
+  m_pending_events.push_back(ev);
+}
+//------------------------------------------------------------------
+void blockchain_storage::publish_pending_events()
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  //blocks of the batch may still be rolled back, events wait for the batch commit
+  if (m_batch_tx_depth)
+    return;
+  for (const auto& ev : m_pending_events)
+    m_pevent_journal->push(ev.type, ev.id, ev.height);
+  m_pending_events.clear();
+}
+//------------------------------------------------------------------
+size_t blockchain_storage::get_pending_events_count()
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  return m_pending_events.size();
+}
+//------------------------------------------------------------------
+void blockchain_storage::drop_pending_events(size_t keep_count)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  while (m_pending_events.size() > keep_count)
+    m_pending_events.pop_back();
+}
+//------------------------------------------------------------------
 bool blockchain_storage::update_next_comulative_size_limit()
 {
   std::vector<size_t> sz;
@@ -2710,6 +3092,28 @@ bool blockchain_storage::update_next_comulative_size_limit()
 //------------------------------------------------------------------
 bool blockchain_storage::add_new_block(const block& bl_, block_verification_context& bvc)
 {
+  bool r = try_add_new_block(bl_, bvc);
+  std::shared_ptr<db::lmdb_adapter> lmdb = get_lmdb_adapter();
+  if (r || !bvc.m_verifivation_failed || !lmdb || !lmdb->is_map_grow_required())
+    return r;
+
+  //the block didn't fit into the memory map, it's grown when the next top-level write transaction begins:
+  //the batch transaction (if any) is committed to let it happen, then the block is added once again
+  CRITICAL_REGION_LOCAL(m_tx_pool);
+  CRITICAL_REGION_LOCAL1(m_blockchain_lock);
+  LOG_PRINT_L0("Block " << get_block_hash(bl_) << " failed with db memory map full, retrying after map growth");
+  if (m_batch_tx_depth && !commit_batch_import_transaction(true))
+    return r;
+  bvc = boost::value_initialized<block_verification_context>();
+  return try_add_new_block(bl_, bvc);
+}
+//------------------------------------------------------------------
+bool blockchain_storage::try_add_new_block(const block& bl_, block_verification_context& bvc)
+{
+  //in batched import the outer batch transaction is already open, only transactions of this block should be aborted on failure
+  size_t tx_depth = get_db_transactions_depth();
+  size_t events_count = get_pending_events_count();
+  bool committing_block_tx = false;
   try
   {
     block bl = bl_;
@@ -2731,21 +3135,35 @@ bool blockchain_storage::add_new_block(const block& bl_, block_verification_cont
       bvc.m_added_to_main_chain = false;
       m_db.begin_transaction();
       bool r = handle_alternative_block(bl, id, bvc);
+      committing_block_tx = true;
       m_db.commit_transaction();
+      committing_block_tx = false;
+      if (!m_batch_tx_depth)
+        m_pool_txs_moved.clear();
+      update_chain_stats();
+      publish_pending_events();
       return r;
       //never relay alternative blocks
     }
 
     m_db.begin_transaction();
     bool res = handle_block_to_main_chain(bl, id, bvc);
+    committing_block_tx = true;
     m_db.commit_transaction();
+    committing_block_tx = false;
+    if (bvc.m_added_to_main_chain)
+      commit_batch_import_if_needed();
+    if (!m_batch_tx_depth)
+      m_pool_txs_moved.clear();
+    update_chain_stats();
+    publish_pending_events();
     return res;
   }
   catch (const std::exception& ex)
   {
     bvc.m_verifivation_failed = true;
     bvc.m_added_to_main_chain = false;
-    m_db.abort_transaction();
+    on_add_block_failed(tx_depth, committing_block_tx, events_count);
     LOG_ERROR("UNKNOWN EXCEPTION WHILE ADDINIG NEW BLOCK: " << ex.what());
     return false;
   }
@@ -2753,8 +3171,424 @@ bool blockchain_storage::add_new_block(const block& bl_, block_verification_cont
   {
     bvc.m_verifivation_failed = true;
     bvc.m_added_to_main_chain = false;
-    m_db.abort_transaction();
+    on_add_block_failed(tx_depth, committing_block_tx, events_count);
     LOG_ERROR("UNKNOWN EXCEPTION WHILE ADDINIG NEW BLOCK.");
     return false;
   }
 }
+//------------------------------------------------------------------
+void blockchain_storage::on_add_block_failed(size_t tx_depth, bool block_tx_commit_failed, size_t events_count)
+{
+  CRITICAL_REGION_LOCAL(m_tx_pool);
+  CRITICAL_REGION_LOCAL1(m_blockchain_lock);
+  abort_db_transactions(tx_depth);
+  if (m_batch_tx_depth && block_tx_commit_failed)
+  {
+    //failed commit of a nested transaction leaves the outer batch transaction unusable
+    abort_db_transactions(m_batch_tx_depth - 1);
+    on_batch_import_transaction_lost();
+  }
+  restore_pool_txs();
+  if (!m_batch_tx_depth)
+    m_pool_txs_moved.clear();
+  ++m_main_chain_rollbacks;
+  //events of earlier blocks of the batch are kept for the batch commit
+  drop_pending_events(m_batch_tx_depth ? events_count : 0);
+  rebuild_chain_stats();
+}
+//------------------------------------------------------------------
+size_t blockchain_storage::get_db_transactions_depth()
+{
+  std::shared_ptr<db::lmdb_adapter> lmdb = get_lmdb_adapter();
+  return lmdb ? lmdb->get_transactions_depth() : 0;
+}
+//------------------------------------------------------------------
+void blockchain_storage::abort_db_transactions(size_t depth)
+{
+  //aborts transactions opened by this thread above given depth
+  while (get_db_transactions_depth() > depth)
+    m_db.abort_transaction();
+}
+//------------------------------------------------------------------
+void blockchain_storage::track_pool_tx(const crypto::hash& tx_id, const transaction& tx)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  m_pool_txs_moved.insert(std::make_pair(tx_id, tx));
+}
+//------------------------------------------------------------------
+bool blockchain_storage::insert_tracked_block(blocks_ext_by_hash& blocks, const crypto::hash& id, const block_extended_info& bei, blocks_ext_by_hash::iterator* p_it)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  auto i_res = blocks.insert(blocks_ext_by_hash::value_type(id, bei));
+  if (p_it)
+    *p_it = i_res.first;
+  if (!i_res.second)
+    return false;
+  if (m_batch_tx_depth)
+    m_batch_blocks_changes.push_back(batch_blocks_change{ &blocks, true, id, block_extended_info() });
+  return true;
+}
+//------------------------------------------------------------------
+void blockchain_storage::erase_tracked_block(blocks_ext_by_hash& blocks, blocks_ext_by_hash::iterator it)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  if (m_batch_tx_depth)
+    m_batch_blocks_changes.push_back(batch_blocks_change{ &blocks, false, it->first, it->second });
+  blocks.erase(it);
+}
+//------------------------------------------------------------------
+void blockchain_storage::undo_batch_blocks_changes()
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  for (auto it = m_batch_blocks_changes.rbegin(); it != m_batch_blocks_changes.rend(); ++it)
+  {
+    if (it->inserted)
+      it->p_blocks->erase(it->id);
+    else
+      it->p_blocks->insert(blocks_ext_by_hash::value_type(it->id, it->bei));
+  }
+  m_batch_blocks_changes.clear();
+}
+//------------------------------------------------------------------
+void blockchain_storage::restore_pool_txs()
+{
+  CRITICAL_REGION_LOCAL(m_tx_pool);
+  CRITICAL_REGION_LOCAL1(m_blockchain_lock);
+  //after a rollback every moved transaction should be either in blockchain or in the pool, as db says
+  for (const auto& t : m_pool_txs_moved)
+  {
+    bool in_blockchain = have_tx(t.first);
+    bool in_pool = m_tx_pool.have_tx(t.first);
+    if (in_blockchain && in_pool)
+    {
+      transaction tx;
+      size_t blob_size = 0;
+      uint64_t fee = 0;
+      m_tx_pool.take_tx(t.first, tx, blob_size, fee);
+    }
+    else if (!in_blockchain && !in_pool)
+    {
+      tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+      if (!m_tx_pool.add_tx(t.second, t.first, tvc, true))
+        LOG_ERROR("Failed to return transaction " << t.first << " to the pool");
+    }
+  }
+}
+//------------------------------------------------------------------
+void blockchain_storage::set_batch_import_policy(uint64_t commit_every_blocks, uint64_t commit_every_seconds)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  m_batch_commit_every_blocks = commit_every_blocks;
+  m_batch_commit_every_seconds = commit_every_seconds;
+  LOG_PRINT_L1("Batch import policy: commit every " << m_batch_commit_every_blocks << " blocks or " << m_batch_commit_every_seconds << " seconds");
+}
+//------------------------------------------------------------------
+bool blockchain_storage::is_batch_import_active()
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  return m_batch_import_active;
+}
+//------------------------------------------------------------------
+uint64_t blockchain_storage::get_batch_import_lock_time_ms()
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  return m_batch_import_active ? misc_utils::get_tick_count() - m_batch_locked_at : 0;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::begin_batch_import()
+{
+  //same lock order as in add_new_block(), both locks are held by the calling thread until end_batch_import()
+  m_tx_pool.lock();
+  m_blockchain_lock.lock();
+  std::shared_ptr<db::lmdb_adapter> lmdb = get_lmdb_adapter();
+  if (lmdb && !lmdb->is_nested_transactions_supported())
+  {
+    m_blockchain_lock.unlock();
+    m_tx_pool.unlock();
+    LOG_PRINT_L1("begin_batch_import: db doesn't support nested transactions (writemap mode), batch import disabled");
+    return false;
+  }
+  if (m_batch_import_active)
+  {
+    m_blockchain_lock.unlock();
+    m_tx_pool.unlock();
+    LOG_ERROR("begin_batch_import: batch import is already active");
+    return false;
+  }
+
+  if (!begin_batch_import_transaction())
+  {
+    m_blockchain_lock.unlock();
+    m_tx_pool.unlock();
+    return false;
+  }
+  m_batch_import_active = true;
+  m_batch_locked_at = misc_utils::get_tick_count();
+  if (!is_fast_sync_mode())
+  {
+    //in fast sync mode counters are kept between batches as they define durability checkpoints
+    m_batch_blocks_since_commit = 0;
+    m_batch_last_commit_time = time(nullptr);
+  }
+  return true;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::end_batch_import()
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  CHECK_AND_ASSERT_MES(m_batch_import_active, false, "end_batch_import: batch import is not active");
+
+  //batch transaction could be lost in the middle of import, then remaining blocks have been committed one by one
+  bool r = true;
+  if (m_batch_tx_depth)
+    r = commit_batch_import_transaction(false);
+  m_batch_import_active = false;
+  //release locks taken in begin_batch_import()
+  m_blockchain_lock.unlock();
+  m_tx_pool.unlock();
+  return r;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::commit_batch_import_if_needed()
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  if (!m_batch_tx_depth)
+    return true;
+
+  ++m_batch_blocks_since_commit;
+  bool blocks_limit_reached = m_batch_commit_every_blocks && m_batch_blocks_since_commit >= m_batch_commit_every_blocks;
+  bool time_limit_reached = m_batch_commit_every_seconds && time(nullptr) - m_batch_last_commit_time >= m_batch_commit_every_seconds;
+  if (!blocks_limit_reached && !time_limit_reached)
+    return true;
+
+  uint64_t blocks_count = m_batch_blocks_since_commit;
+  m_batch_blocks_since_commit = 0;
+  m_batch_last_commit_time = time(nullptr);
+  bool r = commit_batch_import_transaction(true);
+  std::shared_ptr<db::lmdb_adapter> lmdb = get_lmdb_adapter();
+  if (r && lmdb && lmdb->is_fast_sync_mode())
+  {
+    //durability checkpoint
+    r = lmdb->sync();
+    LOG_PRINT_L1("Batch import: fast sync checkpoint, " << blocks_count << " blocks flushed to disk, height " << get_current_blockchain_height());
+  }
+  return r;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::begin_batch_import_transaction()
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  if (!m_db.begin_transaction())
+  {
+    LOG_ERROR("Batch import: failed to begin db transaction");
+    return false;
+  }
+  m_batch_tx_depth = get_db_transactions_depth();
+  m_batch_blocks_changes.clear();
+  return true;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::commit_batch_import_transaction(bool reopen)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  CHECK_AND_ASSERT_MES(m_batch_tx_depth, false, "Batch import: db transaction is not open");
+  bool r = true;
+  try
+  {
+    abort_db_transactions(m_batch_tx_depth);
+    m_db.commit_transaction();
+    LOG_PRINT_L1("Batch import: committed, height " << get_current_blockchain_height());
+  }
+  catch (const std::exception& ex)
+  {
+    LOG_ERROR("Batch import: failed to commit: " << ex.what());
+    r = false;
+  }
+
+  if (!r)
+  {
+    //uncommitted blocks are lost, remaining blocks of the import are added without batching
+    on_batch_import_transaction_lost();
+    return false;
+  }
+
+  m_batch_tx_depth = 0;
+  m_batch_blocks_changes.clear();
+  m_pool_txs_moved.clear();
+  publish_pending_events();
+  if (reopen)
+    return begin_batch_import_transaction();
+  return true;
+}
+//------------------------------------------------------------------
+void blockchain_storage::on_batch_import_transaction_lost()
+{
+  CRITICAL_REGION_LOCAL(m_tx_pool);
+  CRITICAL_REGION_LOCAL1(m_blockchain_lock);
+  //db is back at the last committed block, in-memory state should follow it
+  m_batch_tx_depth = 0;
+  m_scratchpad_wr.reload_cache_from_db();
+  m_is_in_checkpoint_zone = m_checkpoints.is_in_checkpoint_zone(get_current_blockchain_height());
+  undo_batch_blocks_changes();
+  restore_pool_txs();
+  m_pool_txs_moved.clear();
+  ++m_main_chain_rollbacks;
+  drop_pending_events();
+  rebuild_chain_stats();
+  LOG_PRINT_RED_L0("Batch import: rolled back to height " << get_current_blockchain_height());
+}
+//------------------------------------------------------------------
+std::shared_ptr<db::lmdb_adapter> blockchain_storage::get_lmdb_adapter()
+{
+  return std::dynamic_pointer_cast<db::lmdb_adapter>(m_db.get_adapter());
+}
+//------------------------------------------------------------------
+bool blockchain_storage::set_db_options(const db::lmdb_adapter_options& options)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  std::shared_ptr<db::lmdb_adapter> lmdb = get_lmdb_adapter();
+  CHECK_AND_ASSERT_MES(lmdb, false, "set_db_options: db adapter is not lmdb");
+  lmdb->set_options(options);
+  return true;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::set_fast_sync_mode(bool enabled)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  std::shared_ptr<db::lmdb_adapter> lmdb = get_lmdb_adapter();
+  CHECK_AND_ASSERT_MES(lmdb, false, "set_fast_sync_mode: db adapter is not lmdb");
+  return lmdb->set_fast_sync_mode(enabled);
+}
+//------------------------------------------------------------------
+bool blockchain_storage::is_fast_sync_mode()
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  std::shared_ptr<db::lmdb_adapter> lmdb = get_lmdb_adapter();
+  return lmdb && lmdb->is_fast_sync_mode();
+}
+//------------------------------------------------------------------
+void blockchain_storage::set_verification_threads(size_t threads_count)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  m_verification_threads = threads_count ? threads_count : 1;
+  LOG_PRINT_L1("Verification threads: " << m_verification_threads);
+}
+//------------------------------------------------------------------
+size_t blockchain_storage::get_verification_threads()
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  return m_verification_threads;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::precalculate_blocks_pow(const std::vector<block>& blocks)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  m_precalculated_pow.clear();
+  if (m_verification_threads < 2)
+    return true; //nothing to win, proofs of work are checked when blocks are handled
+
+  TIME_MEASURE_START(precalculate_time);
+
+  //scratchpad states for every block are built sequentially (that's cheap), then longhashes are calculated in parallel
+  uint64_t start_height = m_db_blocks.size();
+  scratchpad_versions scratchpad(m_scratchpad_wr.get_scratchpad());
+  std::vector<crypto::hash> ids;
+  crypto::hash prev_id = get_top_block_id();
+  for (const block& b : blocks)
+  {
+    if (b.prev_id != prev_id)
+      break; //the rest doesn't continue main chain
+    ids.push_back(get_block_hash(b));
+    prev_id = ids.back();
+    if (ids.size() == blocks.size())
+      break; //scratchpad state after the last block is not needed
+    scratchpad.begin_next_version();
+    if (!push_block_scratchpad_data(b, scratchpad))
+      break;
+  }
+
+  std::vector<crypto::hash> pows(ids.size(), null_hash);
+  tools::parallel_for(ids.size(), m_verification_threads, [&](size_t i)
+  {
+    uint64_t scratchpad_size = scratchpad.size(i);
+    if (!scratchpad_size)
+      return;
+    pows[i] = get_block_longhash(blocks[i], start_height + i, [&](uint64_t index) -> crypto::hash
+    {
+      return scratchpad.get(index % scratchpad_size, i);
+    });
+  });
+
+  for (size_t i = 0; i != ids.size(); ++i)
+  {
+    if (pows[i] == null_hash)
+      continue;
+    precalculated_pow_entry& e = m_precalculated_pow[ids[i]];
+    e.height = start_height + i;
+    e.pow = pows[i];
+  }
+  TIME_MEASURE_FINISH(precalculate_time);
+  LOG_PRINT_L1("Proofs of work precalculated for " << m_precalculated_pow.size() << " of " << blocks.size() << " blocks, height " << start_height
+    << ", " << m_verification_threads << " threads, " << print_mcsec(precalculate_time) << "ms");
+  return true;
+}
+//------------------------------------------------------------------
+bool blockchain_storage::precheck_ring_signatures(const block& bl, std::unordered_set<crypto::hash>& checked_txs)
+{
+  CRITICAL_REGION_LOCAL(m_blockchain_lock);
+  //output keys are collected here sequentially, signatures are checked in parallel;
+  //transactions that can't be prechecked (e.g. spending outputs of the same block) are left for sequential check
+  struct ring_signature_job
+  {
+    size_t tx_index;
+    const txin_to_key* pin;
+    const std::vector<crypto::signature>* psig;
+    std::vector<crypto::public_key> output_keys;
+  };
+
+  std::vector<transaction> txs(bl.tx_hashes.size());
+  std::vector<crypto::hash> prefix_hashes(bl.tx_hashes.size());
+  std::vector<ring_signature_job> jobs;
+  for (size_t tx_index = 0; tx_index != bl.tx_hashes.size(); ++tx_index)
+  {
+    transaction& tx = txs[tx_index];
+    if (!m_tx_pool.get_transaction(bl.tx_hashes[tx_index], tx) || tx.signatures.size() != tx.vin.size())
+      continue;
+    prefix_hashes[tx_index] = get_transaction_prefix_hash(tx);
+
+    size_t jobs_count_before = jobs.size();
+    for (size_t i = 0; i != tx.vin.size(); ++i)
+    {
+      if (tx.vin[i].type() != typeid(txin_to_key))
+        break;
+      ring_signature_job job = AUTO_VAL_INIT(job);
+      job.tx_index = tx_index;
+      job.pin = &boost::get<txin_to_key>(tx.vin[i]);
+      job.psig = &tx.signatures[i];
+      if (!get_output_keys_for_input(*job.pin, job.output_keys, NULL) || job.output_keys.size() != job.psig->size())
+        break;
+      jobs.push_back(job);
+    }
+    if (jobs.size() - jobs_count_before != tx.vin.size())
+      jobs.resize(jobs_count_before);
+  }
+  if (jobs.size() < 2)
+    return true;
+
+  std::vector<uint8_t> results(jobs.size(), 0);
+  tools::parallel_for(jobs.size(), m_verification_threads, [&](size_t i)
+  {
+    const ring_signature_job& job = jobs[i];
+    results[i] = crypto::check_ring_signature(prefix_hashes[job.tx_index], job.pin->k_image, job.output_keys, job.psig->data()) ? 1 : 0;
+  });
+
+  std::vector<uint8_t> tx_results(txs.size(), 1);
+  for (size_t i = 0; i != jobs.size(); ++i)
+    tx_results[jobs[i].tx_index] &= results[i];
+  for (size_t i = 0; i != jobs.size(); ++i)
+  {
+    if (tx_results[jobs[i].tx_index])
+      checked_txs.insert(bl.tx_hashes[jobs[i].tx_index]);
+  }
+  return true;
+}
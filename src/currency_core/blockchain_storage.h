@@ -10,6 +10,7 @@
 
 #include <boost/foreach.hpp>
 #include <atomic>
+#include <deque>
 
 
 #include "serialization/serialization.h"
@@ -18,9 +19,11 @@
 
 
 #include "tx_pool.h"
+#include "core_event_journal.h"
 #include "currency_basic.h"
 #include "common/util.h"
 #include "common/db_bridge.h"
+#include "common/db_lmdb_adapter.h"
 #include "currency_protocol/currency_protocol_defs.h"
 #include "rpc/core_rpc_server_commands_defs.h"
 #include "difficulty.h"
@@ -55,12 +58,17 @@ namespace currency
       std::vector<bool> m_spent_flags;
       uint32_t version;
 
-      DEFINE_SERIALIZATION_VERSION(1)
+      DEFINE_SERIALIZATION_VERSION(2)
 
       BEGIN_SERIALIZE_OBJECT()
         VERSION_ENTRY(version)
         FIELD(version)
-        FIELDS(tx)
+        if (version < 2)
+        {
+          FIELDS(tx)
+        }
+        else if (!do_serialize_as_blob(ar, tx)) //since version 2 tx is kept as blob, it is given to peers right from the record (get_transaction_blob())
+          return false;
         FIELD(m_keeper_block_height)
         FIELD(m_global_output_indexes)
         FIELD(m_spent_flags)
@@ -79,10 +87,15 @@ namespace currency
 
       uint32_t version;
 
-      DEFINE_SERIALIZATION_VERSION(1)
+      DEFINE_SERIALIZATION_VERSION(2)
       BEGIN_SERIALIZE_OBJECT()
         VERSION_ENTRY(version)
-        FIELDS(bl)
+        if (version < 2)
+        {
+          FIELDS(bl)
+        }
+        else if (!do_serialize_as_blob(ar, bl)) //see transaction_chain_entry::tx, get_block_blob()
+          return false;
         FIELD(height)
         FIELD(block_cumulative_size)
         FIELD(cumulative_difficulty)
@@ -94,6 +107,35 @@ namespace currency
 
     typedef db::key_to_array_accessor_base<uint64_t, std::pair<crypto::hash, uint64_t>, false>  outputs_container;
 
+    //what mixin selection needs to know about an output, kept with the same indexes as outputs_container
+#pragma pack(push, 1)
+    struct output_meta_entry
+    {
+      crypto::public_key out_key;
+      uint64_t keeper_block_height;
+      uint64_t unlock_time;
+      uint8_t mix_attr;
+      uint8_t spent;
+    };
+#pragma pack(pop)
+    typedef db::key_to_array_accessor_base<uint64_t, output_meta_entry, false>  outputs_meta_container;
+
+    //chain statistics for getinfo, updated on block push/pop instead of being calculated on each request
+    struct chain_stats
+    {
+      uint64_t height;
+      wide_difficulty_type next_difficulty;
+      uint64_t total_transactions;
+      uint64_t alt_blocks_count;
+      uint64_t current_comulative_blocksize_limit;
+      uint64_t hashrate_50;
+      uint64_t hashrate_350;
+      uint64_t scratchpad_size;
+      uint64_t aliases_count;
+      uint64_t daily_tx_count;
+      uint64_t daily_tx_volume;
+    };
+
     blockchain_storage(tx_memory_pool& tx_pool);
 
     bool init() { return init(tools::get_default_data_dir()); }
@@ -111,6 +153,8 @@ namespace currency
     crypto::hash get_block_id_by_height(uint64_t height);
     bool get_block_by_hash(const crypto::hash &h, block &blk);
     bool get_block_by_height(uint64_t h, block &blk);
+    //block and its transactions blobs as they were stored, blk is filled with the decoded block
+    bool get_block_complete_entry(uint64_t h, block& blk, block_complete_entry& e);
     //void get_all_known_block_ids(std::list<crypto::hash> &main, std::list<crypto::hash> &alt, std::list<crypto::hash> &invalid);
 
     template<class archive_t>
@@ -130,6 +174,22 @@ namespace currency
     bool get_top_block(block& b);
     wide_difficulty_type get_difficulty_for_next_block();
     bool add_new_block(const block& bl_, block_verification_context& bvc);
+    //batched import: blocks added between begin/end share one db write transaction (each block is a nested one)
+    bool begin_batch_import();
+    bool end_batch_import();
+    bool is_batch_import_active();
+    uint64_t get_batch_import_lock_time_ms(); //how long locks are held by current batch
+    void set_batch_import_policy(uint64_t commit_every_blocks, uint64_t commit_every_seconds);
+    //db environment tuning, options should be set before init()
+    bool set_db_options(const db::lmdb_adapter_options& options);
+    //fast sync: db commits are not flushed to disk except on batch import checkpoints, disabling it flushes everything
+    bool set_fast_sync_mode(bool enabled);
+    bool is_fast_sync_mode();
+    //parallel verification: ring signatures of block transactions are checked on worker threads in handle_block_to_main_chain(),
+    //proofs of work for a sequence of blocks continuing the main chain could be precalculated with precalculate_blocks_pow()
+    void set_verification_threads(size_t threads_count);
+    size_t get_verification_threads();
+    bool precalculate_blocks_pow(const std::vector<block>& blocks);
     bool reset_and_set_genesis_block(const block& b);
     bool create_block_template(block& b, const account_public_address& miner_address, wide_difficulty_type& di, uint64_t& height, const blobdata& ex_nonce, bool vote_for_donation, const alias_info& ai);
     bool have_block(const crypto::hash& id);
@@ -150,8 +210,8 @@ namespace currency
     uint64_t get_aliases_count();
     uint64_t get_scratchpad_size();
     //bool store_blockchain();
-    bool check_tx_input(const txin_to_key& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height = NULL);
-    bool check_tx_inputs(const transaction& tx, const crypto::hash& tx_prefix_hash, uint64_t* pmax_used_block_height = NULL);
+    bool check_tx_input(const txin_to_key& txin, const crypto::hash& tx_prefix_hash, const std::vector<crypto::signature>& sig, uint64_t* pmax_related_block_height = NULL, bool skip_ring_signature = false);
+    bool check_tx_inputs(const transaction& tx, const crypto::hash& tx_prefix_hash, uint64_t* pmax_used_block_height = NULL, bool skip_ring_signatures = false);
     bool check_tx_inputs(const transaction& tx, uint64_t* pmax_used_block_height = NULL);
     bool check_tx_inputs(const transaction& tx, uint64_t& pmax_used_block_height, crypto::hash& max_used_block_id);
     uint64_t get_current_comulative_blocksize_limit();
@@ -170,6 +230,12 @@ namespace currency
     bool copy_scratchpad_as_blob(std::string& dst);
     bool prune_aged_alt_blocks();
     bool get_transactions_daily_stat(uint64_t& daily_cnt, uint64_t& daily_volume);
+    //doesn't take m_blockchain_lock
+    void get_chain_stats(chain_stats& cs) const;
+    //grows each time blocks leave the main chain, lets caches keyed by height know their data is stale
+    uint64_t get_main_chain_rollbacks_count() const { return m_main_chain_rollbacks; }
+    //main chain changes are published there once they are committed to db
+    void set_event_journal(core_event_journal* pevent_journal) { m_pevent_journal = pevent_journal; }
     bool check_keyimages(const std::list<crypto::key_image>& images, std::list<bool>& images_stat);//true - unspent, false - spent
     void initialize_db_solo_options_values();
     bool get_block_extended_info_by_hash(const crypto::hash &h, block_extended_info &blk) const;
@@ -254,7 +320,9 @@ namespace currency
     db::single_value<uint64_t, uint64_t, solo_options_container> m_db_current_pruned_rs_height;
     db::single_value<uint64_t, std::string, solo_options_container, true> m_db_last_worked_version;
     db::single_value<uint64_t, uint64_t, solo_options_container> m_db_storage_major_compability_version;
+    db::single_value<uint64_t, uint64_t, solo_options_container> m_db_outputs_meta_height;
     outputs_container m_db_outputs;
+    outputs_meta_container m_db_outputs_meta;
     aliases_container m_db_aliases;
     address_to_aliases_container m_db_addr_to_alias;
     
@@ -279,6 +347,52 @@ namespace currency
 
     epee::file_io_utils::native_filesystem_handle m_locker_file;
 
+    // batched import state, guarded by m_blockchain_lock
+    bool m_batch_import_active;            // between begin_batch_import() and end_batch_import(), locks are held
+    uint64_t m_batch_locked_at;            // tick count when locks were taken by begin_batch_import()
+    size_t m_batch_tx_depth;               // depth of the outer batch db transaction, 0 if it's not open
+    //alternative chains and invalid blocks changes since the last batch commit, undone in reverse order if the batch is lost
+    struct batch_blocks_change
+    {
+      blocks_ext_by_hash* p_blocks;
+      bool inserted;                       // true if id was inserted, false if erased
+      crypto::hash id;
+      block_extended_info bei;             // erased entry, empty for insertions
+    };
+    std::vector<batch_blocks_change> m_batch_blocks_changes;
+    uint64_t m_batch_blocks_since_commit;
+    uint64_t m_batch_last_commit_time;
+    uint64_t m_batch_commit_every_blocks;
+    uint64_t m_batch_commit_every_seconds;
+    //transactions moved between the pool and blocks not committed to db yet, to put them back in place if these blocks are rolled back
+    std::unordered_map<crypto::hash, transaction> m_pool_txs_moved;
+
+    // parallel verification state, guarded by m_blockchain_lock
+    struct precalculated_pow_entry
+    {
+      uint64_t height;
+      crypto::hash pow;
+    };
+    std::unordered_map<crypto::hash, precalculated_pow_entry> m_precalculated_pow;
+    size_t m_verification_threads;
+
+    // chain statistics state, guarded by m_blockchain_lock
+    std::deque<std::pair<uint64_t, uint64_t> > m_daily_tx_stat; // transactions count and inputs volume of each of last CURRENCY_BLOCK_PER_DAY blocks
+    uint64_t m_daily_tx_count;
+    uint64_t m_daily_tx_volume;
+    uint64_t m_next_difficulty_height; // blockchain size m_next_difficulty was calculated for, 0 if none
+    wide_difficulty_type m_next_difficulty;
+    std::atomic<uint64_t> m_main_chain_rollbacks;
+    // copy of statistics for readers
+    chain_stats m_chain_stats;
+    mutable critical_section m_chain_stats_lock;
+    core_event_journal* m_pevent_journal;
+    std::list<core_event> m_pending_events; // main chain changes not committed yet (of the whole batch in batched import), guarded by m_blockchain_lock
+    //amount -> count of outputs old enough to be used as mixins, valid for the height and rollbacks count below, guarded by m_blockchain_lock
+    std::unordered_map<uint64_t, size_t> m_unlocked_outs_frontier;
+    uint64_t m_unlocked_outs_frontier_height;
+    uint64_t m_unlocked_outs_frontier_rollbacks;
+
     // mutable members
     mutable critical_section m_blockchain_lock; // TODO: add here reader/writer lock
 
@@ -297,11 +411,13 @@ namespace currency
     bool validate_transaction(const block& b, uint64_t height, const transaction& tx);
     bool rollback_blockchain_switching(std::list<block>& original_chain, size_t rollback_height);
     bool add_transaction_from_block(const transaction& tx, const crypto::hash& tx_id, const crypto::hash& bl_id, uint64_t bl_height);
-    bool push_transaction_to_global_outs_index(const transaction& tx, const crypto::hash& tx_id, std::vector<uint64_t>& global_indexes);
+    bool push_transaction_to_global_outs_index(const transaction& tx, const crypto::hash& tx_id, uint64_t keeper_block_height, std::vector<uint64_t>& global_indexes);
+    void push_output_meta(uint64_t amount, const txout_to_key& otk, uint64_t unlock_time, uint64_t keeper_block_height, bool spent);
     bool pop_transaction_from_global_index(const transaction& tx, const crypto::hash& tx_id);
     bool get_last_n_blocks_sizes(std::vector<size_t>& sz, size_t count);
     bool add_out_to_get_random_outs(COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::outs_for_amount& result_outs, uint64_t amount, size_t i, uint64_t mix_count, bool use_only_forced_to_mix = false);
     bool is_tx_spendtime_unlocked(uint64_t unlock_time);
+    bool get_random_outs_for_amounts_in_transaction(const COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& req, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& res);
     bool add_block_as_invalid(const block& bl, const crypto::hash& h);
     bool add_block_as_invalid(const block_extended_info& bei, const crypto::hash& h);
     size_t find_end_of_allowed_index(uint64_t amount);
@@ -323,6 +439,34 @@ namespace currency
     bool prune_ring_signatures_if_need();
     bool prune_ring_signatures(uint64_t height, uint64_t& transactions_pruned, uint64_t& signatures_pruned);
     bool check_instance(const std::string& data_dir);
+    bool begin_batch_import_transaction();
+    bool commit_batch_import_if_needed();
+    bool commit_batch_import_transaction(bool reopen);
+    void on_batch_import_transaction_lost();
+    bool try_add_new_block(const block& bl_, block_verification_context& bvc);
+    void on_add_block_failed(size_t tx_depth, bool block_tx_commit_failed, size_t events_count);
+    size_t get_db_transactions_depth();
+    void abort_db_transactions(size_t depth);
+    void track_pool_tx(const crypto::hash& tx_id, const transaction& tx);
+    bool insert_tracked_block(blocks_ext_by_hash& blocks, const crypto::hash& id, const block_extended_info& bei, blocks_ext_by_hash::iterator* p_it = nullptr);
+    void erase_tracked_block(blocks_ext_by_hash& blocks, blocks_ext_by_hash::iterator it);
+    void undo_batch_blocks_changes();
+    void restore_pool_txs();
+    bool get_output_keys_for_input(const txin_to_key& txin, std::vector<crypto::public_key>& output_keys, uint64_t* pmax_related_block_height);
+    bool precheck_ring_signatures(const block& bl, std::unordered_set<crypto::hash>& checked_txs);
+    bool get_block_daily_tx_stat(const block& bl, uint64_t& tx_count, uint64_t& tx_volume);
+    void push_daily_tx_stat(uint64_t tx_count, uint64_t tx_volume);
+    bool pop_daily_tx_stat();
+    bool rebuild_chain_stats();
+    bool get_block_blob(uint64_t h, blobdata& blob) const;
+    bool get_transaction_blob(const crypto::hash& tx_id, blobdata& blob) const;
+    bool store_missing_outputs_meta();
+    void update_chain_stats();
+    void add_pending_event(core_event_type type, const crypto::hash& id, uint64_t height);
+    void publish_pending_events();
+    size_t get_pending_events_count();
+    void drop_pending_events(size_t keep_count = 0);
+    std::shared_ptr<db::lmdb_adapter> get_lmdb_adapter();
   };
 
   /************************************************************************/
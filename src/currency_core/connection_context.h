@@ -22,12 +22,28 @@ namespace currency
       state_normal
     };
 
+    currency_connection_context(): m_state(state_befor_handshake),
+                                   m_remote_blockchain_height(0),
+                                   m_last_response_height(0),
+                                   m_request_time(0),
+                                   m_latency(0),
+                                   m_download_speed(0),
+                                   m_avg_block_size(0),
+                                   m_objects_responses_count(0)
+    {}
+
     state m_state;
     std::list<crypto::hash> m_needed_objects;
     std::unordered_set<crypto::hash> m_requested_objects;
     uint64_t m_remote_blockchain_height;
     uint64_t m_last_response_height;
     epee::copyable_atomic m_callback_request_count; //in debug purpose: problem with double callback rise
+    //sync throughput, used for adaptive blocks request size (smoothed values, 0 - not measured yet)
+    uint64_t m_request_time;            //ms, when the last chain/objects request was sent
+    uint64_t m_latency;                 //ms, chain request round trip
+    uint64_t m_download_speed;          //bytes/s, blocks downloading
+    uint64_t m_avg_block_size;          //bytes, block with transactions
+    uint64_t m_objects_responses_count;
     //size_t m_score;  TODO: add score calculations
   };
 
@@ -0,0 +1,120 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+
+#include "crypto/hash.h"
+
+#define CORE_EVENT_JOURNAL_DEFAULT_SIZE  10000
+
+namespace currency
+{
+  enum core_event_type
+  {
+    core_event_block_added,   // block pushed to the main chain
+    core_event_block_removed, // block popped from the main chain (chain switching)
+    core_event_tx_added,      // transaction added to the pool
+    core_event_tx_removed     // transaction left the pool: included in a block, stuck or purged
+  };
+
+  struct core_event
+  {
+    uint64_t seq;
+    core_event_type type;
+    crypto::hash id;
+    uint64_t height;          // block height, 0 for transactions
+  };
+
+  /************************************************************************/
+  /* Numbered journal of main chain and pool changes for subscribers.     */
+  /* The last max_size events are kept, a subscriber which fell behind    */
+  /* them is told that events were lost and has to resync.               */
+  /* Sequence numbers start over on restart, the journal id tells one    */
+  /* journal from another.                                               */
+  /************************************************************************/
+  class core_event_journal
+  {
+  public:
+    core_event_journal(size_t max_size = CORE_EVENT_JOURNAL_DEFAULT_SIZE) : m_max_size(max_size), m_last_seq(0), m_interrupted(false),
+      m_id(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now().time_since_epoch()).count())
+    {}
+
+    //start time of the journal, never 0
+    uint64_t get_id() const
+    {
+      return m_id;
+    }
+
+    void push(core_event_type type, const crypto::hash& id, uint64_t height)
+    {
+      {
+        std::lock_guard<std::mutex> lk(m_lock);
+        core_event ev = { ++m_last_seq, type, id, height };
+        m_events.push_back(ev);
+        if (m_events.size() > m_max_size)
+          m_events.pop_front();
+      }
+      m_cond.notify_all();
+    }
+
+    uint64_t get_last_seq() const
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      return m_last_seq;
+    }
+
+    //returns false if some events after since_seq are not kept anymore, events which are kept are returned anyway
+    bool get_events(uint64_t since_seq, size_t max_count, std::list<core_event>& events, uint64_t& last_seq) const
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      return get_events_nolock(since_seq, max_count, events, last_seq);
+    }
+
+    //waits up to timeout_ms for events after since_seq, then works as get_events()
+    bool wait_events(uint64_t since_seq, uint64_t timeout_ms, size_t max_count, std::list<core_event>& events, uint64_t& last_seq)
+    {
+      std::unique_lock<std::mutex> lk(m_lock);
+      m_cond.wait_for(lk, std::chrono::milliseconds(timeout_ms), [&]() { return m_interrupted || m_last_seq != since_seq; });
+      return get_events_nolock(since_seq, max_count, events, last_seq);
+    }
+
+    //wakes up waiting subscribers and makes further waits return at once, for shutdown
+    void interrupt_waits()
+    {
+      {
+        std::lock_guard<std::mutex> lk(m_lock);
+        m_interrupted = true;
+      }
+      m_cond.notify_all();
+    }
+
+  private:
+    bool get_events_nolock(uint64_t since_seq, size_t max_count, std::list<core_event>& events, uint64_t& last_seq) const
+    {
+      last_seq = m_last_seq;
+      if (since_seq >= m_last_seq)
+        return since_seq == m_last_seq;
+      uint64_t first_kept_seq = m_events.empty() ? m_last_seq + 1 : m_events.front().seq;
+      size_t offset = since_seq + 1 >= first_kept_seq ? static_cast<size_t>(since_seq + 1 - first_kept_seq) : 0;
+      for (auto it = m_events.begin() + offset; it != m_events.end() && events.size() < max_count; ++it)
+        events.push_back(*it);
+      return since_seq + 1 >= first_kept_seq;
+    }
+
+    std::deque<core_event> m_events;
+    size_t m_max_size;
+    uint64_t m_last_seq;
+    bool m_interrupted;
+    const uint64_t m_id;
+    mutable std::mutex m_lock;
+    std::condition_variable m_cond;
+  };
+}
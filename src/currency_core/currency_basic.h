@@ -13,6 +13,7 @@
 #include "serialization/serialization.h"
 #include "serialization/variant.h"
 #include "serialization/binary_archive.h"
+#include "serialization/binary_buffer_archive.h"
 #include "serialization/json_archive.h"
 #include "serialization/debug_archive.h"
 #include "serialization/keyvalue_serialization.h" // epee key-value serialization
@@ -164,15 +165,29 @@ namespace currency
     transaction();
     virtual ~transaction();
     void set_null();
+    //should be called when prefix of a parsed transaction is modified, signatures may be changed freely
+    void invalidate_hashes();
 
     BEGIN_SERIALIZE_OBJECT()
+      if (!W)
+        invalidate_hashes();
       FIELDS(*static_cast<transaction_prefix *>(this))
       FIELD(signatures)
     END_SERIALIZE()
 
 
     static size_t get_signature_size(const txin_v& tx_in);
-    
+
+  private:
+    //not serialized: transaction hash (it's the prefix hash) and blob size, both depend on prefix only. Filled in by
+    //parse_and_validate_tx_from_blob(), reset by set_null(), deserialization and invalidate_hashes()
+    bool hash_cached;
+    crypto::hash cached_hash;
+    size_t cached_blob_size;
+
+    friend void cache_transaction_hash(transaction& tx);
+    friend bool get_transaction_hash(const transaction& t, crypto::hash& res);
+    friend size_t get_object_blobsize(const transaction& t);
   };
 
 
@@ -197,6 +212,15 @@ namespace currency
     vout.clear();
     extra.clear();
     signatures.clear();
+    invalidate_hashes();
+  }
+
+  inline
+  void transaction::invalidate_hashes()
+  {
+    hash_cached = false;
+    cached_hash = null_hash;
+    cached_blob_size = 0;
   }
 
   inline
@@ -243,11 +267,29 @@ namespace currency
     transaction miner_tx;
     std::vector<crypto::hash> tx_hashes;
 
+    //should be called when a parsed block is modified (see transaction::invalidate_hashes())
+    void invalidate_hashes()
+    {
+      hash_cached = false;
+      cached_hash = null_hash;
+      miner_tx.invalidate_hashes();
+    }
+
     BEGIN_SERIALIZE_OBJECT()
+      if (!W)
+        invalidate_hashes();
       FIELDS(*static_cast<block_header *>(this))
       FIELD(miner_tx)
       FIELD(tx_hashes)
     END_SERIALIZE()
+
+  private:
+    //not serialized: block id, filled in by parse_and_validate_block_from_blob()
+    bool hash_cached = false;
+    crypto::hash cached_hash;
+
+    friend bool get_block_hash(const block& b, crypto::hash& res);
+    friend bool parse_and_validate_block_from_blob(const std::string& b_blob, block& b);
   };
 
 
@@ -306,6 +348,16 @@ VARIANT_TAG(binary_archive, currency::txout_to_key, 0x2);
 VARIANT_TAG(binary_archive, currency::transaction, 0xcc);
 VARIANT_TAG(binary_archive, currency::block, 0xbb);
 
+VARIANT_TAG(binary_buffer_archive, currency::txin_gen, 0xff);
+VARIANT_TAG(binary_buffer_archive, currency::txin_to_script, 0x0);
+VARIANT_TAG(binary_buffer_archive, currency::txin_to_scripthash, 0x1);
+VARIANT_TAG(binary_buffer_archive, currency::txin_to_key, 0x2);
+VARIANT_TAG(binary_buffer_archive, currency::txout_to_script, 0x0);
+VARIANT_TAG(binary_buffer_archive, currency::txout_to_scripthash, 0x1);
+VARIANT_TAG(binary_buffer_archive, currency::txout_to_key, 0x2);
+VARIANT_TAG(binary_buffer_archive, currency::transaction, 0xcc);
+VARIANT_TAG(binary_buffer_archive, currency::block, 0xbb);
+
 VARIANT_TAG(json_archive, currency::txin_gen, "gen");
 VARIANT_TAG(json_archive, currency::txin_to_script, "script");
 VARIANT_TAG(json_archive, currency::txin_to_scripthash, "scripthash");
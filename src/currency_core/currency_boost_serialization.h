@@ -86,6 +86,8 @@ namespace boost
   template <class Archive>
   inline void serialize(Archive &a, currency::transaction &x, const boost::serialization::version_type ver)
   {
+    if (Archive::is_loading::value)
+      x.invalidate_hashes();
     a & x.version;
     a & x.unlock_time;
     a & x.vin;
@@ -100,6 +102,8 @@ namespace boost
     {
       throw std::runtime_error("wrong block serialization version");
     }
+    if (Archive::is_loading::value)
+      b.invalidate_hashes();
     a & b.major_version;
     a & b.minor_version;
     a & b.timestamp;
@@ -12,6 +12,7 @@ using namespace epee;
 #include "currency_core.h"
 #include "common/command_line.h"
 #include "common/util.h"
+#include "common/parallel_for.h"
 #include "warnings.h"
 #include "crypto/crypto.h"
 #include "currency_config.h"
@@ -23,15 +24,34 @@ DISABLE_VS_WARNINGS(4355)
 namespace currency
 {
 
+  namespace
+  {
+    const command_line::arg_descriptor<uint64_t>      arg_db_batch_commit_blocks =   {"db-batch-commit-blocks", "Batched block import: commit db write transaction every N blocks (0 - no limit)", BLOCKCHAIN_BATCH_COMMIT_DEFAULT_BLOCKS};
+    const command_line::arg_descriptor<uint64_t>      arg_db_batch_commit_seconds =  {"db-batch-commit-seconds", "Batched block import: commit db write transaction every T seconds (0 - no limit)", BLOCKCHAIN_BATCH_COMMIT_DEFAULT_SECONDS};
+    const command_line::arg_descriptor<uint64_t>      arg_db_map_size_mb =           {"db-map-size-mb", "LMDB initial memory map size, MB", LMDB_DEFAULT_MEMORY_MAP_SIZE / (1024 * 1024)};
+    const command_line::arg_descriptor<uint64_t>      arg_db_map_growth_mb =         {"db-map-growth-mb", "LMDB memory map growth step, MB (0 - don't grow)", LMDB_DEFAULT_MEMORY_MAP_GROWTH_STEP / (1024 * 1024)};
+    const command_line::arg_descriptor<uint32_t>      arg_db_max_dbs =               {"db-max-dbs", "LMDB max number of named tables", LMDB_DEFAULT_MAX_DBS};
+    const command_line::arg_descriptor<bool>          arg_db_nosync =                {"db-nosync", "LMDB: don't flush system buffers to disk on commit (MDB_NOSYNC, unsafe on system crash)"};
+    const command_line::arg_descriptor<bool>          arg_db_nometasync =            {"db-nometasync", "LMDB: flush system buffers but omit metadata flush on commit (MDB_NOMETASYNC)"};
+    const command_line::arg_descriptor<bool>          arg_db_writemap =              {"db-writemap", "LMDB: use writeable memory map (MDB_WRITEMAP), disables batched block import"};
+    const command_line::arg_descriptor<bool>          arg_db_mapasync =              {"db-mapasync", "LMDB: use asynchronous flushes with --db-writemap (MDB_MAPASYNC)"};
+    const command_line::arg_descriptor<bool>          arg_db_readahead =             {"db-readahead", "LMDB: enable OS readahead (disabled by default)"};
+    const command_line::arg_descriptor<uint32_t>      arg_verify_threads =           {"verify-threads", "Threads for proof of work and ring signatures verification of synchronized blocks (0 - number of CPU cores)", 0};
+    const command_line::arg_descriptor<bool>          arg_db_fast_sync =             {"db-fast-sync", "Initial sync profile: db is flushed to disk only on batch import checkpoints (see --db-batch-commit-*) until the node is synchronized"};
+  }
+
   //-----------------------------------------------------------------------------------------------
   core::core(i_currency_protocol* pprotocol):
               m_mempool(m_blockchain_storage),
               m_blockchain_storage(m_mempool),
               m_miner(this, m_blockchain_storage),
               m_miner_address(boost::value_initialized<account_public_address>()), 
-              m_starter_message_showed(false)
+              m_starter_message_showed(false),
+              m_fast_sync_requested(false)
   {
     set_currency_protocol(pprotocol);
+    m_mempool.set_event_journal(&m_event_journal);
+    m_blockchain_storage.set_event_journal(&m_event_journal);
   }
   void core::set_currency_protocol(i_currency_protocol* pprotocol)
   {
@@ -46,8 +66,20 @@ namespace currency
     m_blockchain_storage.set_checkpoints(std::move(chk_pts));
   }
   //-----------------------------------------------------------------------------------
-  void core::init_options(boost::program_options::options_description& /*desc*/)
-  {
+  void core::init_options(boost::program_options::options_description& desc)
+  {
+    command_line::add_arg(desc, arg_db_batch_commit_blocks);
+    command_line::add_arg(desc, arg_db_batch_commit_seconds);
+    command_line::add_arg(desc, arg_db_map_size_mb);
+    command_line::add_arg(desc, arg_db_map_growth_mb);
+    command_line::add_arg(desc, arg_db_max_dbs);
+    command_line::add_arg(desc, arg_db_nosync);
+    command_line::add_arg(desc, arg_db_nometasync);
+    command_line::add_arg(desc, arg_db_writemap);
+    command_line::add_arg(desc, arg_db_mapasync);
+    command_line::add_arg(desc, arg_db_readahead);
+    command_line::add_arg(desc, arg_db_fast_sync);
+    command_line::add_arg(desc, arg_verify_threads);
   }
   //-----------------------------------------------------------------------------------------------
   std::string core::get_config_folder()
@@ -65,6 +97,26 @@ namespace currency
     if (!m_config_folder.size())
         m_config_folder = command_line::get_arg(vm, command_line::arg_data_dir);
 
+    m_blockchain_storage.set_batch_import_policy(command_line::get_arg(vm, arg_db_batch_commit_blocks), command_line::get_arg(vm, arg_db_batch_commit_seconds));
+
+    db::lmdb_adapter_options db_options;
+    db_options.map_size = command_line::get_arg(vm, arg_db_map_size_mb) * 1024 * 1024;
+    db_options.map_growth_step = command_line::get_arg(vm, arg_db_map_growth_mb) * 1024 * 1024;
+    db_options.max_dbs = command_line::get_arg(vm, arg_db_max_dbs);
+    db_options.no_sync = command_line::get_arg(vm, arg_db_nosync);
+    db_options.no_meta_sync = command_line::get_arg(vm, arg_db_nometasync);
+    db_options.write_map = command_line::get_arg(vm, arg_db_writemap);
+    db_options.map_async = command_line::get_arg(vm, arg_db_mapasync);
+    db_options.no_readahead = !command_line::get_arg(vm, arg_db_readahead);
+    bool r = m_blockchain_storage.set_db_options(db_options);
+    CHECK_AND_ASSERT_MES(r, false, "Failed to set db options");
+
+    m_fast_sync_requested = command_line::get_arg(vm, arg_db_fast_sync);
+
+    size_t verification_threads = command_line::get_arg(vm, arg_verify_threads);
+    if (!verification_threads)
+      verification_threads = tools::get_default_worker_threads_count();
+    m_blockchain_storage.set_verification_threads(verification_threads);
     return true;
   }
   //-----------------------------------------------------------------------------------------------
@@ -131,6 +183,12 @@ namespace currency
     r = m_blockchain_storage.init(m_config_folder);
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize blockchain storage");
 
+    if (m_fast_sync_requested)
+    {
+      r = m_blockchain_storage.set_fast_sync_mode(true);
+      CHECK_AND_ASSERT_MES(r, false, "Failed to enable db fast sync mode");
+    }
+
     r = m_miner.init(vm);
     CHECK_AND_ASSERT_MES(r, false, "Failed to initialize blockchain storage");
 
@@ -181,6 +239,21 @@ namespace currency
       return false;
     }
     //std::cout << "!"<< tx.vin.size() << std::endl;
+    return handle_incoming_tx(tx, tx_hash, tx_prefixt_hash, tx_blob.size(), tvc, keeped_by_block);
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::handle_incoming_tx(const transaction& tx, const crypto::hash& tx_hash, const crypto::hash& tx_prefixt_hash, size_t tx_blob_size, tx_verification_context& tvc, bool keeped_by_block)
+  {
+    tvc = boost::value_initialized<tx_verification_context>();
+    //want to process all transactions sequentially
+    CRITICAL_REGION_LOCAL(m_incoming_tx_lock);
+
+    if(tx_blob_size > get_max_tx_size())
+    {
+      LOG_PRINT_L0("WRONG TRANSACTION, too big size " << tx_blob_size << ", rejected");
+      tvc.m_verifivation_failed = true;
+      return false;
+    }
 
     if(!check_tx_syntax(tx))
     {
@@ -423,6 +496,8 @@ namespace currency
   //-----------------------------------------------------------------------------------------------
   void core::on_synchronized()
   {
+    if (m_blockchain_storage.is_fast_sync_mode())
+      m_blockchain_storage.set_fast_sync_mode(false); // flushes everything to disk
     m_miner.on_synchronized();
   }
   bool core::get_backward_blocks_sizes(uint64_t from_height, std::vector<size_t>& sizes, size_t count)
@@ -453,12 +528,61 @@ namespace currency
       bvc.m_verifivation_failed = true;
       return false;
     }
+    return handle_incoming_block(b, block_blob.size(), bvc, update_miner_blocktemplate);
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::handle_incoming_block(const block& b, size_t block_blob_size, block_verification_context& bvc, bool update_miner_blocktemplate)
+  {
+    bvc = boost::value_initialized<block_verification_context>();
+    if(block_blob_size > get_max_block_size())
+    {
+      LOG_PRINT_L0("WRONG BLOCK, too big size " << block_blob_size << ", rejected");
+      bvc.m_verifivation_failed = true;
+      return false;
+    }
+
     add_new_block(b, bvc);
     if(update_miner_blocktemplate && bvc.m_added_to_main_chain)
        update_miner_block_template();
     return true;
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::begin_batch_import()
+  {
+    //lock order should be the same as in handle_incoming_tx(): incoming tx lock, then tx pool and blockchain
+    m_incoming_tx_lock.lock();
+    if (!m_blockchain_storage.begin_batch_import())
+    {
+      m_incoming_tx_lock.unlock();
+      return false;
+    }
+    return true;
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::end_batch_import()
+  {
+    CRITICAL_REGION_LOCAL(m_incoming_tx_lock);
+    CHECK_AND_ASSERT_MES(m_blockchain_storage.is_batch_import_active(), false, "end_batch_import: batch import is not active");
+    bool r = m_blockchain_storage.end_batch_import();
+    m_incoming_tx_lock.unlock();
+    return r;
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::yield_batch_import()
+  {
+    if (m_blockchain_storage.get_batch_import_lock_time_ms() < BLOCKCHAIN_BATCH_MAX_LOCK_MILLISECONDS)
+      return true;
+    end_batch_import();
+    //waiting threads should have a chance to take the locks before they are taken again
+    misc_utils::sleep_no_w(1);
+    return begin_batch_import();
+  }
+  //-----------------------------------------------------------------------------------------------
+  bool core::precalculate_blocks_pow(const std::vector<block>& blocks)
+  {
+    return m_blockchain_storage.precalculate_blocks_pow(blocks);
+  }
+  //-----------------------------------------------------------------------------------------------
   crypto::hash core::get_tail_id()
   {
     return m_blockchain_storage.get_top_block_id();
@@ -489,6 +613,11 @@ namespace currency
     return m_mempool.get_transactions(txs);
   }
   //-----------------------------------------------------------------------------------------------
+  bool core::get_pool_changes(uint64_t since_version, std::list<transaction>& added, std::list<crypto::hash>& removed, uint64_t& version)
+  {
+    return m_mempool.get_changes(since_version, added, removed, version);
+  }
+  //-----------------------------------------------------------------------------------------------
   bool core::get_short_chain_history(std::list<crypto::hash>& ids)
   {
     return m_blockchain_storage.get_short_chain_history(ids);
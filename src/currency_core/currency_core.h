@@ -35,8 +35,19 @@ namespace currency
      bool on_idle();
      bool handle_incoming_tx(const blobdata& tx_blob, tx_verification_context& tvc, bool keeped_by_block);
      bool handle_incoming_block(const blobdata& block_blob, block_verification_context& bvc, bool update_miner_blocktemplate = true);
+     //already parsed objects (bulk import), blob sizes are needed for the same size checks
+     bool handle_incoming_tx(const transaction& tx, const crypto::hash& tx_hash, const crypto::hash& tx_prefix_hash, size_t tx_blob_size, tx_verification_context& tvc, bool keeped_by_block);
+     bool handle_incoming_block(const block& b, size_t block_blob_size, block_verification_context& bvc, bool update_miner_blocktemplate = true);
+     //blocks handled between these calls (by the same thread) are committed to db in batches, see blockchain_storage::begin_batch_import()
+     bool begin_batch_import();
+     bool end_batch_import();
+     //ends the batch and starts a new one if locks have been held for too long, to let other threads in; returns false if new batch wasn't started
+     bool yield_batch_import();
+     //verifies proofs of work of blocks continuing main chain in parallel, results are used when these blocks are handled
+     bool precalculate_blocks_pow(const std::vector<block>& blocks);
      i_currency_protocol* get_protocol(){return m_pprotocol;}
      tx_memory_pool& get_tx_pool(){ return m_mempool; };
+     core_event_journal& get_event_journal(){ return m_event_journal; }
 
      //-------------------- i_miner_handler -----------------------
      virtual bool handle_block_found( block& b);
@@ -72,6 +83,7 @@ namespace currency
      void set_checkpoints(checkpoints&& chk_pts);
 
      bool get_pool_transactions(std::list<transaction>& txs);
+     bool get_pool_changes(uint64_t since_version, std::list<transaction>& added, std::list<crypto::hash>& removed, uint64_t& version);
      size_t get_pool_transactions_count();
      size_t get_blockchain_total_transactions();
      bool get_outs(uint64_t amount, std::list<crypto::public_key>& pkeys);
@@ -117,6 +129,7 @@ namespace currency
      bool check_tx_inputs_keyimages_diff(const transaction& tx);
 
 
+     core_event_journal m_event_journal;
      tx_memory_pool m_mempool;
      blockchain_storage m_blockchain_storage;
      i_currency_protocol* m_pprotocol;
@@ -130,6 +143,7 @@ namespace currency
      math_helper::once_a_time_seconds<60*60*12, false> m_prune_alt_blocks_interval;
      friend class tx_validate_inputs;
      std::atomic<bool> m_starter_message_showed;
+     bool m_fast_sync_requested;
    };
 }
 
@@ -18,10 +18,9 @@ namespace currency
   //---------------------------------------------------------------
   void get_transaction_prefix_hash(const transaction_prefix& tx, crypto::hash& h)
   {
-    std::ostringstream s;
-    binary_archive<true> a(s);
-    ::serialization::serialize(a, const_cast<transaction_prefix&>(tx));
-    crypto::cn_fast_hash(s.str().data(), s.str().size(), h);
+    blobdata blob;
+    t_serializable_object_to_blob(tx, blob);
+    crypto::cn_fast_hash(blob.data(), blob.size(), h);
   }
   //---------------------------------------------------------------
   crypto::hash get_transaction_prefix_hash(const transaction_prefix& tx)
@@ -31,9 +30,22 @@ namespace currency
     return h;
   }
   //---------------------------------------------------------------
+  void get_transaction_prefix_hash(const transaction& tx, crypto::hash& h)
+  {
+    //transaction hash is the prefix hash
+    get_transaction_hash(tx, h);
+  }
+  //---------------------------------------------------------------
+  crypto::hash get_transaction_prefix_hash(const transaction& tx)
+  {
+    return get_transaction_hash(tx);
+  }
+  //---------------------------------------------------------------
   bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, transaction& tx)
   {
-    return t_unserializable_object_from_blob(tx, tx_blob);
+    crypto::hash tx_hash = null_hash;
+    crypto::hash tx_prefix_hash = null_hash;
+    return parse_and_validate_tx_from_blob(tx_blob, tx, tx_hash, tx_prefix_hash);
   }
   //---------------------------------------------------------------
   bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash)
@@ -44,11 +56,21 @@ namespace currency
     //TODO: validate tx
 
     //crypto::cn_fast_hash(tx_blob.data(), tx_blob.size(), tx_hash);
-    get_transaction_prefix_hash(tx, tx_prefix_hash);
+    cache_transaction_hash(tx);
+    get_transaction_hash(tx, tx_prefix_hash);
     tx_hash = tx_prefix_hash;
     return true;
   }
   //---------------------------------------------------------------
+  void cache_transaction_hash(transaction& tx)
+  {
+    tx.invalidate_hashes();
+    size_t prefix_blob_size = 0;
+    get_object_hash(static_cast<const transaction_prefix&>(tx), tx.cached_hash, prefix_blob_size);
+    tx.cached_blob_size = get_object_blobsize(tx, prefix_blob_size);
+    tx.hash_cached = true;
+  }
+  //---------------------------------------------------------------
   bool get_donation_accounts(account_keys &donation_acc, account_keys &royalty_acc)
   {
     bool r = get_account_address_from_str(donation_acc.m_account_address, CURRENCY_DONATIONS_ADDRESS);
@@ -103,6 +125,7 @@ namespace currency
                                                              size_t amount_to_donate, 
                                                              const alias_info& alias)
   {
+    tx.invalidate_hashes();
     tx.vin.clear();
     tx.vout.clear();
     tx.extra.clear();
@@ -508,6 +531,7 @@ namespace currency
                                                              uint64_t unlock_time,
                                                              uint8_t tx_outs_attr)
   {
+    tx.invalidate_hashes();
     tx.vin.clear();
     tx.vout.clear();
     tx.signatures.clear();
@@ -718,6 +742,11 @@ namespace currency
   {
     crypto::key_derivation derivation;
     generate_key_derivation(tx_pub_key, acc.m_view_secret_key, derivation);
+    return is_out_to_acc(acc, out_key, derivation, output_index);
+  }
+  //---------------------------------------------------------------
+  bool is_out_to_acc(const account_keys& acc, const txout_to_key& out_key, const crypto::key_derivation& derivation, size_t output_index)
+  {
     crypto::public_key pk;
     derive_public_key(derivation, output_index, acc.m_account_address.m_spend_public_key, pk);
     return pk == out_key.key;
@@ -734,11 +763,14 @@ namespace currency
   bool lookup_acc_outs(const account_keys& acc, const transaction& tx, const crypto::public_key& tx_pub_key, std::vector<size_t>& outs, uint64_t& money_transfered)
   {
     money_transfered = 0;
+    // derivation is the same for all outputs of the transaction
+    crypto::key_derivation derivation = AUTO_VAL_INIT(derivation);
+    generate_key_derivation(tx_pub_key, acc.m_view_secret_key, derivation);
     size_t i = 0;
     BOOST_FOREACH(const tx_out& o,  tx.vout)
     {
       CHECK_AND_ASSERT_MES(o.target.type() ==  typeid(txout_to_key), false, "wrong type id in transaction out" );
-      if(is_out_to_acc(acc, boost::get<txout_to_key>(o.target), tx_pub_key, i))
+      if(is_out_to_acc(acc, boost::get<txout_to_key>(o.target), derivation, i))
       {
         outs.push_back(i);
         money_transfered += o.amount;
@@ -817,13 +849,17 @@ namespace currency
   crypto::hash get_transaction_hash(const transaction& t)
   {
     crypto::hash h = null_hash;
-    size_t blob_size = 0;
-    get_object_hash(static_cast<const transaction_prefix&>(t), h, blob_size);
+    get_transaction_hash(t, h);
     return h;
   }
   //---------------------------------------------------------------
   bool get_transaction_hash(const transaction& t, crypto::hash& res)
   {
+    if (t.hash_cached)
+    {
+      res = t.cached_hash;
+      return true;
+    }
     size_t blob_size = 0;
     return get_object_hash(static_cast<const transaction_prefix&>(t), res, blob_size);
   }
@@ -982,6 +1018,11 @@ namespace currency
   //---------------------------------------------------------------
   bool get_block_hash(const block& b, crypto::hash& res)
   {
+    if (b.hash_cached)
+    {
+      res = b.cached_hash;
+      return true;
+    }
     return get_object_hash(get_block_hashing_blob(b), res);
   }
   //---------------------------------------------------------------
@@ -1060,17 +1101,27 @@ namespace currency
   //---------------------------------------------------------------
   bool parse_and_validate_block_from_blob(const blobdata& b_blob, block& b)
   {
-    std::stringstream ss;
-    ss << b_blob;
-    binary_archive<false> ba(ss);
+    binary_buffer_istream bs(b_blob.data(), b_blob.size());
+    binary_buffer_archive<false> ba(bs);
     bool r = ::serialization::serialize(ba, b);
     CHECK_AND_ASSERT_MES(r, false, "Failed to parse block from blob");
+
+    cache_transaction_hash(b.miner_tx);
+    get_block_hash(b, b.cached_hash);
+    b.hash_cached = true;
     return true;
   }
   //---------------------------------------------------------------
   size_t get_object_blobsize(const transaction& t)
   {
-    size_t prefix_blob = get_object_blobsize(static_cast<const transaction_prefix&>(t));
+    if (t.hash_cached)
+      return t.cached_blob_size;
+    return get_object_blobsize(t, get_object_blobsize(static_cast<const transaction_prefix&>(t)));
+  }
+  //---------------------------------------------------------------
+  size_t get_object_blobsize(const transaction& t, size_t prefix_blob_size)
+  {
+    size_t prefix_blob = prefix_blob_size;
 
     if(is_coinbase(t))    
       return prefix_blob;    
@@ -131,8 +131,13 @@ namespace currency
   //---------------------------------------------------------------
   void get_transaction_prefix_hash(const transaction_prefix& tx, crypto::hash& h);
   crypto::hash get_transaction_prefix_hash(const transaction_prefix& tx);
+  //these use hash cached in transaction, if any
+  void get_transaction_prefix_hash(const transaction& tx, crypto::hash& h);
+  crypto::hash get_transaction_prefix_hash(const transaction& tx);
   bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, transaction& tx, crypto::hash& tx_hash, crypto::hash& tx_prefix_hash);
   bool parse_and_validate_tx_from_blob(const blobdata& tx_blob, transaction& tx);  
+  //fill in hash cache of a transaction (parse_and_validate_*_from_blob() do it on their own)
+  void cache_transaction_hash(transaction& tx);
   bool get_donation_accounts(account_keys &donation_acc, account_keys &royalty_acc);
   bool construct_miner_tx(size_t height, size_t median_size, uint64_t already_generated_coins,
                                                              size_t current_block_size, 
@@ -170,6 +175,7 @@ namespace currency
   bool add_tx_pub_key_to_extra(transaction& tx, const crypto::public_key& tx_pub_key);
   bool add_tx_extra_nonce(transaction& tx, const blobdata& extra_nonce);
   bool is_out_to_acc(const account_keys& acc, const txout_to_key& out_key, const crypto::public_key& tx_pub_key, size_t output_index);
+  bool is_out_to_acc(const account_keys& acc, const txout_to_key& out_key, const crypto::key_derivation& derivation, size_t output_index);
   bool lookup_acc_outs(const account_keys& acc, const transaction& tx, const crypto::public_key& tx_pub_key, std::vector<size_t>& outs, uint64_t& money_transfered);
   bool lookup_acc_outs(const account_keys& acc, const transaction& tx, std::vector<size_t>& outs, uint64_t& money_transfered);
   bool get_tx_fee(const transaction& tx, uint64_t & fee);
@@ -295,19 +301,18 @@ namespace currency
   template<class t_object>
   bool t_serializable_object_to_blob(const t_object& to, blobdata& b_blob)
   {
-    std::stringstream ss;
-    binary_archive<true> ba(ss);
+    b_blob.clear();
+    binary_buffer_ostream bs(b_blob);
+    binary_buffer_archive<true> ba(bs);
     bool r = ::serialization::serialize(ba, const_cast<t_object&>(to));
-    b_blob = ss.str();
     return r;
   }
   //---------------------------------------------------------------
   template<class t_object>
-  bool t_unserializable_object_from_blob(t_object& to, const blobdata& b_blob)
+  bool t_unserializable_object_from_blob(t_object& to, const char* p_blob, size_t blob_size)
   {
-    std::stringstream ss;
-    ss << b_blob;
-    binary_archive<false> ba(ss);
+    binary_buffer_istream bs(p_blob, blob_size);
+    binary_buffer_archive<false> ba(bs);
     bool r = ::serialization::serialize(ba, to);
     CHECK_AND_ASSERT_MES(r, false, "Failed to unserialize object from blob: " << typeid(to).name());
 
@@ -315,6 +320,12 @@ namespace currency
   }
   //---------------------------------------------------------------
   template<class t_object>
+  bool t_unserializable_object_from_blob(t_object& to, const blobdata& b_blob)
+  {
+    return t_unserializable_object_from_blob(to, b_blob.data(), b_blob.size());
+  }
+  //---------------------------------------------------------------
+  template<class t_object>
   blobdata t_serializable_object_to_blob(const t_object& to)
   {
     blobdata b;
@@ -322,6 +333,31 @@ namespace currency
     return b;
   }
   //---------------------------------------------------------------
+  //object is kept in archive as length prefixed blob, so its blob can be taken from archive without decoding the object
+  template<template <bool> class Archive, class t_object>
+  bool do_serialize_as_blob(Archive<true>& ar, t_object& obj)
+  {
+    blobdata b;
+    if (!t_serializable_object_to_blob(obj, b))
+      return false;
+    return ::do_serialize(ar, b);
+  }
+  //---------------------------------------------------------------
+  template<template <bool> class Archive, class t_object>
+  bool do_serialize_as_blob(Archive<false>& ar, t_object& obj)
+  {
+    //decoded right from archive, without copying the blob out
+    size_t blob_size = 0;
+    ar.serialize_varint(blob_size);
+    size_t remaining = ar.remaining_bytes();
+    if (!ar.stream().good() || remaining < blob_size)
+      return false;
+    if (!::do_serialize(ar, obj) || !ar.stream().good())
+      return false;
+    CHECK_AND_ASSERT_MES(remaining - ar.remaining_bytes() == blob_size, false, "Wrong blob size " << blob_size << " for decoded " << typeid(obj).name() << " of " << remaining - ar.remaining_bytes() << " bytes");
+    return true;
+  }
+  //---------------------------------------------------------------
   template<class t_object>
   bool get_object_hash(const t_object& o, crypto::hash& res)
   {
@@ -346,6 +382,7 @@ namespace currency
   }
   //---------------------------------------------------------------
   size_t get_object_blobsize(const transaction& t);
+  size_t get_object_blobsize(const transaction& t, size_t prefix_blob_size);
   //---------------------------------------------------------------
   template<class t_object>
   bool get_object_hash(const t_object& o, crypto::hash& res, size_t& blob_size)
@@ -430,6 +430,7 @@ namespace currency
       {
         //we lucky!
         b.nonce = nonce;
+        b.invalidate_hashes();
         //move alias info to temp var 
         alias_info ai_local = AUTO_VAL_INIT(ai_local);
         CRITICAL_REGION_BEGIN(m_aliace_to_apply_in_block_lock);
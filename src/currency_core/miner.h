@@ -53,6 +53,7 @@ namespace currency
     template<typename callback_t>
     static bool find_nonce_for_given_block(block& bl, const wide_difficulty_type& diffic, uint64_t height, callback_t scratch_accessor)
     {
+      bl.invalidate_hashes();
       blobdata bd = get_block_hashing_blob(bl);
       for(; bl.nonce != std::numeric_limits<uint32_t>::max(); bl.nonce++)
       {
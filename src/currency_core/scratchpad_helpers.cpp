@@ -81,6 +81,13 @@ namespace currency
     return true;
   }
 
+  bool scratchpad_wrapper::reload_cache_from_db()
+  {
+    LOG_PRINT_MAGENTA("Reloading scratchpad cache from db...", LOG_LEVEL_0);
+    m_scratchpad_cache.clear();
+    return load_scratchpad_from_db(m_rdb_scratchpad, m_scratchpad_cache);
+  }
+
   void scratchpad_wrapper::clear()
   {
     m_scratchpad_cache.clear();
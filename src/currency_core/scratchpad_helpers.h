@@ -4,6 +4,9 @@
 
 #pragma once
 
+#include <unordered_map>
+#include <algorithm>
+
 #include "currency_basic.h"
 #include "common/util.h"
 #include "currency_core/currency_format_utils.h"
@@ -23,6 +26,7 @@ namespace currency
     bool init(const std::string& config_folder);
     bool deinit();
     void clear();
+    bool reload_cache_from_db();
     const std::vector<crypto::hash>& get_scratchpad();
     void set_scratchpad(const std::vector<crypto::hash>& sc);
     bool push_block_scratchpad_data(const block& b);
@@ -149,5 +153,77 @@ namespace currency
     return true;
   }
 
+  //------------------------------------------------------------------
+  // scratchpad states for a sequence of blocks on top of read-only base scratchpad:
+  // every modification is kept as a new version of the entry, so the state before any block
+  // of the sequence could be accessed (concurrently, once all blocks are pushed) without copying the base
+  class scratchpad_versions
+  {
+  public:
+    scratchpad_versions(const std::vector<crypto::hash>& base)
+      : m_base(base)
+      , m_size(base.size())
+      , m_version(0)
+    {
+      m_sizes.push_back(m_size);
+    }
+
+    // should be called before pushing next block data
+    void begin_next_version()
+    {
+      ++m_version;
+      m_sizes.push_back(m_size);
+    }
+    // state size before the block with the given index in the sequence
+    uint64_t size(size_t version) const
+    {
+      return m_sizes[version];
+    }
+    crypto::hash get(uint64_t i, size_t version) const
+    {
+      auto it = m_entries.find(i);
+      if (it != m_entries.end())
+      {
+        // last entry version that is not newer than requested
+        auto vit = std::upper_bound(it->second.begin(), it->second.end(), version, [](size_t v, const std::pair<size_t, crypto::hash>& e) { return v < e.first; });
+        if (vit != it->second.begin())
+          return (--vit)->second;
+      }
+      return i < m_base.size() ? m_base[i] : null_hash;
+    }
+
+    // container interface for push_block_scratchpad_data(), operates on the latest version
+    size_t size() const { return m_size; }
+    crypto::hash operator[](uint64_t i) const { return get(i, m_version); }
+    void push_back(const crypto::hash& h)
+    {
+      set(m_size, h);
+      m_sizes.back() = ++m_size;
+    }
+    void set(uint64_t i, const crypto::hash& h)
+    {
+      auto& versions = m_entries[i];
+      if (versions.size() && versions.back().first == m_version)
+        versions.back().second = h;
+      else
+        versions.push_back(std::make_pair(m_version, h));
+    }
+    void resize(size_t sz)
+    {
+      // only rollback of the latest version addendum is supported
+      CHECK_AND_ASSERT_MES_NO_RET(sz <= m_size && sz >= m_sizes[m_version ? m_version - 1 : 0], "scratchpad_versions: wrong resize");
+      for (uint64_t i = sz; i != m_size; ++i)
+        m_entries.erase(i);
+      m_sizes.back() = m_size = sz;
+    }
+
+  private:
+    const std::vector<crypto::hash>& m_base;
+    std::unordered_map<uint64_t, std::vector<std::pair<size_t, crypto::hash> > > m_entries; // index -> [(version, value), ...]
+    std::vector<uint64_t> m_sizes; // version -> state size
+    uint64_t m_size;
+    size_t m_version;
+  };
+
 }
 
@@ -23,7 +23,9 @@ DISABLE_VS_WARNINGS(4244 4345 4503) //'boost::foreach_detail_::or_' : decorated
 namespace currency
 {
   //---------------------------------------------------------------------------------
-  tx_memory_pool::tx_memory_pool(blockchain_storage& bchs): m_blockchain(bchs)
+  tx_memory_pool::tx_memory_pool(blockchain_storage& bchs): m_blockchain(bchs), m_pevent_journal(nullptr),
+    //versions start from the launch time, so a version got before restart is never taken for a current one
+    m_version(static_cast<uint64_t>(time(nullptr)) << 20), m_min_known_version(m_version)
   {
 
   }
@@ -98,6 +100,7 @@ namespace currency
         txd_p.first->second.max_used_block_height = 0;
         txd_p.first->second.kept_by_block = kept_by_block;
         txd_p.first->second.receive_time = time(nullptr);
+        txd_p.first->second.pool_version = ++m_version;
         tvc.m_verifivation_impossible = true;
         tvc.m_added_to_pool = true;
       }else
@@ -120,6 +123,7 @@ namespace currency
       txd_p.first->second.last_failed_height = 0;
       txd_p.first->second.last_failed_id = null_hash;
       txd_p.first->second.receive_time = time(nullptr);
+      txd_p.first->second.pool_version = ++m_version;
       tvc.m_added_to_pool = true;
 
       if(txd_p.first->second.fee > 0)
@@ -140,6 +144,7 @@ namespace currency
     }
 
     tvc.m_verifivation_failed = false;
+    publish_event(core_event_tx_added, id);
     //succeed
     return true;
   }
@@ -154,19 +159,20 @@ namespace currency
   bool tx_memory_pool::remove_transaction_keyimages(const transaction& tx)
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
+    crypto::hash tx_id = get_transaction_hash(tx);
     BOOST_FOREACH(const txin_v& vi, tx.vin)
     {
       CHECKED_GET_SPECIFIC_VARIANT(vi, const txin_to_key, txin, false);
       auto it = m_spent_key_images.find(txin.k_image);
       CHECK_AND_ASSERT_MES(it != m_spent_key_images.end(), false, "failed to find transaction input in key images. img=" << txin.k_image << ENDL
-                                    << "transaction id = " << get_transaction_hash(tx));
+                                    << "transaction id = " << tx_id);
       std::unordered_set<crypto::hash>& key_image_set =  it->second;
       CHECK_AND_ASSERT_MES(key_image_set.size(), false, "empty key_image set, img=" << txin.k_image << ENDL
-        << "transaction id = " << get_transaction_hash(tx));
+        << "transaction id = " << tx_id);
 
-      auto it_in_set = key_image_set.find(get_transaction_hash(tx));
+      auto it_in_set = key_image_set.find(tx_id);
       CHECK_AND_ASSERT_MES(it_in_set != key_image_set.end(), false, "transaction id not found in key_image set, img=" << txin.k_image << ENDL
-        << "transaction id = " << get_transaction_hash(tx));
+        << "transaction id = " << tx_id);
       key_image_set.erase(it_in_set);
       if(!key_image_set.size())
       {
@@ -190,6 +196,7 @@ namespace currency
     fee = it->second.fee;
     remove_transaction_keyimages(it->second.tx);
     m_transactions.erase(it);
+    on_tx_removed(id);
     return true;
   }
   //---------------------------------------------------------------------------------
@@ -210,6 +217,7 @@ namespace currency
       {
         LOG_PRINT_L0("Tx " << it->first << " removed from tx pool due to outdated, age: " << tx_age );
         remove_transaction_keyimages(it->second.tx);
+        on_tx_removed(it->first);
         m_transactions.erase(it++);
       }else
         ++it;
@@ -291,10 +299,54 @@ namespace currency
   void tx_memory_pool::purge_transactions()
   {
     CRITICAL_REGION_LOCAL(m_transactions_lock);
+    for (const auto& tx_entry : m_transactions)
+      on_tx_removed(tx_entry.first);
     m_transactions.clear();
     m_spent_key_images.clear();
   }
   //---------------------------------------------------------------------------------
+  void tx_memory_pool::publish_event(core_event_type type, const crypto::hash& id)
+  {
+    if (m_pevent_journal)
+      m_pevent_journal->push(type, id, 0);
+  }
+  //---------------------------------------------------------------------------------
+  void tx_memory_pool::on_tx_removed(const crypto::hash& id)
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    m_removed_txs.push_back(std::make_pair(++m_version, id));
+    if (m_removed_txs.size() > MEMPOOL_REMOVED_TXS_HISTORY_SIZE)
+    {
+      m_min_known_version = m_removed_txs.front().first;
+      m_removed_txs.pop_front();
+    }
+    publish_event(core_event_tx_removed, id);
+  }
+  //---------------------------------------------------------------------------------
+  uint64_t tx_memory_pool::get_version()
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    return m_version;
+  }
+  //---------------------------------------------------------------------------------
+  bool tx_memory_pool::get_changes(uint64_t since_version, std::list<transaction>& added, std::list<crypto::hash>& removed, uint64_t& version)
+  {
+    CRITICAL_REGION_LOCAL(m_transactions_lock);
+    version = m_version;
+    bool known = since_version >= m_min_known_version && since_version <= m_version;
+    if (known)
+    {
+      for (auto it = m_removed_txs.rbegin(); it != m_removed_txs.rend() && it->first > since_version; ++it)
+        removed.push_front(it->second);
+    }
+    for (const auto& tx_entry : m_transactions)
+    {
+      if (!known || tx_entry.second.pool_version > since_version)
+        added.push_back(tx_entry.second.tx);
+    }
+    return known;
+  }
+  //---------------------------------------------------------------------------------
   bool tx_memory_pool::is_transaction_ready_to_go(tx_details& txd)
   {
     //not the best implementation at this time, sorry :(
@@ -494,6 +546,8 @@ namespace currency
     bool res = tools::unserialize_obj_from_file(*this, state_file_path);
     if (res)
     {
+      for (auto& tx_entry : m_transactions)
+        tx_entry.second.pool_version = m_version;
       // mem pool has just been successfully loaded from file
       // delete pool file to avoid loading outdated data on the next load (in case a crash happen for ex.)
       if (!boost::filesystem::remove_all(state_file_path))
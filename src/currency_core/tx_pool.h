@@ -7,6 +7,7 @@
 using namespace epee;
 
 
+#include <deque>
 #include <set>
 #include <unordered_map>
 #include <unordered_set>
@@ -18,6 +19,7 @@ using namespace epee;
 #include "math_helper.h"
 #include "currency_basic_impl.h"
 #include "verification_context.h"
+#include "core_event_journal.h"
 #include "crypto/hash.h"
 #include "common/boost_serialization_helper.h"
 
@@ -62,6 +64,12 @@ namespace currency
     bool have_key_images(const std::unordered_set<crypto::key_image>& kic, const transaction& tx);
     bool append_key_images(std::unordered_set<crypto::key_image>& kic, const transaction& tx);
     std::string print_pool(bool short_format);
+    uint64_t get_version();
+    //transactions added to and ids removed from the pool after since_version, removals go first (a tx may be removed and added again),
+    //returns false and the whole pool if changes after since_version are not known (too old or from before restart)
+    bool get_changes(uint64_t since_version, std::list<transaction>& added, std::list<crypto::hash>& removed, uint64_t& version);
+    //transactions added and removed are published there
+    void set_event_journal(core_event_journal* pevent_journal) { m_pevent_journal = pevent_journal; }
 
     /*
     bool flush_pool(const std::strig& folder);
@@ -69,6 +77,7 @@ namespace currency
     */
 
 #define CURRENT_MEMPOOL_ARCHIVE_VER    12
+#define MEMPOOL_REMOVED_TXS_HISTORY_SIZE  10000
 
     template<class archive_t>
     void serialize(archive_t & ar, const unsigned int version)
@@ -94,17 +103,23 @@ namespace currency
       crypto::hash last_failed_id;
       time_t receive_time;
       std::string decline_reason;
+      uint64_t pool_version;  //pool version at adding, not stored
     };
 
   private:
     bool remove_stuck_transactions();
     bool is_transaction_ready_to_go(tx_details& txd);
+    void publish_event(core_event_type type, const crypto::hash& id);
+    void on_tx_removed(const crypto::hash& id);
     typedef std::unordered_map<crypto::hash, tx_details > transactions_container;
     typedef std::unordered_map<crypto::key_image, std::unordered_set<crypto::hash> > key_images_container;
 
     epee::critical_section m_transactions_lock;
     transactions_container m_transactions;
     key_images_container m_spent_key_images;
+    uint64_t m_version;                                        //incremented on every added and removed tx
+    uint64_t m_min_known_version;                              //changes are known after this version only
+    std::deque<std::pair<uint64_t, crypto::hash> > m_removed_txs; //last removed txs with the version of removal
     
     epee::math_helper::once_a_time_seconds<30> m_remove_stuck_tx_interval;
 
@@ -112,6 +127,7 @@ namespace currency
 
     std::string m_config_folder;
     blockchain_storage& m_blockchain;
+    core_event_journal* m_pevent_journal;
     /************************************************************************/
     /*                                                                      */
     /************************************************************************/
@@ -72,6 +72,9 @@ namespace currency
     //bool get_payload_sync_data(HANDSHAKE_DATA::request& hshd, currency_connection_context& context);
     bool request_missing_objects(currency_connection_context& context, bool check_having_blocks);
     size_t get_synchronizing_connections_count();
+    size_t get_blocks_request_size(const currency_connection_context& context);
+    void update_download_stats(currency_connection_context& context, const NOTIFY_RESPONSE_GET_OBJECTS::request& arg);
+    bool is_slow_synchronizing_peer(const currency_connection_context& context);
     bool on_connection_synchronized();  
     bool check_stop_flag_and_exit(currency_connection_context& context);
     t_core& m_core;
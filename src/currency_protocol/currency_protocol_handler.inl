@@ -58,6 +58,7 @@ namespace currency
       NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
       m_core.get_short_chain_history(r.block_ids);
       LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size() );
+      context.m_request_time = misc_utils::get_tick_count();
       post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
     }
 
@@ -79,7 +80,8 @@ namespace currency
       << std::setw(20) << "Peer id"
       << std::setw(25) << "Recv/Sent (idle,sec)"
       << std::setw(25) << "State"
-      << std::setw(20) << "Livetime(seconds)" << ENDL;
+      << std::setw(20) << "Livetime(seconds)"
+      << std::setw(20) << "Speed(KB/s)/RTT(ms)" << ENDL;
 
     m_p2p->for_each_connection([&](const connection_context& cntxt, nodetool::peerid_type peer_id)
     {
@@ -88,7 +90,8 @@ namespace currency
         << std::setw(20) << std::hex << peer_id
         << std::setw(25) << std::to_string(cntxt.m_recv_cnt)+ "(" + std::to_string(time(NULL) - cntxt.m_last_recv) + ")" + "/" + std::to_string(cntxt.m_send_cnt) + "(" + std::to_string(time(NULL) - cntxt.m_last_send) + ")"
         << std::setw(25) << get_protocol_state_string(cntxt.m_state)
-        << std::setw(20) << std::to_string(time(NULL) - cntxt.m_started) << ENDL;
+        << std::setw(20) << std::to_string(time(NULL) - cntxt.m_started)
+        << std::setw(20) << std::to_string(cntxt.m_download_speed / 1024) + "/" + std::to_string(cntxt.m_latency) << ENDL;
       return true;
     });
     LOG_PRINT_L0("Connections: " << ENDL << ss.str());
@@ -303,14 +306,18 @@ namespace currency
     }
 
     context.m_remote_blockchain_height = arg.current_blockchain_height;
+    update_download_stats(context, arg);
 
     size_t count = 0;
+    std::vector<block> blocks;
+    blocks.reserve(arg.blocks.size());
     BOOST_FOREACH(const block_complete_entry& block_entry, arg.blocks)
     {
       CHECK_STOP_FLAG_EXIT_IF_SET(1, "Blocks processing interrupted, connection dropped");
 
       ++count;
-      block b;
+      blocks.push_back(block());
+      block& b = blocks.back();
       if(!parse_and_validate_block_from_blob(block_entry.block, b))
       {
         LOG_ERROR_CCONTEXT("sent wrong block: failed to parse and validate block: \r\n" 
@@ -364,8 +371,21 @@ namespace currency
       misc_utils::auto_scope_leave_caller scope_exit_handler = misc_utils::create_scope_leave_handler(
         boost::bind(&t_core::resume_mine, &m_core));
 
+      //apply whole response within batched db write transactions instead of one commit per block
+      bool batch_started = m_core.begin_batch_import();
+      misc_utils::auto_scope_leave_caller batch_exit_handler = misc_utils::create_scope_leave_handler([&]()
+      {
+        if (batch_started)
+          m_core.end_batch_import();
+      });
+
+      //proofs of work of the whole response are checked in parallel here, blocks are applied sequentially below
+      m_core.precalculate_blocks_pow(blocks);
+
+      auto block_it = blocks.begin();
       BOOST_FOREACH(const block_complete_entry& block_entry, arg.blocks)
       {
+        const block& b = *block_it++;
         CHECK_STOP_FLAG_EXIT_IF_SET(1, "Blocks processing interrupted, connection dropped");
         //process transactions
         TIME_MEASURE_START(transactions_process_time);
@@ -388,7 +408,7 @@ namespace currency
         TIME_MEASURE_START(block_process_time);
         block_verification_context bvc = boost::value_initialized<block_verification_context>();
 
-        m_core.handle_incoming_block(block_entry.block, bvc, false);
+        m_core.handle_incoming_block(b, block_entry.block.size(), bvc, false);
 
         if(bvc.m_verifivation_failed)
         {
@@ -407,9 +427,20 @@ namespace currency
 
         TIME_MEASURE_FINISH(block_process_time);
         LOG_PRINT_CCONTEXT_L2("Block process time: " << block_process_time + transactions_process_time << "(" << transactions_process_time << "/" << block_process_time << ")ms");
+
+        //don't keep rpc and other connections waiting for the whole response
+        if (batch_started)
+          batch_started = m_core.yield_batch_import();
       }
     }
 
+    if (is_slow_synchronizing_peer(context))
+    {
+      LOG_PRINT_CCONTEXT_L0("Peer is too slow for synchronizing (" << context.m_download_speed / 1024 << " KB/s), dropping connection");
+      m_p2p->drop_connection(context);
+      return 1;
+    }
+
     request_missing_objects(context, true);
     return 1;
   }
@@ -444,9 +475,10 @@ namespace currency
       //we know objects that we need, request this objects
       NOTIFY_REQUEST_GET_OBJECTS::request req;
       size_t count = 0;
+      size_t max_count = get_blocks_request_size(context);
       auto it = context.m_needed_objects.begin();
 
-      while(it != context.m_needed_objects.end() && count < BLOCKS_SYNCHRONIZING_DEFAULT_COUNT)
+      while(it != context.m_needed_objects.end() && count < max_count)
       {
         if( !(check_having_blocks && m_core.have_block(*it)))
         {
@@ -457,6 +489,7 @@ namespace currency
         context.m_needed_objects.erase(it++);
       }
       LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_GET_OBJECTS: blocks.size()=" << req.blocks.size() << ", txs.size()=" << req.txs.size());
+      context.m_request_time = misc_utils::get_tick_count();
       post_notify<NOTIFY_REQUEST_GET_OBJECTS>(req, context);    
     }else if(context.m_last_response_height < context.m_remote_blockchain_height-1)
     {//we have to fetch more objects ids, request blockchain entry
@@ -464,6 +497,7 @@ namespace currency
       NOTIFY_REQUEST_CHAIN::request r = boost::value_initialized<NOTIFY_REQUEST_CHAIN::request>();
       m_core.get_short_chain_history(r.block_ids);
       LOG_PRINT_CCONTEXT_L2("-->>NOTIFY_REQUEST_CHAIN: m_block_ids.size()=" << r.block_ids.size() );
+      context.m_request_time = misc_utils::get_tick_count();
       post_notify<NOTIFY_REQUEST_CHAIN>(r, context);
     }else
     { 
@@ -514,11 +548,70 @@ namespace currency
     return count;
   }
   //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  size_t t_currency_protocol_handler<t_core>::get_blocks_request_size(const currency_connection_context& context)
+  {
+    if (!context.m_download_speed || !context.m_avg_block_size)
+      return BLOCKS_SYNCHRONIZING_DEFAULT_COUNT;
+
+    //request as many blocks as this peer is expected to deliver in BLOCKS_SYNCHRONIZING_TARGET_SECONDS
+    uint64_t target_size = std::min<uint64_t>(context.m_download_speed * BLOCKS_SYNCHRONIZING_TARGET_SECONDS, BLOCKS_SYNCHRONIZING_MAX_RESPONSE_SIZE);
+    uint64_t count = target_size / context.m_avg_block_size;
+    return static_cast<size_t>(std::max<uint64_t>(BLOCKS_SYNCHRONIZING_MIN_COUNT, std::min<uint64_t>(count, BLOCKS_SYNCHRONIZING_MAX_COUNT)));
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  void t_currency_protocol_handler<t_core>::update_download_stats(currency_connection_context& context, const NOTIFY_RESPONSE_GET_OBJECTS::request& arg)
+  {
+    if (!context.m_request_time || arg.blocks.empty())
+      return;
+
+    uint64_t size = 0;
+    BOOST_FOREACH(const block_complete_entry& block_entry, arg.blocks)
+    {
+      size += block_entry.block.size();
+      BOOST_FOREACH(const blobdata& tx_blob, block_entry.txs)
+        size += tx_blob.size();
+    }
+    //round trip is included: that's what the next request will cost as well
+    uint64_t elapsed = std::max<uint64_t>(misc_utils::get_tick_count() - context.m_request_time, 1);
+    uint64_t speed = size * 1000 / elapsed;
+    uint64_t block_size = size / arg.blocks.size();
+    context.m_download_speed = context.m_download_speed ? (context.m_download_speed * 3 + speed) / 4 : speed;
+    context.m_avg_block_size = context.m_avg_block_size ? (context.m_avg_block_size * 3 + block_size) / 4 : block_size;
+    context.m_request_time = 0;
+    ++context.m_objects_responses_count;
+    LOG_PRINT_CCONTEXT_L2("Download stats: " << size << " bytes in " << elapsed << "ms, speed " << context.m_download_speed / 1024
+      << " KB/s, avg block size " << context.m_avg_block_size << ", next request size " << get_blocks_request_size(context));
+  }
+  //------------------------------------------------------------------------------------------------------------------------
+  template<class t_core>
+  bool t_currency_protocol_handler<t_core>::is_slow_synchronizing_peer(const currency_connection_context& context)
+  {
+    if (m_synchronized || context.m_state != currency_connection_context::state_synchronizing || context.m_objects_responses_count < BLOCKS_SYNCHRONIZING_SLOW_PEER_MIN_RESPONSES)
+      return false;
+
+    uint64_t max_speed = 0;
+    m_p2p->for_each_connection([&](currency_connection_context& cntxt, nodetool::peerid_type peer_id)->bool{
+      if (cntxt.m_state == currency_connection_context::state_synchronizing && cntxt.m_objects_responses_count >= BLOCKS_SYNCHRONIZING_SLOW_PEER_MIN_RESPONSES)
+        max_speed = std::max(max_speed, cntxt.m_download_speed);
+      return true;
+    });
+    return context.m_download_speed * BLOCKS_SYNCHRONIZING_SLOW_PEER_RATIO < max_speed;
+  }
+  //------------------------------------------------------------------------------------------------------------------------
   template<class t_core> 
   int t_currency_protocol_handler<t_core>::handle_response_chain_entry(int command, NOTIFY_RESPONSE_CHAIN_ENTRY::request& arg, currency_connection_context& context)
   {
     LOG_PRINT_CCONTEXT_L2("NOTIFY_RESPONSE_CHAIN_ENTRY: m_block_ids.size()=" << arg.m_block_ids.size() 
       << ", m_start_height=" << arg.start_height << ", m_total_height=" << arg.total_height);
+
+    if (context.m_request_time)
+    {
+      uint64_t latency = misc_utils::get_tick_count() - context.m_request_time;
+      context.m_latency = context.m_latency ? (context.m_latency * 3 + latency) / 4 : latency;
+      context.m_request_time = 0;
+    }
     
     if(!arg.m_block_ids.size())
     {
@@ -242,7 +242,7 @@ void daemon_backend::main_worker(const po::variables_map& vm)
   LOG_PRINT_L0("Starting core rpc server...");
   dsi.text_state = "Starting core rpc server";
   m_pview->update_daemon_status(dsi);
-  res = m_rpc_server.run(2, false);
+  res = m_rpc_server.run(m_rpc_server.get_threads_count(), false);
   CHECK_AND_ASSERT_AND_SET_GUI(res, void(), "Failed to initialize core rpc server.");
   LOG_PRINT_L0("Core rpc server started ok");
 
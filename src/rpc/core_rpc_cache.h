@@ -0,0 +1,106 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <atomic>
+#include <list>
+#include <unordered_map>
+
+#include "syncobj.h"
+
+namespace currency
+{
+  /************************************************************************/
+  /* LRU cache for rpc responses prepared from main chain blocks.         */
+  /* Entries are valid for one main chain version (see                    */
+  /* blockchain_storage::get_main_chain_rollbacks_count()): when blocks    */
+  /* leave the main chain everything cached is dropped.                    */
+  /************************************************************************/
+  template<class t_key, class t_value>
+  class rpc_response_cache
+  {
+  public:
+    rpc_response_cache() : m_max_size(0), m_size(0), m_chain_version(0), m_hits(0), m_misses(0)
+    {}
+
+    void set_max_size(uint64_t max_size)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      m_max_size = max_size;
+      shrink();
+    }
+
+    bool get(const t_key& key, uint64_t chain_version, t_value& value)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      sync_chain_version(chain_version);
+      auto it = m_index.find(key);
+      if (it == m_index.end())
+      {
+        ++m_misses;
+        return false;
+      }
+      //move to the front of LRU list
+      m_entries.splice(m_entries.begin(), m_entries, it->second);
+      value = it->second->value;
+      ++m_hits;
+      return true;
+    }
+
+    //chain_version should be taken before the data for the value was read from the blockchain
+    void put(const t_key& key, uint64_t chain_version, const t_value& value, uint64_t size)
+    {
+      CRITICAL_REGION_LOCAL(m_lock);
+      sync_chain_version(chain_version);
+      if (chain_version != m_chain_version || size > m_max_size || m_index.count(key))
+        return;
+      m_entries.push_front(entry{ key, value, size });
+      m_index[key] = m_entries.begin();
+      m_size += size;
+      shrink();
+    }
+
+    uint64_t get_size() const { return m_size; }
+    uint64_t get_hits() const { return m_hits; }
+    uint64_t get_misses() const { return m_misses; }
+
+  private:
+    struct entry
+    {
+      t_key key;
+      t_value value;
+      uint64_t size;
+    };
+
+    void sync_chain_version(uint64_t chain_version)
+    {
+      if (chain_version <= m_chain_version)
+        return;
+      m_index.clear();
+      m_entries.clear();
+      m_size = 0;
+      m_chain_version = chain_version;
+    }
+
+    void shrink()
+    {
+      while (m_size > m_max_size && !m_entries.empty())
+      {
+        m_size -= m_entries.back().size;
+        m_index.erase(m_entries.back().key);
+        m_entries.pop_back();
+      }
+    }
+
+    std::list<entry> m_entries; // most recently used first
+    std::unordered_map<t_key, typename std::list<entry>::iterator> m_index;
+    uint64_t m_max_size;
+    std::atomic<uint64_t> m_size;
+    uint64_t m_chain_version;
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+    epee::critical_section m_lock;
+  };
+}
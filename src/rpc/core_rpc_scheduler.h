@@ -0,0 +1,234 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+
+namespace currency
+{
+  enum rpc_request_class
+  {
+    rpc_request_priority, // mining and submit calls, never wait and always find a free thread
+    rpc_request_normal,
+    rpc_request_heavy     // limited number of concurrent calls per endpoint, others wait in a queue
+  };
+
+  struct rpc_endpoint_stats
+  {
+    uint64_t calls;
+    uint64_t rejected;
+    uint64_t active;
+    uint64_t completed;
+    uint64_t queue_depth;
+    uint64_t max_queue_depth;
+    uint64_t total_wait_us;
+    uint64_t total_run_us;
+    uint64_t max_run_us;
+  };
+
+  //finds top level "method" of a json-rpc request body without parsing the whole body,
+  //looks at the first max_scan bytes only and accepts a method name without escapes
+  inline bool get_json_rpc_method(const std::string& body, std::string& method, size_t max_scan = 4096)
+  {
+    size_t end = std::min(body.size(), max_scan);
+    auto skip_spaces = [&](size_t i) { while (i < end && isspace(static_cast<unsigned char>(body[i]))) ++i; return i; };
+    size_t i = skip_spaces(0);
+    if (i >= end || body[i] != '{')
+      return false;
+    size_t depth = 1;
+    bool expect_key = true;   // next string at depth 1 is a key of the request object
+    for (++i; i < end && depth; ++i)
+    {
+      char c = body[i];
+      if (c == '"')
+      {
+        size_t str_begin = ++i;
+        bool escaped = false;
+        for (; i < end && body[i] != '"'; ++i)
+        {
+          if (body[i] == '\\')
+          {
+            escaped = true;
+            ++i;
+          }
+        }
+        if (i >= end)
+          return false;
+        if (depth != 1 || !expect_key || escaped || body.compare(str_begin, i - str_begin, "method") != 0)
+        {
+          expect_key = false;
+          continue;
+        }
+        i = skip_spaces(i + 1);
+        if (i >= end || body[i] != ':')
+          return false;
+        i = skip_spaces(i + 1);
+        if (i >= end || body[i] != '"')
+          return false;
+        size_t value_end = body.find_first_of("\"\\", i + 1);
+        if (value_end >= end || body[value_end] != '"')
+          return false;
+        method.assign(body, i + 1, value_end - i - 1);
+        return true;
+      }
+      else if (c == '{' || c == '[')
+        ++depth;
+      else if (c == '}' || c == ']')
+        --depth;
+      else if (c == ',')
+        expect_key = depth == 1;
+    }
+    return false;
+  }
+
+  /************************************************************************/
+  /* Admission of rpc requests on the server threads.                     */
+  /* Normal and heavy requests together never take more than              */
+  /* (threads - reserved) threads, running or waiting, so priority        */
+  /* requests always have a thread. A request which doesn't fit is        */
+  /* answered with "busy" right away, a heavy request over its endpoint   */
+  /* limit waits for a slot up to wait_timeout_ms.                        */
+  /* Requests of unknown endpoints are counted as "other".                */
+  /************************************************************************/
+  class rpc_request_scheduler
+  {
+  public:
+    rpc_request_scheduler() : m_max_occupied(1), m_occupied(0), m_wait_timeout_ms(0)
+    {}
+
+    void configure(size_t threads, size_t reserved_threads, uint64_t wait_timeout_ms)
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      m_max_occupied = threads > reserved_threads ? threads - reserved_threads : 1;
+      m_wait_timeout_ms = wait_timeout_ms;
+    }
+
+    //concurrency_limit is used for heavy endpoints only
+    void add_endpoint(const std::string& endpoint, rpc_request_class cls, size_t concurrency_limit = 0)
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      endpoint_state& es = m_endpoints[endpoint];
+      es.cls = cls;
+      es.limit = std::max<size_t>(concurrency_limit, 1);
+    }
+
+    bool is_known_endpoint(const std::string& endpoint) const
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      return m_endpoints.count(endpoint) != 0;
+    }
+
+    //returns false if the request should be answered with "busy"
+    bool enter(const std::string& endpoint)
+    {
+      std::unique_lock<std::mutex> lk(m_lock);
+      endpoint_state& es = get_endpoint(endpoint);
+      ++es.st.calls;
+      if (es.cls == rpc_request_priority)
+      {
+        ++es.st.active;
+        return true;
+      }
+      if (m_occupied >= m_max_occupied)
+      {
+        ++es.st.rejected;
+        return false;
+      }
+      ++m_occupied;
+      if (es.cls == rpc_request_heavy && es.st.active >= es.limit)
+      {
+        auto wait_start = std::chrono::steady_clock::now();
+        ++es.st.queue_depth;
+        es.st.max_queue_depth = std::max(es.st.max_queue_depth, es.st.queue_depth);
+        bool got_slot = m_cond.wait_for(lk, std::chrono::milliseconds(m_wait_timeout_ms), [&es]() { return es.st.active < es.limit; });
+        --es.st.queue_depth;
+        es.st.total_wait_us += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - wait_start).count();
+        if (!got_slot)
+        {
+          --m_occupied;
+          ++es.st.rejected;
+          return false;
+        }
+      }
+      ++es.st.active;
+      return true;
+    }
+
+    void leave(const std::string& endpoint, uint64_t run_us)
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      endpoint_state& es = get_endpoint(endpoint);
+      --es.st.active;
+      if (es.cls != rpc_request_priority)
+        --m_occupied;
+      ++es.st.completed;
+      es.st.total_run_us += run_us;
+      es.st.max_run_us = std::max(es.st.max_run_us, run_us);
+      m_cond.notify_all();
+    }
+
+    void get_stats(std::list<std::pair<std::string, rpc_endpoint_stats> >& stats) const
+    {
+      std::lock_guard<std::mutex> lk(m_lock);
+      for (const auto& e : m_endpoints)
+        stats.push_back(std::make_pair(e.first, e.second.st));
+    }
+
+    //takes a slot for the request if it can be served, gives it back when the request is done
+    class request_guard
+    {
+    public:
+      request_guard(rpc_request_scheduler& s, const std::string& endpoint) : m_s(s), m_endpoint(endpoint), m_admitted(false)
+      {
+        m_admitted = m_s.enter(m_endpoint);
+        m_start = std::chrono::steady_clock::now(); // time in the queue is not counted as run time
+      }
+      ~request_guard()
+      {
+        if (m_admitted)
+          m_s.leave(m_endpoint, std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - m_start).count());
+      }
+      bool is_admitted() const { return m_admitted; }
+
+    private:
+      rpc_request_scheduler& m_s;
+      std::string m_endpoint;
+      std::chrono::steady_clock::time_point m_start;
+      bool m_admitted;
+    };
+
+  private:
+    struct endpoint_state
+    {
+      endpoint_state() : cls(rpc_request_normal), limit(1), st() {}
+      rpc_request_class cls;
+      size_t limit;
+      rpc_endpoint_stats st;
+    };
+
+    endpoint_state& get_endpoint(const std::string& endpoint)
+    {
+      auto it = m_endpoints.find(endpoint);
+      if (it != m_endpoints.end())
+        return it->second;
+      return m_endpoints["other"];
+    }
+
+    std::map<std::string, endpoint_state> m_endpoints; // only added endpoints and "other", references stay valid
+    size_t m_max_occupied;
+    size_t m_occupied;       // threads taken by normal and heavy requests, running or waiting
+    uint64_t m_wait_timeout_ms;
+    mutable std::mutex m_lock;
+    std::condition_variable m_cond;
+  };
+}
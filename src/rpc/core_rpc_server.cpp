@@ -25,6 +25,25 @@ namespace currency
     const command_line::arg_descriptor<std::string> arg_rpc_bind_ip   = {"rpc-bind-ip", "IP for RPC Server", "127.0.0.1"};
     const command_line::arg_descriptor<std::string> arg_rpc_bind_port = {"rpc-bind-port", "Port for RPC Server", std::to_string(RPC_DEFAULT_PORT)};
 	const command_line::arg_descriptor<bool> arg_rpc_restricted_rpc = { "restricted-rpc", "Restrict RPC to view only commands", false};
+    const command_line::arg_descriptor<uint64_t> arg_rpc_blocks_cache_size = { "rpc-blocks-cache-size", "Memory for prepared getblocks.bin entries, MB", 64 };
+    const command_line::arg_descriptor<uint64_t> arg_rpc_explorer_cache_size = { "rpc-explorer-cache-size", "Memory for prepared block headers and details responses, MB", 16 };
+    const command_line::arg_descriptor<uint64_t> arg_rpc_threads = { "rpc-threads", "Number of RPC server threads", 4 };
+    const command_line::arg_descriptor<uint64_t> arg_rpc_priority_threads = { "rpc-priority-threads", "RPC server threads kept for mining and submit calls", 1 };
+    const command_line::arg_descriptor<uint64_t> arg_rpc_heavy_requests_limit = { "rpc-heavy-requests-limit", "Max concurrent calls of each heavy RPC (getblocks.bin, getrandom_outs.bin, getfullscratchpad2...)", 1 };
+    const command_line::arg_descriptor<uint64_t> arg_rpc_queue_timeout = { "rpc-queue-timeout", "Max time a heavy RPC call waits for its turn, ms", 10000 };
+    const command_line::arg_descriptor<uint64_t> arg_rpc_subscribe_threads = { "rpc-subscribe-threads", "Max RPC server threads waiting for events in /subscribe, others get events without waiting", 1 };
+
+    const char* get_core_event_type_name(core_event_type type)
+    {
+      switch (type)
+      {
+      case core_event_block_added:   return "block_added";
+      case core_event_block_removed: return "block_removed";
+      case core_event_tx_added:      return "tx_added";
+      case core_event_tx_removed:    return "tx_removed";
+      default:                       return "unknown";
+      }
+    }
   }
   //-----------------------------------------------------------------------------------
   void core_rpc_server::init_options(boost::program_options::options_description& desc)
@@ -32,9 +51,16 @@ namespace currency
     command_line::add_arg(desc, arg_rpc_bind_ip);
     command_line::add_arg(desc, arg_rpc_bind_port);
 	command_line::add_arg(desc, arg_rpc_restricted_rpc);
+    command_line::add_arg(desc, arg_rpc_blocks_cache_size);
+    command_line::add_arg(desc, arg_rpc_explorer_cache_size);
+    command_line::add_arg(desc, arg_rpc_threads);
+    command_line::add_arg(desc, arg_rpc_priority_threads);
+    command_line::add_arg(desc, arg_rpc_heavy_requests_limit);
+    command_line::add_arg(desc, arg_rpc_queue_timeout);
+    command_line::add_arg(desc, arg_rpc_subscribe_threads);
   }
   //------------------------------------------------------------------------------------------------------------------------------
-  core_rpc_server::core_rpc_server(core& cr, nodetool::node_server<currency::t_currency_protocol_handler<currency::core> >& p2p):m_core(cr), m_p2p(p2p), m_session_counter(0)
+  core_rpc_server::core_rpc_server(core& cr, nodetool::node_server<currency::t_currency_protocol_handler<currency::core> >& p2p):m_core(cr), m_p2p(p2p), m_session_counter(0), m_threads_count(1), m_subscribe_threads_limit(1), m_subscribe_threads(0)
   {}
   //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::handle_command_line(const boost::program_options::variables_map& vm)
@@ -42,6 +68,72 @@ namespace currency
     m_bind_ip = command_line::get_arg(vm, arg_rpc_bind_ip);
     m_port = command_line::get_arg(vm, arg_rpc_bind_port);
 	m_restricted = command_line::get_arg(vm, arg_rpc_restricted_rpc);
+    m_blocks_cache.set_max_size(command_line::get_arg(vm, arg_rpc_blocks_cache_size) * 1024 * 1024);
+    uint64_t explorer_cache_size = command_line::get_arg(vm, arg_rpc_explorer_cache_size) * 1024 * 1024;
+    m_block_headers_cache.set_max_size(explorer_cache_size / 3);
+    m_short_blocks_cache.set_max_size(explorer_cache_size / 3);
+    m_block_details_cache.set_max_size(explorer_cache_size / 3);
+    m_threads_count = std::max<uint64_t>(command_line::get_arg(vm, arg_rpc_threads), 1);
+    init_scheduler(command_line::get_arg(vm, arg_rpc_priority_threads), command_line::get_arg(vm, arg_rpc_heavy_requests_limit), command_line::get_arg(vm, arg_rpc_queue_timeout));
+    m_subscribe_threads_limit = command_line::get_arg(vm, arg_rpc_subscribe_threads);
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  void core_rpc_server::init_scheduler(size_t reserved_threads, size_t heavy_requests_limit, uint64_t queue_timeout_ms)
+  {
+    m_scheduler.configure(m_threads_count, reserved_threads, queue_timeout_ms);
+    //mining and submit calls
+    const char* priority_endpoints[] = { "/sendrawtransaction", "/json_rpc/getblocktemplate", "/json_rpc/submitblock",
+      "/json_rpc/login", "/json_rpc/getjob", "/json_rpc/submit" };
+    for (const char* e : priority_endpoints)
+      m_scheduler.add_endpoint(e, rpc_request_priority);
+    //wallet sync, scratchpad and explorer lists: big responses, long blockchain locks
+    const char* heavy_endpoints[] = { "/getblocks.bin", "/getrandom_outs.bin", "/getfullscratchpad2", "/get_tx_pool.bin", "/gettransactions",
+      "/json_rpc/getfullscratchpad", "/json_rpc/get_all_alias_details", "/json_rpc/f_blocks_list_json", "/json_rpc/f_pool_json" };
+    for (const char* e : heavy_endpoints)
+      m_scheduler.add_endpoint(e, rpc_request_heavy, heavy_requests_limit);
+    const char* normal_endpoints[] = { "/getheight", "/get_o_indexes.bin", "/set_maintainers_info.bin", "/check_keyimages.bin", "/get_pool_changes.bin", "/start_mining",
+      "/stop_mining", "/getinfo", "/getrpcstats", "/subscribe", "/stop_daemon", "/json_rpc", "/json_rpc/getblockcount", "/json_rpc/on_getblockhash",
+      "/json_rpc/getlastblockheader", "/json_rpc/getblockheaderbyhash", "/json_rpc/getblockheaderbyheight", "/json_rpc/get_alias_details",
+      "/json_rpc/get_alias_by_address", "/json_rpc/get_addendums", "/json_rpc/f_block_json", "/json_rpc/f_transaction_json",
+      "/json_rpc/reset_transaction_pool", "/json_rpc/getblock", "/json_rpc/validate_signed_text", "/json_rpc/store_scratchpad" };
+    for (const char* e : normal_endpoints)
+      m_scheduler.add_endpoint(e, rpc_request_normal);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  std::string core_rpc_server::get_request_endpoint(const epee::net_utils::http::http_request_info& query_info)
+  {
+    if (query_info.m_URI.find("/getfullscratchpad2") != std::string::npos)
+      return "/getfullscratchpad2";
+    if (query_info.m_URI != "/json_rpc")
+      return query_info.m_URI;
+
+    //the body is parsed by the uri map later, only the beginning of it is scanned for "method" here
+    std::string method;
+    if (!get_json_rpc_method(query_info.m_body, method))
+      return query_info.m_URI;
+    std::string endpoint = query_info.m_URI + "/" + method;
+    return m_scheduler.is_known_endpoint(endpoint) ? endpoint : query_info.m_URI;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context)
+  {
+    LOG_PRINT_L2("HTTP [" << epee::string_tools::get_ip_string_from_int32(m_conn_context.m_remote_ip) << "] " << query_info.m_http_method_str << " " << query_info.m_URI);
+    rpc_request_scheduler::request_guard rg(m_scheduler, get_request_endpoint(query_info));
+    if (!rg.is_admitted())
+    {
+      LOG_PRINT_L1("[HTTP][" << query_info.m_URI << "] rejected: no free rpc threads");
+      response.m_response_code = 503;
+      response.m_response_comment = "Service Unavailable";
+      return true;
+    }
+    response.m_response_code = 200;
+    response.m_response_comment = "Ok";
+    if (!handle_http_request_map(query_info, response, m_conn_context))
+    {
+      response.m_response_code = 404;
+      response.m_response_comment = "Not found";
+    }
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -86,22 +178,26 @@ namespace currency
       return true; 
     }
 
-    res.height = m_core.get_current_blockchain_height();
-    res.difficulty = m_core.get_blockchain_storage().get_difficulty_for_next_block().convert_to<uint64_t>();
-    res.tx_count = m_core.get_blockchain_storage().get_total_transactions() - res.height; //without coinbase
+    //chain statistics are kept up to date by blockchain_storage, no need to lock the blockchain here
+    blockchain_storage::chain_stats cs = AUTO_VAL_INIT(cs);
+    m_core.get_blockchain_storage().get_chain_stats(cs);
+    res.height = cs.height;
+    res.difficulty = cs.next_difficulty.convert_to<uint64_t>();
+    res.tx_count = cs.total_transactions - res.height; //without coinbase
     res.tx_pool_size = m_core.get_pool_transactions_count();
-    res.alt_blocks_count = m_core.get_blockchain_storage().get_alternative_blocks_count();
+    res.alt_blocks_count = cs.alt_blocks_count;
     uint64_t total_conn = m_p2p.get_connections_count();
     res.outgoing_connections_count = m_p2p.get_outgoing_connections_count();
     res.incoming_connections_count = total_conn - res.outgoing_connections_count;
     res.white_peerlist_size = m_p2p.get_peerlist_manager().get_white_peers_count();
     res.grey_peerlist_size = m_p2p.get_peerlist_manager().get_gray_peers_count();
-    res.current_blocks_median = m_core.get_blockchain_storage().get_current_comulative_blocksize_limit()/2;
-    res.current_network_hashrate_50 = m_core.get_blockchain_storage().get_current_hashrate(50);
-    res.current_network_hashrate_350 = m_core.get_blockchain_storage().get_current_hashrate(350);
-    res.scratchpad_size = m_core.get_blockchain_storage().get_scratchpad_size();
-    res.alias_count = m_core.get_blockchain_storage().get_aliases_count();
-    m_core.get_blockchain_storage().get_transactions_daily_stat(res.transactions_cnt_per_day, res.transactions_volume_per_day);
+    res.current_blocks_median = cs.current_comulative_blocksize_limit/2;
+    res.current_network_hashrate_50 = cs.hashrate_50;
+    res.current_network_hashrate_350 = cs.hashrate_350;
+    res.scratchpad_size = cs.scratchpad_size;
+    res.alias_count = cs.aliases_count;
+    res.transactions_cnt_per_day = cs.daily_tx_count;
+    res.transactions_volume_per_day = cs.daily_tx_volume;
 
     if (!res.outgoing_connections_count)
       res.daemon_network_state = COMMAND_RPC_GET_INFO::daemon_network_state_connecting;
@@ -110,6 +206,10 @@ namespace currency
     else
       res.daemon_network_state = COMMAND_RPC_GET_INFO::daemon_network_state_synchronizing;
     
+    res.rpc_cache_size = m_blocks_cache.get_size() + m_block_headers_cache.get_size() + m_short_blocks_cache.get_size() + m_block_details_cache.get_size();
+    res.rpc_cache_hits = m_blocks_cache.get_hits() + m_block_headers_cache.get_hits() + m_short_blocks_cache.get_hits() + m_block_details_cache.get_hits();
+    res.rpc_cache_misses = m_blocks_cache.get_misses() + m_block_headers_cache.get_misses() + m_short_blocks_cache.get_misses() + m_block_details_cache.get_misses();
+
     res.synchronization_start_height = m_p2p.get_payload_object().get_core_inital_height();
     res.max_net_seen_height = m_p2p.get_payload_object().get_max_seen_height();
     m_p2p.get_maintainers_info(res.mi);
@@ -118,6 +218,76 @@ namespace currency
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_rpc_stats(const COMMAND_RPC_GET_RPC_STATS::request& req, COMMAND_RPC_GET_RPC_STATS::response& res, connection_context& cntx)
+  {
+    std::list<std::pair<std::string, rpc_endpoint_stats> > stats;
+    m_scheduler.get_stats(stats);
+    for (const auto& s : stats)
+    {
+      if (!s.second.calls)
+        continue;
+      COMMAND_RPC_GET_RPC_STATS::endpoint_stats es = AUTO_VAL_INIT(es);
+      es.endpoint = s.first;
+      es.calls = s.second.calls;
+      es.rejected = s.second.rejected;
+      es.active = s.second.active;
+      es.queue_depth = s.second.queue_depth;
+      es.max_queue_depth = s.second.max_queue_depth;
+      es.avg_wait_us = s.second.total_wait_us / s.second.calls;
+      es.avg_run_us = s.second.completed ? s.second.total_run_us / s.second.completed : 0;
+      es.max_run_us = s.second.max_run_us;
+      res.endpoints.push_back(es);
+    }
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_subscribe(const COMMAND_RPC_SUBSCRIBE::request& req, COMMAND_RPC_SUBSCRIBE::response& res, connection_context& cntx)
+  {
+    core_event_journal& journal = m_core.get_event_journal();
+    res.journal_id = journal.get_id();
+    if (req.journal_id && req.journal_id != res.journal_id)
+    {
+      //since_seq is from the journal of another daemon run
+      res.last_seq = journal.get_last_seq();
+      res.events_lost = true;
+      res.status = CORE_RPC_STATUS_OK;
+      return true;
+    }
+
+    //each waiting call holds a server thread, calls over the limit are answered at once
+    uint64_t timeout_ms = std::min<uint64_t>(req.timeout_ms, CORE_RPC_SUBSCRIBE_MAX_TIMEOUT_MS);
+    if (++m_subscribe_threads > m_subscribe_threads_limit)
+      timeout_ms = 0;
+    std::list<core_event> events;
+    res.events_lost = !journal.wait_events(req.since_seq, timeout_ms, CORE_RPC_SUBSCRIBE_MAX_EVENTS, events, res.last_seq);
+    --m_subscribe_threads;
+    if (events.size())
+      res.last_seq = events.back().seq;
+
+    blockchain_storage& bcs = m_core.get_blockchain_storage();
+    for (const auto& ev : events)
+    {
+      COMMAND_RPC_SUBSCRIBE::event_entry ee = AUTO_VAL_INIT(ee);
+      ee.seq = ev.seq;
+      ee.type = get_core_event_type_name(ev.type);
+      ee.id = string_tools::pod_to_hex(ev.id);
+      ee.height = ev.height;
+      block blk = AUTO_VAL_INIT(blk);
+      if (ev.type == core_event_block_added && bcs.get_block_by_height(ev.height, blk) && get_block_hash(blk) == ev.id)
+        fill_block_header_responce(blk, false, ee.block_header);
+      res.events.push_back(ee);
+    }
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::send_stop_signal()
+  {
+    m_core.get_event_journal().interrupt_waits();
+    return epee::http_server_impl_base<core_rpc_server, connection_context>::send_stop_signal();
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_stop_daemon(const COMMAND_RPC_STOP_DAEMON::request& req, COMMAND_RPC_STOP_DAEMON::response& res, connection_context& cntx)
   {
 	  m_p2p.send_stop_signal();
@@ -128,24 +298,79 @@ namespace currency
   bool core_rpc_server::on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res, connection_context& cntx)
   {
     CHECK_CORE_READY();
-    std::list<std::pair<block, std::list<transaction> > > bs;
-    if(!m_core.find_blockchain_supplement(req.block_ids, bs, res.current_height, res.start_height, COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT))
-    {
-      res.status = "Failed";
-      return false;
-    }
+    blockchain_storage& bcs = m_core.get_blockchain_storage();
+    //entries are taken block by block, the response is given only if main chain wasn't changed meanwhile
+    for (size_t attempt = 0; attempt != 3; ++attempt)
+    {
+      uint64_t chain_version = bcs.get_main_chain_rollbacks_count();
+      res.blocks.clear();
+      res.blocks_global_outs.clear();
+      if (!bcs.find_blockchain_supplement(req.block_ids, res.start_height))
+      {
+        res.status = "Failed";
+        return false;
+      }
+      res.current_height = bcs.get_current_blockchain_height();
 
-    BOOST_FOREACH(auto& b, bs)
-    {
-      res.blocks.resize(res.blocks.size()+1);
-      res.blocks.back().block = block_to_blob(b.first);
-      BOOST_FOREACH(auto& t, b.second)
+      bool r = true;
+      for (uint64_t h = res.start_height; r && h < res.current_height && h - res.start_height < COMMAND_RPC_GET_BLOCKS_FAST_MAX_COUNT; ++h)
+      {
+        blocks_cache_entry e = AUTO_VAL_INIT(e);
+        r = get_blocks_cache_entry(h, chain_version, e);
+        if (!r)
+          break;
+        res.blocks.push_back(std::move(e.bce));
+        if (req.need_global_indexes)
+          res.blocks_global_outs.push_back(std::move(e.global_outs));
+      }
+      if (chain_version != bcs.get_main_chain_rollbacks_count())
+        continue;
+      if (!r)
       {
-        res.blocks.back().txs.push_back(tx_to_blob(t));
+        res.status = "Failed";
+        return false;
       }
+      res.status = CORE_RPC_STATUS_OK;
+      return true;
     }
 
-    res.status = CORE_RPC_STATUS_OK;
+    res.status = CORE_RPC_STATUS_BUSY;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::get_blocks_cache_entry(uint64_t height, uint64_t chain_version, blocks_cache_entry& e)
+  {
+    if (m_blocks_cache.get(height, chain_version, e))
+      return true;
+
+    block b = AUTO_VAL_INIT(b);
+    if (!m_core.get_blockchain_storage().get_block_complete_entry(height, b, e.bce))
+      return false;
+
+    uint64_t size = e.bce.block.size();
+    BOOST_FOREACH(const auto& tx_blob, e.bce.txs)
+      size += tx_blob.size();
+    //global indexes are prepared always, the same entry serves requests with and without need_global_indexes
+    e.global_outs.txs.resize(b.tx_hashes.size() + 1);
+    crypto::hash tx_id = get_transaction_hash(b.miner_tx);
+    bool r = m_core.get_tx_outputs_gindexs(tx_id, e.global_outs.txs[0].indexes);
+    size += e.global_outs.txs[0].indexes.size() * sizeof(uint64_t);
+    size_t i = 1;
+    BOOST_FOREACH(const auto& h, b.tx_hashes)
+    {
+      if (!r)
+        break;
+      tx_id = h;
+      r = m_core.get_tx_outputs_gindexs(tx_id, e.global_outs.txs[i].indexes);
+      size += e.global_outs.txs[i++].indexes.size() * sizeof(uint64_t);
+    }
+    if (!r)
+    {
+      LOG_PRINT_L0("on_get_blocks: failed to get global outputs indexes for tx " << tx_id);
+      return false;
+    }
+
+    m_blocks_cache.put(height, chain_version, e, size);
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
@@ -222,6 +447,17 @@ namespace currency
     return true;
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool core_rpc_server::on_get_pool_changes(const COMMAND_RPC_GET_POOL_CHANGES::request& req, COMMAND_RPC_GET_POOL_CHANGES::response& res, connection_context& cntx)
+  {
+    CHECK_CORE_READY();
+    std::list<transaction> txs;
+    res.full = !m_core.get_pool_changes(req.since_version, txs, res.removed_ids, res.version);
+    for (auto& tx : txs)
+      res.txs.push_back(t_serializable_object_to_blob(tx));
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool core_rpc_server::on_check_keyimages(const COMMAND_RPC_CHECK_KEYIMAGES::request& req, COMMAND_RPC_CHECK_KEYIMAGES::response& res, connection_context& cntx)
   {
     m_core.get_blockchain_storage().check_keyimages(req.images, res.images_stat);
@@ -670,6 +906,14 @@ namespace currency
       error_resp.message = std::string("To big height: ") + std::to_string(req.height) + ", current blockchain height = " +  std::to_string(m_core.get_current_blockchain_height());
       return false;
     }
+    uint64_t chain_version = m_core.get_blockchain_storage().get_main_chain_rollbacks_count();
+    if (m_block_headers_cache.get(req.height, chain_version, res.block_header))
+    {
+      res.block_header.depth = m_core.get_current_blockchain_height() - res.block_header.height - 1;
+      res.status = CORE_RPC_STATUS_OK;
+      return true;
+    }
+
     block blk = AUTO_VAL_INIT(blk);
     m_core.get_blockchain_storage().get_block_by_height(req.height, blk);
     
@@ -680,6 +924,7 @@ namespace currency
       error_resp.message = "Internal error: can't produce valid response.";
       return false;
     }
+    m_block_headers_cache.put(req.height, chain_version, res.block_header, sizeof(res.block_header) + res.block_header.hash.size() + res.block_header.prev_hash.size());
     res.status = CORE_RPC_STATUS_OK;
     return true;
   }
@@ -703,7 +948,16 @@ bool core_rpc_server::f_on_blocks_list_json(const F_COMMAND_RPC_GET_BLOCKS_LIST:
     last_height = 0;
   } 
 
+  uint64_t chain_version = m_core.get_blockchain_storage().get_main_chain_rollbacks_count();
   for (uint32_t i = req.height; i >= last_height; i--) {
+    f_block_short_response block_short;
+    if (m_short_blocks_cache.get(i, chain_version, block_short)) {
+      res.blocks.push_back(block_short);
+      if (i == 0)
+        break;
+      continue;
+    }
+
     crypto::hash block_hash = m_core.get_block_id_by_height(static_cast<uint32_t>(i));
     block blk;
     if (!m_core.get_block_by_hash(block_hash, blk)) {
@@ -720,7 +974,6 @@ bool core_rpc_server::f_on_blocks_list_json(const F_COMMAND_RPC_GET_BLOCKS_LIST:
     size_t blokBlobSize = get_object_blobsize(blk);
     size_t minerTxBlobSize = get_object_blobsize(blk.miner_tx);
 
-    f_block_short_response block_short;
     block_short.cumul_size = blokBlobSize + tx_cumulative_block_size - minerTxBlobSize;
     block_short.timestamp = blk.timestamp;
     block_short.height = i;
@@ -728,6 +981,7 @@ bool core_rpc_server::f_on_blocks_list_json(const F_COMMAND_RPC_GET_BLOCKS_LIST:
     block_short.cumul_size = blokBlobSize + tx_cumulative_block_size - minerTxBlobSize;
     block_short.tx_count = blk.tx_hashes.size() + 1;
     block_short.difficulty = m_core.get_blockchain_storage().block_difficulty(i).convert_to<uint64_t>();
+    m_short_blocks_cache.put(i, chain_version, block_short, sizeof(block_short) + block_short.hash.size());
     res.blocks.push_back(block_short);
 
     if (i == 0)
@@ -748,6 +1002,13 @@ bool core_rpc_server::f_on_block_json(const F_COMMAND_RPC_GET_BLOCK_DETAILS::req
       
   }
 
+  uint64_t chain_version = m_core.get_blockchain_storage().get_main_chain_rollbacks_count();
+  if (m_block_details_cache.get(hash, chain_version, res.block)) {
+    res.block.depth = m_core.get_current_blockchain_height() - res.block.height - 1;
+    res.status = CORE_RPC_STATUS_OK;
+    return true;
+  }
+
   block blk;
   if (!m_core.get_block_by_hash(hash, blk)) {
     error_resp.code = CORE_RPC_ERROR_CODE_INTERNAL_ERROR;
@@ -874,6 +1135,11 @@ bool core_rpc_server::f_on_block_json(const F_COMMAND_RPC_GET_BLOCK_DETAILS::req
     res.block.totalFeeAmount += transaction_short.fee;
   }
 
+  uint64_t details_size = sizeof(res.block) + res.block.hash.size() + res.block.prev_hash.size();
+  for (const auto& t : res.block.transactions)
+    details_size += sizeof(t) + t.hash.size();
+  m_block_details_cache.put(hash, chain_version, res.block, details_size);
+
   res.status = CORE_RPC_STATUS_OK;
   return true;
 }
@@ -1310,6 +1576,7 @@ bool core_rpc_server::f_getMixin(const transaction& transaction, uint64_t& mixin
     }
 
     b.nonce = req.nonce;
+    b.invalidate_hashes();
 
     if(!m_core.handle_block_found(b))
     {
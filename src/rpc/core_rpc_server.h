@@ -13,6 +13,8 @@
 #include "p2p/net_node.h"
 #include "currency_protocol/currency_protocol_handler.h"
 #include "mining_protocol_defs.h"
+#include "core_rpc_cache.h"
+#include "core_rpc_scheduler.h"
 
 namespace currency
 {
@@ -28,6 +30,9 @@ namespace currency
 
     static void init_options(boost::program_options::options_description& desc);
     bool init(const boost::program_options::variables_map& vm);
+    size_t get_threads_count() const { return m_threads_count; }
+    //also wakes up /subscribe long-polls so server threads can stop
+    bool send_stop_signal();
 
     bool on_get_height(const COMMAND_RPC_GET_HEIGHT::request& req, COMMAND_RPC_GET_HEIGHT::response& res, connection_context& cntx);
     bool on_get_blocks(const COMMAND_RPC_GET_BLOCKS_FAST::request& req, COMMAND_RPC_GET_BLOCKS_FAST::response& res, connection_context& cntx);
@@ -41,7 +46,10 @@ namespace currency
     bool on_stop_daemon(const COMMAND_RPC_STOP_DAEMON::request& req, COMMAND_RPC_STOP_DAEMON::response& res, connection_context& cntx);
     bool on_set_maintainers_info(const COMMAND_RPC_SET_MAINTAINERS_INFO::request& req, COMMAND_RPC_SET_MAINTAINERS_INFO::response& res, connection_context& cntx);
     bool on_get_tx_pool(const COMMAND_RPC_GET_TX_POOL::request& req, COMMAND_RPC_GET_TX_POOL::response& res, connection_context& cntx);
+    bool on_get_pool_changes(const COMMAND_RPC_GET_POOL_CHANGES::request& req, COMMAND_RPC_GET_POOL_CHANGES::response& res, connection_context& cntx);
     bool on_check_keyimages(const COMMAND_RPC_CHECK_KEYIMAGES::request& req, COMMAND_RPC_CHECK_KEYIMAGES::response& res, connection_context& cntx);
+    bool on_get_rpc_stats(const COMMAND_RPC_GET_RPC_STATS::request& req, COMMAND_RPC_GET_RPC_STATS::response& res, connection_context& cntx);
+    bool on_subscribe(const COMMAND_RPC_SUBSCRIBE::request& req, COMMAND_RPC_SUBSCRIBE::response& res, connection_context& cntx);
     
 
     //json_rpc
@@ -78,7 +86,8 @@ namespace currency
 
   private:
 
-    CHAIN_HTTP_TO_MAP2(connection_context); //forward http requests to uri map
+    //forwards http requests to uri map once rpc_request_scheduler lets them in
+    virtual bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, connection_context& m_conn_context);
 
     BEGIN_URI_MAP2()
       MAP_URI_AUTO_JON2("/getheight", on_get_height, COMMAND_RPC_GET_HEIGHT)
@@ -87,12 +96,15 @@ namespace currency
       MAP_URI_AUTO_BIN2("/getrandom_outs.bin", on_get_random_outs, COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS)
       MAP_URI_AUTO_BIN2("/set_maintainers_info.bin", on_set_maintainers_info, COMMAND_RPC_SET_MAINTAINERS_INFO)
       MAP_URI_AUTO_BIN2("/get_tx_pool.bin", on_get_tx_pool, COMMAND_RPC_GET_TX_POOL)
+      MAP_URI_AUTO_BIN2("/get_pool_changes.bin", on_get_pool_changes, COMMAND_RPC_GET_POOL_CHANGES)
       MAP_URI_AUTO_BIN2("/check_keyimages.bin", on_check_keyimages, COMMAND_RPC_CHECK_KEYIMAGES)
       MAP_URI_AUTO_JON2("/gettransactions", on_get_transactions, COMMAND_RPC_GET_TRANSACTIONS)
       MAP_URI_AUTO_JON2("/sendrawtransaction", on_send_raw_tx, COMMAND_RPC_SEND_RAW_TX)
       MAP_URI_AUTO_JON2_IF("/start_mining", on_start_mining, COMMAND_RPC_START_MINING, !m_restricted)
       MAP_URI_AUTO_JON2_IF("/stop_mining", on_stop_mining, COMMAND_RPC_STOP_MINING, !m_restricted)
       MAP_URI_AUTO_JON2("/getinfo", on_get_info, COMMAND_RPC_GET_INFO)
+      MAP_URI_AUTO_JON2("/getrpcstats", on_get_rpc_stats, COMMAND_RPC_GET_RPC_STATS)
+      MAP_URI_AUTO_JON2("/subscribe", on_subscribe, COMMAND_RPC_SUBSCRIBE)
       MAP_URI_AUTO_JON2_IF("/stop_daemon", on_stop_daemon, COMMAND_RPC_STOP_DAEMON, !m_restricted)
       MAP_URI2("/getfullscratchpad2", on_getfullscratchpad2)
       BEGIN_JSON_RPC_MAP("/json_rpc")
@@ -127,11 +139,21 @@ namespace currency
 
     //-----------------------
     bool handle_command_line(const boost::program_options::variables_map& vm);
+    void init_scheduler(size_t reserved_threads, size_t heavy_requests_limit, uint64_t queue_timeout_ms);
+    std::string get_request_endpoint(const epee::net_utils::http::http_request_info& query_info);
     bool check_core_ready();
     bool get_addendum_for_hi(const mining::height_info& hi, std::list<mining::addendum>& res);
     bool get_job(const std::string& job_id, mining::job_details& job, epee::json_rpc::error& err, connection_context& cntx);
     bool get_current_hi(mining::height_info& hi);
 
+    //getblocks.bin entry of one block, taken from m_blocks_cache or prepared and put there
+    struct blocks_cache_entry
+    {
+      block_complete_entry bce;
+      COMMAND_RPC_GET_BLOCKS_FAST::block_global_outs global_outs;
+    };
+    bool get_blocks_cache_entry(uint64_t height, uint64_t chain_version, blocks_cache_entry& e);
+
     //utils
     uint64_t get_block_reward(const block& blk);
     bool fill_block_header_responce(const block& blk, bool orphan_status, block_header_responce& responce);
@@ -147,5 +169,14 @@ namespace currency
     epee::critical_section m_session_jobs_lock;
     std::map<std::string, currency::block> m_session_jobs; //session id -> blob
     std::atomic<size_t> m_session_counter;
+    //prepared responses for main chain blocks
+    rpc_response_cache<uint64_t, blocks_cache_entry> m_blocks_cache;                    // by height
+    rpc_response_cache<uint64_t, block_header_responce> m_block_headers_cache;          // by height
+    rpc_response_cache<uint64_t, f_block_short_response> m_short_blocks_cache;          // by height
+    rpc_response_cache<crypto::hash, f_block_details_response> m_block_details_cache;   // by block hash
+    size_t m_threads_count;
+    rpc_request_scheduler m_scheduler;
+    size_t m_subscribe_threads_limit;
+    std::atomic<size_t> m_subscribe_threads;   // threads waiting in /subscribe
   };
 }
@@ -20,6 +20,9 @@ namespace currency
 #define CORE_RPC_STATUS_FAILED              "FAILED"
 #define CORE_RPC_STATUS_INVALID_ARGUMENT    "INVALID_ARGUMENT"
 
+#define CORE_RPC_SUBSCRIBE_MAX_TIMEOUT_MS   30000
+#define CORE_RPC_SUBSCRIBE_MAX_EVENTS       1000
+
 struct EMPTY_STRUCT {
   BEGIN_KV_SERIALIZE_MAP()
   END_KV_SERIALIZE_MAP()
@@ -74,21 +77,43 @@ struct EMPTY_STRUCT {
     struct request
     {
       std::list<crypto::hash> block_ids; //*first 10 blocks id goes sequential, next goes in pow(2,n) offset, like 2, 4, 8, 16, 32, 64 and so on, and the last one is always genesis block */
+      bool need_global_indexes;          // fill response::blocks_global_outs, saves get_o_indexes.bin call for every transaction with our outputs
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE_CONTAINER_POD_AS_BLOB(block_ids)
+        KV_SERIALIZE(need_global_indexes)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct tx_global_outs
+    {
+      std::vector<uint64_t> indexes;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(indexes)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct block_global_outs
+    {
+      std::vector<tx_global_outs> txs; // miner tx goes first, then transactions in the order of block_complete_entry::txs
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(txs)
       END_KV_SERIALIZE_MAP()
     };
 
     struct response
     {
       std::list<block_complete_entry> blocks;
+      std::list<block_global_outs> blocks_global_outs; // one entry per block if requested, empty from older daemons
       uint64_t    start_height;
       uint64_t    current_height;
       std::string status;
 
       BEGIN_KV_SERIALIZE_MAP()
         KV_SERIALIZE(blocks)
+        KV_SERIALIZE(blocks_global_outs)
         KV_SERIALIZE(start_height)
         KV_SERIALIZE(current_height)
         KV_SERIALIZE(status)
@@ -142,6 +167,35 @@ struct EMPTY_STRUCT {
     };
   };
   //-----------------------------------------------
+  struct COMMAND_RPC_GET_POOL_CHANGES
+  {
+    struct request
+    {
+      uint64_t since_version;   //version from the previous response, 0 for the first call
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(since_version)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      uint64_t version;
+      bool full;                             //since_version is unknown to the daemon, txs is the whole pool
+      std::list<crypto::hash> removed_ids;   //apply before txs, a tx may be removed and added again
+      std::list<blobdata> txs;               //transactions added after since_version
+      std::string status;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(version)
+        KV_SERIALIZE(full)
+        KV_SERIALIZE_CONTAINER_POD_AS_BLOB(removed_ids)
+        KV_SERIALIZE(txs)
+        KV_SERIALIZE(status)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+  //-----------------------------------------------
   struct COMMAND_RPC_CHECK_KEYIMAGES
   {
     struct request
@@ -331,6 +385,9 @@ struct EMPTY_STRUCT {
       uint64_t max_net_seen_height;
       uint64_t transactions_cnt_per_day;
       uint64_t transactions_volume_per_day;
+      uint64_t rpc_cache_size;
+      uint64_t rpc_cache_hits;
+      uint64_t rpc_cache_misses;
       nodetool::maintainers_info_external mi;
 
       BEGIN_KV_SERIALIZE_MAP()
@@ -354,6 +411,9 @@ struct EMPTY_STRUCT {
         KV_SERIALIZE(max_net_seen_height)
         KV_SERIALIZE(transactions_cnt_per_day)
         KV_SERIALIZE(transactions_volume_per_day)
+        KV_SERIALIZE(rpc_cache_size)
+        KV_SERIALIZE(rpc_cache_hits)
+        KV_SERIALIZE(rpc_cache_misses)
         KV_SERIALIZE(mi)
       END_KV_SERIALIZE_MAP()
     };
@@ -377,6 +437,51 @@ struct EMPTY_STRUCT {
 	  };
   };
   //-----------------------------------------------
+  struct COMMAND_RPC_GET_RPC_STATS
+  {
+    struct request
+    {
+      BEGIN_KV_SERIALIZE_MAP()
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct endpoint_stats
+    {
+      std::string endpoint;          // uri, or "/json_rpc/" + method name
+      uint64_t calls;
+      uint64_t rejected;             // answered with "503 Service Unavailable"
+      uint64_t active;
+      uint64_t queue_depth;
+      uint64_t max_queue_depth;
+      uint64_t avg_wait_us;
+      uint64_t avg_run_us;
+      uint64_t max_run_us;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(endpoint)
+        KV_SERIALIZE(calls)
+        KV_SERIALIZE(rejected)
+        KV_SERIALIZE(active)
+        KV_SERIALIZE(queue_depth)
+        KV_SERIALIZE(max_queue_depth)
+        KV_SERIALIZE(avg_wait_us)
+        KV_SERIALIZE(avg_run_us)
+        KV_SERIALIZE(max_run_us)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      std::list<endpoint_stats> endpoints;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(endpoints)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+  //-----------------------------------------------
   struct COMMAND_RPC_STOP_MINING
   {
     struct request
@@ -606,6 +711,57 @@ struct EMPTY_STRUCT {
 
   };
 
+  //long-poll for main chain and pool changes
+  struct COMMAND_RPC_SUBSCRIBE
+  {
+    struct request
+    {
+      uint64_t since_seq;            // last_seq of the previous response
+      uint64_t timeout_ms;           // how long to wait if there are no events yet, up to CORE_RPC_SUBSCRIBE_MAX_TIMEOUT_MS
+      uint64_t journal_id;           // journal_id of the previous response, 0 for the first call
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(since_seq)
+        KV_SERIALIZE(timeout_ms)
+        KV_SERIALIZE(journal_id)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct event_entry
+    {
+      uint64_t seq;
+      std::string type;              // "block_added", "block_removed", "tx_added" or "tx_removed"
+      std::string id;
+      uint64_t height;
+      block_header_responce block_header; // filled for "block_added" blocks which are still in the main chain
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(seq)
+        KV_SERIALIZE(type)
+        KV_SERIALIZE(id)
+        KV_SERIALIZE(height)
+        KV_SERIALIZE(block_header)
+      END_KV_SERIALIZE_MAP()
+    };
+
+    struct response
+    {
+      std::string status;
+      uint64_t journal_id;           // changes when daemon restarts, seq numbers start over then
+      uint64_t last_seq;
+      bool events_lost;              // events after since_seq are not kept anymore (or daemon restarted), re-read the state
+      std::list<event_entry> events;
+
+      BEGIN_KV_SERIALIZE_MAP()
+        KV_SERIALIZE(status)
+        KV_SERIALIZE(journal_id)
+        KV_SERIALIZE(last_seq)
+        KV_SERIALIZE(events_lost)
+        KV_SERIALIZE(events)
+      END_KV_SERIALIZE_MAP()
+    };
+  };
+
   struct COMMAND_RPC_GET_ALIAS_DETAILS
   {
     struct request
@@ -0,0 +1,223 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+/* binary_buffer_archive.h
+ *
+ * The same format as binary_archive, but reads from a memory buffer and writes to a string, without iostreams.
+ * Buffer "streams" below implement only the part of std::istream/std::ostream interface that serializers use
+ * (state bits and peek() for the end-of-input check). */
+#pragma once
+
+#include <cstring>
+#include <string>
+#include <ios>
+
+#include "binary_archive.h"
+#include "serialization.h"
+
+PUSH_WARNINGS
+DISABLE_VS_WARNINGS(4244)
+DISABLE_VS_WARNINGS(4100)
+
+class binary_buffer_istream
+{
+public:
+  binary_buffer_istream(const char* data, size_t size) : m_pos(data), m_end(data + size), m_state(std::ios_base::goodbit) { }
+
+  bool good() const { return m_state == std::ios_base::goodbit; }
+  std::ios_base::iostate rdstate() const { return m_state; }
+  void setstate(std::ios_base::iostate state) { m_state |= state; }
+  void clear(std::ios_base::iostate state = std::ios_base::goodbit) { m_state = state; }
+
+  int peek()
+  {
+    if (!good())
+      return EOF;
+    if (m_pos == m_end)
+    {
+      m_state |= std::ios_base::eofbit;
+      return EOF;
+    }
+    return static_cast<unsigned char>(*m_pos);
+  }
+  // reads exactly len bytes or fails like std::istream::read()
+  bool read(char* buf, size_t len)
+  {
+    if (!good())
+      return false;
+    size_t available = m_end - m_pos;
+    if (len > available)
+    {
+      memcpy(buf, m_pos, available);
+      m_pos = m_end;
+      m_state |= std::ios_base::eofbit | std::ios_base::failbit;
+      return false;
+    }
+    memcpy(buf, m_pos, len);
+    m_pos += len;
+    return true;
+  }
+
+  const char*& pos() { return m_pos; }
+  const char* end() const { return m_end; }
+  size_t remaining_bytes() const { return m_end - m_pos; }
+
+private:
+  const char* m_pos;
+  const char* m_end;
+  std::ios_base::iostate m_state;
+};
+
+class binary_buffer_ostream
+{
+public:
+  explicit binary_buffer_ostream(std::string& buff) : m_buff(buff), m_state(std::ios_base::goodbit) { }
+
+  bool good() const { return m_state == std::ios_base::goodbit; }
+  std::ios_base::iostate rdstate() const { return m_state; }
+  void setstate(std::ios_base::iostate state) { m_state |= state; }
+  void clear(std::ios_base::iostate state = std::ios_base::goodbit) { m_state = state; }
+
+  void put(char c) { m_buff.push_back(c); }
+  void write(const char* data, size_t len) { m_buff.append(data, len); }
+  std::string& buffer() { return m_buff; }
+
+private:
+  std::string& m_buff;
+  std::ios_base::iostate m_state;
+};
+
+template <bool W>
+struct binary_buffer_archive;
+
+template <>
+struct binary_buffer_archive<false> : public binary_archive_base<binary_buffer_istream, false>
+{
+  explicit binary_buffer_archive(stream_type &s) : base_type(s) { }
+
+  template <class T>
+  void serialize_int(T &v)
+  {
+    serialize_uint(*(typename boost::make_unsigned<T>::type *)&v);
+  }
+
+  template <class T>
+  void serialize_uint(T &v, size_t width = sizeof(T))
+  {
+    if (stream_.remaining_bytes() < width)
+    {
+      stream_.pos() = stream_.end();
+      stream_.setstate(std::ios_base::eofbit | std::ios_base::failbit);
+      return;
+    }
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(stream_.pos());
+    T ret = 0;
+    for (size_t i = 0; i < width; i++)
+      ret += static_cast<T>(p[i]) << (8 * i);
+    stream_.pos() += width;
+    v = ret;
+  }
+  void serialize_blob(void *buf, size_t len, const char *delimiter="") { stream_.read((char *)buf, len); }
+
+  template <class T>
+  void serialize_varint(T &v)
+  {
+    serialize_uvarint(*(typename boost::make_unsigned<T>::type *)(&v));
+  }
+
+  template <class T>
+  void serialize_uvarint(T &v)
+  {
+    // errors are ignored the same way binary_archive does, the result should be identical for any input
+    if (!stream_.good())
+      return;
+    const char* end = stream_.end();
+    tools::read_varint<std::numeric_limits<T>::digits>(stream_.pos(), end, v);
+  }
+  void serialize_varint_array(uint64_t* v, size_t count)
+  {
+    if (!stream_.good())
+      return;
+    tools::read_varint_array(stream_.pos(), stream_.end(), v, count);
+  }
+  void begin_array(size_t &s)
+  {
+    serialize_varint(s);
+  }
+  void begin_array() { }
+
+  void delimit_array() { }
+  void end_array() { }
+
+  void begin_string(const char *delimiter="\"") { }
+  void end_string(const char *delimiter="\"") { }
+
+  void read_variant_tag(variant_tag_type &t) {
+    serialize_int(t);
+  }
+
+  size_t remaining_bytes() {
+    if (!stream_.good())
+      return 0;
+    return stream_.remaining_bytes();
+  }
+};
+
+template <>
+struct binary_buffer_archive<true> : public binary_archive_base<binary_buffer_ostream, true>
+{
+  explicit binary_buffer_archive(stream_type &s) : base_type(s) { }
+
+  template <class T>
+  void serialize_int(T v)
+  {
+    serialize_uint(static_cast<typename boost::make_unsigned<T>::type>(v));
+  }
+  template <class T>
+  void serialize_uint(T v)
+  {
+    for (size_t i = 0; i < sizeof(T); i++) {
+      stream_.put((char)(v & 0xff));
+      if (1 < sizeof(T)) {
+        v >>= 8;
+      }
+    }
+  }
+  void serialize_blob(void *buf, size_t len, const char *delimiter="") { stream_.write((char *)buf, len); }
+
+  template <class T>
+  void serialize_varint(T &v)
+  {
+    serialize_uvarint(*(typename boost::make_unsigned<T>::type *)(&v));
+  }
+
+  template <class T>
+  void serialize_uvarint(T &v)
+  {
+    tools::write_varint(std::back_inserter(stream_.buffer()), v);
+  }
+  void serialize_varint_array(const uint64_t* v, size_t count)
+  {
+    tools::write_varint_array(stream_.buffer(), v, count);
+  }
+  void begin_array(size_t s)
+  {
+    serialize_varint(s);
+  }
+  void begin_array() { }
+  void delimit_array() { }
+  void end_array() { }
+
+  void begin_string(const char *delimiter="\"") { }
+  void end_string(const char *delimiter="\"") { }
+
+  void write_variant_tag(variant_tag_type t) {
+    serialize_int(t);
+  }
+};
+
+template <bool W>
+struct has_varint_array_serializer<binary_buffer_archive<W> > { typedef boost::true_type type; };
+
+POP_WARNINGS
@@ -2,26 +2,25 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
-#include <sstream>
-#include "binary_archive.h"
+#include "binary_buffer_archive.h"
 
 namespace serialization {
 
 template <class T>
 bool parse_binary(const std::string &blob, T &v)
 {
-  std::istringstream istr(blob);
-  binary_archive<false> iar(istr);
+  binary_buffer_istream istr(blob.data(), blob.size());
+  binary_buffer_archive<false> iar(istr);
   return ::serialization::serialize(iar, v);
 }
 
 template<class T>
 bool dump_binary(T& v, std::string& blob)
 {
-  std::stringstream ostr;
-  binary_archive<true> oar(ostr);
+  blob.clear();
+  binary_buffer_ostream ostr(blob);
+  binary_buffer_archive<true> oar(ostr);
   bool success = ::serialization::serialize(oar, v);
-  blob = ostr.str();
   return success && ostr.good();
 };
 
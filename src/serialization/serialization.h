@@ -15,6 +15,8 @@ template <class T>
 struct is_blob_type { typedef boost::false_type type; };
 template <class T>
 struct has_free_serializer { typedef boost::true_type type; };
+template <class Archive>
+struct has_varint_array_serializer { typedef boost::false_type type; };
 
 template <class Archive, class T>
 struct serializer
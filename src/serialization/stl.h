@@ -13,6 +13,10 @@ template <template <bool> class Archive, class T>
 bool do_serialize(Archive<false> &ar, std::vector<T> &v);
 template <template <bool> class Archive, class T>
 bool do_serialize(Archive<true> &ar, std::vector<T> &v);
+template <template <bool> class Archive>
+bool do_serialize(Archive<false> &ar, std::vector<uint64_t> &v);
+template <template <bool> class Archive>
+bool do_serialize(Archive<true> &ar, std::vector<uint64_t> &v);
 
 namespace serialization
 {
@@ -30,6 +34,27 @@ namespace serialization
       ar.serialize_varint(e);
       return true;
     }
+
+    template <typename Archive>
+    bool serialize_varint_array(Archive& ar, uint64_t* v, size_t cnt, boost::false_type)
+    {
+      for (size_t i = 0; i < cnt; i++) {
+        if (i > 0)
+          ar.delimit_array();
+        ar.serialize_varint(v[i]);
+        if (!ar.stream().good())
+          return false;
+      }
+      return true;
+    }
+
+    // archives with bulk varint codec (see common/varint.h)
+    template <typename Archive>
+    bool serialize_varint_array(Archive& ar, uint64_t* v, size_t cnt, boost::true_type)
+    {
+      ar.serialize_varint_array(v, cnt);
+      return ar.stream().good();
+    }
   }
 }
 
@@ -139,7 +164,7 @@ bool do_serialize(Archive<false> &ar, std::set<T> &v)
       return false;
     if (!ar.stream().good())
       return false;
-    v.insert(t);
+    v.insert(std::move(t));
   }
   ar.end_array();
   return true;
@@ -190,6 +215,36 @@ bool do_serialize(Archive<true> &ar, std::vector<bool> &v)
   ar.end_array();
   return true;
 }
+template <template <bool> class Archive>
+bool do_serialize(Archive<false> &ar, std::vector<bool> &v)
+{
+  size_t cnt;
+  ar.begin_array(cnt);
+  if (!ar.stream().good())
+    return false;
+  v.clear();
+
+  // very basic sanity check
+  if (ar.remaining_bytes() < cnt) {
+    ar.stream().setstate(std::ios::failbit);
+    return false;
+  }
+
+  v.reserve(cnt);
+  for (size_t i = 0; i < cnt; i++) {
+    if (i > 0)
+      ar.delimit_array();
+
+    bool local_b = false;
+    if (!::serialization::detail::serialize_container_element(ar, local_b))
+      return false;
+    if (!ar.stream().good())
+      return false;
+    v.push_back(local_b);
+  }
+  ar.end_array();
+  return true;
+}
 template <template <bool> class Archive, class T>
 bool do_serialize(Archive<false> &ar, std::vector<T> &v)
 {
@@ -210,12 +265,12 @@ bool do_serialize(Archive<false> &ar, std::vector<T> &v)
     if (i > 0)
       ar.delimit_array();
 
-    T t = T();
-    if (!::serialization::detail::serialize_container_element(ar, t))
+    // decode in place, without a temporary copy of the element and its nested containers
+    v.emplace_back();
+    if (!::serialization::detail::serialize_container_element(ar, v.back()))
       return false;
     if (!ar.stream().good())
       return false;
-    v.push_back(t);
   }
   ar.end_array();
   return true;
@@ -238,4 +293,39 @@ bool do_serialize(Archive<true> &ar, std::vector<T> &v)
   }
   ar.end_array();
   return true;
-}
\ No newline at end of file
+}
+
+template <template <bool> class Archive>
+bool do_serialize(Archive<false> &ar, std::vector<uint64_t> &v)
+{
+  size_t cnt;
+  ar.begin_array(cnt);
+  if (!ar.stream().good())
+    return false;
+  v.clear();
+
+  // very basic sanity check
+  if (ar.remaining_bytes() < cnt) {
+    ar.stream().setstate(std::ios::failbit);
+    return false;
+  }
+
+  v.resize(cnt);
+  if (!::serialization::detail::serialize_varint_array(ar, v.data(), cnt, typename has_varint_array_serializer<Archive<false> >::type()))
+    return false;
+  ar.end_array();
+  return true;
+}
+
+template <template <bool> class Archive>
+bool do_serialize(Archive<true> &ar, std::vector<uint64_t> &v)
+{
+  size_t cnt = v.size();
+  ar.begin_array(cnt);
+  if (!ar.stream().good())
+    return false;
+  if (!::serialization::detail::serialize_varint_array(ar, v.data(), cnt, typename has_varint_array_serializer<Archive<true> >::type()))
+    return false;
+  ar.end_array();
+  return true;
+}
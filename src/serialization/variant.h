@@ -28,13 +28,13 @@ struct variant_reader
   static inline bool read(Archive &ar, Variant &v, variant_tag_type t)
   {
     if (variant_serialization_traits<Archive, current_type>::get_tag() == t) {
-      current_type x;
-      if(!::do_serialize(ar, x))
+      // decode in place: copying x into the variant would duplicate all its nested allocations
+      v = current_type();
+      if(!::do_serialize(ar, boost::get<current_type>(v)))
       {
         ar.stream().setstate(std::ios::failbit);
         return false;
       }
-      v = x;
     } else {
       return variant_reader<Archive, Variant, TNext, TEnd>::read(ar, v, t);
     }
@@ -37,6 +37,11 @@ namespace tools
     return net_utils::invoke_http_bin_remote_command2(m_daemon_address + "/get_tx_pool.bin", req, res, m_http_client, WALLET_RCP_CONNECTION_TIMEOUT);
   }
   //------------------------------------------------------------------------------------------------------------------------------
+  bool default_http_core_proxy::call_COMMAND_RPC_GET_POOL_CHANGES(const currency::COMMAND_RPC_GET_POOL_CHANGES::request& req, currency::COMMAND_RPC_GET_POOL_CHANGES::response& res)
+  {
+    return net_utils::invoke_http_bin_remote_command2(m_daemon_address + "/get_pool_changes.bin", req, res, m_http_client, WALLET_RCP_CONNECTION_TIMEOUT);
+  }
+  //------------------------------------------------------------------------------------------------------------------------------
   bool default_http_core_proxy::call_COMMAND_RPC_GET_ALIASES_BY_ADDRESS(const currency::COMMAND_RPC_GET_ALIASES_BY_ADDRESS::request& req, currency::COMMAND_RPC_GET_ALIASES_BY_ADDRESS::response& res)
   {
     return epee::net_utils::invoke_http_json_rpc("/json_rpc", "get_alias_by_address", req, res, m_http_client); 
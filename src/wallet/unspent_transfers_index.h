@@ -0,0 +1,103 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <cstdint>
+#include <list>
+#include <map>
+
+#include "currency_core/currency_format_utils.h"
+
+namespace tools
+{
+  // spendable outputs of the wallet by amount, kept up to date instead of being collected from all transfers for each payment
+  class unspent_transfers_index
+  {
+  public:
+    unspent_transfers_index() : m_size(0) {}
+
+    void add(uint64_t amount, uint8_t mix_attr, size_t transfer_index)
+    {
+      if (m_by_amount[amount].insert(std::make_pair(transfer_index, mix_attr)).second)
+        ++m_size;
+    }
+
+    bool remove(uint64_t amount, size_t transfer_index)
+    {
+      auto it = m_by_amount.find(amount);
+      if (it == m_by_amount.end() || !it->second.erase(transfer_index))
+        return false;
+      if (it->second.empty())
+        m_by_amount.erase(it);
+      --m_size;
+      return true;
+    }
+
+    void clear()
+    {
+      m_by_amount.clear();
+      m_size = 0;
+    }
+
+    size_t size() const { return m_size; }
+
+    // makes the same choice as wallet2::select_indices_for_transfer() over the outputs which can be mixed with fake_outputs_count:
+    // the smallest output covering the rest of needed_money if there is one, otherwise the biggest output, and so on
+    uint64_t select(uint64_t needed_money, size_t fake_outputs_count, std::list<size_t>& selected_indexes) const
+    {
+      uint64_t found_money = 0;
+      // outputs are taken from the top in descending order, everything above (top, top_pos) is already taken
+      auto top = m_by_amount.end();
+      bucket::const_reverse_iterator top_pos;
+      while (found_money < needed_money)
+      {
+        for (auto it = m_by_amount.lower_bound(needed_money - found_money); it != m_by_amount.end(); ++it)
+        {
+          if (top != m_by_amount.end() && top->first < it->first)
+            break;
+          auto pos = next_applicable(it->second, top == it ? top_pos : it->second.rbegin(), fake_outputs_count);
+          if (pos != it->second.rend())
+          {
+            selected_indexes.push_back(pos->first);
+            return found_money + it->first;
+          }
+        }
+
+        if (top == m_by_amount.end())
+        {
+          if (m_by_amount.empty())
+            break;
+          top = --m_by_amount.end();
+          top_pos = top->second.rbegin();
+        }
+        top_pos = next_applicable(top->second, top_pos, fake_outputs_count);
+        while (top_pos == top->second.rend() && top != m_by_amount.begin())
+        {
+          --top;
+          top_pos = next_applicable(top->second, top->second.rbegin(), fake_outputs_count);
+        }
+        if (top_pos == top->second.rend())
+          break; //nothing left
+        found_money += top->first;
+        selected_indexes.push_back(top_pos->first);
+        ++top_pos;
+      }
+      return found_money;
+    }
+
+  private:
+    typedef std::map<size_t, uint8_t> bucket; // transfer index -> mix_attr
+
+    static bucket::const_reverse_iterator next_applicable(const bucket& b, bucket::const_reverse_iterator pos, size_t fake_outputs_count)
+    {
+      while (pos != b.rend() && !currency::is_mixattr_applicable_for_fake_outs_counter(pos->second, fake_outputs_count))
+        ++pos;
+      return pos;
+    }
+
+    std::map<uint64_t, bucket> m_by_amount;
+    size_t m_size;
+  };
+}
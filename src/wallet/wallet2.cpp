@@ -5,6 +5,7 @@
 
 #include <boost/archive/binary_oarchive.hpp>
 #include <boost/archive/binary_iarchive.hpp>
+#include <sstream>
 
 #include <boost/utility/value_init.hpp>
 #include "include_base_utils.h"
@@ -42,12 +43,14 @@ void fill_transfer_details(const currency::transaction& tx, const tools::money_t
 void wallet2::init(const std::string& daemon_address)
 {
   m_upper_transaction_size_limit = 0;
+  m_pool_version = 0;
   m_core_proxy->set_connection_addr(daemon_address);
 }
 //----------------------------------------------------------------------------------------------------
 bool wallet2::set_core_proxy(std::shared_ptr<i_core_proxy>& proxy)
 {
   m_core_proxy = proxy;
+  m_pool_version = 0;
   return true;
 }
 //----------------------------------------------------------------------------------------------------
@@ -56,18 +59,68 @@ std::shared_ptr<i_core_proxy> wallet2::get_core_proxy()
   return m_core_proxy;
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::process_new_transaction(const currency::transaction& tx, uint64_t height, const currency::block& b)
+void wallet2::scan_transaction(const currency::account_keys& keys, tx_scan_result& sr)
 {
+  sr.tx_pub_key = null_pkey;
+  sr.outs.clear();
+  sr.money_got_in_outs = 0;
+  sr.outs_looked_up = false;
+  sr.has_global_indexes = false;
+  sr.extra_parsed = parse_and_validate_tx_extra(sr.tx, sr.tx_pub_key);
+  if (!sr.extra_parsed)
+    return;
+  sr.outs_looked_up = lookup_acc_outs(keys, sr.tx, sr.tx_pub_key, sr.outs, sr.money_got_in_outs);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::scan_blocks(const currency::account_keys& keys, uint64_t account_create_time, const std::list<currency::block_complete_entry>& blocks, std::vector<block_scan_result>& result, size_t threads_count)
+{
+  std::vector<const currency::block_complete_entry*> entries;
+  entries.reserve(blocks.size());
+  for (const auto& bce : blocks)
+    entries.push_back(&bce);
+
+  result.clear();
+  result.resize(entries.size());
+  parallel_for(entries.size(), threads_count, [&](size_t i)
+  {
+    const currency::block_complete_entry& bce = *entries[i];
+    block_scan_result& bsr = result[i];
+    bsr.scanned = false;
+    bsr.parsed = parse_and_validate_block_from_blob(bce.block, bsr.b);
+    if (!bsr.parsed)
+      return;
+    bsr.id = get_block_hash(bsr.b);
+
+    //optimization: seeking only for blocks that are not older then the wallet creation time plus 1 day. 1 day is for possible user incorrect time setup
+    if (bsr.b.timestamp + 60*60*24 <= account_create_time)
+      return;
+    bsr.scanned = true;
+    bsr.txs.resize(bce.txs.size() + 1);
+    bsr.txs[0].tx = bsr.b.miner_tx;
+    bsr.txs[0].parsed = true;
+    scan_transaction(keys, bsr.txs[0]);
+    size_t j = 1;
+    for (const auto& txblob : bce.txs)
+    {
+      tx_scan_result& sr = bsr.txs[j++];
+      sr.parsed = parse_and_validate_tx_from_blob(txblob, sr.tx);
+      if (!sr.parsed)
+        break; // the wallet stops on this transaction anyway
+      scan_transaction(keys, sr);
+    }
+  });
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::process_new_transaction(const tx_scan_result& sr, uint64_t height, const currency::block& b)
+{
+  const currency::transaction& tx = sr.tx;
   std::string recipient, recipient_alias;
   process_unconfirmed(tx, recipient, recipient_alias);
-  std::vector<size_t> outs;
-  uint64_t tx_money_got_in_outs = 0;
-  crypto::public_key tx_pub_key = null_pkey;
-  bool r = parse_and_validate_tx_extra(tx, tx_pub_key);
-  CHECK_AND_THROW_WALLET_EX(!r, error::tx_extra_parse_error, tx);
-
-  r = lookup_acc_outs(m_account.get_keys(), tx, tx_pub_key, outs, tx_money_got_in_outs);
-  CHECK_AND_THROW_WALLET_EX(!r, error::acc_outs_lookup_error, tx, tx_pub_key, m_account.get_keys());
+  const std::vector<size_t>& outs = sr.outs;
+  uint64_t tx_money_got_in_outs = sr.money_got_in_outs;
+  const crypto::public_key& tx_pub_key = sr.tx_pub_key;
+  CHECK_AND_THROW_WALLET_EX(!sr.extra_parsed, error::tx_extra_parse_error, tx);
+  CHECK_AND_THROW_WALLET_EX(!sr.outs_looked_up, error::acc_outs_lookup_error, tx, tx_pub_key, m_account.get_keys());
 
   money_transfer2_details mtd;
 
@@ -75,17 +128,26 @@ void wallet2::process_new_transaction(const currency::transaction& tx, uint64_t
   {
     //good news - got money! take care about it
     //usually we have only one transfer for user in transaction
-    currency::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request req = AUTO_VAL_INIT(req);
     currency::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response res = AUTO_VAL_INIT(res);
-    req.txid = get_transaction_hash(tx);
-    bool r = m_core_proxy->call_COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES(req, res);
-    CHECK_AND_THROW_WALLET_EX(!r, error::no_connection_to_daemon, "get_o_indexes.bin");
-    CHECK_AND_THROW_WALLET_EX(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_o_indexes.bin");
-    CHECK_AND_THROW_WALLET_EX(res.status != CORE_RPC_STATUS_OK, error::get_out_indices_error, res.status);
+    if (sr.has_global_indexes)
+    {
+      res.o_indexes = sr.global_indexes;
+    }
+    else
+    {
+      //daemon doesn't support global indexes in getblocks.bin
+      currency::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request req = AUTO_VAL_INIT(req);
+      req.txid = get_transaction_hash(tx);
+      bool r = m_core_proxy->call_COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES(req, res);
+      CHECK_AND_THROW_WALLET_EX(!r, error::no_connection_to_daemon, "get_o_indexes.bin");
+      CHECK_AND_THROW_WALLET_EX(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_o_indexes.bin");
+      CHECK_AND_THROW_WALLET_EX(res.status != CORE_RPC_STATUS_OK, error::get_out_indices_error, res.status);
+    }
     CHECK_AND_THROW_WALLET_EX(res.o_indexes.size() != tx.vout.size(), error::wallet_internal_error,
       "transactions outputs size=" + std::to_string(tx.vout.size()) +
       " not match with COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES response size=" + std::to_string(res.o_indexes.size()));
 
+    const crypto::hash tx_id = get_transaction_hash(tx);
     for(size_t o : outs)
     {
       CHECK_AND_THROW_WALLET_EX(tx.vout.size() <= o, error::wallet_internal_error, "wrong out in transaction: internal index=" +
@@ -96,20 +158,21 @@ void wallet2::process_new_transaction(const currency::transaction& tx, uint64_t
       m_transfers.push_back(boost::value_initialized<transfer_details>());
       transfer_details& td = m_transfers.back();
       td.m_block_height = height;
-      td.m_internal_output_index = o;
       td.m_global_output_index = res.o_indexes[o];
-      td.m_tx = tx;
-      td.m_spent = false;
+      fill_transfer_output_details(tx, tx_id, tx_pub_key, o, td);
       currency::keypair in_ephemeral;
       currency::generate_key_image_helper(m_account.get_keys(), tx_pub_key, o, in_ephemeral, td.m_key_image);
-      CHECK_AND_THROW_WALLET_EX(in_ephemeral.pub != boost::get<currency::txout_to_key>(tx.vout[o].target).key,
+      CHECK_AND_THROW_WALLET_EX(in_ephemeral.pub != td.m_out_key,
         error::wallet_internal_error, "key_image generated ephemeral public key not matched with output_key");
 
       m_key_images[td.m_key_image] = m_transfers.size()-1;
-      LOG_PRINT_L0("Received money: " << print_money(td.amount()) << ", with tx: " << get_transaction_hash(tx));
+      add_transfer_to_indexes(m_transfers.size()-1);
+      LOG_PRINT_L0("Received money: " << print_money(td.amount()) << ", with tx: " << tx_id);
       if (0 != m_callback)
-        m_callback->on_money_received(height, td.m_tx, td.m_internal_output_index);
+        m_callback->on_money_received(height, tx, td.m_internal_output_index);
     }
+    if (!m_transfer_txs_index.count(tx_id))
+      m_unstored_transfer_txs[tx_id] = tx;
   }
   
   uint64_t tx_money_spent_in_ins = 0;
@@ -125,12 +188,18 @@ void wallet2::process_new_transaction(const currency::transaction& tx, uint64_t
       LOG_PRINT_L0("Spent money: " << print_money(boost::get<currency::txin_to_key>(in).amount) << ", with tx: " << get_transaction_hash(tx));
       tx_money_spent_in_ins += boost::get<currency::txin_to_key>(in).amount;
       transfer_details& td = m_transfers[it->second];
-      td.m_spent = true;
+      set_transfer_spent(it->second, true);
       
       mtd.spent_indices.push_back(i);
 
       if (m_callback)
-        m_callback->on_money_spent(height, td.m_tx, td.m_internal_output_index, tx);
+      {
+        currency::transaction in_tx;
+        if (get_transfer_tx(td.m_tx_id, in_tx))
+          m_callback->on_money_spent(height, in_tx, td.m_internal_output_index, tx);
+        else
+          LOG_ERROR("Transaction " << td.m_tx_id << " of spent transfer not found in " << m_transfer_txs_file);
+      }
     }
     i++;
   }
@@ -146,7 +215,7 @@ void wallet2::process_new_transaction(const currency::transaction& tx, uint64_t
         payment.m_amount       = received;
         payment.m_block_height = height;
         payment.m_unlock_time  = tx.unlock_time;
-        m_payments.emplace(payment_id, payment);
+        add_payment(payment_id, payment);
         LOG_PRINT_L2("Payment found: " << payment_id << " / " << payment.m_tx_hash << " / " << payment.m_amount);
       }
     }
@@ -193,6 +262,7 @@ void wallet2::handle_money_received2(const currency::block& b, const currency::t
   wallet_rpc::wallet_transfer_info& wti = m_transfer_history.back();
   prepare_wti(wti, get_block_height(b), b.timestamp, tx, amount, td);
   wti.is_income = true;
+  add_transfer_history_entry_to_indexes(m_transfer_history.size() - 1);
 
   if (m_callback)
     m_callback->on_transfer2(wti);
@@ -204,6 +274,7 @@ void wallet2::handle_money_spent2(const currency::block& b, const currency::tran
   wallet_rpc::wallet_transfer_info& wti = m_transfer_history.back();
   prepare_wti(wti, get_block_height(b), b.timestamp, in_tx, amount, td);
   wti.is_income = false;
+  add_transfer_history_entry_to_indexes(m_transfer_history.size() - 1);
   wti.destinations = recipient;
   wti.destination_alias = recipient_alias;
 
@@ -222,26 +293,26 @@ void wallet2::process_unconfirmed(const currency::transaction& tx, std::string&
   }
 }
 //----------------------------------------------------------------------------------------------------
-void wallet2::process_new_blockchain_entry(const currency::block& b, currency::block_complete_entry& bche, crypto::hash& bl_id, uint64_t height)
+void wallet2::process_new_blockchain_entry(const block_scan_result& bsr, const currency::block_complete_entry& bche, uint64_t height)
 {
   //handle transactions from new block
   CHECK_AND_THROW_WALLET_EX(height != m_blockchain.size(), error::wallet_internal_error,
     "current_index=" + std::to_string(height) + ", m_blockchain.size()=" + std::to_string(m_blockchain.size()));
 
-  //optimization: seeking only for blocks that are not older then the wallet creation time plus 1 day. 1 day is for possible user incorrect time setup
-  if(b.timestamp + 60*60*24 > m_account.get_createtime())
+  const currency::block& b = bsr.b;
+  const crypto::hash& bl_id = bsr.id;
+  if(bsr.scanned)
   {
     TIME_MEASURE_START(miner_tx_handle_time);
-    process_new_transaction(b.miner_tx, height, b);
+    process_new_transaction(bsr.txs[0], height, b);
     TIME_MEASURE_FINISH(miner_tx_handle_time);
 
     TIME_MEASURE_START(txs_handle_time);
-    BOOST_FOREACH(auto& txblob, bche.txs)
+    auto txblob_it = bche.txs.begin();
+    for (size_t i = 1; i != bsr.txs.size(); ++i, ++txblob_it)
     {
-      currency::transaction tx;
-      bool r = parse_and_validate_tx_from_blob(txblob, tx);
-      CHECK_AND_THROW_WALLET_EX(!r, error::tx_parse_error, txblob);
-      process_new_transaction(tx, height, b);
+      CHECK_AND_THROW_WALLET_EX(!bsr.txs[i].parsed, error::tx_parse_error, *txblob_it);
+      process_new_transaction(bsr.txs[i], height, b);
     }
     TIME_MEASURE_FINISH(txs_handle_time);
     LOG_PRINT_L2("Processed block: " << bl_id << ", height " << height << ", " <<  miner_tx_handle_time + txs_handle_time << "(" << miner_tx_handle_time << "/" << txs_handle_time <<")ms");
@@ -289,6 +360,7 @@ void wallet2::pull_blocks(size_t& blocks_added)
   currency::COMMAND_RPC_GET_BLOCKS_FAST::request req = AUTO_VAL_INIT(req);
   currency::COMMAND_RPC_GET_BLOCKS_FAST::response res = AUTO_VAL_INIT(res);
   get_short_chain_history(req.block_ids);
+  req.need_global_indexes = true;
   bool r = m_core_proxy->call_COMMAND_RPC_GET_BLOCKS_FAST(req, res);
   CHECK_AND_THROW_WALLET_EX(!r, error::no_connection_to_daemon, "getblocks.bin");
   CHECK_AND_THROW_WALLET_EX(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "getblocks.bin");
@@ -297,17 +369,36 @@ void wallet2::pull_blocks(size_t& blocks_added)
     "wrong daemon response: m_start_height=" + std::to_string(res.start_height) +
     " not less than local blockchain size=" + std::to_string(m_blockchain.size()));
 
+  //key derivations for all transactions are calculated in parallel, found transfers are applied in order below
+  std::vector<block_scan_result> scanned_blocks;
+  scan_blocks(m_account.get_keys(), m_account.get_createtime(), res.blocks, scanned_blocks, m_scan_threads);
+  if (res.blocks_global_outs.size() == res.blocks.size())
+  {
+    auto global_outs_it = res.blocks_global_outs.begin();
+    for (auto& bsr : scanned_blocks)
+    {
+      auto& txs_outs = (global_outs_it++)->txs;
+      if (txs_outs.size() != bsr.txs.size())
+        continue;
+      for (size_t i = 0; i != bsr.txs.size(); ++i)
+      {
+        bsr.txs[i].global_indexes.swap(txs_outs[i].indexes);
+        bsr.txs[i].has_global_indexes = true;
+      }
+    }
+  }
+
   size_t current_index = res.start_height;
+  auto scanned_it = scanned_blocks.begin();
   BOOST_FOREACH(auto& bl_entry, res.blocks)
   {
-    currency::block bl;
-    r = currency::parse_and_validate_block_from_blob(bl_entry.block, bl);
-    CHECK_AND_THROW_WALLET_EX(!r, error::block_parse_error, bl_entry.block);
+    const block_scan_result& bsr = *scanned_it++;
+    CHECK_AND_THROW_WALLET_EX(!bsr.parsed, error::block_parse_error, bl_entry.block);
 
-    crypto::hash bl_id = get_block_hash(bl);
+    const crypto::hash& bl_id = bsr.id;
     if(current_index >= m_blockchain.size())
     {
-      process_new_blockchain_entry(bl, bl_entry, bl_id, current_index);
+      process_new_blockchain_entry(bsr, bl_entry, current_index);
       ++blocks_added;
     }
     else if(bl_id != m_blockchain[current_index])
@@ -319,7 +410,7 @@ void wallet2::pull_blocks(size_t& blocks_added)
         string_tools::pod_to_hex(m_blockchain[current_index]));
 
       detach_blockchain(current_index);
-      process_new_blockchain_entry(bl, bl_entry, bl_id, current_index);
+      process_new_blockchain_entry(bsr, bl_entry, current_index);
     }
     else
     {
@@ -381,28 +472,46 @@ void wallet2::update_current_tx_limit()
 //----------------------------------------------------------------------------------------------------
 void wallet2::scan_tx_pool()
 {
-  //get transaction pool content 
-  currency::COMMAND_RPC_GET_TX_POOL::request req = AUTO_VAL_INIT(req);
-  currency::COMMAND_RPC_GET_TX_POOL::response res = AUTO_VAL_INIT(res);
-  bool r = m_core_proxy->call_COMMAND_RPC_GET_TX_POOL(req, res);
-  CHECK_AND_THROW_WALLET_EX(!r, error::no_connection_to_daemon, "get_tx_pool");
-  CHECK_AND_THROW_WALLET_EX(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_tx_pool");
+  //get transaction pool changes since the last scan
+  currency::COMMAND_RPC_GET_POOL_CHANGES::request req = AUTO_VAL_INIT(req);
+  currency::COMMAND_RPC_GET_POOL_CHANGES::response res = AUTO_VAL_INIT(res);
+  req.since_version = m_pool_version;
+  bool r = m_core_proxy->call_COMMAND_RPC_GET_POOL_CHANGES(req, res);
+  CHECK_AND_THROW_WALLET_EX(!r, error::no_connection_to_daemon, "get_pool_changes");
+  CHECK_AND_THROW_WALLET_EX(res.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "get_pool_changes");
   CHECK_AND_THROW_WALLET_EX(res.status != CORE_RPC_STATUS_OK, error::get_blocks_error, res.status);
-  
-  std::unordered_map<crypto::hash, wallet_rpc::wallet_transfer_info> unconfirmed_in_transfers_local(std::move(m_unconfirmed_in_transfers));
-  m_unconfirmed_balance = 0;
+
+  std::unordered_set<crypto::hash> scanned_txs_local;
+  std::unordered_map<crypto::hash, wallet_rpc::wallet_transfer_info> unconfirmed_in_transfers_local;
+  if (res.full)
+  {
+    //whole pool: keep results only for txs which are still there
+    scanned_txs_local.swap(m_pool_scanned_txs);
+    unconfirmed_in_transfers_local.swap(m_unconfirmed_in_transfers);
+    m_pool_version = 0; // if scan fails get the whole pool again next time
+  }
+  for (const auto& id : res.removed_ids)
+  {
+    m_pool_scanned_txs.erase(id);
+    m_unconfirmed_in_transfers.erase(id);
+  }
+
   for (const auto &tx_blob : res.txs)
   {
     currency::transaction tx;
     bool r = parse_and_validate_tx_from_blob(tx_blob, tx);
     CHECK_AND_THROW_WALLET_EX(!r, error::tx_parse_error, tx_blob);
     crypto::hash tx_hash = currency::get_transaction_hash(tx);
-    auto it = unconfirmed_in_transfers_local.find(tx_hash);
-    if (it != unconfirmed_in_transfers_local.end())
+    if (scanned_txs_local.count(tx_hash))
     {
-      m_unconfirmed_in_transfers.insert(*it);
+      m_pool_scanned_txs.insert(tx_hash);
+      auto it = unconfirmed_in_transfers_local.find(tx_hash);
+      if (it != unconfirmed_in_transfers_local.end())
+        m_unconfirmed_in_transfers.insert(*it);
       continue;
     }
+    if (!m_pool_scanned_txs.insert(tx_hash).second)
+      continue;
 
     // read extra
     std::vector<size_t> outs;
@@ -433,11 +542,15 @@ void wallet2::scan_tx_pool()
       wti.tx = tx;
       prepare_wti(wti, 0, 0, tx, tx_money_got_in_outs, money_transfer2_details());
       m_unconfirmed_in_transfers[tx_hash] = wti;
-      m_unconfirmed_balance += wti.amount;
       if (m_callback)
         m_callback->on_transfer2(wti);
     }
   }
+
+  m_unconfirmed_balance = 0;
+  for (const auto& inc : m_unconfirmed_in_transfers)
+    m_unconfirmed_balance += inc.second.amount;
+  m_pool_version = res.version;
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::refresh(size_t & blocks_fetched, bool& received_money)
@@ -446,7 +559,7 @@ void wallet2::refresh(size_t & blocks_fetched, bool& received_money)
   blocks_fetched = 0;
   size_t added_blocks = 0;
   size_t try_count = 0;
-  crypto::hash last_tx_hash_id = m_transfers.size() ? get_transaction_hash(m_transfers.back().m_tx) : null_hash;
+  crypto::hash last_tx_hash_id = m_transfers.size() ? m_transfers.back().m_tx_id : null_hash;
 
   while(m_run.load(std::memory_order_relaxed))
   {
@@ -472,7 +585,7 @@ void wallet2::refresh(size_t & blocks_fetched, bool& received_money)
       }
     }
   }
-  if(last_tx_hash_id != (m_transfers.size() ? get_transaction_hash(m_transfers.back().m_tx) : null_hash))
+  if(last_tx_hash_id != (m_transfers.size() ? m_transfers.back().m_tx_id : null_hash))
     received_money = true;
 
   LOG_PRINT_L1("Refresh done, blocks received: " << blocks_fetched << ", balance: " << print_money(balance()) << ", unlocked: " << print_money(unlocked_balance()));
@@ -521,6 +634,13 @@ void wallet2::detach_blockchain(uint64_t height)
       ++it;
   }
 
+  m_stored_blockchain_size = std::min<size_t>(m_stored_blockchain_size, height);
+  m_stored_transfers_size = std::min(m_stored_transfers_size, i_start);
+  m_stored_spent.resize(m_stored_transfers_size);
+  m_stored_payments_height = std::min(m_stored_payments_height, height);
+  m_cache_detached = true;
+  rebuild_transfer_indexes();
+
   LOG_PRINT_L0("Detached blockchain on height " << height << ", transfers detached " << transfers_detached << ", blocks detached " << blocks_detached);
 }
 //----------------------------------------------------------------------------------------------------
@@ -537,6 +657,13 @@ bool wallet2::clear()
   currency::generate_genesis_block(b);
   m_blockchain.push_back(get_block_hash(b));
   m_local_bc_height = 1;
+  m_cache_generation = 0;
+  m_cache_snapshot_size = 0;
+  m_cache_journal_size = 0;
+  reset_cache_watermarks();
+  m_unstored_transfer_txs.clear();
+  m_transfer_txs_index.clear();
+  rebuild_transfer_indexes();
   return true;
 }
 //----------------------------------------------------------------------------------------------------
@@ -670,6 +797,8 @@ bool wallet2::prepare_file_names(const std::string& file_path)
   {//provided wallet file name
     m_keys_file += ".keys";
   }
+  m_cache_journal_file = m_wallet_file + ".journal";
+  m_transfer_txs_file = m_wallet_file + ".txs";
   return true;
 }
 //----------------------------------------------------------------------------------------------------
@@ -705,6 +834,15 @@ void wallet2::load(const std::string& wallet_, const std::string& password)
     m_account_public_address.m_view_public_key  != m_account.get_keys().m_account_address.m_view_public_key,
     error::wallet_files_doesnt_correspond, m_keys_file, m_wallet_file);
 
+  m_cache_snapshot_size = boost::filesystem::file_size(m_wallet_file, e);
+  load_cache_journal();
+  load_transfer_txs_index();
+  if (!m_unstored_transfer_txs.empty())
+  {
+    LOG_PRINT_L0("Wallet cache has transactions in old format, it will be converted on next store");
+    m_cache_snapshot_size = 0;
+  }
+
   if(m_blockchain.empty())
   {
     currency::block b;
@@ -712,22 +850,526 @@ void wallet2::load(const std::string& wallet_, const std::string& password)
     m_blockchain.push_back(get_block_hash(b));
   }
   m_local_bc_height = m_blockchain.size();
+  reset_cache_watermarks();
+  rebuild_transfer_indexes();
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::store()
 {
-  bool r = tools::serialize_obj_to_file(*this, m_wallet_file);
+  store_transfer_txs();
+  boost::system::error_code e;
+  if (!m_cache_snapshot_size || !boost::filesystem::exists(m_wallet_file, e))
+  {
+    store_cache_snapshot();
+    return;
+  }
+  append_cache_journal();
+  if (m_cache_journal_size * 100 > m_cache_snapshot_size * WALLET_CACHE_JOURNAL_COMPACT_PERCENT)
+    store_cache_snapshot();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::store_cache_snapshot()
+{
+  //new generation makes the current journal obsolete even if we fail to remove it after the file is replaced
+  ++m_cache_generation;
+  const std::string tmp_file = m_wallet_file + ".tmp";
+  boost::system::error_code e;
+  bool r = tools::serialize_obj_to_file(*this, tmp_file);
+  if (r)
+  {
+    boost::filesystem::rename(tmp_file, m_wallet_file, e);
+    r = !e;
+  }
+  if (!r)
+  {
+    --m_cache_generation;
+    boost::filesystem::remove(tmp_file, e);
+  }
   CHECK_AND_THROW_WALLET_EX(!r, error::file_save_error, m_wallet_file);
+  m_cache_snapshot_size = boost::filesystem::file_size(m_wallet_file, e);
+  boost::filesystem::remove(m_cache_journal_file, e);
+  m_cache_journal_size = boost::filesystem::exists(m_cache_journal_file, e) ? boost::filesystem::file_size(m_cache_journal_file, e) : 0;
+  reset_cache_watermarks();
+  //only after the snapshot is replaced: the old one may refer to transactions dropped here
+  compact_transfer_txs();
 }
 //----------------------------------------------------------------------------------------------------
-uint64_t wallet2::unlocked_balance()
+void wallet2::append_cache_journal()
 {
-  uint64_t amount = 0;
-  BOOST_FOREACH(transfer_details& td, m_transfers)
-    if(!td.m_spent && is_transfer_unlocked(td))
-      amount += td.amount();
+  cache_journal_entry entry = AUTO_VAL_INIT(entry);
+  entry.generation = m_cache_generation;
+  entry.blockchain_size = m_stored_blockchain_size;
+  entry.blocks.assign(m_blockchain.begin() + m_stored_blockchain_size, m_blockchain.end());
+  entry.transfers_size = m_stored_transfers_size;
+  entry.transfers.assign(m_transfers.begin() + m_stored_transfers_size, m_transfers.end());
+  for (size_t i = 0; i != m_stored_transfers_size; ++i)
+  {
+    if (m_transfers[i].m_spent != m_stored_spent[i])
+      (m_transfers[i].m_spent ? entry.spent : entry.unspent).push_back(i);
+  }
+  entry.payments_height = m_stored_payments_height;
+  for (const auto& p : m_payments)
+  {
+    if (p.second.m_block_height >= m_stored_payments_height)
+      entry.payments.push_back(p);
+  }
+  entry.history_size = m_stored_history_size;
+  entry.history.assign(m_transfer_history.begin() + m_stored_history_size, m_transfer_history.end());
+  for (const auto& txid : m_unstored_tx_keys)
+    entry.tx_keys.push_back(*m_tx_keys.find(txid));
+  for (const auto& utx : m_unconfirmed_txs)
+  {
+    if (!m_stored_unconfirmed_ids.count(utx.first))
+      entry.unconfirmed_added.push_back(utx);
+  }
+  for (const auto& id : m_stored_unconfirmed_ids)
+  {
+    if (!m_unconfirmed_txs.count(id))
+      entry.unconfirmed_removed.push_back(id);
+  }
 
-  return amount;
+  if (!m_cache_detached && entry.blocks.empty() && entry.transfers.empty() && entry.spent.empty() && entry.unspent.empty() &&
+    entry.payments.empty() && entry.history.empty() && entry.tx_keys.empty() && entry.unconfirmed_added.empty() && entry.unconfirmed_removed.empty())
+    return; //nothing changed
+
+  std::ostringstream payload_stream;
+  {
+    boost::archive::binary_oarchive a(payload_stream);
+    a << entry;
+  }
+  const std::string payload = payload_stream.str();
+  //record: payload size, payload hash, payload; a torn record at the end of the journal is dropped on load
+  uint64_t payload_size = payload.size();
+  crypto::hash payload_hash = crypto::cn_fast_hash(payload.data(), payload.size());
+
+  std::ofstream journal(m_cache_journal_file, std::ios_base::binary | std::ios_base::out | std::ios_base::app);
+  journal.write(reinterpret_cast<const char*>(&payload_size), sizeof(payload_size));
+  journal.write(reinterpret_cast<const char*>(&payload_hash), sizeof(payload_hash));
+  journal.write(payload.data(), payload.size());
+  journal.flush();
+  CHECK_AND_THROW_WALLET_EX(journal.fail(), error::file_save_error, m_cache_journal_file);
+
+  m_cache_journal_size += sizeof(payload_size) + sizeof(payload_hash) + payload.size();
+  reset_cache_watermarks();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::load_cache_journal()
+{
+  m_cache_journal_size = 0;
+  boost::system::error_code e;
+  if (!boost::filesystem::exists(m_cache_journal_file, e) || e)
+    return;
+
+  std::string buf;
+  bool r = epee::file_io_utils::load_file_to_string(m_cache_journal_file, buf);
+  CHECK_AND_THROW_WALLET_EX(!r, error::file_read_error, m_cache_journal_file);
+
+  size_t pos = 0;
+  size_t entries_applied = 0;
+  while (buf.size() - pos >= sizeof(uint64_t) + sizeof(crypto::hash))
+  {
+    uint64_t payload_size = 0;
+    crypto::hash payload_hash = null_hash;
+    memcpy(&payload_size, buf.data() + pos, sizeof(payload_size));
+    memcpy(&payload_hash, buf.data() + pos + sizeof(payload_size), sizeof(payload_hash));
+    size_t payload_pos = pos + sizeof(payload_size) + sizeof(payload_hash);
+    if (buf.size() - payload_pos < payload_size || crypto::cn_fast_hash(buf.data() + payload_pos, payload_size) != payload_hash)
+      break;
+
+    cache_journal_entry entry = AUTO_VAL_INIT(entry);
+    try
+    {
+      std::istringstream payload_stream(buf.substr(payload_pos, payload_size));
+      boost::archive::binary_iarchive a(payload_stream);
+      a >> entry;
+    }
+    catch (const std::exception& ex)
+    {
+      LOG_ERROR("Failed to parse wallet cache journal entry at " << pos << ": " << ex.what());
+      break;
+    }
+    if (entry.generation == m_cache_generation)
+    {
+      r = apply_cache_journal_entry(entry);
+      CHECK_AND_THROW_WALLET_EX(!r, error::wallet_internal_error, "internal error: wallet cache journal entry at " + std::to_string(pos) + " doesn't match " + m_wallet_file);
+      ++entries_applied;
+    }
+    pos = payload_pos + payload_size;
+  }
+
+  if (pos != buf.size())
+  {
+    LOG_PRINT_YELLOW("Wallet cache journal " << m_cache_journal_file << " has " << buf.size() - pos << " bytes of incomplete data, dropping them", LOG_LEVEL_0);
+    boost::filesystem::resize_file(m_cache_journal_file, pos, e);
+  }
+  m_cache_journal_size = pos;
+  LOG_PRINT_L1("Applied " << entries_applied << " wallet cache journal entries from " << m_cache_journal_file);
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::apply_cache_journal_entry(const cache_journal_entry& e)
+{
+  CHECK_AND_ASSERT_MES(e.blockchain_size <= m_blockchain.size() && e.transfers_size <= m_transfers.size() && e.history_size <= m_transfer_history.size(),
+    false, "journal entry refers to data which is not in the wallet cache");
+
+  m_blockchain.erase(m_blockchain.begin() + e.blockchain_size, m_blockchain.end());
+  m_blockchain.insert(m_blockchain.end(), e.blocks.begin(), e.blocks.end());
+
+  for (size_t i = e.transfers_size; i != m_transfers.size(); ++i)
+    m_key_images.erase(m_transfers[i].m_key_image);
+  m_transfers.erase(m_transfers.begin() + e.transfers_size, m_transfers.end());
+  for (const auto& td : e.transfers)
+  {
+    m_transfers.push_back(td);
+    m_key_images[td.m_key_image] = m_transfers.size() - 1;
+  }
+  for (uint64_t i : e.spent)
+  {
+    CHECK_AND_ASSERT_MES(i < e.transfers_size, false, "wrong spent transfer index " << i);
+    m_transfers[i].m_spent = true;
+  }
+  for (uint64_t i : e.unspent)
+  {
+    CHECK_AND_ASSERT_MES(i < e.transfers_size, false, "wrong unspent transfer index " << i);
+    m_transfers[i].m_spent = false;
+  }
+
+  for (auto it = m_payments.begin(); it != m_payments.end(); )
+  {
+    if (e.payments_height <= it->second.m_block_height)
+      it = m_payments.erase(it);
+    else
+      ++it;
+  }
+  m_payments.insert(e.payments.begin(), e.payments.end());
+
+  m_transfer_history.erase(m_transfer_history.begin() + e.history_size, m_transfer_history.end());
+  m_transfer_history.insert(m_transfer_history.end(), e.history.begin(), e.history.end());
+
+  for (const auto& tx : e.legacy_txs)
+    m_unstored_transfer_txs[get_transaction_hash(tx)] = tx;
+
+  m_tx_keys.insert(e.tx_keys.begin(), e.tx_keys.end());
+  for (const auto& id : e.unconfirmed_removed)
+    m_unconfirmed_txs.erase(id);
+  m_unconfirmed_txs.insert(e.unconfirmed_added.begin(), e.unconfirmed_added.end());
+  return true;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::reset_cache_watermarks()
+{
+  m_stored_blockchain_size = m_blockchain.size();
+  m_stored_transfers_size = m_transfers.size();
+  m_stored_spent.resize(m_transfers.size());
+  for (size_t i = 0; i != m_transfers.size(); ++i)
+    m_stored_spent[i] = m_transfers[i].m_spent;
+  m_stored_payments_height = m_blockchain.size();
+  m_stored_history_size = m_transfer_history.size();
+  m_unstored_tx_keys.clear();
+  m_stored_unconfirmed_ids.clear();
+  for (const auto& utx : m_unconfirmed_txs)
+    m_stored_unconfirmed_ids.insert(utx.first);
+  m_cache_detached = false;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::rebuild_transfer_indexes()
+{
+  m_unspent_balance = 0;
+  m_locked_unspent_balance = 0;
+  m_locked_transfers_by_height.clear();
+  m_locked_transfers_by_time.clear();
+  m_unspent_transfers.clear();
+  for (size_t i = 0; i != m_transfers.size(); ++i)
+    add_transfer_to_indexes(i);
+
+  m_payments_by_height.clear();
+  for (const auto& p : m_payments)
+    m_payments_by_height[p.first].emplace(p.second.m_block_height, &p.second);
+
+  m_transfer_history_by_height.clear();
+  for (size_t i = 0; i != m_transfer_history.size(); ++i)
+    add_transfer_history_entry_to_indexes(i);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::add_transfer_to_indexes(size_t transfer_index)
+{
+  const transfer_details& td = m_transfers[transfer_index];
+  if (td.m_spent)
+    return;
+  //considered locked until process_unlocked_transfers() sees it
+  m_unspent_balance += td.amount();
+  m_locked_unspent_balance += td.amount();
+  m_locked_transfers_by_height.emplace(get_transfer_unlock_height(td), transfer_index);
+}
+//----------------------------------------------------------------------------------------------------
+namespace
+{
+  bool erase_transfer_index(std::multimap<uint64_t, size_t>& index, uint64_t key, size_t transfer_index)
+  {
+    auto range = index.equal_range(key);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+      if (it->second == transfer_index)
+      {
+        index.erase(it);
+        return true;
+      }
+    }
+    return false;
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::set_transfer_spent(size_t transfer_index, bool spent)
+{
+  transfer_details& td = m_transfers[transfer_index];
+  if (td.m_spent == spent)
+    return;
+  td.m_spent = spent;
+  if (!spent)
+  {
+    add_transfer_to_indexes(transfer_index);
+    return;
+  }
+  m_unspent_balance -= td.amount();
+  if (erase_transfer_index(m_locked_transfers_by_height, get_transfer_unlock_height(td), transfer_index) ||
+    erase_transfer_index(m_locked_transfers_by_time, td.m_tx_unlock_time, transfer_index))
+    m_locked_unspent_balance -= td.amount();
+  else
+    m_unspent_transfers.remove(td.amount(), transfer_index);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::add_payment(const currency::payment_id_t& payment_id, const payment_details& payment)
+{
+  auto it = m_payments.emplace(payment_id, payment);
+  m_payments_by_height[payment_id].emplace(payment.m_block_height, &it->second);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::add_transfer_history_entry_to_indexes(size_t history_index)
+{
+  const wallet_rpc::wallet_transfer_info& wti = m_transfer_history[history_index];
+  m_transfer_history_by_height.emplace(wti.height, history_index);
+}
+//----------------------------------------------------------------------------------------------------
+uint64_t wallet2::get_transfer_unlock_height(const transfer_details& td) const
+{
+  //the same conditions as is_transfer_unlocked() has, in terms of blockchain size
+  uint64_t unlock_height = td.m_block_height + DEFAULT_TX_SPENDABLE_AGE;
+  if (td.m_tx_unlock_time < CURRENCY_MAX_BLOCK_NUMBER && td.m_tx_unlock_time + 1 > CURRENCY_LOCKED_TX_ALLOWED_DELTA_BLOCKS)
+    unlock_height = std::max<uint64_t>(unlock_height, td.m_tx_unlock_time + 1 - CURRENCY_LOCKED_TX_ALLOWED_DELTA_BLOCKS);
+  return unlock_height;
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::process_unlocked_transfers()
+{
+  const uint64_t blockchain_size = m_blockchain.size();
+  while (!m_locked_transfers_by_height.empty() && m_locked_transfers_by_height.begin()->first <= blockchain_size)
+  {
+    size_t i = m_locked_transfers_by_height.begin()->second;
+    m_locked_transfers_by_height.erase(m_locked_transfers_by_height.begin());
+    if (m_transfers[i].m_tx_unlock_time < CURRENCY_MAX_BLOCK_NUMBER)
+    {
+      m_locked_unspent_balance -= m_transfers[i].amount();
+      m_unspent_transfers.add(m_transfers[i].amount(), m_transfers[i].m_mix_attr, i);
+    }
+    else
+      m_locked_transfers_by_time.emplace(m_transfers[i].m_tx_unlock_time, i);
+  }
+
+  const uint64_t current_time = static_cast<uint64_t>(time(NULL));
+  while (!m_locked_transfers_by_time.empty() && current_time + CURRENCY_LOCKED_TX_ALLOWED_DELTA_SECONDS >= m_locked_transfers_by_time.begin()->first)
+  {
+    const transfer_details& td = m_transfers[m_locked_transfers_by_time.begin()->second];
+    m_locked_unspent_balance -= td.amount();
+    m_unspent_transfers.add(td.amount(), td.m_mix_attr, m_locked_transfers_by_time.begin()->second);
+    m_locked_transfers_by_time.erase(m_locked_transfers_by_time.begin());
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::store_transfer_txs()
+{
+  if (m_unstored_transfer_txs.empty() || m_transfer_txs_file.empty())
+    return;
+
+  //record: tx id, blob size, tx blob
+  boost::system::error_code e;
+  uint64_t offset = boost::filesystem::exists(m_transfer_txs_file, e) ? boost::filesystem::file_size(m_transfer_txs_file, e) : 0;
+  std::unordered_map<crypto::hash, uint64_t> stored;
+  std::ofstream txs_file(m_transfer_txs_file, std::ios_base::binary | std::ios_base::out | std::ios_base::app);
+  for (const auto& tx : m_unstored_transfer_txs)
+  {
+    if (m_transfer_txs_index.count(tx.first))
+      continue;
+    const blobdata blob = tx_to_blob(tx.second);
+    uint64_t blob_size = blob.size();
+    txs_file.write(reinterpret_cast<const char*>(&tx.first), sizeof(tx.first));
+    txs_file.write(reinterpret_cast<const char*>(&blob_size), sizeof(blob_size));
+    txs_file.write(blob.data(), blob.size());
+    stored[tx.first] = offset;
+    offset += sizeof(tx.first) + sizeof(blob_size) + blob.size();
+  }
+  txs_file.flush();
+  CHECK_AND_THROW_WALLET_EX(txs_file.fail(), error::file_save_error, m_transfer_txs_file);
+
+  m_transfer_txs_index.insert(stored.begin(), stored.end());
+  m_unstored_transfer_txs.clear();
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::compact_transfer_txs()
+{
+  std::unordered_set<crypto::hash> referenced;
+  for (const auto& td : m_transfers)
+    referenced.insert(td.m_tx_id);
+  size_t unreferenced_count = 0;
+  for (const auto& txi : m_transfer_txs_index)
+    unreferenced_count += referenced.count(txi.first) ? 0 : 1;
+  if (!unreferenced_count)
+    return;
+
+  //records of transfers left after detach are copied as is to a new file, which replaces the old one
+  const std::string tmp_file = m_transfer_txs_file + ".tmp";
+  boost::system::error_code e;
+  std::unordered_map<crypto::hash, uint64_t> compacted_index;
+  bool r = true;
+  {
+    std::ifstream txs_file(m_transfer_txs_file, std::ios_base::binary | std::ios_base::in);
+    std::ofstream compacted_file(tmp_file, std::ios_base::binary | std::ios_base::out | std::ios_base::trunc);
+    uint64_t offset = 0;
+    blobdata record;
+    for (const auto& txi : m_transfer_txs_index)
+    {
+      if (!referenced.count(txi.first))
+        continue;
+      uint64_t blob_size = 0;
+      txs_file.seekg(txi.second + sizeof(crypto::hash));
+      txs_file.read(reinterpret_cast<char*>(&blob_size), sizeof(blob_size));
+      if (txs_file.fail() || blob_size > CURRENCY_MAX_TRANSACTION_BLOB_SIZE)
+      {
+        r = false;
+        break;
+      }
+      record.resize(sizeof(crypto::hash) + sizeof(blob_size) + static_cast<size_t>(blob_size));
+      txs_file.seekg(txi.second);
+      txs_file.read(&record[0], record.size());
+      compacted_file.write(record.data(), record.size());
+      compacted_index[txi.first] = offset;
+      offset += record.size();
+    }
+    compacted_file.flush();
+    r = r && !txs_file.fail() && !compacted_file.fail();
+  }
+  if (r)
+  {
+    boost::filesystem::rename(tmp_file, m_transfer_txs_file, e);
+    r = !e;
+  }
+  if (!r)
+  {
+    boost::filesystem::remove(tmp_file, e);
+    LOG_ERROR("Failed to compact " << m_transfer_txs_file << ", " << unreferenced_count << " unused transactions are kept in it");
+    return;
+  }
+  LOG_PRINT_L1("Dropped " << unreferenced_count << " unused transactions from " << m_transfer_txs_file);
+  m_transfer_txs_index.swap(compacted_index);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::load_transfer_txs_index()
+{
+  m_transfer_txs_index.clear();
+  boost::system::error_code e;
+  if (!boost::filesystem::exists(m_transfer_txs_file, e) || e)
+    return;
+
+  const uint64_t file_size = boost::filesystem::file_size(m_transfer_txs_file, e);
+  std::ifstream txs_file(m_transfer_txs_file, std::ios_base::binary | std::ios_base::in);
+  CHECK_AND_THROW_WALLET_EX(txs_file.fail(), error::file_read_error, m_transfer_txs_file);
+  //only record headers are read here, transactions are loaded on demand
+  uint64_t offset = 0;
+  while (file_size - offset >= sizeof(crypto::hash) + sizeof(uint64_t))
+  {
+    crypto::hash tx_id = null_hash;
+    uint64_t blob_size = 0;
+    txs_file.seekg(offset);
+    txs_file.read(reinterpret_cast<char*>(&tx_id), sizeof(tx_id));
+    txs_file.read(reinterpret_cast<char*>(&blob_size), sizeof(blob_size));
+    if (txs_file.fail() || file_size - offset - sizeof(tx_id) - sizeof(blob_size) < blob_size)
+      break;
+    m_transfer_txs_index[tx_id] = offset;
+    offset += sizeof(tx_id) + sizeof(blob_size) + blob_size;
+  }
+  txs_file.close();
+
+  if (offset != file_size)
+  {
+    LOG_PRINT_YELLOW("Wallet transactions file " << m_transfer_txs_file << " has " << file_size - offset << " bytes of incomplete data, dropping them", LOG_LEVEL_0);
+    boost::filesystem::resize_file(m_transfer_txs_file, offset, e);
+  }
+}
+//----------------------------------------------------------------------------------------------------
+bool wallet2::get_transfer_tx(const crypto::hash& tx_id, currency::transaction& tx) const
+{
+  auto unstored_it = m_unstored_transfer_txs.find(tx_id);
+  if (unstored_it != m_unstored_transfer_txs.end())
+  {
+    tx = unstored_it->second;
+    return true;
+  }
+  auto it = m_transfer_txs_index.find(tx_id);
+  if (it == m_transfer_txs_index.end())
+    return false;
+
+  std::ifstream txs_file(m_transfer_txs_file, std::ios_base::binary | std::ios_base::in);
+  txs_file.seekg(it->second + sizeof(crypto::hash));
+  uint64_t blob_size = 0;
+  txs_file.read(reinterpret_cast<char*>(&blob_size), sizeof(blob_size));
+  CHECK_AND_ASSERT_MES(!txs_file.fail() && blob_size <= CURRENCY_MAX_TRANSACTION_BLOB_SIZE, false, "failed to read transaction " << tx_id << " from " << m_transfer_txs_file);
+  blobdata blob(static_cast<size_t>(blob_size), '\0');
+  txs_file.read(&blob[0], blob.size());
+  CHECK_AND_ASSERT_MES(!txs_file.fail(), false, "failed to read transaction " << tx_id << " from " << m_transfer_txs_file);
+  return parse_and_validate_tx_from_blob(blob, tx);
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::fill_transfer_output_details(const currency::transaction& tx, const crypto::hash& tx_id, const crypto::public_key& tx_pub_key, size_t out_index, transfer_details& td)
+{
+  const currency::tx_out& out = tx.vout[out_index];
+  td.m_tx_id = tx_id;
+  td.m_tx_pub_key = tx_pub_key;
+  td.m_tx_unlock_time = tx.unlock_time;
+  td.m_internal_output_index = out_index;
+  td.m_amount = out.amount;
+  if (out.target.type() == typeid(currency::txout_to_key))
+  {
+    const currency::txout_to_key& out_key = boost::get<currency::txout_to_key>(out.target);
+    td.m_out_key = out_key.key;
+    td.m_mix_attr = out_key.mix_attr;
+  }
+}
+//----------------------------------------------------------------------------------------------------
+void wallet2::import_legacy_transfers(std::vector<legacy_transfer_details>& legacy_transfers, transfer_container& transfers, std::unordered_map<crypto::hash, currency::transaction>& txs)
+{
+  transfers.clear();
+  transfers.reserve(legacy_transfers.size());
+  for (auto& ltd : legacy_transfers)
+  {
+    transfers.push_back(boost::value_initialized<transfer_details>());
+    transfer_details& td = transfers.back();
+    td.m_block_height = ltd.m_block_height;
+    td.m_global_output_index = ltd.m_global_output_index;
+    td.m_spent = ltd.m_spent;
+    td.m_key_image = ltd.m_key_image;
+    const crypto::hash tx_id = get_transaction_hash(ltd.m_tx);
+    if (ltd.m_internal_output_index < ltd.m_tx.vout.size())
+      fill_transfer_output_details(ltd.m_tx, tx_id, get_tx_pub_key_from_extra(ltd.m_tx), ltd.m_internal_output_index, td);
+    else
+      LOG_ERROR("Wrong output index " << ltd.m_internal_output_index << " in wallet cache transfer of tx " << tx_id);
+    if (!txs.count(tx_id))
+      txs[tx_id] = std::move(ltd.m_tx);
+  }
+  legacy_transfers.clear();
+}
+//----------------------------------------------------------------------------------------------------
+uint64_t wallet2::unlocked_balance()
+{
+  process_unlocked_transfers();
+  return m_unspent_balance - m_locked_unspent_balance;
 }
 //----------------------------------------------------------------------------------------------------
 int64_t wallet2::unconfirmed_balance()
@@ -739,12 +1381,7 @@ int64_t wallet2::unconfirmed_balance()
 //----------------------------------------------------------------------------------------------------
 uint64_t wallet2::balance()
 {
-  uint64_t amount = 0;
-  BOOST_FOREACH(auto& td, m_transfers)
-    if(!td.m_spent)
-      amount += td.amount();
-
-
+  uint64_t amount = m_unspent_balance;
   BOOST_FOREACH(auto& utx, m_unconfirmed_txs)
     amount+= utx.second.m_change;
 
@@ -758,38 +1395,30 @@ void wallet2::get_transfers(wallet2::transfer_container& incoming_transfers) con
 //----------------------------------------------------------------------------------------------------
 bool wallet2::get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request& req, wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response& res) const 
 {
-  uint64_t tr_count = m_transfer_history.size();
-  if (!tr_count)
-    return true;
-  uint64_t i = tr_count;
-
-  do
+  auto add_transfer = [&](const wallet_rpc::wallet_transfer_info& thi)
   {
-    --i;
-    const wallet_rpc::wallet_transfer_info& thi = m_transfer_history[i];
-
-    // handle filter_by_height
-    if (req.filter_by_height)
-    {
-      if (!thi.height) // unconfirmed
-        continue;
-
-      if (thi.height < req.min_height)
-      {
-        //no need to scan more
-        break;
-      }
-      if (thi.height > req.max_height)
-      {
-        continue;
-      }
-    }
-    
     if (thi.is_income && req.in)
       res.in.push_back(thi);
     if (!thi.is_income && req.out)
-      res.out.push_back(thi);   
-  } while (i != 0);
+      res.out.push_back(thi);
+  };
+
+  if (req.filter_by_height)
+  {
+    //unconfirmed ones have zero height
+    uint64_t min_height = std::max<uint64_t>(req.min_height, 1);
+    if (min_height <= req.max_height)
+    {
+      auto first = m_transfer_history_by_height.lower_bound(min_height);
+      for (auto it = m_transfer_history_by_height.upper_bound(req.max_height); it != first; )
+        add_transfer(m_transfer_history[(--it)->second]);
+    }
+  }
+  else
+  {
+    for (auto it = m_transfer_history.rbegin(); it != m_transfer_history.rend(); ++it)
+      add_transfer(*it);
+  }
 
   if (req.pool)
   {
@@ -812,13 +1441,11 @@ bool wallet2::get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request
 //----------------------------------------------------------------------------------------------------
 void wallet2::get_payments(const payment_id_t& payment_id, std::list<wallet2::payment_details>& payments, uint64_t min_height) const
 {
-  auto range = m_payments.equal_range(payment_id);
-  std::for_each(range.first, range.second, [&payments, &min_height](const payment_container::value_type& x) {
-    if (min_height < x.second.m_block_height)
-    {
-      payments.push_back(x.second);
-    }
-  });
+  auto it = m_payments_by_height.find(payment_id);
+  if (it == m_payments_by_height.end())
+    return;
+  for (auto p_it = it->second.upper_bound(min_height); p_it != it->second.end(); ++p_it)
+    payments.push_back(*p_it->second);
 }
 //----------------------------------------------------------------------------------------------------
 void wallet2::sign_transfer(const std::string& tx_sources_file, const std::string& signed_tx_file, currency::transaction& tx)
@@ -901,13 +1528,13 @@ void wallet2::finalize_transaction(const currency::create_tx_arg& create_tx_para
     {
       //unlock funds if transaction rejected
       for (auto& s : create_tx_param.sources)
-        m_transfers[s.transfer_index].m_spent = false;
+        set_transfer_spent(s.transfer_index, false);
     }
     else
     {
       //unlock funds if transaction rejected
       for (auto& s : create_tx_param.sources)
-        m_transfers[s.transfer_index].m_spent = true;
+        set_transfer_spent(s.transfer_index, true);
     }
     CHECK_AND_THROW_WALLET_EX(!r, error::no_connection_to_daemon, "sendrawtransaction");
     CHECK_AND_THROW_WALLET_EX(daemon_send_resp.status == CORE_RPC_STATUS_BUSY, error::daemon_busy, "sendrawtransaction");
@@ -917,7 +1544,7 @@ void wallet2::finalize_transaction(const currency::create_tx_arg& create_tx_para
   {
     //unlock funds if transaction rejected
     for (auto& s : create_tx_param.sources)
-      m_transfers[s.transfer_index].m_spent = true;
+      set_transfer_spent(s.transfer_index, true);
   }
 
   std::string recipient;
@@ -930,7 +1557,8 @@ void wallet2::finalize_transaction(const currency::create_tx_arg& create_tx_para
   add_sent_unconfirmed_tx(tx, create_tx_param.change_amount, recipient);
 
   crypto::hash txid = get_transaction_hash(tx);
-  m_tx_keys.insert(std::make_pair(txid, create_tx_result.txkey.sec));
+  if (m_tx_keys.insert(std::make_pair(txid, create_tx_result.txkey.sec)).second)
+    m_unstored_tx_keys.push_back(txid);
 
   LOG_PRINT_L2("transaction " << get_transaction_hash(tx) << " generated ok and sent to daemon, key_images: [" << key_images << "]");
 
@@ -979,7 +1607,7 @@ void wallet2::get_unconfirmed_transfers(std::vector<wallet_rpc::wallet_transfer_
 //----------------------------------------------------------------------------------------------------
 bool wallet2::is_transfer_unlocked(const transfer_details& td) const
 {
-  if(!is_tx_spendtime_unlocked(td.m_tx.unlock_time))
+  if(!is_tx_spendtime_unlocked(td.m_tx_unlock_time))
     return false;
 
   if(td.m_block_height + DEFAULT_TX_SPENDABLE_AGE > m_blockchain.size())
@@ -1056,20 +1684,10 @@ uint64_t wallet2::select_indices_for_transfer(std::list<size_t>& selected_indexe
 //----------------------------------------------------------------------------------------------------
 uint64_t wallet2::select_transfers(uint64_t needed_money, size_t fake_outputs_count, uint64_t dust, std::list<transfer_container::iterator>& selected_transfers)
 {
-  std::map<uint64_t, std::list<size_t> > found_free_amounts;
-
-  for (size_t i = 0; i < m_transfers.size(); ++i)
-  {
-    const transfer_details& td = m_transfers[i];
-    if (!td.m_spent && is_transfer_unlocked(td) && 
-      currency::is_mixattr_applicable_for_fake_outs_counter(boost::get<currency::txout_to_key>(td.m_tx.vout[td.m_internal_output_index].target).mix_attr, fake_outputs_count))
-    {
-      found_free_amounts[td.m_tx.vout[td.m_internal_output_index].amount].push_back(i);
-    }
-  }
-
+  //unlocked unspent transfers are kept by amount, no need to go over all of them
+  process_unlocked_transfers();
   std::list<size_t> selected_indexes;
-  uint64_t found_money = select_indices_for_transfer(selected_indexes, found_free_amounts, needed_money);
+  uint64_t found_money = m_unspent_transfers.select(needed_money, fake_outputs_count, selected_indexes);
   for(auto i: selected_indexes)
     selected_transfers.push_back(m_transfers.begin() + i);
   
@@ -5,8 +5,10 @@
 #pragma once
 
 #include <memory>
+#include <unordered_set>
 #include <boost/serialization/list.hpp>
 #include <boost/serialization/vector.hpp>
+#include <boost/serialization/utility.hpp>
 #include <atomic>
 
 #include "include_base_utils.h"
@@ -22,8 +24,11 @@
 #include "core_rpc_proxy.h"
 #include "core_default_rpc_proxy.h"
 #include "wallet_errors.h"
+#include "common/parallel_for.h"
+#include "unspent_transfers_index.h"
 
 #define DEFAULT_TX_SPENDABLE_AGE                               10
+#define WALLET_CACHE_JOURNAL_COMPACT_PERCENT                   50 //rewrite wallet cache when journal grows beyond this share of it
 
 namespace tools
 {
@@ -62,20 +67,40 @@ namespace tools
 
   class wallet2
   {
-    wallet2(const wallet2&) : m_run(true), m_is_view_only(false), m_callback(0), m_unconfirmed_balance(0) {};
+    wallet2(const wallet2&) : m_run(true), m_is_view_only(false), m_callback(0), m_unconfirmed_balance(0), m_pool_version(0), m_scan_threads(get_default_worker_threads_count()), m_cache_generation(0), m_cache_snapshot_size(0), m_cache_journal_size(0), m_unspent_balance(0), m_locked_unspent_balance(0) {};
   public:
-    wallet2() : m_run(true), m_callback(0), m_is_view_only(false), m_core_proxy(new default_http_core_proxy()), m_unconfirmed_balance(0)
-    {};
+    wallet2() : m_run(true), m_callback(0), m_is_view_only(false), m_core_proxy(new default_http_core_proxy()), m_unconfirmed_balance(0), m_pool_version(0), m_scan_threads(get_default_worker_threads_count()),
+      m_cache_generation(0), m_cache_snapshot_size(0), m_cache_journal_size(0), m_unspent_balance(0), m_locked_unspent_balance(0)
+    {
+      reset_cache_watermarks();
+    };
+    // received output; the whole transaction is kept once per tx in the transfer transactions table (see get_transfer_tx())
     struct transfer_details
     {
       uint64_t m_block_height;
-      currency::transaction m_tx;
+      crypto::hash m_tx_id;
+      crypto::public_key m_tx_pub_key;
+      uint64_t m_tx_unlock_time;
       size_t m_internal_output_index;
       uint64_t m_global_output_index;
+      uint64_t m_amount;
+      crypto::public_key m_out_key;
+      uint8_t m_mix_attr;
       bool m_spent;
       crypto::key_image m_key_image; //TODO: key_image stored twice :(
 
-      uint64_t amount() const { return m_tx.vout[m_internal_output_index].amount; }
+      uint64_t amount() const { return m_amount; }
+    };
+
+    // transfer_details layout of wallet cache versions before 12, with a transaction copy per output
+    struct legacy_transfer_details
+    {
+      uint64_t m_block_height;
+      currency::transaction m_tx;
+      size_t m_internal_output_index;
+      uint64_t m_global_output_index;
+      bool m_spent;
+      crypto::key_image m_key_image;
     };
 
     struct unconfirmed_transfer_details
@@ -95,6 +120,30 @@ namespace tools
       uint64_t m_unlock_time;
     };
     
+    // output detection results for a transaction; they depend only on account keys, not on the wallet state,
+    // so blocks are scanned in parallel and then applied to the wallet in order
+    struct tx_scan_result
+    {
+      currency::transaction tx;
+      bool parsed;
+      bool extra_parsed;
+      bool outs_looked_up;
+      crypto::public_key tx_pub_key;
+      std::vector<size_t> outs;
+      uint64_t money_got_in_outs;
+      bool has_global_indexes; // global outputs indexes came with getblocks.bin
+      std::vector<uint64_t> global_indexes;
+    };
+
+    struct block_scan_result
+    {
+      currency::block b;
+      crypto::hash id;
+      bool parsed;
+      bool scanned; // false for blocks older than the account, they are not searched for transfers
+      std::vector<tx_scan_result> txs; // miner tx goes first
+    };
+
     typedef std::unordered_multimap<currency::payment_id_t, payment_details> payment_container;
 
     typedef std::vector<transfer_details> transfer_container;
@@ -110,6 +159,27 @@ namespace tools
       END_SERIALIZE()
     };
 
+    // wallet cache changes since previous store(), appended to the cache journal.
+    // Containers are cut to the stored sizes first and then extended, so an entry can't depend on detached blocks
+    struct cache_journal_entry
+    {
+      uint64_t generation;  // entries from other generations belong to an older cache file and are skipped
+      uint64_t blockchain_size;
+      std::vector<crypto::hash> blocks;
+      uint64_t transfers_size;
+      std::vector<transfer_details> transfers;
+      std::vector<uint64_t> spent;   // indexes of earlier transfers which became spent
+      std::vector<uint64_t> unspent; // ...and unspent
+      uint64_t payments_height;      // payments from this height are replaced
+      std::vector<std::pair<currency::payment_id_t, payment_details> > payments;
+      uint64_t history_size;
+      std::vector<wallet_rpc::wallet_transfer_info> history;
+      std::vector<std::pair<crypto::hash, crypto::secret_key> > tx_keys;
+      std::vector<std::pair<crypto::hash, unconfirmed_transfer_details> > unconfirmed_added;
+      std::vector<crypto::hash> unconfirmed_removed;
+      std::vector<currency::transaction> legacy_txs; // not stored, transactions of transfers read from entries of version 0
+    };
+
     std::vector<unsigned char> generate(const std::string& wallet, const std::string& password);
     void restore(const std::string& wallet, const std::vector<unsigned char>& restore_seed, const std::string& password);
     void load(const std::string& wallet, const std::string& password);    
@@ -158,6 +228,7 @@ namespace tools
     void transfer(const std::vector<currency::tx_destination_entry>& dsts, size_t fake_outputs_count, uint64_t unlock_time, uint64_t fee, const std::vector<uint8_t>& extra, currency::transaction& tx, currency::blobdata& relay_blob, bool do_not_relay = false);
     
     bool get_tx_key(const crypto::hash &txid, crypto::secret_key &tx_key) const;
+    bool get_transfer_tx(const crypto::hash& tx_id, currency::transaction& tx) const;
     bool check_connection();
     void get_transfers(wallet2::transfer_container& incoming_transfers) const;
     bool get_transfers(const wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request& req, wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response& res) const;
@@ -171,7 +242,16 @@ namespace tools
       if(ver < 5)
         return;
       a & m_blockchain;
-      a & m_transfers;
+      if (ver < 12)
+      {
+        std::vector<legacy_transfer_details> legacy_transfers;
+        a & legacy_transfers;
+        import_legacy_transfers(legacy_transfers, m_transfers, m_unstored_transfer_txs);
+      }
+      else
+      {
+        a & m_transfers;
+      }
       a & m_account_public_address;
       a & m_key_images;
       if(ver < 6)
@@ -186,14 +266,21 @@ namespace tools
       if (ver < 9)
           return;
       a & m_tx_keys;
-
+      if (ver < 11)
+        return;
+      a & m_cache_generation;
     }
+    static void scan_transaction(const currency::account_keys& keys, tx_scan_result& sr);
+    static void scan_blocks(const currency::account_keys& keys, uint64_t account_create_time, const std::list<currency::block_complete_entry>& blocks, std::vector<block_scan_result>& result, size_t threads_count);
+    void set_scan_threads(size_t threads_count) { m_scan_threads = threads_count ? threads_count : get_default_worker_threads_count(); }
+    static void fill_transfer_output_details(const currency::transaction& tx, const crypto::hash& tx_id, const crypto::public_key& tx_pub_key, size_t out_index, transfer_details& td);
+    static void import_legacy_transfers(std::vector<legacy_transfer_details>& legacy_transfers, transfer_container& transfers, std::unordered_map<crypto::hash, currency::transaction>& txs);
     static uint64_t select_indices_for_transfer(std::list<size_t>& ind, std::map<uint64_t, std::list<size_t> >& found_free_amounts, uint64_t needed_money);
   private:
 
     void load_keys(const std::string& keys_file_name, const std::string& password);
-    void process_new_transaction(const currency::transaction& tx, uint64_t height, const currency::block& b);
-    void process_new_blockchain_entry(const currency::block& b, currency::block_complete_entry& bche, crypto::hash& bl_id, uint64_t height);
+    void process_new_transaction(const tx_scan_result& sr, uint64_t height, const currency::block& b);
+    void process_new_blockchain_entry(const block_scan_result& bsr, const currency::block_complete_entry& bche, uint64_t height);
     void detach_blockchain(uint64_t height);
     void get_short_chain_history(std::list<crypto::hash>& ids);
     bool is_tx_spendtime_unlocked(uint64_t unlock_time) const;
@@ -202,6 +289,21 @@ namespace tools
     void pull_blocks(size_t& blocks_added);
     uint64_t select_transfers(uint64_t needed_money, size_t fake_outputs_count, uint64_t dust, std::list<transfer_container::iterator>& selected_transfers);
     bool prepare_file_names(const std::string& file_path);
+    void store_cache_snapshot();
+    void append_cache_journal();
+    void load_cache_journal();
+    bool apply_cache_journal_entry(const cache_journal_entry& e);
+    void reset_cache_watermarks();
+    void store_transfer_txs();
+    void compact_transfer_txs();
+    void load_transfer_txs_index();
+    void rebuild_transfer_indexes();
+    void add_transfer_to_indexes(size_t transfer_index);
+    void set_transfer_spent(size_t transfer_index, bool spent);
+    void add_payment(const currency::payment_id_t& payment_id, const payment_details& payment);
+    void add_transfer_history_entry_to_indexes(size_t history_index);
+    void process_unlocked_transfers();
+    uint64_t get_transfer_unlock_height(const transfer_details& td) const;
     void process_unconfirmed(const currency::transaction& tx, std::string& recipient, std::string& recipient_alias);
     void add_sent_unconfirmed_tx(const currency::transaction& tx, uint64_t change_amount, std::string recipient);
     void update_current_tx_limit();
@@ -217,6 +319,8 @@ namespace tools
     bool m_is_view_only;
     std::string m_wallet_file;
     std::string m_keys_file;
+    std::string m_cache_journal_file;
+    std::string m_transfer_txs_file;
     std::vector<crypto::hash> m_blockchain;
     std::atomic<uint64_t> m_local_bc_height; //temporary workaround 
     std::unordered_map<crypto::hash, unconfirmed_transfer_details> m_unconfirmed_txs;
@@ -231,16 +335,46 @@ namespace tools
     std::vector<wallet_rpc::wallet_transfer_info> m_transfer_history;
     std::unordered_map<crypto::hash, wallet_rpc::wallet_transfer_info> m_unconfirmed_in_transfers;
     uint64_t m_unconfirmed_balance;
+    uint64_t m_pool_version;                             //daemon pool version of the last scan_tx_pool()
+    std::unordered_set<crypto::hash> m_pool_scanned_txs; //pool txs already scanned, incomes are in m_unconfirmed_in_transfers
     std::shared_ptr<i_core_proxy> m_core_proxy;
     i_wallet2_callback* m_callback;
     std::unordered_map<crypto::hash, crypto::secret_key> m_tx_keys;
+    size_t m_scan_threads;
+
+    //wallet cache file state, everything below the watermarks is already on disk
+    uint64_t m_cache_generation;
+    uint64_t m_cache_snapshot_size;
+    uint64_t m_cache_journal_size;
+    size_t m_stored_blockchain_size;
+    size_t m_stored_transfers_size;
+    std::vector<bool> m_stored_spent;
+    uint64_t m_stored_payments_height;
+    size_t m_stored_history_size;
+    std::vector<crypto::hash> m_unstored_tx_keys;
+    std::unordered_set<crypto::hash> m_stored_unconfirmed_ids;
+    bool m_cache_detached;
+
+    //transactions of m_transfers, deduplicated: the ones not yet stored are kept in memory, others are read from m_transfer_txs_file by offset
+    std::unordered_map<crypto::hash, currency::transaction> m_unstored_transfer_txs;
+    std::unordered_map<crypto::hash, uint64_t> m_transfer_txs_index;
+
+    //aggregates and indexes over m_transfers, m_payments and m_transfer_history; not stored, rebuilt on load and detach
+    uint64_t m_unspent_balance;
+    uint64_t m_locked_unspent_balance;
+    std::multimap<uint64_t, size_t> m_locked_transfers_by_height; // unspent transfers by the blockchain size they get unlocked at
+    std::multimap<uint64_t, size_t> m_locked_transfers_by_time;   // ...then by unlock time, for time-locked ones
+    unspent_transfers_index m_unspent_transfers;                  // unlocked unspent transfers, for select_transfers()
+    std::unordered_map<currency::payment_id_t, std::multimap<uint64_t, const payment_details*> > m_payments_by_height;
+    std::multimap<uint64_t, size_t> m_transfer_history_by_height;
   };
 }
 
 
-BOOST_CLASS_VERSION(tools::wallet2, 10)
+BOOST_CLASS_VERSION(tools::wallet2, 12)
 BOOST_CLASS_VERSION(tools::wallet2::unconfirmed_transfer_details, 3)
 BOOST_CLASS_VERSION(tools::wallet_rpc::wallet_transfer_info, 3)
+BOOST_CLASS_VERSION(tools::wallet2::cache_journal_entry, 1)
 
 
 namespace boost
@@ -249,6 +383,22 @@ namespace boost
   {
     template <class Archive>
     inline void serialize(Archive &a, tools::wallet2::transfer_details &x, const boost::serialization::version_type ver)
+    {
+      a & x.m_block_height;
+      a & x.m_tx_id;
+      a & x.m_tx_pub_key;
+      a & x.m_tx_unlock_time;
+      a & x.m_internal_output_index;
+      a & x.m_global_output_index;
+      a & x.m_amount;
+      a & x.m_out_key;
+      a & x.m_mix_attr;
+      a & x.m_spent;
+      a & x.m_key_image;
+    }
+
+    template <class Archive>
+    inline void serialize(Archive &a, tools::wallet2::legacy_transfer_details &x, const boost::serialization::version_type ver)
     {
       a & x.m_block_height;
       a & x.m_global_output_index;
@@ -280,6 +430,37 @@ namespace boost
       a & x.m_block_height;
       a & x.m_unlock_time;
     }
+
+    template <class Archive>
+    inline void serialize(Archive& a, tools::wallet2::cache_journal_entry& x, const boost::serialization::version_type ver)
+    {
+      a & x.generation;
+      a & x.blockchain_size;
+      a & x.blocks;
+      a & x.transfers_size;
+      if (ver < 1)
+      {
+        std::vector<tools::wallet2::legacy_transfer_details> legacy_transfers;
+        a & legacy_transfers;
+        std::unordered_map<crypto::hash, currency::transaction> txs;
+        tools::wallet2::import_legacy_transfers(legacy_transfers, x.transfers, txs);
+        for (auto& tx : txs)
+          x.legacy_txs.push_back(tx.second);
+      }
+      else
+      {
+        a & x.transfers;
+      }
+      a & x.spent;
+      a & x.unspent;
+      a & x.payments_height;
+      a & x.payments;
+      a & x.history_size;
+      a & x.history;
+      a & x.tx_keys;
+      a & x.unconfirmed_added;
+      a & x.unconfirmed_removed;
+    }
     
     template <class Archive>
     inline void serialize(Archive& a, tools::wallet_rpc::wallet_transfer_info_details& x, const boost::serialization::version_type ver)
@@ -439,9 +620,6 @@ namespace tools
       req.outs_count = fake_outputs_count + 1;// add one to make possible (if need) to skip real output key
       BOOST_FOREACH(transfer_container::iterator it, selected_transfers)
       {
-        CHECK_AND_THROW_WALLET_EX(it->m_tx.vout.size() <= it->m_internal_output_index, error::wallet_internal_error,
-          "m_internal_output_index = " + std::to_string(it->m_internal_output_index) +
-          " is greater or equal to outputs count = " + std::to_string(it->m_tx.vout.size()));
         req.amounts.push_back(it->amount());
       }
 
@@ -499,9 +677,9 @@ namespace tools
       //size_t real_index = src.outputs.size() ? (rand() % src.outputs.size() ):0;
       tx_output_entry real_oe;
       real_oe.first = td.m_global_output_index;
-      real_oe.second = boost::get<txout_to_key>(td.m_tx.vout[td.m_internal_output_index].target).key;
+      real_oe.second = td.m_out_key;
       auto inserted_it = src.outputs.insert(it_to_insert, real_oe);
-      src.real_out_tx_key = get_tx_pub_key_from_extra(td.m_tx);
+      src.real_out_tx_key = td.m_tx_pub_key;
       src.real_output = inserted_it - src.outputs.begin();
       src.real_output_in_tx_index = td.m_internal_output_index;
       detail::print_source_entry(src);
@@ -530,7 +708,7 @@ namespace tools
     {
       //mark outputs as spent 
       BOOST_FOREACH(transfer_container::iterator it, selected_transfers)
-        it->m_spent = true;
+        set_transfer_spent(it - m_transfers.begin(), true);
       //do offline sig
       blobdata bl = t_serializable_object_to_blob(create_tx_param);
       crypto::do_chacha_crypt(bl, m_account.get_keys().m_view_secret_key);
@@ -0,0 +1,96 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chaingen.h"
+#include "chaingen_tests_list.h"
+
+#include "batch_import_events.h"
+
+using namespace epee;
+using namespace currency;
+
+
+gen_batch_import_events::gen_batch_import_events() : m_batch_start_seq(0), m_batch_start_height(0)
+{
+  REGISTER_CALLBACK_METHOD(gen_batch_import_events, begin_batch);
+  REGISTER_CALLBACK_METHOD(gen_batch_import_events, check_events_held);
+  REGISTER_CALLBACK_METHOD(gen_batch_import_events, end_batch);
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_batch_import_events::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  /*
+  (0 )-(0r)-(1 )-(2 )
+          \-(1a)-(2a)-(3a)   <- chain switch inside the batch
+  */
+
+  GENERATE_ACCOUNT(miner_account);
+
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  REWIND_BLOCKS(events, blk_0r, blk_0, miner_account);
+  DO_CALLBACK(events, "begin_batch");
+
+  MAKE_NEXT_BLOCK(events, blk_1, blk_0r, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_2, blk_1, miner_account);
+  DO_CALLBACK(events, "check_events_held");
+
+  MAKE_NEXT_BLOCK(events, blk_1a, blk_0r, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_2a, blk_1a, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_3a, blk_2a, miner_account);
+  DO_CALLBACK(events, "check_events_held");
+  DO_CALLBACK(events, "end_batch");
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_batch_import_events::begin_batch(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  m_batch_start_seq = c.get_event_journal().get_last_seq();
+  m_batch_start_height = c.get_current_blockchain_height();
+  CHECK_TEST_CONDITION(c.begin_batch_import());
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_batch_import_events::check_events_held(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  CHECK_EQ(m_batch_start_seq, c.get_event_journal().get_last_seq());
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_batch_import_events::end_batch(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  CHECK_TEST_CONDITION(c.end_batch_import());
+
+  std::list<core_event> journal_events;
+  uint64_t last_seq = 0;
+  CHECK_TEST_CONDITION(c.get_event_journal().get_events(m_batch_start_seq, 100, journal_events, last_seq));
+  CHECK_EQ(7, journal_events.size());
+
+  //(1), (2) added, then popped from the top, then the alternative chain added
+  const core_event_type expected_types[] = { core_event_block_added, core_event_block_added, core_event_block_removed, core_event_block_removed,
+    core_event_block_added, core_event_block_added, core_event_block_added };
+  const uint64_t expected_heights[] = { 0, 1, 1, 0, 0, 1, 2 };
+  size_t i = 0;
+  for (const auto& ev : journal_events)
+  {
+    CHECK_EQ(m_batch_start_seq + i + 1, ev.seq);
+    CHECK_EQ(expected_types[i], ev.type);
+    CHECK_EQ(m_batch_start_height + expected_heights[i], ev.height);
+    ++i;
+  }
+
+  //published ids are the ones of the main chain
+  for (auto it = std::next(journal_events.begin(), 4); it != journal_events.end(); ++it)
+  {
+    block b = AUTO_VAL_INIT(b);
+    CHECK_TEST_CONDITION(c.get_blockchain_storage().get_block_by_height(it->height, b));
+    CHECK_TEST_CONDITION(get_block_hash(b) == it->id);
+  }
+  return true;
+}
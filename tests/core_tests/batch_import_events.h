@@ -0,0 +1,26 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include "chaingen.h"
+
+/************************************************************************/
+/* Main chain events of a batched import are published only when the   */
+/* batch is committed                                                   */
+/************************************************************************/
+class gen_batch_import_events : public test_chain_unit_base
+{
+public:
+  gen_batch_import_events();
+
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool begin_batch(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool check_events_held(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool end_batch(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+
+private:
+  uint64_t m_batch_start_seq;
+  uint64_t m_batch_start_height;
+};
@@ -0,0 +1,167 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chaingen.h"
+#include "chaingen_tests_list.h"
+
+#include "chain_stats.h"
+
+using namespace epee;
+using namespace currency;
+
+
+gen_chain_stats::gen_chain_stats()
+{
+  REGISTER_CALLBACK_METHOD(gen_chain_stats, check_chain_stats);
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_stats::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  /*
+  (0 )-(0r)-(1 )-(1r)-(2 )-(5 )-(6 )        <- main chain at the end
+                    \-(3 )-(4 )             <- main chain for a while
+
+  (1) is the last block of the daily window after (1r), then it leaves the window with (2) and
+  gets back into it with each switch. (1) and (3) have transactions.
+  */
+
+  GENERATE_ACCOUNT(miner_account);
+
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  MAKE_ACCOUNT(events, alice_account);
+  REWIND_BLOCKS(events, blk_0r, blk_0, miner_account);
+  DO_CALLBACK(events, "check_chain_stats");
+
+  MAKE_TX(events, tx_0, miner_account, alice_account, MK_COINS(5), blk_0r);
+  MAKE_NEXT_BLOCK_TX1(events, blk_1, blk_0r, miner_account, tx_0);
+  DO_CALLBACK(events, "check_chain_stats");
+
+  REWIND_BLOCKS_N(events, blk_1r, blk_1, miner_account, CURRENCY_BLOCK_PER_DAY - 1);
+  DO_CALLBACK(events, "check_chain_stats");
+  MAKE_NEXT_BLOCK(events, blk_2, blk_1r, miner_account);
+  DO_CALLBACK(events, "check_chain_stats");
+
+  //switch to the alt chain: (2) is popped, (1) gets back into the window
+  MAKE_TX(events, tx_1, miner_account, alice_account, MK_COINS(7), blk_1r);
+  MAKE_NEXT_BLOCK_TX1(events, blk_3, blk_1r, miner_account, tx_1);
+  DO_CALLBACK(events, "check_chain_stats");
+  MAKE_NEXT_BLOCK(events, blk_4, blk_3, miner_account);
+  DO_CALLBACK(events, "check_chain_stats");
+
+  //switch back: (4) and (3) are popped, tx_1 goes back to the pool
+  MAKE_NEXT_BLOCK(events, blk_5, blk_2, miner_account);
+  DO_CALLBACK(events, "check_chain_stats");
+  MAKE_NEXT_BLOCK(events, blk_6, blk_5, miner_account);
+  DO_CALLBACK(events, "check_chain_stats");
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_stats::check_chain_stats(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  blockchain_storage& bcs = c.get_blockchain_storage();
+  blockchain_storage::chain_stats cs = AUTO_VAL_INIT(cs);
+  bcs.get_chain_stats(cs);
+
+  uint64_t height = bcs.get_current_blockchain_height();
+  CHECK_EQ(height, cs.height);
+
+  //walk the whole chain
+  uint64_t total_transactions = 0, daily_tx_count = 0, daily_tx_volume = 0;
+  std::vector<uint64_t> timestamps;
+  std::vector<wide_difficulty_type> commulative_difficulties;
+  for (uint64_t h = 0; h != height; ++h)
+  {
+    blockchain_storage::block_extended_info bei = AUTO_VAL_INIT(bei);
+    CHECK_TEST_CONDITION(bcs.get_block_extended_info_by_height(h, bei));
+    total_transactions += 1 + bei.bl.tx_hashes.size();
+    if (h && h + DIFFICULTY_BLOCKS_COUNT >= height)
+    {
+      timestamps.push_back(bei.bl.timestamp);
+      commulative_difficulties.push_back(bei.cumulative_difficulty);
+    }
+    if (h + CURRENCY_BLOCK_PER_DAY < height)
+      continue;
+
+    std::list<transaction> txs;
+    std::list<crypto::hash> missed_txs;
+    CHECK_TEST_CONDITION(bcs.get_transactions(bei.bl.tx_hashes, txs, missed_txs));
+    CHECK_TEST_CONDITION(missed_txs.empty());
+    for (const auto& tx : txs)
+    {
+      uint64_t amount = 0;
+      CHECK_TEST_CONDITION(get_inputs_money_amount(tx, amount));
+      ++daily_tx_count;
+      daily_tx_volume += amount;
+    }
+  }
+
+  CHECK_EQ(total_transactions, cs.total_transactions);
+  CHECK_EQ(daily_tx_count, cs.daily_tx_count);
+  CHECK_EQ(daily_tx_volume, cs.daily_tx_volume);
+  CHECK_TEST_CONDITION(next_difficulty(timestamps, commulative_difficulties) == cs.next_difficulty);
+  CHECK_EQ(c.get_alternative_blocks_count(), cs.alt_blocks_count);
+  CHECK_EQ(bcs.get_current_comulative_blocksize_limit(), cs.current_comulative_blocksize_limit);
+  CHECK_EQ(bcs.get_current_hashrate(50), cs.hashrate_50);
+  CHECK_EQ(bcs.get_current_hashrate(350), cs.hashrate_350);
+  CHECK_EQ(bcs.get_scratchpad_size(), cs.scratchpad_size);
+  CHECK_EQ(bcs.get_aliases_count(), cs.aliases_count);
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+gen_chain_stats_timestamps_back::gen_chain_stats_timestamps_back()
+{
+  REGISTER_CALLBACK_METHOD(gen_chain_stats_timestamps_back, check_zero_hashrate);
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_stats_timestamps_back::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  /*
+  (0 )-(1 )-...-(11)-(12)-(13)-...-(61)
+
+  (12) has the same timestamp as (61), others go one target apart. When (61) is added, hashrate
+  for 50 blocks is counted between them.
+  */
+  const uint64_t last_height = 61;
+  const uint64_t far_height = last_height + 1 - 50;
+
+  GENERATE_ACCOUNT(miner_account);
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+
+  block blk_prev = blk_0;
+  for (uint64_t h = 1; h <= last_height; ++h)
+  {
+    uint64_t timestamp = ts_start + (h == far_height ? last_height : h) * DIFFICULTY_TARGET;
+    block blk = AUTO_VAL_INIT(blk);
+    CHECK_AND_ASSERT_MES(generator.construct_block_manually(blk, blk_prev, miner_account, test_generator::bf_timestamp, 0, 0, timestamp),
+      false, "failed to construct block on height " << h);
+    events.push_back(blk);
+    blk_prev = blk;
+  }
+  DO_CALLBACK(events, "check_chain_stats");
+  DO_CALLBACK(events, "check_zero_hashrate");
+
+  //one more block, (13) is the far one now
+  MAKE_NEXT_BLOCK(events, blk_62, blk_prev, miner_account);
+  DO_CALLBACK(events, "check_chain_stats");
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_chain_stats_timestamps_back::check_zero_hashrate(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  blockchain_storage& bcs = c.get_blockchain_storage();
+  blockchain_storage::chain_stats cs = AUTO_VAL_INIT(cs);
+  bcs.get_chain_stats(cs);
+  CHECK_EQ(62, cs.height);
+  CHECK_EQ(0, cs.hashrate_50);
+  CHECK_EQ(0, bcs.get_current_hashrate(50));
+  return true;
+}
@@ -0,0 +1,34 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include "chaingen.h"
+
+/************************************************************************/
+/* Chain statistics kept incrementally on block push/pop should be the  */
+/* same as statistics calculated from scratch                           */
+/************************************************************************/
+class gen_chain_stats : public test_chain_unit_base
+{
+public:
+  gen_chain_stats();
+
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool check_chain_stats(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
+
+/************************************************************************/
+/* Timestamps follow the median rule only: the last block may be not    */
+/* later than the one hashrate is counted from                          */
+/************************************************************************/
+class gen_chain_stats_timestamps_back : public gen_chain_stats
+{
+public:
+  gen_chain_stats_timestamps_back();
+
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool check_zero_hashrate(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
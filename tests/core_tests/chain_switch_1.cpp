@@ -9,7 +9,7 @@ using namespace epee;
 using namespace currency;
 
 
-gen_chain_switch_1::gen_chain_switch_1()
+gen_chain_switch_1::gen_chain_switch_1() : m_pool_version(0)
 {
   REGISTER_CALLBACK("check_split_not_switched", gen_chain_switch_1::check_split_not_switched);
   REGISTER_CALLBACK("check_split_switched", gen_chain_switch_1::check_split_switched);
@@ -130,6 +130,7 @@ bool gen_chain_switch_1::check_split_not_switched(currency::core& c, size_t ev_i
 
   m_chain_1.swap(blocks);
   m_tx_pool.swap(tx_pool);
+  m_pool_version = c.get_tx_pool().get_version();
 
   return true;
 }
@@ -178,5 +179,23 @@ bool gen_chain_switch_1::check_split_switched(currency::core& c, size_t ev_index
   lookup_acc_outs(m_recipient_account_2.get_keys(), tx_pool.front(), tx_outs, transfered);
   CHECK_EQ(MK_COINS(7), transfered);
 
+  // pool changes since the split: tx from blk_5 removed, tx from blk_3 added
+  std::list<transaction> added;
+  std::list<crypto::hash> removed;
+  uint64_t version = 0;
+  r = c.get_pool_changes(m_pool_version, added, removed, version);
+  CHECK_TEST_CONDITION(r);
+  CHECK_TEST_CONDITION(version > m_pool_version);
+  CHECK_EQ(1, added.size());
+  CHECK_TEST_CONDITION(added.front() == tx_pool.front());
+  CHECK_TEST_CONDITION(std::find(removed.begin(), removed.end(), get_transaction_hash(m_tx_pool.front())) != removed.end());
+
+  added.clear();
+  removed.clear();
+  r = c.get_pool_changes(0, added, removed, version);
+  CHECK_TEST_CONDITION(!r);
+  CHECK_EQ(1, added.size());
+  CHECK_TEST_CONDITION(removed.empty());
+
   return true;
 }
@@ -27,4 +27,5 @@ private:
   currency::account_base m_recipient_account_4;
 
   std::list<currency::transaction> m_tx_pool;
+  uint64_t m_pool_version;
 };
@@ -86,6 +86,11 @@ int main(int argc, char* argv[])
     GENERATE_AND_PLAY(gen_simple_chain_split_1);
     GENERATE_AND_PLAY(one_block);
     GENERATE_AND_PLAY(gen_chain_switch_1);
+    GENERATE_AND_PLAY(gen_chain_stats);
+    GENERATE_AND_PLAY(gen_chain_stats_timestamps_back);
+    GENERATE_AND_PLAY(gen_batch_import_events);
+    GENERATE_AND_PLAY(gen_pool_changes);
+    GENERATE_AND_PLAY(gen_outputs_meta);
     GENERATE_AND_PLAY(gen_ring_signature_1);
     GENERATE_AND_PLAY(gen_ring_signature_2);
     //GENERATE_AND_PLAY(gen_ring_signature_big); // Takes up to XXX hours (if CURRENCY_MINED_MONEY_UNLOCK_WINDOW == 10)
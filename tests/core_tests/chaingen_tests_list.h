@@ -9,6 +9,10 @@
 #include "block_validation.h"
 #include "chain_split_1.h"
 #include "chain_switch_1.h"
+#include "chain_stats.h"
+#include "batch_import_events.h"
+#include "pool_changes.h"
+#include "outputs_meta.h"
 #include "double_spend.h"
 #include "integer_overflow.h"
 #include "ring_signature_1.h"
@@ -0,0 +1,217 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chaingen.h"
+#include "chaingen_tests_list.h"
+
+#include "outputs_meta.h"
+#include "common/db_lmdb_adapter.h"
+
+using namespace epee;
+using namespace currency;
+
+namespace
+{
+  //the same tables as blockchain_storage uses
+  const char outputs_meta_table_name[] = "outputs_meta";
+  const char solo_options_table_name[] = "solo";
+  const uint64_t outputs_meta_height_option_id = 4;
+
+  //outputs of each amount in global index order, calculated from the whole chain
+  bool get_expected_outputs_meta(blockchain_storage& bcs, std::map<uint64_t, std::vector<blockchain_storage::output_meta_entry> >& outs)
+  {
+    uint64_t height = bcs.get_current_blockchain_height();
+    std::list<std::pair<uint64_t, uint64_t> > direct_spends;
+    for (uint64_t h = 0; h != height; ++h)
+    {
+      block b = AUTO_VAL_INIT(b);
+      CHECK_TEST_CONDITION(bcs.get_block_by_height(h, b));
+      std::list<transaction> txs;
+      std::list<crypto::hash> missed_txs;
+      CHECK_TEST_CONDITION(bcs.get_transactions(b.tx_hashes, txs, missed_txs));
+      CHECK_TEST_CONDITION(missed_txs.empty());
+      txs.push_front(b.miner_tx);
+      for (const auto& tx : txs)
+      {
+        for (const auto& in : tx.vin)
+        {
+          if (in.type() == typeid(txin_to_key) && boost::get<txin_to_key>(in).key_offsets.size() == 1)
+            direct_spends.push_back(std::make_pair(boost::get<txin_to_key>(in).amount, boost::get<txin_to_key>(in).key_offsets[0]));
+        }
+        for (const auto& out : tx.vout)
+        {
+          if (out.target.type() != typeid(txout_to_key))
+            continue;
+          blockchain_storage::output_meta_entry ome = AUTO_VAL_INIT(ome);
+          ome.out_key = boost::get<txout_to_key>(out.target).key;
+          ome.keeper_block_height = h;
+          ome.unlock_time = tx.unlock_time;
+          ome.mix_attr = boost::get<txout_to_key>(out.target).mix_attr;
+          outs[out.amount].push_back(ome);
+        }
+      }
+    }
+    for (const auto& s : direct_spends)
+    {
+      CHECK_TEST_CONDITION(s.second < outs[s.first].size());
+      outs[s.first][s.second].spent = 1;
+    }
+    return true;
+  }
+
+  bool is_unlocked(uint64_t unlock_time, uint64_t height)
+  {
+    if (unlock_time < CURRENCY_MAX_BLOCK_NUMBER)
+      return height - 1 + CURRENCY_LOCKED_TX_ALLOWED_DELTA_BLOCKS >= unlock_time;
+    return static_cast<uint64_t>(time(nullptr)) + CURRENCY_LOCKED_TX_ALLOWED_DELTA_SECONDS >= unlock_time;
+  }
+}
+
+gen_outputs_meta::gen_outputs_meta()
+{
+  REGISTER_CALLBACK_METHOD(gen_outputs_meta, check_outputs_meta);
+  REGISTER_CALLBACK_METHOD(gen_outputs_meta, restart_with_partial_outputs_meta);
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_outputs_meta::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+  /*
+  (0 )-(0r)-(1 )-(2 )-(3 )-(4 )-(4r)        <- main chain at the end
+          \-(1a)-(2a)-(3a)                  <- main chain for a while
+
+  (1) and (1a) have transactions spending outputs directly. Random outputs are requested after each
+  block, so the frontier of unlocked outputs is cached before each switch.
+  */
+
+  GENERATE_ACCOUNT(miner_account);
+
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  MAKE_ACCOUNT(events, alice_account);
+  REWIND_BLOCKS(events, blk_0r, blk_0, miner_account);
+  DO_CALLBACK(events, "check_outputs_meta");
+
+  MAKE_TX(events, tx_0, miner_account, alice_account, MK_COINS(5), blk_0r);
+  MAKE_NEXT_BLOCK_TX1(events, blk_1, blk_0r, miner_account, tx_0);
+  DO_CALLBACK(events, "check_outputs_meta");
+  MAKE_NEXT_BLOCK(events, blk_2, blk_1, miner_account);
+  DO_CALLBACK(events, "check_outputs_meta");
+
+  //switch to the alt chain: (2) and (1) are popped
+  MAKE_TX(events, tx_1, miner_account, alice_account, MK_COINS(7), blk_0r);
+  MAKE_NEXT_BLOCK_TX1(events, blk_1a, blk_0r, miner_account, tx_1);
+  MAKE_NEXT_BLOCK(events, blk_2a, blk_1a, miner_account);
+  DO_CALLBACK(events, "check_outputs_meta");
+  MAKE_NEXT_BLOCK(events, blk_3a, blk_2a, miner_account);
+  DO_CALLBACK(events, "check_outputs_meta");
+
+  //switch back
+  MAKE_NEXT_BLOCK(events, blk_3, blk_2, miner_account);
+  MAKE_NEXT_BLOCK(events, blk_4, blk_3, miner_account);
+  DO_CALLBACK(events, "check_outputs_meta");
+
+  //outputs of (1)..(4) get unlocked
+  REWIND_BLOCKS(events, blk_4r, blk_4, miner_account);
+  DO_CALLBACK(events, "check_outputs_meta");
+
+  DO_CALLBACK(events, "restart_with_partial_outputs_meta");
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_outputs_meta::check_outputs_meta(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  blockchain_storage& bcs = c.get_blockchain_storage();
+  std::map<uint64_t, std::vector<blockchain_storage::output_meta_entry> > outs;
+  CHECK_TEST_CONDITION(get_expected_outputs_meta(bcs, outs));
+  uint64_t height = bcs.get_current_blockchain_height();
+
+  for (const auto& amount_outs : outs)
+  {
+    const uint64_t amount = amount_outs.first;
+    const std::vector<blockchain_storage::output_meta_entry>& expected = amount_outs.second;
+    std::list<crypto::public_key> pkeys;
+    CHECK_TEST_CONDITION(bcs.get_outs(amount, pkeys));
+    CHECK_EQ(expected.size(), pkeys.size());
+    size_t i = 0;
+    for (const auto& pk : pkeys)
+      CHECK_TEST_CONDITION(expected[i++].out_key == pk);
+
+    //more outputs than there are: all good ones below the frontier are returned in index order
+    COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request req = AUTO_VAL_INIT(req);
+    COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response res = AUTO_VAL_INIT(res);
+    req.amounts.push_back(amount);
+    req.outs_count = expected.size() + 1;
+    CHECK_TEST_CONDITION(bcs.get_random_outs_for_amounts(req, res));
+    CHECK_EQ(1, res.outs.size());
+
+    std::list<std::pair<uint64_t, crypto::public_key> > expected_random_outs;
+    for (i = 0; i != expected.size() && expected[i].keeper_block_height + CURRENCY_MINED_MONEY_UNLOCK_WINDOW <= height; ++i)
+    {
+      const blockchain_storage::output_meta_entry& ome = expected[i];
+      if (ome.spent || !is_unlocked(ome.unlock_time, height) || ome.mix_attr == CURRENCY_TO_KEY_OUT_FORCED_NO_MIX ||
+        (ome.mix_attr != CURRENCY_TO_KEY_OUT_RELAXED && ome.mix_attr > req.outs_count))
+        continue;
+      expected_random_outs.push_back(std::make_pair(i, ome.out_key));
+    }
+    CHECK_EQ(expected_random_outs.size(), res.outs.front().outs.size());
+    auto e_it = expected_random_outs.begin();
+    for (const auto& oen : res.outs.front().outs)
+    {
+      CHECK_EQ(e_it->first, oen.global_amount_index);
+      CHECK_TEST_CONDITION(e_it->second == oen.out_key);
+      ++e_it;
+    }
+  }
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_outputs_meta::restart_with_partial_outputs_meta(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  blockchain_storage& bcs = c.get_blockchain_storage();
+  std::map<uint64_t, std::vector<blockchain_storage::output_meta_entry> > outs;
+  CHECK_TEST_CONDITION(get_expected_outputs_meta(bcs, outs));
+  const uint64_t height = bcs.get_current_blockchain_height();
+  const std::string db_folder = c.get_config_folder() + "/" CURRENCY_BLOCKCHAINDATA_FOLDERNAME;
+
+  //storage as left by a run interrupted while filling metadata, then by a run of a version which doesn't keep it
+  const uint64_t resume_heights[] = { height / 2, 0 };
+  for (uint64_t resume_height : resume_heights)
+  {
+    CHECK_TEST_CONDITION(bcs.deinit());
+    {
+      std::shared_ptr<db::lmdb_adapter> lmdb_ptr = std::make_shared<db::lmdb_adapter>();
+      db::db_bridge_base dbb(lmdb_ptr);
+      CHECK_TEST_CONDITION(dbb.open(db_folder));
+      blockchain_storage::outputs_meta_container meta(dbb);
+      CHECK_TEST_CONDITION(meta.init(outputs_meta_table_name));
+      db::key_value_accessor_base<uint64_t, uint64_t, false> solo_options(dbb);
+      CHECK_TEST_CONDITION(solo_options.init(solo_options_table_name));
+      db::single_value<uint64_t, uint64_t, db::key_value_accessor_base<uint64_t, uint64_t, false> > meta_height(outputs_meta_height_option_id, solo_options);
+
+      dbb.begin_transaction();
+      CHECK_EQ(std::numeric_limits<uint64_t>::max(), static_cast<uint64_t>(meta_height));
+      for (const auto& amount_outs : outs)
+      {
+        size_t count = meta.get_item_size(amount_outs.first);
+        CHECK_EQ(amount_outs.second.size(), count);
+        //with zero height, metadata which is there is not trusted and is filled from scratch
+        while (resume_height && count && amount_outs.second[count - 1].keeper_block_height >= resume_height)
+        {
+          meta.pop_back_item(amount_outs.first);
+          --count;
+        }
+      }
+      meta_height = resume_height;
+      dbb.commit_transaction();
+      dbb.close();
+    }
+    CHECK_TEST_CONDITION(bcs.init(c.get_config_folder()));
+    CHECK_EQ(height, bcs.get_current_blockchain_height());
+    CHECK_TEST_CONDITION(check_outputs_meta(c, ev_index, events));
+  }
+  return true;
+}
@@ -0,0 +1,22 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include "chaingen.h"
+
+/************************************************************************/
+/* Outputs metadata and the cached unlocked outputs frontier should     */
+/* give the same random outputs as the whole chain, after rollbacks and */
+/* after metadata is filled for an old storage on start                 */
+/************************************************************************/
+class gen_outputs_meta : public test_chain_unit_base
+{
+public:
+  gen_outputs_meta();
+
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool check_outputs_meta(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+  bool restart_with_partial_outputs_meta(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
@@ -0,0 +1,144 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chaingen.h"
+#include "chaingen_tests_list.h"
+
+#include "pool_changes.h"
+
+using namespace epee;
+using namespace currency;
+
+namespace
+{
+  //transaction with a unique key image; its inputs are not in the blockchain, so it's accepted by the pool only as kept by block
+  transaction make_pool_tx(uint64_t n)
+  {
+    transaction tx = AUTO_VAL_INIT(tx);
+    tx.version = CURRENT_TRANSACTION_VERSION;
+    txin_to_key in = AUTO_VAL_INIT(in);
+    in.amount = MK_COINS(1);
+    in.key_offsets.push_back(0);
+    memcpy(&in.k_image, &n, sizeof(n));
+    tx.vin.push_back(in);
+    tx.signatures.push_back(std::vector<crypto::signature>(1));
+    txout_to_key out_target = AUTO_VAL_INIT(out_target);
+    tx_out out = AUTO_VAL_INIT(out);
+    out.amount = MK_COINS(1) - TX_POOL_MINIMUM_FEE;
+    out.target = out_target;
+    tx.vout.push_back(out);
+    return tx;
+  }
+
+  bool add_pool_tx(tx_memory_pool& pool, const transaction& tx)
+  {
+    tx_verification_context tvc = AUTO_VAL_INIT(tvc);
+    return pool.add_tx(tx, tvc, true) && tvc.m_added_to_pool;
+  }
+
+  bool take_pool_tx(tx_memory_pool& pool, const transaction& tx)
+  {
+    transaction taken_tx;
+    size_t blob_size = 0;
+    uint64_t fee = 0;
+    return pool.take_tx(get_transaction_hash(tx), taken_tx, blob_size, fee);
+  }
+}
+
+gen_pool_changes::gen_pool_changes()
+{
+  REGISTER_CALLBACK_METHOD(gen_pool_changes, check_pool_changes);
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_pool_changes::generate(std::vector<test_event_entry>& events) const
+{
+  uint64_t ts_start = 1338224400;
+
+  GENERATE_ACCOUNT(miner_account);
+  MAKE_GENESIS_BLOCK(events, blk_0, miner_account, ts_start);
+  DO_CALLBACK(events, "check_pool_changes");
+
+  return true;
+}
+
+//-----------------------------------------------------------------------------------------------------
+bool gen_pool_changes::check_pool_changes(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events)
+{
+  tx_memory_pool& pool = c.get_tx_pool();
+  std::list<transaction> added;
+  std::list<crypto::hash> removed;
+  const uint64_t start_version = pool.get_version();
+  uint64_t version = 0;
+  CHECK_TEST_CONDITION(c.get_pool_changes(start_version, added, removed, version));
+  CHECK_EQ(start_version, version);
+  CHECK_TEST_CONDITION(added.empty() && removed.empty());
+
+  const transaction tx_a = make_pool_tx(1);
+  const transaction tx_b = make_pool_tx(2);
+  CHECK_TEST_CONDITION(add_pool_tx(pool, tx_a));
+  CHECK_TEST_CONDITION(add_pool_tx(pool, tx_b));
+  const uint64_t added_version = pool.get_version();
+  CHECK_TEST_CONDITION(take_pool_tx(pool, tx_a));
+  const uint64_t removed_version = pool.get_version();
+
+  //tx_a is added and removed after start_version
+  CHECK_TEST_CONDITION(c.get_pool_changes(start_version, added, removed, version));
+  CHECK_EQ(removed_version, version);
+  CHECK_EQ(1, added.size());
+  CHECK_TEST_CONDITION(added.front() == tx_b);
+  CHECK_EQ(1, removed.size());
+  CHECK_TEST_CONDITION(removed.front() == get_transaction_hash(tx_a));
+
+  added.clear();
+  removed.clear();
+  CHECK_TEST_CONDITION(c.get_pool_changes(added_version, added, removed, version));
+  CHECK_TEST_CONDITION(added.empty());
+  CHECK_EQ(1, removed.size());
+
+  //versions from a previous daemon run or from the future are unknown, the whole pool is returned
+  const uint64_t unknown_versions[] = { 0, start_version - 1, (static_cast<uint64_t>(time(nullptr)) - 1) << 20, removed_version + 1 };
+  for (uint64_t unknown_version : unknown_versions)
+  {
+    added.clear();
+    removed.clear();
+    CHECK_TEST_CONDITION(!c.get_pool_changes(unknown_version, added, removed, version));
+    CHECK_EQ(removed_version, version);
+    CHECK_EQ(1, added.size());
+    CHECK_TEST_CONDITION(added.front() == tx_b);
+    CHECK_TEST_CONDITION(removed.empty());
+  }
+
+  //a restarted pool doesn't take versions of the previous run
+  misc_utils::sleep_no_w(1100);
+  tx_memory_pool restarted_pool(c.get_blockchain_storage());
+  CHECK_TEST_CONDITION(add_pool_tx(restarted_pool, tx_b));
+  added.clear();
+  CHECK_TEST_CONDITION(!restarted_pool.get_changes(removed_version, added, removed, version));
+  CHECK_EQ(1, added.size());
+  CHECK_TEST_CONDITION(removed.empty());
+
+  //only last MEMPOOL_REMOVED_TXS_HISTORY_SIZE removals are kept, removal of tx_a is the first one to be forgotten
+  for (uint64_t n = 0; n != MEMPOOL_REMOVED_TXS_HISTORY_SIZE; ++n)
+  {
+    const transaction tx = make_pool_tx(3 + n);
+    CHECK_TEST_CONDITION(add_pool_tx(pool, tx));
+    CHECK_TEST_CONDITION(take_pool_tx(pool, tx));
+  }
+  added.clear();
+  removed.clear();
+  CHECK_TEST_CONDITION(c.get_pool_changes(removed_version, added, removed, version));
+  CHECK_TEST_CONDITION(added.empty());
+  CHECK_EQ(MEMPOOL_REMOVED_TXS_HISTORY_SIZE, removed.size());
+  CHECK_TEST_CONDITION(removed.back() == get_transaction_hash(make_pool_tx(2 + MEMPOOL_REMOVED_TXS_HISTORY_SIZE)));
+
+  removed.clear();
+  CHECK_TEST_CONDITION(!c.get_pool_changes(removed_version - 1, added, removed, version));
+  CHECK_EQ(1, added.size());
+  CHECK_TEST_CONDITION(added.front() == tx_b);
+  CHECK_TEST_CONDITION(removed.empty());
+
+  CHECK_TEST_CONDITION(take_pool_tx(pool, tx_b));
+  return true;
+}
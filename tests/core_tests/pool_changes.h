@@ -0,0 +1,21 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+#include "chaingen.h"
+
+/************************************************************************/
+/* Pool changes since a version: added and removed transactions, or     */
+/* the whole pool if the version is unknown (too old or from a previous */
+/* daemon run)                                                          */
+/************************************************************************/
+class gen_pool_changes : public test_chain_unit_base
+{
+public:
+  gen_pool_changes();
+
+  bool generate(std::vector<test_event_entry>& events) const;
+
+  bool check_pool_changes(currency::core& c, size_t ev_index, const std::vector<test_event_entry>& events);
+};
@@ -116,5 +116,36 @@ bool prun_ring_signatures::check_blockchain(currency::core& c, size_t ev_index,
   
   CHECK_EQ(c.get_current_blockchain_height(), currency::get_block_height(b) + 1);
 
+  //blocks and transactions are served the way they are stored, pruned transactions without signatures
+  blockchain_storage& bcs = c.get_blockchain_storage();
+  for (uint64_t h = 0; h != bcs.get_current_blockchain_height(); ++h)
+  {
+    block bl = AUTO_VAL_INIT(bl);
+    CHECK_TEST_CONDITION(bcs.get_block_by_height(h, bl));
+    NOTIFY_REQUEST_GET_OBJECTS::request req = AUTO_VAL_INIT(req);
+    NOTIFY_RESPONSE_GET_OBJECTS::request rsp = AUTO_VAL_INIT(rsp);
+    req.blocks.push_back(get_block_hash(bl));
+    req.txs.assign(bl.tx_hashes.begin(), bl.tx_hashes.end());
+    CHECK_TEST_CONDITION(bcs.handle_get_objects(req, rsp));
+    CHECK_EQ(1, rsp.blocks.size());
+    CHECK_TEST_CONDITION(rsp.blocks.front().block == block_to_blob(bl));
+    CHECK_EQ(bl.tx_hashes.size(), rsp.blocks.front().txs.size());
+    CHECK_EQ(bl.tx_hashes.size(), rsp.txs.size());
+    CHECK_TEST_CONDITION(rsp.missed_ids.empty());
+
+    std::list<transaction> txs;
+    std::list<crypto::hash> missed_txs;
+    bcs.get_transactions(bl.tx_hashes, txs, missed_txs);
+    CHECK_EQ(bl.tx_hashes.size(), txs.size());
+    auto it_blob = rsp.blocks.front().txs.begin();
+    auto it_tx_blob = rsp.txs.begin();
+    for (const auto& tx : txs)
+    {
+      CHECK_TEST_CONDITION(tx.signatures.empty());
+      CHECK_TEST_CONDITION(*it_blob++ == tx_to_blob(tx));
+      CHECK_TEST_CONDITION(*it_tx_blob++ == tx_to_blob(tx));
+    }
+  }
+
   return true;
 }
\ No newline at end of file
@@ -0,0 +1,62 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <string>
+
+#include "crypto/crypto.h"
+#include "currency_protocol/currency_protocol_defs.h"
+#include "storages/portable_storage_template_helper.h"
+
+// loading NOTIFY_RESPONSE_GET_OBJECTS with a_blocks_count blocks of 4 transactions each, like the node gets it while syncing:
+// through portable_storage tree, as it used to be, or straight from the buffer with binary_view_storage
+template<size_t a_blocks_count, bool a_use_view>
+class test_load_get_objects
+{
+public:
+  static const size_t loop_count = 100;
+
+  bool init()
+  {
+    currency::NOTIFY_RESPONSE_GET_OBJECTS::request req = AUTO_VAL_INIT(req);
+    for (size_t i = 0; i != a_blocks_count; ++i)
+    {
+      currency::block_complete_entry bce;
+      bce.block = random_blob(400);
+      for (size_t j = 0; j != 4; ++j)
+        bce.txs.push_back(random_blob(3000));
+      req.blocks.push_back(bce);
+    }
+    req.current_blockchain_height = 100500;
+    return epee::serialization::store_t_to_binary(req, m_buff);
+  }
+
+  bool test()
+  {
+    currency::NOTIFY_RESPONSE_GET_OBJECTS::request req;
+    if (a_use_view)
+    {
+      if (!epee::serialization::load_t_from_binary(req, m_buff))
+        return false;
+    }
+    else
+    {
+      epee::serialization::portable_storage ps;
+      if (!ps.load_from_binary(m_buff) || !req.load(ps))
+        return false;
+    }
+    return req.blocks.size() == a_blocks_count;
+  }
+
+private:
+  static std::string random_blob(size_t size)
+  {
+    std::string blob(size, '\0');
+    crypto::generate_random_bytes(size, &blob[0]);
+    return blob;
+  }
+
+  std::string m_buff;
+};
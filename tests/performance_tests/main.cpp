@@ -15,6 +15,10 @@
 #include "generate_key_image_helper.h"
 #include "is_out_to_acc.h"
 #include "keccak_test.h"
+#include "load_from_binary.h"
+#include "parse_tx.h"
+#include "select_transfers.h"
+#include "wallet_scan.h"
 
 int main(int argc, char** argv)
 {
@@ -43,6 +47,32 @@ int main(int argc, char** argv)
   TEST_PERFORMANCE1(test_wild_keccak2, 100000000);
 
   measure_keccak_over_scratchpad();
+
+  TEST_PERFORMANCE2(test_parse_tx, 1, 1);
+  TEST_PERFORMANCE2(test_parse_tx, 2, 10);
+  TEST_PERFORMANCE2(test_parse_tx, 10, 50);
+  TEST_PERFORMANCE2(test_parse_tx, 100, 100);
+
+  TEST_PERFORMANCE1(test_parse_block, 0);
+  TEST_PERFORMANCE1(test_parse_block, 10);
+  TEST_PERFORMANCE1(test_parse_block, 100);
+
+  TEST_PERFORMANCE1(test_wallet_scan_blocks, 1);
+  TEST_PERFORMANCE1(test_wallet_scan_blocks, 2);
+  TEST_PERFORMANCE1(test_wallet_scan_blocks, 4);
+  TEST_PERFORMANCE1(test_wallet_scan_blocks, 8);
+
+  TEST_PERFORMANCE2(test_select_transfers, 1000, false);
+  TEST_PERFORMANCE2(test_select_transfers, 1000, true);
+  TEST_PERFORMANCE2(test_select_transfers, 10000, false);
+  TEST_PERFORMANCE2(test_select_transfers, 10000, true);
+  TEST_PERFORMANCE2(test_select_transfers, 50000, false);
+  TEST_PERFORMANCE2(test_select_transfers, 50000, true);
+
+  TEST_PERFORMANCE2(test_load_get_objects, 20, false);
+  TEST_PERFORMANCE2(test_load_get_objects, 20, true);
+  TEST_PERFORMANCE2(test_load_get_objects, 200, false);
+  TEST_PERFORMANCE2(test_load_get_objects, 200, true);
   /*
   TEST_PERFORMANCE2(test_construct_tx, 1, 1);
   TEST_PERFORMANCE2(test_construct_tx, 1, 2);
@@ -0,0 +1,114 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <list>
+
+#include "currency_core/account.h"
+#include "currency_core/currency_basic.h"
+#include "currency_core/currency_format_utils.h"
+#include "crypto/crypto.h"
+
+// transaction with random key offsets, key images and signatures: parsing doesn't check them
+inline currency::transaction make_parse_test_tx(size_t in_count, size_t ring_size, size_t out_count)
+{
+  using namespace currency;
+
+  transaction tx = AUTO_VAL_INIT(tx);
+  tx.version = CURRENT_TRANSACTION_VERSION;
+  for (size_t i = 0; i != in_count; ++i)
+  {
+    txin_to_key in = AUTO_VAL_INIT(in);
+    in.amount = crypto::rand<uint64_t>() % 1000000000000;
+    in.k_image = crypto::rand<crypto::key_image>();
+    // relative offsets: first one is a global index, others are small gaps
+    in.key_offsets.push_back(crypto::rand<uint32_t>() % 2000000);
+    for (size_t j = 1; j < ring_size; ++j)
+      in.key_offsets.push_back(crypto::rand<uint32_t>() % 20000);
+    tx.vin.push_back(in);
+    tx.signatures.push_back(std::vector<crypto::signature>(ring_size));
+    for (auto& s : tx.signatures.back())
+      s = crypto::rand<crypto::signature>();
+  }
+  for (size_t i = 0; i != out_count; ++i)
+  {
+    txout_to_key out_key;
+    out_key.key = crypto::rand<crypto::public_key>();
+    tx_out out = AUTO_VAL_INIT(out);
+    out.amount = crypto::rand<uint64_t>() % 1000000000000;
+    out.target = out_key;
+    tx.vout.push_back(out);
+  }
+  add_tx_pub_key_to_extra(tx, crypto::rand<crypto::public_key>());
+  return tx;
+}
+
+template<size_t a_in_count, size_t a_ring_size>
+class test_parse_tx
+{
+public:
+  static const size_t loop_count = 1000;
+
+  bool init()
+  {
+    m_tx_blob = currency::tx_to_blob(make_parse_test_tx(a_in_count, a_ring_size, 2 * a_in_count));
+    return true;
+  }
+
+  bool test()
+  {
+    currency::transaction tx;
+    return currency::parse_and_validate_tx_from_blob(m_tx_blob, tx);
+  }
+
+private:
+  currency::blobdata m_tx_blob;
+};
+
+// block with transactions as it comes in NOTIFY_RESPONSE_GET_OBJECTS during synchronization
+template<size_t a_tx_count>
+class test_parse_block
+{
+public:
+  static const size_t loop_count = 100;
+
+  bool init()
+  {
+    using namespace currency;
+
+    account_base miner;
+    miner.generate();
+    block b = AUTO_VAL_INIT(b);
+    if (!construct_miner_tx(0, 0, 0, 0, 0, miner.get_keys().m_account_address, b.miner_tx))
+      return false;
+
+    for (size_t i = 0; i != a_tx_count; ++i)
+    {
+      transaction tx = make_parse_test_tx(2, 10, 4);
+      b.tx_hashes.push_back(get_transaction_hash(tx));
+      m_tx_blobs.push_back(tx_to_blob(tx));
+    }
+    m_block_blob = block_to_blob(b);
+    return true;
+  }
+
+  bool test()
+  {
+    currency::block b;
+    if (!currency::parse_and_validate_block_from_blob(m_block_blob, b))
+      return false;
+    for (const auto& tx_blob : m_tx_blobs)
+    {
+      currency::transaction tx;
+      if (!currency::parse_and_validate_tx_from_blob(tx_blob, tx))
+        return false;
+    }
+    return true;
+  }
+
+private:
+  currency::blobdata m_block_blob;
+  std::list<currency::blobdata> m_tx_blobs;
+};
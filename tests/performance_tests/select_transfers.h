@@ -0,0 +1,59 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include "crypto/crypto.h"
+#include "wallet/wallet2.h"
+#include "wallet/unspent_transfers_index.h"
+
+// coin selection over a wallet with a_outputs_count unspent outputs of random amounts:
+// building the amounts map from all transfers for each payment, as wallet2 used to, or using the kept index
+template<size_t a_outputs_count, bool a_use_index>
+class test_select_transfers
+{
+public:
+  static const size_t loop_count = 100;
+
+  bool init()
+  {
+    for (size_t i = 0; i != a_outputs_count; ++i)
+    {
+      // digit-decomposed amounts, like the wallet gets them
+      uint64_t amount = (crypto::rand<uint64_t>() % 9 + 1);
+      for (size_t p = crypto::rand<uint64_t>() % 12; p; --p)
+        amount *= 10;
+      m_amounts.push_back(amount);
+      m_index.add(amount, CURRENCY_TO_KEY_OUT_RELAXED, i);
+    }
+    return true;
+  }
+
+  bool test()
+  {
+    const uint64_t needed_money = 12345678900;
+    std::list<size_t> selected_indexes;
+    uint64_t found_money = 0;
+    if (a_use_index)
+    {
+      found_money = m_index.select(needed_money, 0, selected_indexes);
+    }
+    else
+    {
+      std::map<uint64_t, std::list<size_t> > found_free_amounts;
+      for (size_t i = 0; i != m_amounts.size(); ++i)
+        found_free_amounts[m_amounts[i]].push_back(i);
+      found_money = tools::wallet2::select_indices_for_transfer(selected_indexes, found_free_amounts, needed_money);
+    }
+    return found_money >= needed_money && !selected_indexes.empty();
+  }
+
+private:
+  std::vector<uint64_t> m_amounts;
+  tools::unspent_transfers_index m_index;
+};
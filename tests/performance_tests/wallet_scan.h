@@ -0,0 +1,89 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <list>
+
+#include "currency_core/account.h"
+#include "currency_core/currency_basic.h"
+#include "currency_core/currency_format_utils.h"
+#include "wallet/wallet2.h"
+
+// wallet refresh over synthetic chain: 100 blocks with 20 transactions of 4 outputs, each 10th transaction pays to the wallet
+template<size_t a_threads>
+class test_wallet_scan_blocks
+{
+public:
+  static const size_t loop_count = 10;
+  static const size_t blocks_count = 100;
+  static const size_t txs_per_block = 20;
+  static const size_t outs_per_tx = 4;
+
+  bool init()
+  {
+    using namespace currency;
+
+    m_wallet_acc.generate();
+    m_other_acc.generate();
+    size_t tx_counter = 0;
+    for (size_t i = 0; i != blocks_count; ++i)
+    {
+      block b = AUTO_VAL_INIT(b);
+      b.timestamp = 1500000000 + i * 120;
+      if (!construct_miner_tx(0, 0, 0, 0, 0, m_other_acc.get_keys().m_account_address, b.miner_tx))
+        return false;
+
+      block_complete_entry bce;
+      for (size_t j = 0; j != txs_per_block; ++j, ++tx_counter)
+      {
+        const account_public_address& addr = tx_counter % 10 ? m_other_acc.get_keys().m_account_address : m_wallet_acc.get_keys().m_account_address;
+        transaction tx = make_tx_to(addr);
+        b.tx_hashes.push_back(get_transaction_hash(tx));
+        bce.txs.push_back(tx_to_blob(tx));
+      }
+      bce.block = block_to_blob(b);
+      m_blocks.push_back(bce);
+    }
+    return true;
+  }
+
+  bool test()
+  {
+    std::vector<tools::wallet2::block_scan_result> result;
+    tools::wallet2::scan_blocks(m_wallet_acc.get_keys(), 0, m_blocks, result, a_threads);
+    size_t found = 0;
+    for (const auto& bsr : result)
+      for (const auto& sr : bsr.txs)
+        found += sr.outs.size();
+    return found == blocks_count * txs_per_block / 10 * outs_per_tx;
+  }
+
+private:
+  currency::transaction make_tx_to(const currency::account_public_address& addr)
+  {
+    using namespace currency;
+
+    transaction tx = AUTO_VAL_INIT(tx);
+    tx.version = CURRENT_TRANSACTION_VERSION;
+    keypair txkey = keypair::generate();
+    add_tx_pub_key_to_extra(tx, txkey.pub);
+    crypto::key_derivation derivation;
+    crypto::generate_key_derivation(addr.m_view_public_key, txkey.sec, derivation);
+    for (size_t i = 0; i != outs_per_tx; ++i)
+    {
+      txout_to_key out_key;
+      crypto::derive_public_key(derivation, i, addr.m_spend_public_key, out_key.key);
+      tx_out out = AUTO_VAL_INIT(out);
+      out.amount = 1000000;
+      out.target = out_key;
+      tx.vout.push_back(out);
+    }
+    return tx;
+  }
+
+  currency::account_base m_wallet_acc;
+  currency::account_base m_other_acc;
+  std::list<currency::block_complete_entry> m_blocks;
+};
@@ -12,6 +12,8 @@
 #include "currency_core/currency_boost_serialization.h"
 #include "currency_core/difficulty.h"
 #include "common/difficulty_boost_serialization.h"
+#include "currency_core/blockchain_storage.h"
+#include "currency_core/miner.h"
 
 TEST(block_pack_unpack, basic_struct_packing)
 {
@@ -34,6 +36,153 @@ TEST(block_pack_unpack, basic_struct_packing)
   ASSERT_EQ(original_id, loaded_boost_id);
 }
 
+namespace
+{
+  //hashes calculated from scratch, ignoring cache of the object
+  crypto::hash get_uncached_block_hash(currency::block b)
+  {
+    b.invalidate_hashes();
+    return get_block_hash(b);
+  }
+  crypto::hash get_uncached_transaction_hash(currency::transaction tx)
+  {
+    tx.invalidate_hashes();
+    return get_transaction_hash(tx);
+  }
+  size_t get_uncached_blobsize(currency::transaction tx)
+  {
+    tx.invalidate_hashes();
+    return get_object_blobsize(tx);
+  }
+}
+
+TEST(block_pack_unpack, hashes_cache)
+{
+  currency::block b = AUTO_VAL_INIT(b);
+  currency::generate_genesis_block(b);
+  crypto::hash original_id = get_block_hash(b);
+  crypto::hash miner_tx_id = get_transaction_hash(b.miner_tx);
+  size_t miner_tx_size = get_object_blobsize(b.miner_tx);
+
+  currency::blobdata blob = currency::t_serializable_object_to_blob(b);
+  currency::block b_loaded = AUTO_VAL_INIT(b_loaded);
+  ASSERT_TRUE(currency::parse_and_validate_block_from_blob(blob, b_loaded));
+  ASSERT_EQ(original_id, get_block_hash(b_loaded));
+  ASSERT_EQ(miner_tx_id, get_transaction_hash(b_loaded.miner_tx));
+  ASSERT_EQ(miner_tx_size, get_object_blobsize(b_loaded.miner_tx));
+  ASSERT_EQ(blob.size(), get_object_blobsize(b_loaded));
+
+  //modified object needs explicit invalidation
+  b_loaded.nonce++;
+  ASSERT_EQ(original_id, get_block_hash(b_loaded));
+  b_loaded.invalidate_hashes();
+  ASSERT_EQ(get_uncached_block_hash(b_loaded), get_block_hash(b_loaded));
+  ASSERT_NE(original_id, get_block_hash(b_loaded));
+
+  //miner changes nonce of a parsed block
+  currency::block b_mined = AUTO_VAL_INIT(b_mined);
+  ASSERT_TRUE(currency::parse_and_validate_block_from_blob(blob, b_mined));
+  std::vector<crypto::hash> scratchpad(16, currency::null_hash);
+  ASSERT_TRUE(currency::miner::find_nonce_for_given_block(b_mined, 1, 0, [&](uint64_t index) -> crypto::hash&
+  {
+    return scratchpad[index%scratchpad.size()];
+  }));
+  ASSERT_EQ(get_uncached_block_hash(b_mined), get_block_hash(b_mined));
+
+  //signatures don't contribute to cached prefix hash and blob size
+  currency::transaction tx = AUTO_VAL_INIT(tx);
+  ASSERT_TRUE(currency::parse_and_validate_tx_from_blob(currency::t_serializable_object_to_blob(b.miner_tx), tx));
+  tx.signatures.clear();
+  ASSERT_EQ(get_uncached_transaction_hash(tx), get_transaction_hash(tx));
+  ASSERT_EQ(get_uncached_blobsize(tx), get_object_blobsize(tx));
+
+  //deserialization into already parsed object resets cache
+  currency::block b_other = b;
+  b_other.nonce++;
+  ASSERT_TRUE(currency::t_unserializable_object_from_blob(b_loaded, blob));
+  ASSERT_EQ(original_id, get_block_hash(b_loaded));
+  ASSERT_TRUE(currency::t_unserializable_object_from_blob(b_loaded, currency::t_serializable_object_to_blob(b_other)));
+  ASSERT_EQ(get_uncached_block_hash(b_other), get_block_hash(b_loaded));
+
+  //construction into already parsed transaction resets cache
+  currency::account_base acc;
+  acc.generate();
+  ASSERT_TRUE(currency::construct_miner_tx(1, 0, 0, 0, 0, acc.get_keys().m_account_address, tx));
+  ASSERT_EQ(get_uncached_transaction_hash(tx), get_transaction_hash(tx));
+  ASSERT_NE(miner_tx_id, get_transaction_hash(tx));
+  ASSERT_EQ(get_uncached_blobsize(tx), get_object_blobsize(tx));
+}
+
+TEST(block_pack_unpack, chain_entries_records)
+{
+  //block and transaction are kept in records as length prefixed blobs, right after version field(s)
+  currency::blockchain_storage::block_extended_info bei = AUTO_VAL_INIT(bei);
+  ASSERT_TRUE(currency::generate_genesis_block(bei.bl));
+  bei.height = 1;
+  bei.block_cumulative_size = 2;
+  bei.cumulative_difficulty = 3;
+  bei.already_generated_coins = 4;
+  bei.already_donated_coins = 5;
+  bei.scratch_offset = 6;
+  currency::blobdata block_blob = currency::block_to_blob(bei.bl);
+  currency::blobdata record = currency::t_serializable_object_to_blob(bei);
+  size_t prefix_size = tools::get_varint_packed_size(block_blob.size());
+  ASSERT_EQ(2, record[0]);
+  ASSERT_EQ(block_blob, record.substr(sizeof(uint32_t) + prefix_size, block_blob.size()));
+
+  currency::blockchain_storage::block_extended_info bei_loaded = AUTO_VAL_INIT(bei_loaded);
+  ASSERT_TRUE(currency::t_unserializable_object_from_blob(bei_loaded, record));
+  ASSERT_EQ(get_block_hash(bei.bl), get_block_hash(bei_loaded.bl));
+  ASSERT_EQ(bei.height, bei_loaded.height);
+  ASSERT_EQ(bei.cumulative_difficulty, bei_loaded.cumulative_difficulty);
+  ASSERT_EQ(bei.scratch_offset, bei_loaded.scratch_offset);
+
+  //version 1 record has block inline, it's still loaded and is stored back as version 2
+  currency::blobdata record_v1 = record;
+  record_v1.erase(sizeof(uint32_t), prefix_size);
+  record_v1[0] = 1;
+  bei_loaded = AUTO_VAL_INIT(bei_loaded);
+  ASSERT_TRUE(currency::t_unserializable_object_from_blob(bei_loaded, record_v1));
+  ASSERT_EQ(1, bei_loaded.version);
+  ASSERT_EQ(get_block_hash(bei.bl), get_block_hash(bei_loaded.bl));
+  ASSERT_EQ(bei.scratch_offset, bei_loaded.scratch_offset);
+  ASSERT_EQ(record, currency::t_serializable_object_to_blob(bei_loaded));
+
+  //wrong blob length
+  currency::blobdata record_broken = record;
+  record_broken[sizeof(uint32_t)]--;
+  ASSERT_FALSE(currency::t_unserializable_object_from_blob(bei_loaded, record_broken));
+
+  currency::blockchain_storage::transaction_chain_entry tce = AUTO_VAL_INIT(tce);
+  tce.tx = bei.bl.miner_tx;
+  tce.m_keeper_block_height = 7;
+  tce.m_global_output_indexes.assign(tce.tx.vout.size(), 8);
+  tce.m_spent_flags.assign(tce.tx.vout.size(), true);
+  currency::blobdata tx_blob = currency::tx_to_blob(tce.tx);
+  record = currency::t_serializable_object_to_blob(tce);
+  prefix_size = tools::get_varint_packed_size(tx_blob.size());
+  ASSERT_EQ(2, record[0]);
+  ASSERT_EQ(2, record[sizeof(uint32_t)]);
+  ASSERT_EQ(tx_blob, record.substr(2 * sizeof(uint32_t) + prefix_size, tx_blob.size()));
+
+  currency::blockchain_storage::transaction_chain_entry tce_loaded = AUTO_VAL_INIT(tce_loaded);
+  ASSERT_TRUE(currency::t_unserializable_object_from_blob(tce_loaded, record));
+  ASSERT_EQ(get_transaction_hash(tce.tx), get_transaction_hash(tce_loaded.tx));
+  ASSERT_EQ(tce.m_keeper_block_height, tce_loaded.m_keeper_block_height);
+  ASSERT_EQ(tce.m_global_output_indexes, tce_loaded.m_global_output_indexes);
+  ASSERT_EQ(tce.m_spent_flags, tce_loaded.m_spent_flags);
+
+  record_v1 = record;
+  record_v1.erase(2 * sizeof(uint32_t), prefix_size);
+  record_v1[0] = 1;
+  record_v1[sizeof(uint32_t)] = 1;
+  tce_loaded = AUTO_VAL_INIT(tce_loaded);
+  ASSERT_TRUE(currency::t_unserializable_object_from_blob(tce_loaded, record_v1));
+  ASSERT_EQ(get_transaction_hash(tce.tx), get_transaction_hash(tce_loaded.tx));
+  ASSERT_EQ(tce.m_spent_flags, tce_loaded.m_spent_flags);
+  ASSERT_EQ(record, currency::t_serializable_object_to_blob(tce_loaded));
+}
+
 TEST(boost_multiprecision_serizlization, basic_struct_packing)
 {
   std::vector<currency::wide_difficulty_type> v_origial;
@@ -0,0 +1,98 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <thread>
+
+#include "currency_core/core_event_journal.h"
+
+namespace
+{
+  crypto::hash make_id(char c)
+  {
+    crypto::hash h;
+    memset(&h, c, sizeof(h));
+    return h;
+  }
+}
+
+TEST(core_event_journal, returns_events_after_seq)
+{
+  currency::core_event_journal journal(3);
+  std::list<currency::core_event> events;
+  uint64_t last_seq = 100;
+  ASSERT_TRUE(journal.get_events(0, 10, events, last_seq));
+  ASSERT_TRUE(events.empty());
+  ASSERT_EQ(0, last_seq);
+
+  journal.push(currency::core_event_block_added, make_id(1), 10);
+  journal.push(currency::core_event_tx_added, make_id(2), 0);
+  ASSERT_TRUE(journal.get_events(1, 10, events, last_seq));
+  ASSERT_EQ(2, last_seq);
+  ASSERT_EQ(1, events.size());
+  ASSERT_EQ(2, events.front().seq);
+  ASSERT_EQ(currency::core_event_tx_added, events.front().type);
+  ASSERT_EQ(make_id(2), events.front().id);
+
+  events.clear();
+  ASSERT_TRUE(journal.get_events(0, 1, events, last_seq));
+  ASSERT_EQ(1, events.size());
+  ASSERT_EQ(1, events.front().seq);
+  ASSERT_EQ(10, events.front().height);
+
+  // only last 3 events are kept
+  journal.push(currency::core_event_tx_removed, make_id(2), 0);
+  journal.push(currency::core_event_block_removed, make_id(1), 10);
+  events.clear();
+  ASSERT_FALSE(journal.get_events(0, 10, events, last_seq));
+  ASSERT_EQ(3, events.size());
+  ASSERT_EQ(2, events.front().seq);
+  ASSERT_EQ(4, last_seq);
+  events.clear();
+  ASSERT_TRUE(journal.get_events(1, 10, events, last_seq));
+  ASSERT_EQ(3, events.size());
+
+  // seq from before daemon restart
+  events.clear();
+  ASSERT_FALSE(journal.get_events(5, 10, events, last_seq));
+  ASSERT_TRUE(events.empty());
+}
+
+TEST(core_event_journal, wait_events)
+{
+  currency::core_event_journal journal;
+  std::list<currency::core_event> events;
+  uint64_t last_seq = 0;
+  ASSERT_TRUE(journal.wait_events(0, 10, 10, events, last_seq));
+  ASSERT_TRUE(events.empty());
+
+  std::thread pusher([&journal]()
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    journal.push(currency::core_event_block_added, make_id(1), 1);
+  });
+  ASSERT_TRUE(journal.wait_events(0, 60000, 10, events, last_seq));
+  pusher.join();
+  ASSERT_EQ(1, events.size());
+  ASSERT_EQ(1, last_seq);
+
+  journal.interrupt_waits();
+  events.clear();
+  ASSERT_TRUE(journal.wait_events(1, 60000, 10, events, last_seq));
+  ASSERT_TRUE(events.empty());
+}
+
+TEST(core_event_journal, id_changes_on_restart)
+{
+  currency::core_event_journal journal;
+  ASSERT_NE(0, journal.get_id());
+  journal.push(currency::core_event_block_added, make_id(1), 1);
+  ASSERT_EQ(journal.get_id(), journal.get_id());
+
+  // seq of a restarted daemon may go past the old one, only the id tells it
+  std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  currency::core_event_journal restarted_journal;
+  ASSERT_NE(journal.get_id(), restarted_journal.get_id());
+}
@@ -0,0 +1,164 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include "include_base_utils.h"
+#include "serialization/keyvalue_serialization.h"
+#include "storages/portable_storage_template_helper.h"
+
+namespace
+{
+  struct bin_view_item
+  {
+    std::string blob;
+    std::list<std::string> blobs;
+    uint32_t value;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(blob)
+      KV_SERIALIZE(blobs)
+      KV_SERIALIZE(value)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct bin_view_struct
+  {
+    int64_t i64;
+    int8_t i8;
+    uint16_t u16;
+    double d;
+    bool flag;
+    std::string text;
+    std::vector<uint64_t> numbers;
+    std::list<bin_view_item> items;
+    bin_view_item nested;
+    std::list<uint64_t> pods;
+    std::list<bin_view_item> no_items;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(i64)
+      KV_SERIALIZE(i8)
+      KV_SERIALIZE(u16)
+      KV_SERIALIZE(d)
+      KV_SERIALIZE(flag)
+      KV_SERIALIZE(text)
+      KV_SERIALIZE(numbers)
+      KV_SERIALIZE(items)
+      KV_SERIALIZE(nested)
+      KV_SERIALIZE_CONTAINER_POD_AS_BLOB(pods)
+      KV_SERIALIZE(no_items)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  // newer version of bin_view_struct: fields which are not in the buffer keep their values
+  struct bin_view_struct_ext
+  {
+    int64_t i64;
+    uint64_t missing_value;
+    bin_view_item missing_section;
+    epee::enableable<bin_view_item> missing_enableable;
+    std::list<bin_view_item> items;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(i64)
+      KV_SERIALIZE(missing_value)
+      KV_SERIALIZE(missing_section)
+      KV_SERIALIZE(missing_enableable)
+      KV_SERIALIZE(items)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  bin_view_item make_item(const std::string& blob, uint32_t value)
+  {
+    bin_view_item item = AUTO_VAL_INIT(item);
+    item.blob = blob;
+    item.blobs.push_back(blob + blob);
+    item.blobs.push_back(std::string());
+    item.value = value;
+    return item;
+  }
+
+  bin_view_struct make_struct()
+  {
+    bin_view_struct s = AUTO_VAL_INIT(s);
+    s.i64 = -100500;
+    s.i8 = -3;
+    s.u16 = 65535;
+    s.d = 0.125;
+    s.flag = true;
+    s.text = std::string("\x00\x01" "text", 6);
+    s.numbers.push_back(1);
+    s.numbers.push_back(18446744073709551615ULL);
+    s.items.push_back(make_item("first", 1));
+    s.items.push_back(make_item(std::string(70000, 'a'), 2));
+    s.nested = make_item("nested", 3);
+    s.pods.push_back(5);
+    s.pods.push_back(6);
+    return s;
+  }
+}
+
+TEST(binary_view_storage, loads_as_portable_storage)
+{
+  bin_view_struct s = make_struct();
+  std::string buff = epee::serialization::store_t_to_binary(s);
+
+  bin_view_struct from_tree = AUTO_VAL_INIT(from_tree);
+  epee::serialization::portable_storage ps;
+  ASSERT_TRUE(ps.load_from_binary(buff));
+  ASSERT_TRUE(from_tree.load(ps));
+
+  bin_view_struct from_view = AUTO_VAL_INIT(from_view);
+  epee::serialization::binary_view_storage bvs;
+  ASSERT_TRUE(bvs.load_from_binary(buff));
+  ASSERT_TRUE(from_view.load(bvs));
+
+  ASSERT_EQ(epee::serialization::store_t_to_json(from_tree), epee::serialization::store_t_to_json(from_view));
+  ASSERT_EQ(epee::serialization::store_t_to_json(s), epee::serialization::store_t_to_json(from_view));
+  ASSERT_EQ(2, from_view.items.size());
+  ASSERT_EQ(70000, from_view.items.back().blob.size());
+  ASSERT_EQ(std::string("\x00\x01" "text", 6), from_view.text);
+}
+
+TEST(binary_view_storage, missing_entries)
+{
+  bin_view_struct s = make_struct();
+  std::string buff = epee::serialization::store_t_to_binary(s);
+
+  bin_view_struct_ext ext = AUTO_VAL_INIT(ext);
+  ext.missing_value = 7;
+  ext.missing_section.value = 8;
+  ASSERT_TRUE(epee::serialization::load_t_from_binary(ext, buff));
+  ASSERT_EQ(-100500, ext.i64);
+  ASSERT_EQ(7, ext.missing_value);
+  ASSERT_EQ(8, ext.missing_section.value);
+  ASSERT_TRUE(ext.missing_enableable.enabled); // the same as portable_storage gives
+  ASSERT_EQ(2, ext.items.size());
+  ASSERT_EQ("first", ext.items.front().blob);
+}
+
+TEST(binary_view_storage, wrong_buffers)
+{
+  bin_view_struct s = make_struct();
+  std::string buff = epee::serialization::store_t_to_binary(s);
+
+  epee::serialization::binary_view_storage bvs;
+  ASSERT_FALSE(bvs.load_from_binary(std::string()));
+  ASSERT_FALSE(bvs.load_from_binary(std::string(buff.size(), '\0')));
+  for (size_t sz = 0; sz < buff.size(); sz += (sz < 1000 ? 1 : 997))
+    ASSERT_FALSE(bvs.load_from_binary(buff.substr(0, sz))) << "size " << sz;
+
+  // root section claims a huge number of entries
+  std::string huge = buff.substr(0, 9);
+  huge.push_back(static_cast<char>(0xff));
+  huge.append(7, static_cast<char>(0xff));
+  huge.append(10, 'x');
+  ASSERT_FALSE(bvs.load_from_binary(huge));
+
+  ASSERT_TRUE(bvs.load_from_binary(buff));
+  bin_view_struct l = AUTO_VAL_INIT(l);
+  ASSERT_TRUE(l.load(bvs));
+  ASSERT_EQ(s.text, l.text);
+}
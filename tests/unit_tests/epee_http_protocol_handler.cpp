@@ -0,0 +1,234 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include "include_base_utils.h"
+#include "net/http_protocol_handler.h"
+#ifdef HTTP_ENABLE_GZIP
+#include <zlib.h>
+#endif
+
+namespace
+{
+  typedef epee::net_utils::connection_context_base test_context;
+
+  struct test_endpoint : public epee::net_utils::i_service_endpoint
+  {
+    virtual bool do_send(const void* ptr, size_t cb) { sent.push_back(std::string(static_cast<const char*>(ptr), cb)); return true; }
+    virtual bool close() { return true; }
+    virtual bool call_run_once_service_io() { return true; }
+    virtual bool request_callback() { return true; }
+    virtual boost::asio::io_service& get_io_service() { return io_service; }
+    virtual bool add_ref() { return true; }
+    virtual bool release() { return true; }
+
+    std::vector<std::string> sent;
+    boost::asio::io_service io_service;
+  };
+
+  struct echo_handler : public epee::net_utils::http::i_http_server_handler<test_context>
+  {
+    virtual bool handle_http_request(const epee::net_utils::http::http_request_info& query_info, epee::net_utils::http::http_response_info& response, test_context& context)
+    {
+      response.m_body = query_info.m_URI + ":" + query_info.m_body;
+      return true;
+    }
+  };
+
+  struct test_connection
+  {
+    test_connection() : handler(&endpoint, config, context)
+    {
+      config.m_phandler = &echo;
+    }
+
+    bool recv(const std::string& data)
+    {
+      return handler.handle_recv(data.data(), data.size());
+    }
+
+    bool sent_ends_with(size_t i, const std::string& tail) const
+    {
+      if (endpoint.sent.size() <= i || endpoint.sent[i].size() < tail.size())
+        return false;
+      return 0 == endpoint.sent[i].compare(endpoint.sent[i].size() - tail.size(), tail.size(), tail);
+    }
+
+    test_endpoint endpoint;
+    echo_handler echo;
+    test_context context;
+    epee::net_utils::http::custum_handler_config<test_context> config;
+    epee::net_utils::http::http_custom_handler<test_context> handler;
+  };
+}
+
+TEST(http_protocol_handler, pipelined_requests)
+{
+  test_connection c;
+  ASSERT_TRUE(c.recv("POST /a HTTP/1.1\r\nContent-Length: 3\r\n\r\nabcGET /b HTTP/1.1\r\n\r\nPOST /c HTTP/1.1\r\nContent-Length: 2\r\n\r\nd"));
+  ASSERT_EQ(2, c.endpoint.sent.size());
+  ASSERT_TRUE(c.sent_ends_with(0, "\r\n\r\n/a:abc"));
+  ASSERT_TRUE(c.sent_ends_with(1, "\r\n\r\n/b:"));
+  ASSERT_EQ(std::string::npos, c.endpoint.sent[0].find("Connection: close"));
+
+  ASSERT_TRUE(c.recv("e"));
+  ASSERT_EQ(3, c.endpoint.sent.size());
+  ASSERT_TRUE(c.sent_ends_with(2, "\r\n\r\n/c:de"));
+}
+
+TEST(http_protocol_handler, chunked_request_body)
+{
+  test_connection c;
+  ASSERT_TRUE(c.recv("POST /c HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n"));
+  ASSERT_TRUE(c.recv("4;ext=1\r\nde"));
+  ASSERT_TRUE(c.recv("fg\r"));
+  ASSERT_TRUE(c.endpoint.sent.empty());
+  ASSERT_TRUE(c.recv("\n0\r\nTrailer: x\r\n\r\nGET /d HTTP/1.1\r\n\r\n"));
+  ASSERT_EQ(2, c.endpoint.sent.size());
+  ASSERT_TRUE(c.sent_ends_with(0, "\r\n\r\n/c:abcdefg"));
+  ASSERT_TRUE(c.sent_ends_with(1, "\r\n\r\n/d:"));
+
+  test_connection bad;
+  ASSERT_FALSE(bad.recv("POST /c HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nxyz\r\n"));
+  ASSERT_TRUE(bad.endpoint.sent.empty());
+}
+
+TEST(http_protocol_handler, request_body_size_limit)
+{
+  test_connection c;
+  ASSERT_FALSE(c.recv("POST /a HTTP/1.1\r\nContent-Length: " + std::to_string(HTTP_MAX_BODY_SIZE + 1) + "\r\n\r\nabc"));
+  ASSERT_TRUE(c.endpoint.sent.empty());
+
+  //chunks are limited by their total size
+  std::stringstream ss;
+  ss << std::hex << HTTP_MAX_BODY_SIZE - 2;
+  test_connection chunked;
+  ASSERT_TRUE(chunked.recv("POST /c HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabc\r\n"));
+  ASSERT_FALSE(chunked.recv(ss.str() + "\r\n"));
+  ASSERT_TRUE(chunked.endpoint.sent.empty());
+
+  test_connection huge_chunk;
+  ASSERT_FALSE(huge_chunk.recv("POST /c HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nffffffffffffffff\r\n"));
+  ASSERT_TRUE(huge_chunk.endpoint.sent.empty());
+}
+
+TEST(http_protocol_handler, http10_connection_close)
+{
+  test_connection c;
+  ASSERT_FALSE(c.recv("GET /a HTTP/1.0\r\n\r\nGET /b HTTP/1.1\r\n\r\n"));
+  ASSERT_EQ(1, c.endpoint.sent.size());
+  ASSERT_NE(std::string::npos, c.endpoint.sent[0].find("Connection: close\r\n"));
+
+  test_connection keep_alive;
+  ASSERT_TRUE(keep_alive.recv("GET /a HTTP/1.0\r\nConnection: keep-alive\r\n\r\n"));
+  ASSERT_EQ(1, keep_alive.endpoint.sent.size());
+  ASSERT_NE(std::string::npos, keep_alive.endpoint.sent[0].find("Connection: keep-alive\r\n"));
+  ASSERT_FALSE(keep_alive.recv("GET /b HTTP/1.1\r\nConnection: close\r\n\r\n"));
+  ASSERT_EQ(2, keep_alive.endpoint.sent.size());
+  ASSERT_NE(std::string::npos, keep_alive.endpoint.sent[1].find("Connection: close\r\n"));
+}
+
+#ifdef HTTP_ENABLE_GZIP
+namespace
+{
+  bool gunzip(const std::string& in, std::string& out)
+  {
+    z_stream zs = {0};
+    if (Z_OK != inflateInit2(&zs, 16 + MAX_WBITS))
+      return false;
+    zs.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(in.data()));
+    zs.avail_in = static_cast<uInt>(in.size());
+    int ret = Z_OK;
+    char buff[4096];
+    while (Z_OK == ret)
+    {
+      zs.next_out = reinterpret_cast<Bytef*>(buff);
+      zs.avail_out = sizeof(buff);
+      ret = inflate(&zs, Z_NO_FLUSH);
+      out.append(buff, sizeof(buff) - zs.avail_out);
+    }
+    inflateEnd(&zs);
+    return Z_STREAM_END == ret && 0 == zs.avail_in;
+  }
+
+  //body of the response, which is the last one sent
+  std::string get_response_body(const test_connection& c)
+  {
+    const std::string& response = c.endpoint.sent.back();
+    size_t pos = response.find("\r\n\r\n");
+    return pos == std::string::npos ? std::string() : response.substr(pos + 4);
+  }
+
+  //echoed back body is "/<uri>:" followed by the request body
+  std::string make_request(const std::string& body, const std::string& accept_encoding)
+  {
+    std::string request = "POST /g HTTP/1.1\r\nContent-Length: " + std::to_string(body.size()) + "\r\n";
+    if (accept_encoding.size())
+      request += "Accept-Encoding: " + accept_encoding + "\r\n";
+    return request + "\r\n" + body;
+  }
+}
+
+TEST(http_protocol_handler, gzip_round_trip)
+{
+  std::string body;
+  for (size_t i = 0; body.size() < 200000; ++i)
+    body += "{\"height\": " + std::to_string(i) + ", \"status\": \"OK\"}, ";
+
+  test_connection c;
+  ASSERT_TRUE(c.recv(make_request(body, "gzip, deflate")));
+  //header and body may go in one send or in two
+  std::string response;
+  for (const auto& part : c.endpoint.sent)
+    response += part;
+  size_t header_end = response.find("\r\n\r\n");
+  ASSERT_NE(std::string::npos, header_end);
+  const std::string header = response.substr(0, header_end + 2);
+  const std::string gzipped = response.substr(header_end + 4);
+  ASSERT_NE(std::string::npos, header.find("Content-Encoding: gzip\r\n"));
+  ASSERT_NE(std::string::npos, header.find("Vary: Accept-Encoding\r\n"));
+  ASSERT_NE(std::string::npos, header.find("Content-Length: " + std::to_string(gzipped.size()) + "\r\n"));
+  ASSERT_LT(gzipped.size(), body.size() / 4);
+  std::string unpacked;
+  ASSERT_TRUE(gunzip(gzipped, unpacked));
+  ASSERT_EQ("/g:" + body, unpacked);
+}
+
+TEST(http_protocol_handler, gzip_threshold)
+{
+  const std::string prefix = "/g:";
+  const std::string below(HTTP_MIN_GZIP_BODY_SIZE - prefix.size() - 1, 'a');
+  test_connection c;
+  ASSERT_TRUE(c.recv(make_request(below, "gzip")));
+  ASSERT_EQ(std::string::npos, c.endpoint.sent.back().find("Content-Encoding"));
+  ASSERT_EQ(prefix + below, get_response_body(c));
+
+  const std::string at(HTTP_MIN_GZIP_BODY_SIZE - prefix.size(), 'a');
+  ASSERT_TRUE(c.recv(make_request(at, "gzip")));
+  ASSERT_NE(std::string::npos, c.endpoint.sent.back().find("Content-Encoding: gzip\r\n"));
+  std::string unpacked;
+  ASSERT_TRUE(gunzip(get_response_body(c), unpacked));
+  ASSERT_EQ(prefix + at, unpacked);
+}
+
+TEST(http_protocol_handler, gzip_only_when_accepted)
+{
+  const std::string body(10000, 'a');
+  test_connection c;
+  ASSERT_TRUE(c.recv(make_request(body, "")));
+  ASSERT_EQ(std::string::npos, c.endpoint.sent.back().find("Content-Encoding"));
+  ASSERT_EQ("/g:" + body, get_response_body(c));
+
+  ASSERT_TRUE(c.recv(make_request(body, "identity")));
+  ASSERT_EQ(std::string::npos, c.endpoint.sent.back().find("Content-Encoding"));
+  ASSERT_EQ("/g:" + body, get_response_body(c));
+
+  ASSERT_TRUE(c.recv(make_request(body, "deflate, GZIP;q=0.5")));
+  ASSERT_NE(std::string::npos, c.endpoint.sent.back().find("Content-Encoding: gzip\r\n"));
+  std::string unpacked;
+  ASSERT_TRUE(gunzip(get_response_body(c), unpacked));
+  ASSERT_EQ("/g:" + body, unpacked);
+}
+#endif
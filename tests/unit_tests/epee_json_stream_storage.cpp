@@ -0,0 +1,147 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include "include_base_utils.h"
+#include "serialization/keyvalue_serialization.h"
+#include "storages/portable_storage_template_helper.h"
+
+namespace
+{
+  struct json_stream_item
+  {
+    std::string name;
+    uint64_t value;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(name)
+      KV_SERIALIZE(value)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  // entries are declared in name order, so portable_storage gives them in the same order
+  struct json_stream_sorted
+  {
+    double a_double;
+    bool b_flag;
+    std::list<json_stream_item> c_items;
+    std::vector<uint64_t> d_numbers;
+    std::list<std::string> e_empty;
+    json_stream_item f_nested;
+    int8_t g_small;
+    uint64_t h_pod;
+    std::string i_text;
+    std::list<json_stream_item> j_one_item;
+    std::vector<std::string> k_strings;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(a_double)
+      KV_SERIALIZE(b_flag)
+      KV_SERIALIZE(c_items)
+      KV_SERIALIZE(d_numbers)
+      KV_SERIALIZE(e_empty)
+      KV_SERIALIZE(f_nested)
+      KV_SERIALIZE(g_small)
+      KV_SERIALIZE_VAL_POD_AS_BLOB(h_pod)
+      KV_SERIALIZE(i_text)
+      KV_SERIALIZE(j_one_item)
+      KV_SERIALIZE(k_strings)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  struct json_stream_unsorted
+  {
+    std::list<json_stream_item> items;
+    uint64_t height;
+    json_stream_item alias;
+    std::string status;
+
+    BEGIN_KV_SERIALIZE_MAP()
+      KV_SERIALIZE(items)
+      KV_SERIALIZE(height)
+      KV_SERIALIZE(alias)
+      KV_SERIALIZE(status)
+    END_KV_SERIALIZE_MAP()
+  };
+
+  json_stream_item make_item(const std::string& name, uint64_t value)
+  {
+    json_stream_item item;
+    item.name = name;
+    item.value = value;
+    return item;
+  }
+}
+
+TEST(json_stream_storage, same_output_as_portable_storage)
+{
+  json_stream_sorted s;
+  s.a_double = 0.25;
+  s.b_flag = true;
+  s.c_items.push_back(make_item("first", 1));
+  s.c_items.push_back(make_item("second", 18446744073709551615ULL));
+  s.d_numbers.push_back(7);
+  s.d_numbers.push_back(0);
+  s.d_numbers.push_back(100500);
+  s.f_nested = make_item("nested", 42);
+  s.g_small = -5;
+  s.h_pod = 0x2f225c0a0d09ULL; // '/', '"', '\\' and control characters in the blob
+  s.i_text = "quote \" slash / backslash \\ crlf \r\n tab \t end";
+  s.j_one_item.push_back(make_item("", 0));
+  s.k_strings.push_back("a");
+  s.k_strings.push_back("b/c");
+
+  for (size_t indent = 0; indent != 3; ++indent)
+  {
+    epee::serialization::portable_storage ps;
+    s.store(ps);
+    std::string expected;
+    ASSERT_TRUE(ps.dump_as_json(expected, indent));
+
+    std::string json;
+    ASSERT_TRUE(epee::serialization::store_t_to_json(s, json, indent));
+    ASSERT_EQ(expected, json);
+  }
+
+  json_stream_sorted empty = AUTO_VAL_INIT(empty);
+  epee::serialization::portable_storage ps;
+  empty.store(ps);
+  std::string expected;
+  ASSERT_TRUE(ps.dump_as_json(expected));
+  ASSERT_EQ(expected, epee::serialization::store_t_to_json(empty));
+}
+
+TEST(json_stream_storage, loads_back)
+{
+  json_stream_unsorted s;
+  s.items.push_back(make_item("one", 1));
+  s.items.push_back(make_item("two", 2));
+  s.height = 12345;
+  s.alias = make_item("alias", 3);
+  s.status = "OK";
+
+  std::string json = epee::serialization::store_t_to_json(s);
+
+  json_stream_unsorted l = AUTO_VAL_INIT(l);
+  ASSERT_TRUE(epee::serialization::load_t_from_json(l, json));
+  ASSERT_EQ(2, l.items.size());
+  ASSERT_EQ("one", l.items.front().name);
+  ASSERT_EQ(2, l.items.back().value);
+  ASSERT_EQ(12345, l.height);
+  ASSERT_EQ("alias", l.alias.name);
+  ASSERT_EQ(3, l.alias.value);
+  ASSERT_EQ("OK", l.status);
+
+  // the same tree as portable_storage builds
+  epee::serialization::portable_storage ps;
+  s.store(ps);
+  std::string expected;
+  ASSERT_TRUE(ps.dump_as_json(expected));
+  epee::serialization::portable_storage ps_loaded;
+  ASSERT_TRUE(ps_loaded.load_from_json(json));
+  std::string loaded;
+  ASSERT_TRUE(ps_loaded.dump_as_json(loaded));
+  ASSERT_EQ(expected, loaded);
+}
@@ -13,6 +13,7 @@ extern "C"
 
 #include "epee/include/include_base_utils.h"
 #include "crypto/crypto.h"
+#include <boost/filesystem.hpp>
 #include "gtest/gtest.h"
 #include "common/db_bridge.h"
 #include "common/db_lmdb_adapter.h"
@@ -678,6 +679,91 @@ namespace lmdb_test
     ASSERT_TRUE(dbb.close());
   }
 
+  //////////////////////////////////////////////////////////////////////////////
+  // array_set_subitem_test
+  //////////////////////////////////////////////////////////////////////////////
+  TEST(lmdb, array_set_subitem_test)
+  {
+    bool r = false;
+
+    const std::string array_table_name("test_array");
+
+    std::shared_ptr<db::lmdb_adapter> lmdb_ptr = std::make_shared<db::lmdb_adapter>();
+    db::db_bridge_base dbb(lmdb_ptr);
+
+    db::key_to_array_accessor_base<uint64_t, serializable_string, true> db_array(dbb);
+
+    ASSERT_TRUE(dbb.open("array_set_subitem_test"));
+
+    // clear table
+    db::table_id tid;
+    ASSERT_TRUE(lmdb_ptr->open_table(array_table_name, tid));
+    ASSERT_TRUE(dbb.begin_transaction());
+    ASSERT_TRUE(dbb.clear(tid));
+    dbb.commit_transaction();
+
+    ASSERT_TRUE(db_array.init(array_table_name));
+
+    ASSERT_TRUE(dbb.begin_transaction());
+    db_array.push_back_item(97, serializable_string("507507507507507507507507"));
+    db_array.push_back_item(97, serializable_string("787878787878787878787878"));
+    db_array.push_back_item(98, serializable_string("ringing phone"));
+    dbb.commit_transaction();
+
+    // out of range and unknown array
+    ASSERT_TRUE(dbb.begin_transaction());
+    r = false;
+    try
+    {
+      db_array.set_subitem(97, 2, serializable_string("out of range"));
+    }
+    catch (...)
+    {
+      r = true;
+    }
+    ASSERT_TRUE(r);
+    r = false;
+    try
+    {
+      db_array.set_subitem(555, 0, serializable_string("unknown array"));
+    }
+    catch (...)
+    {
+      r = true;
+    }
+    ASSERT_TRUE(r);
+    ASSERT_EQ(db_array.get_item_size(97), 2);
+    ASSERT_EQ(db_array.get_item_size(555), 0);
+    dbb.commit_transaction();
+
+    // aborted change is not visible
+    ASSERT_TRUE(dbb.begin_transaction());
+    db_array.set_subitem(97, 1, serializable_string("aborted"));
+    ASSERT_EQ(db_array.get_subitem(97, 1)->v, "aborted");
+    dbb.abort_transaction();
+
+    ASSERT_TRUE(dbb.begin_transaction());
+    db_array.set_subitem(97, 0, serializable_string("505505505505505505505505"));
+    dbb.commit_transaction();
+
+    ASSERT_TRUE(dbb.close());
+
+
+    // reopen DB, only the item set is changed
+    ASSERT_TRUE(dbb.open("array_set_subitem_test"));
+    ASSERT_TRUE(db_array.init(array_table_name));
+
+    ASSERT_TRUE(dbb.begin_transaction());
+    ASSERT_EQ(db_array.get_item_size(97), 2);
+    ASSERT_EQ(db_array.get_subitem(97, 0)->v, "505505505505505505505505");
+    ASSERT_EQ(db_array.get_subitem(97, 1)->v, "787878787878787878787878");
+    ASSERT_EQ(db_array.get_item_size(98), 1);
+    ASSERT_EQ(db_array.get_subitem(98, 0)->v, "ringing phone");
+    dbb.commit_transaction();
+
+    ASSERT_TRUE(dbb.close());
+  }
+
   //////////////////////////////////////////////////////////////////////////////
   // array_accessor_test
   //////////////////////////////////////////////////////////////////////////////
@@ -783,4 +869,258 @@ namespace lmdb_test
     db_array.commit_transaction();
   }
 
+  //////////////////////////////////////////////////////////////////////////////
+  // nested_transactions_test (batched import: one outer tx, nested tx per block)
+  //////////////////////////////////////////////////////////////////////////////
+  TEST(lmdb, nested_transactions_test)
+  {
+    const std::string array_table_name("array");
+
+    std::shared_ptr<db::lmdb_adapter> lmdb_ptr = std::make_shared<db::lmdb_adapter>();
+    db::db_bridge_base dbb(lmdb_ptr);
+
+    db::array_accessor<serializable_string, true> db_array(dbb);
+
+    ASSERT_TRUE(dbb.open("nested_transactions_test"));
+    ASSERT_TRUE(db_array.init(array_table_name));
+
+    ASSERT_TRUE(dbb.begin_transaction());
+    ASSERT_TRUE(db_array.clear());
+    dbb.commit_transaction();
+
+    // outer (batch) transaction
+    ASSERT_EQ(lmdb_ptr->get_transactions_depth(), 0);
+    ASSERT_TRUE(dbb.begin_transaction());
+    ASSERT_EQ(lmdb_ptr->get_transactions_depth(), 1);
+
+    // good "block"
+    ASSERT_TRUE(dbb.begin_transaction());
+    ASSERT_EQ(lmdb_ptr->get_transactions_depth(), 2);
+    db_array.push_back(serializable_string("A"));
+    dbb.commit_transaction();
+    ASSERT_EQ(lmdb_ptr->get_transactions_depth(), 1);
+
+    // good "block"
+    ASSERT_TRUE(dbb.begin_transaction());
+    db_array.push_back(serializable_string("B"));
+    dbb.commit_transaction();
+
+    // failed "block" -- should be rolled back to the last good one
+    ASSERT_TRUE(dbb.begin_transaction());
+    db_array.push_back(serializable_string("C"));
+    ASSERT_EQ(db_array.size_no_cache(), 3);
+    dbb.abort_transaction();
+    ASSERT_EQ(lmdb_ptr->get_transactions_depth(), 1);
+
+    ASSERT_EQ(db_array.size_no_cache(), 2);
+    dbb.commit_transaction();
+    ASSERT_EQ(lmdb_ptr->get_transactions_depth(), 0);
+
+    ASSERT_TRUE(dbb.begin_transaction(true));
+    ASSERT_EQ(db_array.size_no_cache(), 2);
+    ASSERT_EQ(db_array[1]->v, "B");
+    dbb.commit_transaction();
+
+    // aborted outer transaction discards all nested ones
+    ASSERT_TRUE(dbb.begin_transaction());
+    ASSERT_TRUE(dbb.begin_transaction());
+    db_array.push_back(serializable_string("D"));
+    dbb.commit_transaction();
+    dbb.abort_transaction();
+
+    ASSERT_TRUE(dbb.begin_transaction(true));
+    ASSERT_EQ(db_array.size_no_cache(), 2);
+    dbb.commit_transaction();
+
+    ASSERT_TRUE(dbb.close());
+  }
+
+
+  //////////////////////////////////////////////////////////////////////////////
+  // map_growth_test (small initial map should grow on demand, fast sync mode toggling)
+  //////////////////////////////////////////////////////////////////////////////
+  TEST(lmdb, map_growth_test)
+  {
+    const std::string array_table_name("array");
+    const size_t items_count = 300;
+
+    std::shared_ptr<db::lmdb_adapter> lmdb_ptr = std::make_shared<db::lmdb_adapter>();
+    db::lmdb_adapter_options options;
+    options.map_size = 1024 * 1024;
+    options.map_growth_step = 1024 * 1024;
+    lmdb_ptr->set_options(options);
+    ASSERT_TRUE(lmdb_ptr->set_fast_sync_mode(true));
+
+    db::db_bridge_base dbb(lmdb_ptr);
+    db::array_accessor<serializable_string, true> db_array(dbb);
+
+    boost::system::error_code ec;
+    boost::filesystem::remove_all("map_growth_test", ec);
+    ASSERT_TRUE(dbb.open("map_growth_test"));
+    ASSERT_TRUE(lmdb_ptr->is_fast_sync_mode());
+    ASSERT_TRUE(db_array.init(array_table_name));
+
+    // ~5 MB of data in total, 16 KB per transaction
+    for (size_t i = 0; i != items_count; ++i)
+    {
+      ASSERT_TRUE(dbb.begin_transaction());
+      db_array.push_back(serializable_string(std::string(16 * 1024, 'a' + i % 26)));
+      dbb.commit_transaction();
+    }
+
+    ASSERT_TRUE(lmdb_ptr->sync());
+    ASSERT_TRUE(lmdb_ptr->set_fast_sync_mode(false));
+    ASSERT_FALSE(lmdb_ptr->is_fast_sync_mode());
+
+    ASSERT_TRUE(dbb.begin_transaction(true));
+    ASSERT_EQ(db_array.size_no_cache(), items_count);
+    ASSERT_EQ(db_array[items_count - 1]->v, std::string(16 * 1024, 'a' + (items_count - 1) % 26));
+    dbb.commit_transaction();
+
+    ASSERT_TRUE(dbb.close());
+  }
+
+
+  //////////////////////////////////////////////////////////////////////////////
+  // map_growth_under_readers_test (readers open transactions all the time, map is still grown between them)
+  //////////////////////////////////////////////////////////////////////////////
+  TEST(lmdb, map_growth_under_readers_test)
+  {
+    const std::string table_name("test_table");
+    const uint64_t items_count = 200;
+    const std::string first_value(16 * 1024, 'f');
+
+    std::shared_ptr<db::lmdb_adapter> lmdb_ptr = std::make_shared<db::lmdb_adapter>();
+    db::lmdb_adapter_options options;
+    options.map_size = 1024 * 1024;
+    options.map_growth_step = 1024 * 1024;
+    lmdb_ptr->set_options(options);
+
+    boost::system::error_code ec;
+    boost::filesystem::remove_all("map_growth_under_readers_test", ec);
+    ASSERT_TRUE(lmdb_ptr->open("map_growth_under_readers_test"));
+    db::table_id tid;
+    ASSERT_TRUE(lmdb_ptr->open_table(table_name, tid));
+
+    uint64_t key = 0;
+    ASSERT_TRUE(lmdb_ptr->begin_transaction());
+    ASSERT_TRUE(lmdb_ptr->set(tid, (const char*)&key, sizeof key, first_value.data(), first_value.size()));
+    ASSERT_TRUE(lmdb_ptr->commit_transaction());
+
+    std::atomic<bool> stop(false);
+    std::atomic<bool> read_failed(false);
+    std::atomic<uint64_t> reads_count(0);
+    std::vector<std::thread> readers;
+    for (size_t i = 0; i != 4; ++i)
+    {
+      readers.emplace_back([&]()
+      {
+        const uint64_t first_key = 0;
+        while (!stop)
+        {
+          if (!lmdb_ptr->begin_transaction(true))
+          {
+            read_failed = true;
+            return;
+          }
+          std::string value;
+          if (!lmdb_ptr->get(tid, (const char*)&first_key, sizeof first_key, value) || value != first_value)
+            read_failed = true;
+          lmdb_ptr->commit_transaction();
+          ++reads_count;
+        }
+      });
+    }
+
+    // ~3 MB in total, the map is grown a few times
+    bool written = true;
+    for (key = 1; key != items_count && written; ++key)
+    {
+      const std::string value(16 * 1024, 'a' + key % 26);
+      written = lmdb_ptr->begin_transaction();
+      written = written && lmdb_ptr->set(tid, (const char*)&key, sizeof key, value.data(), value.size());
+      if (written)
+        written = lmdb_ptr->commit_transaction();
+      else if (lmdb_ptr->has_active_transaction())
+        lmdb_ptr->abort_transaction();
+    }
+    stop = true;
+    for (auto& t : readers)
+      t.join();
+
+    ASSERT_TRUE(written);
+    ASSERT_FALSE(read_failed);
+    ASSERT_NE(reads_count.load(), 0);
+    ASSERT_FALSE(lmdb_ptr->is_map_grow_required());
+
+    ASSERT_TRUE(lmdb_ptr->begin_transaction(true));
+    ASSERT_EQ(lmdb_ptr->get_table_size(tid), items_count);
+    std::string value;
+    key = items_count - 1;
+    ASSERT_TRUE(lmdb_ptr->get(tid, (const char*)&key, sizeof key, value));
+    ASSERT_EQ(value, std::string(16 * 1024, 'a' + key % 26));
+    lmdb_ptr->commit_transaction();
+
+    ASSERT_TRUE(lmdb_ptr->close());
+  }
+
+
+  //////////////////////////////////////////////////////////////////////////////
+  // map_full_in_nested_transaction_test (map can't be grown inside a transaction, it's grown on the next top-level one)
+  //////////////////////////////////////////////////////////////////////////////
+  TEST(lmdb, map_full_in_nested_transaction_test)
+  {
+    const std::string table_name("test_table");
+    const std::string value(16 * 1024, 'v');
+
+    std::shared_ptr<db::lmdb_adapter> lmdb_ptr = std::make_shared<db::lmdb_adapter>();
+    db::lmdb_adapter_options options;
+    options.map_size = 4 * 1024 * 1024;
+    options.map_growth_step = 1024 * 1024;
+    lmdb_ptr->set_options(options);
+
+    boost::system::error_code ec;
+    boost::filesystem::remove_all("map_full_in_nested_transaction_test", ec);
+    ASSERT_TRUE(lmdb_ptr->open("map_full_in_nested_transaction_test"));
+    db::table_id tid;
+    ASSERT_TRUE(lmdb_ptr->open_table(table_name, tid));
+
+    ASSERT_TRUE(lmdb_ptr->begin_transaction());
+    ASSERT_TRUE(lmdb_ptr->begin_transaction());
+    ASSERT_EQ(lmdb_ptr->get_transactions_depth(), 2);
+    uint64_t written_count = 0;
+    for (; written_count != 1000; ++written_count)
+    {
+      if (!lmdb_ptr->set(tid, (const char*)&written_count, sizeof written_count, value.data(), value.size()))
+        break;
+    }
+    ASSERT_NE(written_count, 1000);
+    ASSERT_TRUE(lmdb_ptr->is_map_grow_required());
+    lmdb_ptr->abort_transaction();
+    lmdb_ptr->abort_transaction();
+    ASSERT_FALSE(lmdb_ptr->has_active_transaction());
+    ASSERT_TRUE(lmdb_ptr->is_map_grow_required());
+
+    // a reader doesn't grow the map
+    ASSERT_TRUE(lmdb_ptr->begin_transaction(true));
+    lmdb_ptr->commit_transaction();
+    ASSERT_TRUE(lmdb_ptr->is_map_grow_required());
+
+    // nothing is written, though the map is grown before the next top-level write transaction
+    ASSERT_TRUE(lmdb_ptr->begin_transaction());
+    ASSERT_FALSE(lmdb_ptr->is_map_grow_required());
+    ASSERT_EQ(lmdb_ptr->get_table_size(tid), 0);
+    ASSERT_TRUE(lmdb_ptr->begin_transaction());
+    for (uint64_t i = 0; i != written_count; ++i)
+      ASSERT_TRUE(lmdb_ptr->set(tid, (const char*)&i, sizeof i, value.data(), value.size()));
+    ASSERT_TRUE(lmdb_ptr->commit_transaction());
+    ASSERT_TRUE(lmdb_ptr->commit_transaction());
+
+    ASSERT_TRUE(lmdb_ptr->begin_transaction(true));
+    ASSERT_EQ(lmdb_ptr->get_table_size(tid), written_count);
+    lmdb_ptr->commit_transaction();
+
+    ASSERT_TRUE(lmdb_ptr->close());
+  }
+
 }
@@ -0,0 +1,33 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <stdexcept>
+
+#include "common/parallel_for.h"
+
+TEST(parallel_for, calls_every_index)
+{
+  std::vector<size_t> calls(1000, 0);
+  tools::parallel_for(calls.size(), 4, [&](size_t i) { ++calls[i]; });
+  ASSERT_EQ(std::vector<size_t>(calls.size(), 1), calls);
+}
+
+TEST(parallel_for, exception_is_rethrown_in_caller)
+{
+  for (size_t threads_count : {1, 4})
+  {
+    std::atomic<size_t> calls(0);
+    ASSERT_THROW(tools::parallel_for(1000, threads_count, [&](size_t i)
+    {
+      ++calls;
+      if (i == 10)
+        throw std::runtime_error("parse failed");
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }), std::runtime_error);
+    // the rest of the work is skipped
+    ASSERT_GT(1000, calls.load());
+  }
+}
@@ -0,0 +1,141 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <thread>
+
+#include "rpc/core_rpc_scheduler.h"
+
+namespace
+{
+  currency::rpc_endpoint_stats get_endpoint_stats(const currency::rpc_request_scheduler& s, const std::string& endpoint)
+  {
+    std::list<std::pair<std::string, currency::rpc_endpoint_stats> > stats;
+    s.get_stats(stats);
+    for (const auto& e : stats)
+    {
+      if (e.first == endpoint)
+        return e.second;
+    }
+    return currency::rpc_endpoint_stats();
+  }
+}
+
+TEST(rpc_request_scheduler, priority_requests_keep_reserved_threads)
+{
+  currency::rpc_request_scheduler s;
+  s.configure(3, 1, 0);
+  s.add_endpoint("/getheight", currency::rpc_request_normal);
+  s.add_endpoint("/json_rpc/getblocktemplate", currency::rpc_request_priority);
+
+  ASSERT_TRUE(s.enter("/getheight"));
+  ASSERT_TRUE(s.enter("/unknown"));
+  // two threads are taken, the last one is kept for priority requests
+  ASSERT_FALSE(s.enter("/getheight"));
+  ASSERT_TRUE(s.enter("/json_rpc/getblocktemplate"));
+  ASSERT_TRUE(s.enter("/json_rpc/getblocktemplate"));
+  s.leave("/getheight", 10);
+  ASSERT_TRUE(s.enter("/getheight"));
+
+  currency::rpc_endpoint_stats st = get_endpoint_stats(s, "/getheight");
+  ASSERT_EQ(3, st.calls);
+  ASSERT_EQ(1, st.rejected);
+  ASSERT_EQ(1, st.active);
+  ASSERT_EQ(10, st.max_run_us);
+  ASSERT_EQ(1, get_endpoint_stats(s, "other").calls);
+  ASSERT_EQ(2, get_endpoint_stats(s, "/json_rpc/getblocktemplate").active);
+}
+
+TEST(rpc_request_scheduler, heavy_requests_wait_for_slot)
+{
+  currency::rpc_request_scheduler s;
+  s.configure(8, 1, 100);
+  s.add_endpoint("/getblocks.bin", currency::rpc_request_heavy, 1);
+
+  ASSERT_TRUE(s.enter("/getblocks.bin"));
+  // no slot comes within the timeout
+  ASSERT_FALSE(s.enter("/getblocks.bin"));
+
+  s.configure(8, 1, 60000);
+  std::thread t([&s]()
+  {
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    s.leave("/getblocks.bin", 5);
+  });
+  ASSERT_TRUE(s.enter("/getblocks.bin"));
+  t.join();
+
+  currency::rpc_endpoint_stats st = get_endpoint_stats(s, "/getblocks.bin");
+  ASSERT_EQ(3, st.calls);
+  ASSERT_EQ(1, st.rejected);
+  ASSERT_EQ(1, st.active);
+  ASSERT_EQ(0, st.queue_depth);
+  ASSERT_EQ(1, st.max_queue_depth);
+  ASSERT_LE(100000, st.total_wait_us);
+
+  s.configure(8, 1, 10);
+  {
+    currency::rpc_request_scheduler::request_guard rg(s, "/getblocks.bin");
+    ASSERT_FALSE(rg.is_admitted()); // timed out, the slot is still taken
+  }
+  s.leave("/getblocks.bin", 5);
+  {
+    currency::rpc_request_scheduler::request_guard rg(s, "/getblocks.bin");
+    ASSERT_TRUE(rg.is_admitted());
+    ASSERT_EQ(1, get_endpoint_stats(s, "/getblocks.bin").active);
+  }
+  ASSERT_EQ(0, get_endpoint_stats(s, "/getblocks.bin").active);
+}
+
+TEST(rpc_request_scheduler, run_time_counts_completed_requests)
+{
+  currency::rpc_request_scheduler s;
+  s.configure(8, 1, 60000);
+  s.add_endpoint("/getblocks.bin", currency::rpc_request_heavy, 1);
+
+  ASSERT_TRUE(s.enter("/getblocks.bin"));
+  std::thread t([&s]()
+  {
+    if (s.enter("/getblocks.bin"))
+      s.leave("/getblocks.bin", 300);
+  });
+  while (!get_endpoint_stats(s, "/getblocks.bin").queue_depth)
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  // queued request is neither active nor completed
+  currency::rpc_endpoint_stats st = get_endpoint_stats(s, "/getblocks.bin");
+  ASSERT_EQ(2, st.calls);
+  ASSERT_EQ(1, st.active);
+  ASSERT_EQ(0, st.completed);
+
+  s.leave("/getblocks.bin", 100);
+  t.join();
+  st = get_endpoint_stats(s, "/getblocks.bin");
+  ASSERT_EQ(0, st.active);
+  ASSERT_EQ(2, st.completed);
+  ASSERT_EQ(400, st.total_run_us);
+}
+
+TEST(rpc_request_scheduler, json_rpc_method_scan)
+{
+  std::string method;
+  ASSERT_TRUE(currency::get_json_rpc_method("{\"jsonrpc\":\"2.0\",\"id\":0,\"method\":\"getblocktemplate\",\"params\":{}}", method));
+  ASSERT_EQ("getblocktemplate", method);
+  ASSERT_TRUE(currency::get_json_rpc_method(" { \"params\" : {\"method\":\"nested\", \"a\":[\"method\", {}]}, \"x\":\"\\\"method\", \"method\" : \"submitblock\" }", method));
+  ASSERT_EQ("submitblock", method);
+
+  // values and nested keys are not taken for the request method
+  ASSERT_FALSE(currency::get_json_rpc_method("{\"params\":{\"method\":\"getblocktemplate\"}}", method));
+  ASSERT_FALSE(currency::get_json_rpc_method("{\"id\":\"method\"}", method));
+  ASSERT_FALSE(currency::get_json_rpc_method("[{\"method\":\"getblocktemplate\"}]", method));
+  ASSERT_FALSE(currency::get_json_rpc_method("{\"method\":10}", method));
+  ASSERT_FALSE(currency::get_json_rpc_method("{\"method\":\"get\\u0062lock\"}", method));
+  ASSERT_FALSE(currency::get_json_rpc_method("{\"method\":\"getblock", method));
+
+  // only the beginning of the body is scanned
+  std::string body = "{\"params\":\"" + std::string(8192, 'a') + "\",\"method\":\"getblocktemplate\"}";
+  ASSERT_FALSE(currency::get_json_rpc_method(body, method));
+  ASSERT_TRUE(currency::get_json_rpc_method(body, method, body.size()));
+  ASSERT_EQ("getblocktemplate", method);
+}
@@ -0,0 +1,58 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <string>
+
+#include "rpc/core_rpc_cache.h"
+
+TEST(rpc_response_cache, evicts_least_recently_used)
+{
+  currency::rpc_response_cache<uint64_t, std::string> cache;
+  cache.set_max_size(30);
+  cache.put(1, 0, "one", 10);
+  cache.put(2, 0, "two", 10);
+  cache.put(3, 0, "three", 10);
+  ASSERT_EQ(30, cache.get_size());
+
+  std::string v;
+  ASSERT_TRUE(cache.get(1, 0, v));
+  ASSERT_EQ("one", v);
+  cache.put(4, 0, "four", 10); // 2 is the least recently used now
+  ASSERT_FALSE(cache.get(2, 0, v));
+  ASSERT_TRUE(cache.get(1, 0, v));
+  ASSERT_TRUE(cache.get(3, 0, v));
+  ASSERT_TRUE(cache.get(4, 0, v));
+  ASSERT_EQ(30, cache.get_size());
+
+  cache.put(5, 0, "too big", 31);
+  ASSERT_FALSE(cache.get(5, 0, v));
+  ASSERT_EQ(4, cache.get_hits());
+  ASSERT_EQ(2, cache.get_misses());
+
+  cache.set_max_size(10);
+  ASSERT_EQ(10, cache.get_size());
+  ASSERT_TRUE(cache.get(4, 0, v));
+}
+
+TEST(rpc_response_cache, dropped_on_chain_version_change)
+{
+  currency::rpc_response_cache<uint64_t, std::string> cache;
+  cache.set_max_size(100);
+  cache.put(1, 0, "one", 10);
+  cache.put(2, 0, "two", 10);
+
+  std::string v;
+  ASSERT_FALSE(cache.get(1, 1, v));
+  ASSERT_EQ(0, cache.get_size());
+
+  // prepared before the main chain was changed
+  cache.put(1, 0, "one", 10);
+  ASSERT_FALSE(cache.get(1, 1, v));
+
+  cache.put(1, 1, "new one", 10);
+  ASSERT_TRUE(cache.get(1, 1, v));
+  ASSERT_EQ("new one", v);
+}
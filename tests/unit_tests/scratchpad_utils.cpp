@@ -5,6 +5,8 @@
 #include "gtest/gtest.h"
 
 #include "currency_core/currency_format_utils.h"
+#include "currency_core/scratchpad_helpers.h"
+#include "currency_core/account.h"
 
 using namespace currency;
 
@@ -331,4 +333,40 @@ TEST(test_appendum, test_appendum)
 
   ASSERT_EQ(scratchpad, scratchpad2);
 }
-#endif
\ No newline at end of file
+#endif
+
+TEST(test_scratchpad_versions, versions_match_sequential_states)
+{
+  account_base acc;
+  acc.generate();
+
+  std::vector<crypto::hash> base(100);
+  for (auto& h : base)
+    h = crypto::rand<crypto::hash>();
+
+  std::vector<crypto::hash> sequential = base;
+  std::vector<std::vector<crypto::hash>> states;
+  scratchpad_versions versions(base);
+  for (size_t i = 0; i != 20; ++i)
+  {
+    block b = AUTO_VAL_INIT(b);
+    b.prev_id = crypto::rand<crypto::hash>();
+    bool r = construct_miner_tx(0, 0, 0, 10000, 0, acc.get_keys().m_account_address, b.miner_tx);
+    ASSERT_TRUE(r);
+
+    states.push_back(sequential);
+    versions.begin_next_version();
+    r = push_block_scratchpad_data(b, versions);
+    ASSERT_TRUE(r);
+    r = push_block_scratchpad_data(b, sequential);
+    ASSERT_TRUE(r);
+  }
+  states.push_back(sequential);
+
+  for (size_t k = 0; k != states.size(); ++k)
+  {
+    ASSERT_EQ(versions.size(k), states[k].size());
+    for (uint64_t i = 0; i != states[k].size(); ++i)
+      ASSERT_EQ(versions.get(i, k), states[k][i]);
+  }
+}
@@ -77,6 +77,8 @@ struct Blob
 
 VARIANT_TAG(binary_archive, Struct, 0xe0);
 VARIANT_TAG(binary_archive, int, 0xe1);
+VARIANT_TAG(binary_buffer_archive, Struct, 0xe0);
+VARIANT_TAG(binary_buffer_archive, int, 0xe1);
 VARIANT_TAG(json_archive, Struct, "struct");
 VARIANT_TAG(json_archive, int, "int");
 VARIANT_TAG(debug_archive, Struct1, "struct1");
@@ -155,6 +157,51 @@ TEST(Serialization, Test1) {
   ASSERT_FALSE(try_parse(blob));
 }
 
+template<class T>
+bool try_parse_with_stream_archive(const string &blob, T &v)
+{
+  istringstream iss(blob);
+  binary_archive<false> iar(iss);
+  return ::serialization::serialize(iar, v);
+}
+
+TEST(Serialization, BufferArchiveMatchesStreamArchive) {
+  Struct1 s1;
+  s1.si.push_back(0);
+  {
+    Struct s;
+    s.a = -5;
+    s.b = 65539;
+    std::memcpy(s.blob, "12345678", 8);
+    s1.si.push_back(s);
+  }
+  s1.vi.push_back(300);
+  s1.vi.push_back(-1);
+
+  string buffer_blob;
+  ASSERT_TRUE(serialization::dump_binary(s1, buffer_blob));
+  ostringstream oss;
+  binary_archive<true> oar(oss);
+  ASSERT_TRUE(::serialization::serialize(oar, s1));
+  ASSERT_EQ(oss.str(), buffer_blob);
+
+  // truncated, extended and corrupted blobs should give the same results with both archives
+  for (size_t i = 0; i <= buffer_blob.size() + 1; ++i)
+  {
+    string blob = buffer_blob;
+    blob.resize(i, '\x80');
+    Struct1 a, b;
+    ASSERT_EQ(try_parse_with_stream_archive(blob, a), serialization::parse_binary(blob, b));
+  }
+  for (size_t i = 0; i != buffer_blob.size(); ++i)
+  {
+    string blob = buffer_blob;
+    blob[i] = '\xff';
+    Struct1 a, b;
+    ASSERT_EQ(try_parse_with_stream_archive(blob, a), serialization::parse_binary(blob, b));
+  }
+}
+
 TEST(Serialization, Overflow) {
   Blob x = { 0xff00000000 };
   Blob x1;
@@ -215,6 +262,54 @@ TEST(Serialization, serializes_vector_uint64_as_varint)
   ASSERT_EQ(22, blob.size());
 }
 
+TEST(Serialization, varint_array_matches_scalar_varint)
+{
+  std::vector<std::string> blobs;
+  std::string blob;
+  // mix of value sizes, including values longer than 8 bytes
+  for (size_t i = 0; i != 1000; ++i)
+  {
+    uint64_t v = crypto::rand<uint64_t>() >> (crypto::rand<uint8_t>() % 64);
+    tools::write_varint(std::back_inserter(blob), v);
+  }
+  blobs.push_back(blob);
+  // long runs of one-byte values
+  blobs.push_back(std::string(100, '\x01') + std::string("\xff\x01", 2) + std::string(40, '\x7f'));
+  // non-canonical, overflowing and truncated values
+  blobs.push_back(std::string("\x05\x80\x00\x01\xff\xff\xff\xff\xff\xff\xff\xff\xff\x7f\x02\x81\x80\x80", 18));
+  blobs.push_back(std::string(9, '\x80') + std::string(3, '\x01'));
+  for (size_t i = 0; i != 100; ++i)
+  {
+    std::string random_blob(crypto::rand<uint8_t>(), '\0');
+    for (auto& c : random_blob)
+      c = crypto::rand<char>() | (crypto::rand<uint8_t>() % 4 ? 0x80 : 0);
+    blobs.push_back(random_blob);
+  }
+
+  for (const auto& b : blobs)
+  {
+    const size_t count = b.size() + 2;
+    std::vector<uint64_t> expected(count), decoded(count);
+    const char* p = b.data();
+    const char* end = b.data() + b.size();
+    for (size_t i = 0; i != count; ++i)
+      tools::read_varint<64>(p, end, expected[i]);
+    const char* expected_pos = p;
+
+    p = b.data();
+    tools::read_varint_array(p, end, decoded.data(), count);
+    ASSERT_EQ(expected, decoded);
+    ASSERT_EQ(expected_pos, p);
+
+    std::string encoded;
+    tools::write_varint_array(encoded, decoded.data(), decoded.size());
+    std::string expected_encoded;
+    for (auto v : decoded)
+      tools::write_varint(std::back_inserter(expected_encoded), v);
+    ASSERT_EQ(expected_encoded, encoded);
+  }
+}
+
 TEST(Serialization, serializes_vector_int64_as_fixed_int)
 {
   std::vector<int64_t> v;
@@ -0,0 +1,670 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <algorithm>
+#include <fstream>
+#include <memory>
+#include <unordered_set>
+#include <string>
+#include <vector>
+#include <boost/filesystem.hpp>
+
+#include "wallet/wallet2.h"
+#include "wallet_test_core_proxy.h"
+
+namespace
+{
+  const std::string wallet_password = "pass";
+
+  std::string prepare_test_dir(const std::string& name)
+  {
+    boost::system::error_code ec;
+    boost::filesystem::remove_all(name, ec);
+    boost::filesystem::create_directory(name, ec);
+    return name + "/wallet";
+  }
+
+  std::shared_ptr<tools::wallet2> make_wallet(const std::shared_ptr<unit_test::wallet_test_core_proxy>& proxy)
+  {
+    std::shared_ptr<tools::wallet2> w = std::make_shared<tools::wallet2>();
+    std::shared_ptr<tools::i_core_proxy> core_proxy = proxy;
+    w->set_core_proxy(core_proxy);
+    w->set_scan_threads(1);
+    return w;
+  }
+
+  std::shared_ptr<tools::wallet2> load_wallet(const std::string& path, const std::shared_ptr<unit_test::wallet_test_core_proxy>& proxy)
+  {
+    std::shared_ptr<tools::wallet2> w = make_wallet(proxy);
+    w->load(path, wallet_password);
+    return w;
+  }
+
+  const currency::account_public_address& get_address(tools::wallet2& w)
+  {
+    return w.get_account().get_keys().m_account_address;
+  }
+
+  currency::payment_id_t make_payment_id(size_t i)
+  {
+    return "payment " + std::to_string(i % 3);
+  }
+
+  //blocks paying to the wallet with one of three payment ids
+  void add_blocks(unit_test::wallet_test_core_proxy& proxy, const currency::account_public_address& addr, size_t count)
+  {
+    for (size_t i = 0; i != count; ++i)
+      proxy.add_block(addr, make_payment_id(proxy.get_height()));
+  }
+
+  //block spending the first unspent transfer of the wallet
+  void add_spending_block(unit_test::wallet_test_core_proxy& proxy, tools::wallet2& w)
+  {
+    tools::wallet2::transfer_container transfers;
+    w.get_transfers(transfers);
+    for (const auto& td : transfers)
+    {
+      if (td.m_spent)
+        continue;
+      proxy.add_block(get_address(w), currency::payment_id_t(), std::list<currency::transaction>(1, unit_test::wallet_test_core_proxy::make_spend_tx(td.m_key_image, td.amount())));
+      return;
+    }
+  }
+
+  uint64_t get_file_size(const std::string& path)
+  {
+    boost::system::error_code ec;
+    return boost::filesystem::exists(path, ec) ? boost::filesystem::file_size(path, ec) : 0;
+  }
+
+  void get_history(const tools::wallet2& w, std::list<tools::wallet_rpc::wallet_transfer_info>& history)
+  {
+    tools::wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request req = AUTO_VAL_INIT(req);
+    tools::wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response res = AUTO_VAL_INIT(res);
+    req.in = true;
+    req.out = true;
+    w.get_transfers(req, res);
+    history.swap(res.in);
+    history.insert(history.end(), res.out.begin(), res.out.end());
+  }
+
+  void expect_same_history(const std::list<tools::wallet_rpc::wallet_transfer_info>& expected, const std::list<tools::wallet_rpc::wallet_transfer_info>& actual)
+  {
+    ASSERT_EQ(expected.size(), actual.size());
+    for (auto e_it = expected.begin(), a_it = actual.begin(); e_it != expected.end(); ++e_it, ++a_it)
+    {
+      ASSERT_EQ(e_it->tx_hash, a_it->tx_hash);
+      ASSERT_EQ(e_it->height, a_it->height);
+      ASSERT_EQ(e_it->amount, a_it->amount);
+      ASSERT_EQ(e_it->is_income, a_it->is_income);
+    }
+  }
+
+  void expect_same_payments(const tools::wallet2& expected, const tools::wallet2& actual, const currency::payment_id_t& payment_id, uint64_t min_height)
+  {
+    std::list<tools::wallet2::payment_details> expected_payments, actual_payments;
+    expected.get_payments(payment_id, expected_payments, min_height);
+    actual.get_payments(payment_id, actual_payments, min_height);
+    ASSERT_EQ(expected_payments.size(), actual_payments.size());
+    for (auto e_it = expected_payments.begin(), a_it = actual_payments.begin(); e_it != expected_payments.end(); ++e_it, ++a_it)
+    {
+      ASSERT_EQ(e_it->m_tx_hash, a_it->m_tx_hash);
+      ASSERT_EQ(e_it->m_amount, a_it->m_amount);
+      ASSERT_EQ(e_it->m_block_height, a_it->m_block_height);
+    }
+  }
+
+  //blockchain and transfers of actual are the same as of expected
+  void expect_same_transfers(tools::wallet2& expected, tools::wallet2& actual)
+  {
+    ASSERT_EQ(expected.get_blockchain_current_height(), actual.get_blockchain_current_height());
+    ASSERT_EQ(expected.balance(), actual.balance());
+    ASSERT_EQ(expected.unlocked_balance(), actual.unlocked_balance());
+
+    tools::wallet2::transfer_container expected_transfers, actual_transfers;
+    expected.get_transfers(expected_transfers);
+    actual.get_transfers(actual_transfers);
+    ASSERT_EQ(expected_transfers.size(), actual_transfers.size());
+    for (size_t i = 0; i != expected_transfers.size(); ++i)
+    {
+      ASSERT_EQ(expected_transfers[i].m_tx_id, actual_transfers[i].m_tx_id);
+      ASSERT_EQ(expected_transfers[i].m_block_height, actual_transfers[i].m_block_height);
+      ASSERT_EQ(expected_transfers[i].m_global_output_index, actual_transfers[i].m_global_output_index);
+      ASSERT_EQ(expected_transfers[i].m_amount, actual_transfers[i].m_amount);
+      ASSERT_EQ(expected_transfers[i].m_spent, actual_transfers[i].m_spent);
+      ASSERT_EQ(expected_transfers[i].m_key_image, actual_transfers[i].m_key_image);
+      currency::transaction tx;
+      ASSERT_TRUE(actual.get_transfer_tx(actual_transfers[i].m_tx_id, tx));
+      ASSERT_EQ(actual_transfers[i].m_tx_id, currency::get_transaction_hash(tx));
+    }
+  }
+
+  //blockchain, transfers, payments and history of actual are the same as of expected
+  void expect_same_wallet_state(tools::wallet2& expected, tools::wallet2& actual)
+  {
+    ASSERT_NO_FATAL_FAILURE(expect_same_transfers(expected, actual));
+    for (size_t i = 0; i != 3; ++i)
+      ASSERT_NO_FATAL_FAILURE(expect_same_payments(expected, actual, make_payment_id(i), 0));
+
+    std::list<tools::wallet_rpc::wallet_transfer_info> expected_history, actual_history;
+    get_history(expected, expected_history);
+    get_history(actual, actual_history);
+    ASSERT_NO_FATAL_FAILURE(expect_same_history(expected_history, actual_history));
+  }
+
+  //wallet with a cache snapshot of 30 blocks and a journal on top of it
+  void make_wallet_with_journal(const std::string& path, const std::shared_ptr<unit_test::wallet_test_core_proxy>& proxy, std::shared_ptr<tools::wallet2>& w)
+  {
+    w = make_wallet(proxy);
+    w->generate(path, wallet_password);
+    add_blocks(*proxy, get_address(*w), 30);
+    w->refresh();
+    w->store();
+    ASSERT_EQ(0, get_file_size(path + ".journal"));
+
+    add_spending_block(*proxy, *w);
+    add_blocks(*proxy, get_address(*w), 1);
+    w->refresh();
+    w->store();
+    ASSERT_NE(0, get_file_size(path + ".journal"));
+  }
+}
+
+TEST(wallet_cache, snapshot_and_journal_replay)
+{
+  const std::string path = prepare_test_dir("wallet_cache_journal_replay");
+  std::shared_ptr<unit_test::wallet_test_core_proxy> proxy = std::make_shared<unit_test::wallet_test_core_proxy>();
+  std::shared_ptr<tools::wallet2> w;
+  ASSERT_NO_FATAL_FAILURE(make_wallet_with_journal(path, proxy, w));
+
+  std::shared_ptr<tools::wallet2> loaded = load_wallet(path, proxy);
+  ASSERT_NO_FATAL_FAILURE(expect_same_wallet_state(*w, *loaded));
+  tools::wallet2::transfer_container transfers;
+  loaded->get_transfers(transfers);
+  ASSERT_TRUE(transfers.front().m_spent);
+
+  //journal entries are appended one after another
+  const uint64_t journal_size = get_file_size(path + ".journal");
+  add_spending_block(*proxy, *w);
+  w->refresh();
+  w->store();
+  ASSERT_LT(journal_size, get_file_size(path + ".journal"));
+  loaded = load_wallet(path, proxy);
+  ASSERT_NO_FATAL_FAILURE(expect_same_wallet_state(*w, *loaded));
+}
+
+TEST(wallet_cache, torn_journal_record_is_dropped)
+{
+  const std::string path = prepare_test_dir("wallet_cache_torn_journal");
+  std::shared_ptr<unit_test::wallet_test_core_proxy> proxy = std::make_shared<unit_test::wallet_test_core_proxy>();
+  std::shared_ptr<tools::wallet2> w;
+  ASSERT_NO_FATAL_FAILURE(make_wallet_with_journal(path, proxy, w));
+  const uint64_t height = w->get_blockchain_current_height();
+  const uint64_t journal_size = get_file_size(path + ".journal");
+
+  add_blocks(*proxy, get_address(*w), 2);
+  w->refresh();
+  w->store();
+  const uint64_t new_journal_size = get_file_size(path + ".journal");
+  ASSERT_LT(journal_size, new_journal_size);
+
+  //write of the last record was interrupted
+  boost::system::error_code ec;
+  boost::filesystem::resize_file(path + ".journal", journal_size + (new_journal_size - journal_size) / 2, ec);
+  ASSERT_FALSE(ec);
+
+  std::shared_ptr<tools::wallet2> loaded = load_wallet(path, proxy);
+  ASSERT_EQ(height, loaded->get_blockchain_current_height());
+  ASSERT_EQ(journal_size, get_file_size(path + ".journal"));
+
+  //lost blocks are fetched again
+  loaded->refresh();
+  ASSERT_NO_FATAL_FAILURE(expect_same_wallet_state(*w, *loaded));
+  loaded->store();
+  loaded = load_wallet(path, proxy);
+  ASSERT_NO_FATAL_FAILURE(expect_same_wallet_state(*w, *loaded));
+}
+
+TEST(wallet_cache, stale_generation_is_skipped)
+{
+  const std::string path = prepare_test_dir("wallet_cache_stale_generation");
+  std::shared_ptr<unit_test::wallet_test_core_proxy> proxy = std::make_shared<unit_test::wallet_test_core_proxy>();
+  std::shared_ptr<tools::wallet2> w;
+  ASSERT_NO_FATAL_FAILURE(make_wallet_with_journal(path, proxy, w));
+  boost::system::error_code ec;
+  boost::filesystem::copy_file(path + ".journal", path + ".journal.old", ec);
+  ASSERT_FALSE(ec);
+
+  //spend some outputs the old journal knows as unspent, then rewrite the snapshot
+  for (size_t i = 0; i != 100 && get_file_size(path + ".journal"); ++i)
+  {
+    add_spending_block(*proxy, *w);
+    w->refresh();
+    w->store();
+  }
+  ASSERT_EQ(0, get_file_size(path + ".journal"));
+
+  //journal of the previous snapshot, e.g. its removal failed
+  boost::filesystem::copy_file(path + ".journal.old", path + ".journal", ec);
+  ASSERT_FALSE(ec);
+  std::shared_ptr<tools::wallet2> loaded = load_wallet(path, proxy);
+  ASSERT_NO_FATAL_FAILURE(expect_same_wallet_state(*w, *loaded));
+}
+
+TEST(wallet_cache, detach_is_journaled)
+{
+  const std::string path = prepare_test_dir("wallet_cache_detach");
+  std::shared_ptr<unit_test::wallet_test_core_proxy> proxy = std::make_shared<unit_test::wallet_test_core_proxy>();
+  std::shared_ptr<tools::wallet2> w = make_wallet(proxy);
+  w->generate(path, wallet_password);
+  add_blocks(*proxy, get_address(*w), 30);
+  w->refresh();
+  w->store();
+  add_blocks(*proxy, get_address(*w), 3);
+  w->refresh();
+  w->store();
+  ASSERT_NE(0, get_file_size(path + ".journal"));
+
+  //detached blocks are both in the snapshot and in the journal
+  proxy->pop_blocks(5);
+  add_blocks(*proxy, get_address(*w), 6);
+  w->refresh();
+  ASSERT_EQ(proxy->get_height(), w->get_blockchain_current_height());
+  w->store();
+
+  std::shared_ptr<tools::wallet2> loaded = load_wallet(path, proxy);
+  ASSERT_NO_FATAL_FAILURE(expect_same_wallet_state(*w, *loaded));
+
+  //the same as a wallet which has never seen detached blocks
+  boost::system::error_code ec;
+  boost::filesystem::copy_file(path + ".keys", path + "_rescanned.keys", ec);
+  ASSERT_FALSE(ec);
+  std::shared_ptr<tools::wallet2> rescanned = load_wallet(path + "_rescanned", proxy);
+  rescanned->refresh();
+  ASSERT_EQ(rescanned->balance(), loaded->balance());
+  for (size_t i = 0; i != 3; ++i)
+    ASSERT_NO_FATAL_FAILURE(expect_same_payments(*rescanned, *loaded, make_payment_id(i), 0));
+}
+
+TEST(wallet_cache, journal_compaction)
+{
+  const std::string path = prepare_test_dir("wallet_cache_compaction");
+  std::shared_ptr<unit_test::wallet_test_core_proxy> proxy = std::make_shared<unit_test::wallet_test_core_proxy>();
+  std::shared_ptr<tools::wallet2> w;
+  ASSERT_NO_FATAL_FAILURE(make_wallet_with_journal(path, proxy, w));
+  const uint64_t snapshot_size = get_file_size(path);
+
+  //journal grows until it's half of the snapshot, then the snapshot is rewritten
+  uint64_t journal_size = get_file_size(path + ".journal");
+  size_t stores_count = 0;
+  for (; stores_count != 100; ++stores_count)
+  {
+    add_blocks(*proxy, get_address(*w), 1);
+    w->refresh();
+    w->store();
+    uint64_t new_journal_size = get_file_size(path + ".journal");
+    if (!new_journal_size)
+      break;
+    ASSERT_LT(journal_size, new_journal_size);
+    ASSERT_EQ(snapshot_size, get_file_size(path));
+    ASSERT_LE(new_journal_size * 100, snapshot_size * WALLET_CACHE_JOURNAL_COMPACT_PERCENT);
+    journal_size = new_journal_size;
+  }
+  ASSERT_LT(stores_count, 100);
+  ASSERT_LT(snapshot_size, get_file_size(path));
+
+  std::shared_ptr<tools::wallet2> loaded = load_wallet(path, proxy);
+  ASSERT_NO_FATAL_FAILURE(expect_same_wallet_state(*w, *loaded));
+
+  //next changes go to a new journal
+  add_blocks(*proxy, get_address(*w), 1);
+  w->refresh();
+  w->store();
+  ASSERT_NE(0, get_file_size(path + ".journal"));
+  loaded = load_wallet(path, proxy);
+  ASSERT_NO_FATAL_FAILURE(expect_same_wallet_state(*w, *loaded));
+}
+
+namespace
+{
+  //tx ids of records in the transfer transactions file, in file order
+  void read_transfer_txs_ids(const std::string& path, std::vector<crypto::hash>& ids)
+  {
+    std::ifstream txs_file(path, std::ios_base::binary | std::ios_base::in);
+    const uint64_t file_size = get_file_size(path);
+    uint64_t offset = 0;
+    while (offset < file_size)
+    {
+      crypto::hash tx_id = currency::null_hash;
+      uint64_t blob_size = 0;
+      txs_file.seekg(offset);
+      txs_file.read(reinterpret_cast<char*>(&tx_id), sizeof(tx_id));
+      txs_file.read(reinterpret_cast<char*>(&blob_size), sizeof(blob_size));
+      ASSERT_FALSE(txs_file.fail());
+      ids.push_back(tx_id);
+      offset += sizeof(tx_id) + sizeof(blob_size) + blob_size;
+    }
+    ASSERT_EQ(file_size, offset);
+  }
+
+  std::unordered_set<crypto::hash> get_transfers_tx_ids(const tools::wallet2& w)
+  {
+    tools::wallet2::transfer_container transfers;
+    w.get_transfers(transfers);
+    std::unordered_set<crypto::hash> ids;
+    for (const auto& td : transfers)
+      ids.insert(td.m_tx_id);
+    return ids;
+  }
+}
+
+TEST(wallet_cache, legacy_transfers_conversion)
+{
+  const std::string path = prepare_test_dir("wallet_cache_legacy");
+  std::shared_ptr<unit_test::wallet_test_core_proxy> proxy = std::make_shared<unit_test::wallet_test_core_proxy>();
+  std::shared_ptr<tools::wallet2> w = make_wallet(proxy);
+  w->generate(path, wallet_password);
+  add_blocks(*proxy, get_address(*w), 5);
+  w->refresh();
+  add_spending_block(*proxy, *w);
+  w->refresh();
+
+  //layout of old caches: a transaction copy in each transfer
+  tools::wallet2::transfer_container transfers;
+  w->get_transfers(transfers);
+  ASSERT_LT(get_transfers_tx_ids(*w).size(), transfers.size()); //some transactions have several outputs to the wallet
+  std::vector<tools::wallet2::legacy_transfer_details> legacy_transfers;
+  for (const auto& td : transfers)
+  {
+    tools::wallet2::legacy_transfer_details ltd = AUTO_VAL_INIT(ltd);
+    ltd.m_block_height = td.m_block_height;
+    ASSERT_TRUE(w->get_transfer_tx(td.m_tx_id, ltd.m_tx));
+    ltd.m_internal_output_index = td.m_internal_output_index;
+    ltd.m_global_output_index = td.m_global_output_index;
+    ltd.m_spent = td.m_spent;
+    ltd.m_key_image = td.m_key_image;
+    legacy_transfers.push_back(ltd);
+  }
+
+  tools::wallet2::transfer_container imported;
+  std::unordered_map<crypto::hash, currency::transaction> txs;
+  tools::wallet2::import_legacy_transfers(legacy_transfers, imported, txs);
+  ASSERT_TRUE(legacy_transfers.empty());
+  ASSERT_EQ(transfers.size(), imported.size());
+  for (size_t i = 0; i != transfers.size(); ++i)
+  {
+    ASSERT_EQ(transfers[i].m_block_height, imported[i].m_block_height);
+    ASSERT_EQ(transfers[i].m_tx_id, imported[i].m_tx_id);
+    ASSERT_EQ(transfers[i].m_tx_pub_key, imported[i].m_tx_pub_key);
+    ASSERT_EQ(transfers[i].m_tx_unlock_time, imported[i].m_tx_unlock_time);
+    ASSERT_EQ(transfers[i].m_internal_output_index, imported[i].m_internal_output_index);
+    ASSERT_EQ(transfers[i].m_global_output_index, imported[i].m_global_output_index);
+    ASSERT_EQ(transfers[i].m_amount, imported[i].m_amount);
+    ASSERT_EQ(transfers[i].m_out_key, imported[i].m_out_key);
+    ASSERT_EQ(transfers[i].m_mix_attr, imported[i].m_mix_attr);
+    ASSERT_EQ(transfers[i].m_spent, imported[i].m_spent);
+    ASSERT_EQ(transfers[i].m_key_image, imported[i].m_key_image);
+  }
+  //one copy per transaction
+  ASSERT_EQ(get_transfers_tx_ids(*w).size(), txs.size());
+  for (const auto& tx : txs)
+    ASSERT_EQ(tx.first, currency::get_transaction_hash(tx.second));
+
+  //wrong output index: transfer keeps what the legacy record has
+  tools::wallet2::legacy_transfer_details ltd = AUTO_VAL_INIT(ltd);
+  ASSERT_TRUE(w->get_transfer_tx(transfers.front().m_tx_id, ltd.m_tx));
+  ltd.m_internal_output_index = ltd.m_tx.vout.size();
+  ltd.m_global_output_index = 7;
+  ltd.m_spent = true;
+  legacy_transfers.push_back(ltd);
+  tools::wallet2::import_legacy_transfers(legacy_transfers, imported, txs);
+  ASSERT_EQ(1, imported.size());
+  ASSERT_EQ(0, imported.front().m_amount);
+  ASSERT_EQ(7, imported.front().m_global_output_index);
+  ASSERT_TRUE(imported.front().m_spent);
+}
+
+TEST(wallet_cache, torn_transfer_txs_record_is_dropped)
+{
+  const std::string path = prepare_test_dir("wallet_cache_torn_txs");
+  std::shared_ptr<unit_test::wallet_test_core_proxy> proxy = std::make_shared<unit_test::wallet_test_core_proxy>();
+  std::shared_ptr<tools::wallet2> w;
+  ASSERT_NO_FATAL_FAILURE(make_wallet_with_journal(path, proxy, w));
+  const uint64_t txs_size = get_file_size(path + ".txs");
+  ASSERT_NE(0, txs_size);
+
+  //write of a record was interrupted: header and a part of the blob, then only a part of the header
+  currency::transaction tx = unit_test::wallet_test_core_proxy::make_tx_to(get_address(*w), 1000);
+  const crypto::hash tx_id = currency::get_transaction_hash(tx);
+  const currency::blobdata blob = currency::tx_to_blob(tx);
+  for (size_t torn_size : { sizeof(crypto::hash) + sizeof(uint64_t) + blob.size() / 2, sizeof(crypto::hash) / 2 })
+  {
+    {
+      uint64_t blob_size = blob.size();
+      std::string record(reinterpret_cast<const char*>(&tx_id), sizeof(tx_id));
+      record.append(reinterpret_cast<const char*>(&blob_size), sizeof(blob_size));
+      record += blob;
+      std::ofstream txs_file(path + ".txs", std::ios_base::binary | std::ios_base::out | std::ios_base::app);
+      txs_file.write(record.data(), torn_size);
+    }
+    ASSERT_EQ(txs_size + torn_size, get_file_size(path + ".txs"));
+
+    std::shared_ptr<tools::wallet2> loaded = load_wallet(path, proxy);
+    ASSERT_EQ(txs_size, get_file_size(path + ".txs"));
+    ASSERT_NO_FATAL_FAILURE(expect_same_wallet_state(*w, *loaded));
+    currency::transaction torn_tx;
+    ASSERT_FALSE(loaded->get_transfer_tx(tx_id, torn_tx));
+  }
+
+  //records appended after the truncation are found by their offsets
+  std::shared_ptr<tools::wallet2> loaded = load_wallet(path, proxy);
+  add_blocks(*proxy, get_address(*w), 2);
+  w->refresh();
+  loaded->refresh();
+  loaded->store();
+  ASSERT_LT(txs_size, get_file_size(path + ".txs"));
+  loaded = load_wallet(path, proxy);
+  ASSERT_NO_FATAL_FAILURE(expect_same_wallet_state(*w, *loaded));
+}
+
+TEST(wallet_cache, transfer_txs_compaction)
+{
+  const std::string path = prepare_test_dir("wallet_cache_txs_compaction");
+  std::shared_ptr<unit_test::wallet_test_core_proxy> proxy = std::make_shared<unit_test::wallet_test_core_proxy>();
+  std::shared_ptr<tools::wallet2> w;
+  ASSERT_NO_FATAL_FAILURE(make_wallet_with_journal(path, proxy, w));
+
+  //transactions of detached blocks stay in the file until the snapshot is rewritten
+  proxy->pop_blocks(10);
+  add_blocks(*proxy, get_address(*w), 11);
+  w->refresh();
+  w->store();
+  ASSERT_NE(0, get_file_size(path + ".journal"));
+  std::vector<crypto::hash> ids;
+  ASSERT_NO_FATAL_FAILURE(read_transfer_txs_ids(path + ".txs", ids));
+  std::unordered_set<crypto::hash> detached_ids(ids.begin(), ids.end());
+  ASSERT_EQ(ids.size(), detached_ids.size());
+  for (const auto& id : get_transfers_tx_ids(*w))
+    detached_ids.erase(id);
+  ASSERT_EQ(10, detached_ids.size());
+
+  std::shared_ptr<tools::wallet2> loaded = load_wallet(path, proxy);
+  ASSERT_NO_FATAL_FAILURE(expect_same_wallet_state(*w, *loaded));
+
+  for (size_t i = 0; i != 100 && get_file_size(path + ".journal"); ++i)
+  {
+    add_blocks(*proxy, get_address(*w), 1);
+    w->refresh();
+    w->store();
+  }
+  ASSERT_EQ(0, get_file_size(path + ".journal"));
+  ASSERT_FALSE(boost::filesystem::exists(path + ".txs.tmp"));
+
+  //only transactions of current transfers are left
+  ids.clear();
+  ASSERT_NO_FATAL_FAILURE(read_transfer_txs_ids(path + ".txs", ids));
+  const std::unordered_set<crypto::hash> transfers_ids = get_transfers_tx_ids(*w);
+  ASSERT_EQ(transfers_ids, std::unordered_set<crypto::hash>(ids.begin(), ids.end()));
+  ASSERT_EQ(transfers_ids.size(), ids.size());
+  for (const auto& id : detached_ids)
+    ASSERT_EQ(0, transfers_ids.count(id));
+  //in-memory index points to the compacted file
+  ASSERT_NO_FATAL_FAILURE(expect_same_transfers(*w, *w));
+
+  loaded = load_wallet(path, proxy);
+  ASSERT_NO_FATAL_FAILURE(expect_same_wallet_state(*w, *loaded));
+
+  //new records go after the compacted ones
+  add_blocks(*proxy, get_address(*w), 1);
+  w->refresh();
+  w->store();
+  loaded = load_wallet(path, proxy);
+  ASSERT_NO_FATAL_FAILURE(expect_same_wallet_state(*w, *loaded));
+}
+
+namespace
+{
+  bool history_entry_less(const tools::wallet_rpc::wallet_transfer_info& a, const tools::wallet_rpc::wallet_transfer_info& b)
+  {
+    return a.height != b.height ? a.height < b.height : a.tx_hash != b.tx_hash ? a.tx_hash < b.tx_hash : a.is_income < b.is_income;
+  }
+
+  //history entries in [min_height, max_height] from the height index and from the whole history are the same
+  void expect_history_by_height_consistent(const tools::wallet2& w, uint64_t min_height, uint64_t max_height)
+  {
+    tools::wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request req = AUTO_VAL_INIT(req);
+    tools::wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response res = AUTO_VAL_INIT(res);
+    req.in = true;
+    req.out = true;
+    req.filter_by_height = true;
+    req.min_height = min_height;
+    req.max_height = max_height;
+    w.get_transfers(req, res);
+    std::vector<tools::wallet_rpc::wallet_transfer_info> by_index(res.in.begin(), res.in.end());
+    by_index.insert(by_index.end(), res.out.begin(), res.out.end());
+
+    std::list<tools::wallet_rpc::wallet_transfer_info> history;
+    get_history(w, history);
+    std::vector<tools::wallet_rpc::wallet_transfer_info> by_scan;
+    for (const auto& wti : history)
+    {
+      if (wti.height && min_height <= wti.height && wti.height <= max_height)
+        by_scan.push_back(wti);
+    }
+
+    std::sort(by_index.begin(), by_index.end(), history_entry_less);
+    std::sort(by_scan.begin(), by_scan.end(), history_entry_less);
+    ASSERT_NO_FATAL_FAILURE(expect_same_history(std::list<tools::wallet_rpc::wallet_transfer_info>(by_scan.begin(), by_scan.end()),
+      std::list<tools::wallet_rpc::wallet_transfer_info>(by_index.begin(), by_index.end())));
+  }
+
+  void expect_indexes_consistent(tools::wallet2& rescanned, tools::wallet2& w)
+  {
+    ASSERT_NO_FATAL_FAILURE(expect_same_transfers(rescanned, w));
+    const uint64_t height = w.get_blockchain_current_height();
+    for (uint64_t min_height : { uint64_t(0), uint64_t(1), height / 3, height / 2, height - 2, height })
+    {
+      for (size_t i = 0; i != 3; ++i)
+        ASSERT_NO_FATAL_FAILURE(expect_same_payments(rescanned, w, make_payment_id(i), min_height));
+      ASSERT_NO_FATAL_FAILURE(expect_history_by_height_consistent(w, min_height, height));
+      ASSERT_NO_FATAL_FAILURE(expect_history_by_height_consistent(w, 0, min_height));
+      ASSERT_NO_FATAL_FAILURE(expect_history_by_height_consistent(w, min_height, min_height + 3));
+    }
+  }
+}
+
+TEST(wallet_indexes, match_rescan_after_reorg)
+{
+  const std::string path = prepare_test_dir("wallet_indexes_reorg");
+  std::shared_ptr<unit_test::wallet_test_core_proxy> proxy = std::make_shared<unit_test::wallet_test_core_proxy>();
+  std::shared_ptr<tools::wallet2> w = make_wallet(proxy);
+  w->generate(path, wallet_password);
+  add_blocks(*proxy, get_address(*w), 40);
+  w->refresh();
+  for (size_t i = 0; i != 5; ++i)
+  {
+    add_spending_block(*proxy, *w);
+    w->refresh();
+  }
+  add_blocks(*proxy, get_address(*w), 10);
+  w->refresh();
+
+  boost::system::error_code ec;
+  boost::filesystem::copy_file(path + ".keys", path + "_rescanned.keys", ec);
+  ASSERT_FALSE(ec);
+  std::shared_ptr<tools::wallet2> rescanned = load_wallet(path + "_rescanned", proxy);
+  rescanned->refresh();
+  ASSERT_NO_FATAL_FAILURE(expect_indexes_consistent(*rescanned, *w));
+
+  //two reorgs, the second one is deeper
+  for (size_t depth : { 4, 9 })
+  {
+    proxy->pop_blocks(depth);
+    add_blocks(*proxy, get_address(*w), depth + 2);
+    w->refresh();
+    ASSERT_EQ(proxy->get_height(), w->get_blockchain_current_height());
+
+    //rescanned wallet was never stored, it's loaded from keys again
+    rescanned = load_wallet(path + "_rescanned", proxy);
+    rescanned->refresh();
+    ASSERT_NO_FATAL_FAILURE(expect_indexes_consistent(*rescanned, *w));
+  }
+
+  //indexes rebuilt on load
+  w->store();
+  std::shared_ptr<tools::wallet2> loaded = load_wallet(path, proxy);
+  ASSERT_NO_FATAL_FAILURE(expect_indexes_consistent(*rescanned, *loaded));
+}
+
+TEST(wallet_indexes, payments_survive_rehash)
+{
+  const std::string path = prepare_test_dir("wallet_indexes_rehash");
+  std::shared_ptr<unit_test::wallet_test_core_proxy> proxy = std::make_shared<unit_test::wallet_test_core_proxy>();
+  std::shared_ptr<tools::wallet2> w = make_wallet(proxy);
+  w->generate(path, wallet_password);
+
+  //a payment id per block, the payments map is rehashed several times while growing
+  const size_t blocks_count = 300;
+  for (size_t i = 0; i != blocks_count; ++i)
+  {
+    proxy->add_block(get_address(*w), "rehash " + std::to_string(proxy->get_height()));
+    if (i % 7 == 0)
+      w->refresh();
+  }
+  w->refresh();
+
+  auto expect_payments = [&](const tools::wallet2& wallet)
+  {
+    for (size_t h = 1; h != wallet.get_blockchain_current_height(); ++h)
+    {
+      std::list<tools::wallet2::payment_details> payments;
+      wallet.get_payments("rehash " + std::to_string(h), payments);
+      ASSERT_EQ(1, payments.size());
+      const currency::transaction& miner_tx = proxy->get_block(h).miner_tx;
+      ASSERT_EQ(currency::get_transaction_hash(miner_tx), payments.front().m_tx_hash);
+      ASSERT_EQ(h, payments.front().m_block_height);
+      ASSERT_EQ(currency::get_outs_money_amount(miner_tx), payments.front().m_amount);
+      payments.clear();
+      wallet.get_payments("rehash " + std::to_string(h), payments, h);
+      ASSERT_TRUE(payments.empty());
+    }
+  };
+  ASSERT_NO_FATAL_FAILURE(expect_payments(*w));
+
+  //payments of detached blocks are erased from the map, the rest stay where they are
+  proxy->pop_blocks(100);
+  proxy->add_block(get_address(*w), "rehash " + std::to_string(proxy->get_height()));
+  w->refresh();
+  ASSERT_EQ(blocks_count - 98, w->get_blockchain_current_height());
+  ASSERT_NO_FATAL_FAILURE(expect_payments(*w));
+  std::list<tools::wallet2::payment_details> payments;
+  w->get_payments("rehash " + std::to_string(blocks_count - 1), payments);
+  ASSERT_TRUE(payments.empty());
+
+  w->store();
+  std::shared_ptr<tools::wallet2> loaded = load_wallet(path, proxy);
+  ASSERT_NO_FATAL_FAILURE(expect_payments(*loaded));
+}
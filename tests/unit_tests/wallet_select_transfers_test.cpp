@@ -7,7 +7,9 @@
 #include <cstdint>
 #include <vector>
 
+#include "crypto/crypto.h"
 #include "wallet/wallet2.h"
+#include "wallet/unspent_transfers_index.h"
 
 void set_testcase_free_amounts(std::map<uint64_t, std::list<size_t> >& free_amounts)
 {
@@ -56,4 +58,42 @@ TEST(wallet_select_indices_validate, wallet_select_indices_validate)
   set_testcase_free_amounts(found_free_amounts);
   ASSERT_EQ(0, tools::wallet2::select_indices_for_transfer(selected_indexes, found_free_amounts, 0));
 
-}
\ No newline at end of file
+}
+TEST(wallet_select_indices_validate, unspent_transfers_index_same_as_select_indices)
+{
+  for (size_t round = 0; round != 200; ++round)
+  {
+    const size_t fake_outputs_count = round % 4;
+    tools::unspent_transfers_index index;
+    std::map<uint64_t, std::list<size_t> > found_free_amounts;
+    std::vector<uint64_t> amounts;
+    for (size_t i = 0; i != 50; ++i)
+    {
+      uint64_t amount = crypto::rand<uint64_t>() % 20 + 1;
+      uint8_t mix_attr = static_cast<uint8_t>(crypto::rand<uint8_t>() % 5);
+      amounts.push_back(amount);
+      index.add(amount, mix_attr, i);
+      if (currency::is_mixattr_applicable_for_fake_outs_counter(mix_attr, fake_outputs_count))
+        found_free_amounts[amount].push_back(i);
+    }
+    //spend some of them
+    for (size_t i = 0; i < amounts.size(); i += 7)
+    {
+      ASSERT_TRUE(index.remove(amounts[i], i));
+      auto it = found_free_amounts.find(amounts[i]);
+      if (it != found_free_amounts.end())
+      {
+        it->second.remove(i);
+        if (it->second.empty())
+          found_free_amounts.erase(it);
+      }
+    }
+    ASSERT_FALSE(index.remove(amounts[0], 0));
+
+    const uint64_t needed_money = crypto::rand<uint64_t>() % 500;
+    std::list<size_t> expected, selected;
+    uint64_t expected_money = tools::wallet2::select_indices_for_transfer(expected, found_free_amounts, needed_money);
+    ASSERT_EQ(expected_money, index.select(needed_money, fake_outputs_count, selected));
+    ASSERT_EQ(expected, selected);
+  }
+}
@@ -0,0 +1,171 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#pragma once
+
+#include <ctime>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "currency_core/currency_format_utils.h"
+#include "wallet/core_rpc_proxy.h"
+
+namespace unit_test
+{
+  /************************************************************************/
+  /* In-memory blockchain served to a wallet instead of a daemon. Blocks  */
+  /* aren't mined, wallet doesn't check it. Pool changes response is set  */
+  /* by the test.                                                         */
+  /************************************************************************/
+  class wallet_test_core_proxy : public tools::i_core_proxy
+  {
+  public:
+    wallet_test_core_proxy() : m_last_pool_since_version(0), m_next_global_index(0)
+    {
+      m_pool_changes = AUTO_VAL_INIT(m_pool_changes);
+      m_pool_changes.status = CORE_RPC_STATUS_OK;
+      chain_entry ce = AUTO_VAL_INIT(ce);
+      currency::generate_genesis_block(ce.b);
+      m_chain.push_back(ce);
+    }
+
+    //appends a block with a miner tx paying to addr, with payment id if given, and transactions txs
+    const currency::block& add_block(const currency::account_public_address& addr, const currency::payment_id_t& payment_id = currency::payment_id_t(),
+      const std::list<currency::transaction>& txs = std::list<currency::transaction>())
+    {
+      chain_entry ce = AUTO_VAL_INIT(ce);
+      ce.b.major_version = CURRENT_BLOCK_MAJOR_VERSION;
+      ce.b.minor_version = CURRENT_BLOCK_MINOR_VERSION;
+      ce.b.timestamp = time(nullptr);
+      ce.b.prev_id = currency::get_block_hash(m_chain.back().b);
+      ce.b.miner_tx = make_tx_to(addr, m_chain.size(), payment_id);
+      ce.txs = txs;
+      add_global_outs(ce.b.miner_tx, ce.outs);
+      for (const auto& tx : txs)
+      {
+        ce.b.tx_hashes.push_back(currency::get_transaction_hash(tx));
+        add_global_outs(tx, ce.outs);
+      }
+      m_chain.push_back(ce);
+      return m_chain.back().b;
+    }
+
+    //drops blocks from the top, new ones may be added then as an alternative chain
+    void pop_blocks(size_t count)
+    {
+      m_chain.resize(m_chain.size() - count);
+    }
+
+    size_t get_height() const { return m_chain.size(); }
+    const currency::block& get_block(size_t height) const { return m_chain[height].b; }
+
+    //coinbase-like transaction paying to addr, wallet handles it as any other one; seed makes it unique
+    static currency::transaction make_tx_to(const currency::account_public_address& addr, uint64_t seed, const currency::payment_id_t& payment_id = currency::payment_id_t())
+    {
+      currency::blobdata extra_nonce;
+      if (payment_id.size())
+      {
+        extra_nonce.push_back(TX_USER_DATA_TAG_PAYMENT_ID);
+        extra_nonce.push_back(static_cast<char>(payment_id.size()));
+        extra_nonce += payment_id;
+      }
+      currency::transaction tx = AUTO_VAL_INIT(tx);
+      currency::construct_miner_tx(static_cast<size_t>(seed), 0, 0, 0, 0, addr, tx, extra_nonce);
+      return tx;
+    }
+
+    //transaction spending an output with given key image to nowhere; signatures are not checked by wallet
+    static currency::transaction make_spend_tx(const crypto::key_image& ki, uint64_t amount)
+    {
+      currency::transaction tx = AUTO_VAL_INIT(tx);
+      tx.version = CURRENT_TRANSACTION_VERSION;
+      currency::add_tx_pub_key_to_extra(tx, currency::keypair::generate().pub);
+      currency::txin_to_key in = AUTO_VAL_INIT(in);
+      in.amount = amount;
+      in.key_offsets.push_back(0);
+      in.k_image = ki;
+      tx.vin.push_back(in);
+      tx.signatures.push_back(std::vector<crypto::signature>(1));
+      currency::txout_to_key out_target = AUTO_VAL_INIT(out_target);
+      out_target.key = currency::keypair::generate().pub;
+      currency::tx_out out = AUTO_VAL_INIT(out);
+      out.amount = amount;
+      out.target = out_target;
+      tx.vout.push_back(out);
+      return tx;
+    }
+
+    currency::COMMAND_RPC_GET_POOL_CHANGES::response m_pool_changes;  // returned by every get_pool_changes call
+    uint64_t m_last_pool_since_version;                                // since_version of the last get_pool_changes call
+
+    // interface i_core_proxy
+    virtual bool set_connection_addr(const std::string& url) override { return true; }
+    virtual bool call_COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES(const currency::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::request& rqt, currency::COMMAND_RPC_GET_TX_GLOBAL_OUTPUTS_INDEXES::response& rsp) override { return false; }
+    virtual bool call_COMMAND_RPC_GET_BLOCKS_FAST(const currency::COMMAND_RPC_GET_BLOCKS_FAST::request& rqt, currency::COMMAND_RPC_GET_BLOCKS_FAST::response& rsp) override
+    {
+      //the same as the daemon does: from the last known block, including it
+      std::unordered_map<crypto::hash, size_t> heights;
+      for (size_t i = 0; i != m_chain.size(); ++i)
+        heights[currency::get_block_hash(m_chain[i].b)] = i;
+      auto start_it = rqt.block_ids.end();
+      for (auto it = rqt.block_ids.begin(); it != rqt.block_ids.end() && start_it == rqt.block_ids.end(); ++it)
+        if (heights.count(*it))
+          start_it = it;
+      if (start_it == rqt.block_ids.end())
+        return false;
+
+      rsp.start_height = heights[*start_it];
+      rsp.current_height = m_chain.size();
+      for (size_t i = static_cast<size_t>(rsp.start_height); i != m_chain.size(); ++i)
+      {
+        currency::block_complete_entry bce;
+        bce.block = currency::block_to_blob(m_chain[i].b);
+        for (const auto& tx : m_chain[i].txs)
+          bce.txs.push_back(currency::tx_to_blob(tx));
+        rsp.blocks.push_back(bce);
+        if (rqt.need_global_indexes)
+          rsp.blocks_global_outs.push_back(m_chain[i].outs);
+      }
+      rsp.status = CORE_RPC_STATUS_OK;
+      return true;
+    }
+    virtual bool call_COMMAND_RPC_GET_INFO(const currency::COMMAND_RPC_GET_INFO::request& rqt, currency::COMMAND_RPC_GET_INFO::response& rsp) override { return false; }
+    virtual bool call_COMMAND_RPC_GET_TX_POOL(const currency::COMMAND_RPC_GET_TX_POOL::request& rqt, currency::COMMAND_RPC_GET_TX_POOL::response& rsp) override { return false; }
+    virtual bool call_COMMAND_RPC_GET_POOL_CHANGES(const currency::COMMAND_RPC_GET_POOL_CHANGES::request& rqt, currency::COMMAND_RPC_GET_POOL_CHANGES::response& rsp) override
+    {
+      m_last_pool_since_version = rqt.since_version;
+      rsp = m_pool_changes;
+      return true;
+    }
+    virtual bool call_COMMAND_RPC_GET_ALIASES_BY_ADDRESS(const currency::COMMAND_RPC_GET_ALIASES_BY_ADDRESS::request& rqt, currency::COMMAND_RPC_GET_ALIASES_BY_ADDRESS::response& rsp) override { return false; }
+    virtual bool call_COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS(const currency::COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::request& rqt, currency::COMMAND_RPC_GET_RANDOM_OUTPUTS_FOR_AMOUNTS::response& rsp) override { return false; }
+    virtual bool call_COMMAND_RPC_SEND_RAW_TX(const currency::COMMAND_RPC_SEND_RAW_TX::request& rqt, currency::COMMAND_RPC_SEND_RAW_TX::response& rsp) override { return false; }
+    virtual bool call_COMMAND_RPC_GET_ALL_ALIASES(currency::COMMAND_RPC_GET_ALL_ALIASES::response& rsp) override { return false; }
+    virtual bool call_COMMAND_RPC_GET_ALIAS_DETAILS(const currency::COMMAND_RPC_GET_ALIAS_DETAILS::request& req, currency::COMMAND_RPC_GET_ALIAS_DETAILS::response& rsp) override { return false; }
+    virtual bool call_COMMAND_RPC_GET_TRANSACTIONS(const currency::COMMAND_RPC_GET_TRANSACTIONS::request& req, currency::COMMAND_RPC_GET_TRANSACTIONS::response& rsp) override { return false; }
+    virtual bool call_COMMAND_RPC_COMMAND_RPC_CHECK_KEYIMAGES(const currency::COMMAND_RPC_CHECK_KEYIMAGES::request& req, currency::COMMAND_RPC_CHECK_KEYIMAGES::response& rsp) override { return false; }
+    virtual bool call_COMMAND_RPC_VALIDATE_SIGNED_TEXT(const currency::COMMAND_RPC_VALIDATE_SIGNED_TEXT::request& req, currency::COMMAND_RPC_VALIDATE_SIGNED_TEXT::response& rsp) override { return false; }
+    virtual bool check_connection() override { return true; }
+    virtual bool get_transfer_address(const std::string& adr_str, currency::account_public_address& addr, currency::payment_id_t& payment_id) override { return false; }
+
+  private:
+    struct chain_entry
+    {
+      currency::block b;
+      std::list<currency::transaction> txs;
+      currency::COMMAND_RPC_GET_BLOCKS_FAST::block_global_outs outs;
+    };
+
+    void add_global_outs(const currency::transaction& tx, currency::COMMAND_RPC_GET_BLOCKS_FAST::block_global_outs& outs)
+    {
+      outs.txs.push_back(currency::COMMAND_RPC_GET_BLOCKS_FAST::tx_global_outs());
+      for (size_t i = 0; i != tx.vout.size(); ++i)
+        outs.txs.back().indexes.push_back(m_next_global_index++);
+    }
+
+    std::vector<chain_entry> m_chain;
+    uint64_t m_next_global_index;
+  };
+}
@@ -0,0 +1,149 @@
+// Copyright (c) 2012-2018 The Boolberry developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "gtest/gtest.h"
+
+#include <memory>
+#include <boost/filesystem.hpp>
+
+#include "wallet/wallet2.h"
+#include "wallet_test_core_proxy.h"
+
+namespace
+{
+  struct transfers_counter : public tools::i_wallet2_callback
+  {
+    transfers_counter() : count(0) {}
+    virtual void on_transfer2(const tools::wallet_rpc::wallet_transfer_info& wti) override { ++count; }
+    size_t count;
+  };
+
+  class wallet_tx_pool : public ::testing::Test
+  {
+  protected:
+    virtual void SetUp() override
+    {
+      boost::system::error_code ec;
+      boost::filesystem::remove_all("wallet_tx_pool_test", ec);
+      boost::filesystem::create_directory("wallet_tx_pool_test", ec);
+      m_proxy = std::make_shared<unit_test::wallet_test_core_proxy>();
+      std::shared_ptr<tools::i_core_proxy> core_proxy = m_proxy;
+      m_wallet.set_core_proxy(core_proxy);
+      m_wallet.generate("wallet_tx_pool_test/wallet", "pass");
+      m_wallet.callback(&m_counter);
+      m_address = m_wallet.get_account().get_keys().m_account_address;
+    }
+
+    //pool changes the daemon answers with on the next scan
+    void set_pool_changes(uint64_t version, bool full, const std::list<crypto::hash>& removed_ids, const std::list<currency::transaction>& txs)
+    {
+      m_proxy->m_pool_changes.version = version;
+      m_proxy->m_pool_changes.full = full;
+      m_proxy->m_pool_changes.removed_ids = removed_ids;
+      m_proxy->m_pool_changes.txs.clear();
+      for (const auto& tx : txs)
+        m_proxy->m_pool_changes.txs.push_back(currency::tx_to_blob(tx));
+    }
+
+    size_t get_pool_transfers_count()
+    {
+      tools::wallet_rpc::COMMAND_RPC_GET_TRANSFERS::request req = AUTO_VAL_INIT(req);
+      tools::wallet_rpc::COMMAND_RPC_GET_TRANSFERS::response res = AUTO_VAL_INIT(res);
+      req.pool = true;
+      m_wallet.get_transfers(req, res);
+      return res.pool.size();
+    }
+
+    std::shared_ptr<unit_test::wallet_test_core_proxy> m_proxy;
+    tools::wallet2 m_wallet;
+    transfers_counter m_counter;
+    currency::account_public_address m_address;
+  };
+
+  int64_t get_amount(const currency::transaction& tx)
+  {
+    return static_cast<int64_t>(currency::get_outs_money_amount(tx));
+  }
+}
+
+TEST_F(wallet_tx_pool, removals_are_applied_before_additions)
+{
+  const currency::transaction tx_a = unit_test::wallet_test_core_proxy::make_tx_to(m_address, 1);
+  const currency::transaction tx_b = unit_test::wallet_test_core_proxy::make_tx_to(m_address, 2);
+  const crypto::hash tx_a_id = currency::get_transaction_hash(tx_a);
+
+  set_pool_changes(10, true, std::list<crypto::hash>(), std::list<currency::transaction>(1, tx_a));
+  m_wallet.scan_tx_pool();
+  ASSERT_EQ(0, m_proxy->m_last_pool_since_version);
+  ASSERT_EQ(get_amount(tx_a), m_wallet.unconfirmed_balance());
+  ASSERT_EQ(1, m_counter.count);
+
+  //tx_a left the pool and came back (e.g. its block was popped)
+  set_pool_changes(11, false, std::list<crypto::hash>(1, tx_a_id), { tx_a, tx_b });
+  m_wallet.scan_tx_pool();
+  ASSERT_EQ(10, m_proxy->m_last_pool_since_version);
+  ASSERT_EQ(get_amount(tx_a) + get_amount(tx_b), m_wallet.unconfirmed_balance());
+  ASSERT_EQ(2, get_pool_transfers_count());
+
+  set_pool_changes(12, false, std::list<crypto::hash>(1, tx_a_id), std::list<currency::transaction>());
+  m_wallet.scan_tx_pool();
+  ASSERT_EQ(11, m_proxy->m_last_pool_since_version);
+  ASSERT_EQ(get_amount(tx_b), m_wallet.unconfirmed_balance());
+  ASSERT_EQ(1, get_pool_transfers_count());
+
+  //nothing changed
+  set_pool_changes(12, false, std::list<crypto::hash>(), std::list<currency::transaction>());
+  m_wallet.scan_tx_pool();
+  ASSERT_EQ(12, m_proxy->m_last_pool_since_version);
+  ASSERT_EQ(get_amount(tx_b), m_wallet.unconfirmed_balance());
+}
+
+TEST_F(wallet_tx_pool, full_response_resets_pool_state)
+{
+  const currency::transaction tx_a = unit_test::wallet_test_core_proxy::make_tx_to(m_address, 1);
+  const currency::transaction tx_b = unit_test::wallet_test_core_proxy::make_tx_to(m_address, 2);
+  const currency::transaction tx_c = unit_test::wallet_test_core_proxy::make_tx_to(m_address, 3);
+
+  set_pool_changes(10, false, std::list<crypto::hash>(), { tx_a, tx_b });
+  m_wallet.scan_tx_pool();
+  ASSERT_EQ(get_amount(tx_a) + get_amount(tx_b), m_wallet.unconfirmed_balance());
+  ASSERT_EQ(2, m_counter.count);
+
+  //daemon restarted: since_version is unknown, removal of tx_a is not reported, the whole pool comes instead
+  set_pool_changes(1000, true, std::list<crypto::hash>(), { tx_b, tx_c });
+  m_wallet.scan_tx_pool();
+  ASSERT_EQ(10, m_proxy->m_last_pool_since_version);
+  ASSERT_EQ(get_amount(tx_b) + get_amount(tx_c), m_wallet.unconfirmed_balance());
+  ASSERT_EQ(2, get_pool_transfers_count());
+  //tx_b is known already, only tx_c is new
+  ASSERT_EQ(3, m_counter.count);
+
+  set_pool_changes(1001, true, std::list<crypto::hash>(), std::list<currency::transaction>());
+  m_wallet.scan_tx_pool();
+  ASSERT_EQ(1000, m_proxy->m_last_pool_since_version);
+  ASSERT_EQ(0, m_wallet.unconfirmed_balance());
+  ASSERT_EQ(0, get_pool_transfers_count());
+}
+
+TEST_F(wallet_tx_pool, failed_scan_keeps_version)
+{
+  const currency::transaction tx_a = unit_test::wallet_test_core_proxy::make_tx_to(m_address, 1);
+  set_pool_changes(10, true, std::list<crypto::hash>(), std::list<currency::transaction>(1, tx_a));
+  m_wallet.scan_tx_pool();
+
+  m_proxy->m_pool_changes.status = CORE_RPC_STATUS_BUSY;
+  ASSERT_ANY_THROW(m_wallet.scan_tx_pool());
+  m_proxy->m_pool_changes.status = CORE_RPC_STATUS_OK;
+  ASSERT_EQ(get_amount(tx_a), m_wallet.unconfirmed_balance());
+
+  //broken full response: the whole pool is requested again next time
+  set_pool_changes(20, true, std::list<crypto::hash>(), std::list<currency::transaction>());
+  m_proxy->m_pool_changes.txs.push_back("not a transaction");
+  ASSERT_ANY_THROW(m_wallet.scan_tx_pool());
+  ASSERT_EQ(10, m_proxy->m_last_pool_since_version);
+  set_pool_changes(21, false, std::list<crypto::hash>(), std::list<currency::transaction>(1, tx_a));
+  m_wallet.scan_tx_pool();
+  ASSERT_EQ(0, m_proxy->m_last_pool_since_version);
+  ASSERT_EQ(get_amount(tx_a), m_wallet.unconfirmed_balance());
+}